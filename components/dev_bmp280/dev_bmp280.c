@@ -0,0 +1,303 @@
+// @file    dev_bmp280.c
+//
+// @brief  Bosch BMP280 driver on the SYS_I2C API. See dev_bmp280.h.
+//
+// @details
+// Register map and compensation: BST-BMP280-DS001, sections 3.11.3, 4.2, 4.3, 8.2.
+// Plain sys_i2c_read() / sys_i2c_write() only: every access is one locked transaction, nothing is held across a
+// conversion.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+static const char * TAG = "dev_bmp280";
+#include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
+#include "dev_bmp280.h" // includes app_config.h, sys_i2c.h
+
+#include <stdio.h> // printf()
+#include <string.h> // memset()
+#include "esp_timer.h" // esp_timer_get_time()
+#include "freertos/task.h" // vTaskDelay()
+
+#define DEV_BMP280_REG_CALIB        (0x88U) // 24 bytes, dig_T1 .. dig_P9
+#define DEV_BMP280_REG_ID           (0xD0U)
+#define DEV_BMP280_REG_RESET        (0xE0U)
+#define DEV_BMP280_REG_CTRL_MEAS    (0xF4U) // osrs_t[7:5], osrs_p[4:2], mode[1:0]
+#define DEV_BMP280_REG_CONFIG       (0xF5U) // t_sb[7:5], filter[4:2], spi3w_en[0]
+#define DEV_BMP280_REG_PRESS        (0xF7U) // press_msb, press_lsb, press_xlsb, temp_msb, temp_lsb, temp_xlsb
+#define DEV_BMP280_REG_TEMP         (0xFAU)
+
+#define DEV_BMP280_CHIP_ID          (0x58U)
+#define DEV_BMP280_RESET_WORD       (0xB6U)
+#define DEV_BMP280_MODE_FORCED      (0x01U)
+#define DEV_BMP280_CALIB_SIZE       (24U)
+#define DEV_BMP280_BURST_SIZE       (6U)
+#define DEV_BMP280_ADC_SKIPPED      (0x80000)
+#define DEV_BMP280_STARTUP_US       (2000U) // power on reset to first access
+
+// Datasheet 3.8.1 maximum measurement time, microseconds: 1250 + 2300 * T_os + (2300 * P_os + 575)
+#define DEV_BMP280_MEAS_BASE_US     (1250U)
+#define DEV_BMP280_MEAS_OS_US       (2300U)
+#define DEV_BMP280_MEAS_PRESS_US    (575U)
+
+static bool dev_bmp280_burst(struct DEV_BMP280 * dev_addr, struct DEV_BMP280_SAMPLE * sample_addr);
+static uint32_t dev_bmp280_os_cnt(uint8_t osrs);
+static void dev_bmp280_wait_until(int64_t ready_us);
+
+bool dev_bmp280_init(struct DEV_BMP280 * dev_addr, uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t osrs_t, uint8_t osrs_p, uint8_t filter)
+{
+    TRACE_ENTER;
+    uint8_t calib_buf[DEV_BMP280_CALIB_SIZE];
+    uint8_t reg_val;
+
+    if (!dev_addr) { goto fail; }
+    dev_addr->ready_flag = false;
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    if ((DEV_BMP280_OSRS_SKIP == osrs_t) || (DEV_BMP280_OSRS_X16 < osrs_t)) { goto fail; } // pressure needs t_fine
+    if (DEV_BMP280_OSRS_X16 < osrs_p) { goto fail; }
+    if (DEV_BMP280_FILTER_16 < filter) { goto fail; }
+
+    // 1A Chip id, then soft reset: known state whatever ran before.
+    if (!sys_i2c_read(sys_i2c_id, i2c_addr_num, DEV_BMP280_REG_ID, &reg_val, 1)) { goto fail; }
+    if (DEV_BMP280_CHIP_ID != reg_val) { goto fail; }
+    reg_val = DEV_BMP280_RESET_WORD;
+    if (!sys_i2c_write(sys_i2c_id, i2c_addr_num, DEV_BMP280_REG_RESET, &reg_val, 1)) { goto fail; }
+    dev_bmp280_wait_until(esp_timer_get_time() + DEV_BMP280_STARTUP_US);
+
+    // 2A Calibration block, one read, little endian pairs.
+    if (!sys_i2c_read(sys_i2c_id, i2c_addr_num, DEV_BMP280_REG_CALIB, calib_buf, sizeof(calib_buf))) { goto fail; }
+    #define DEV_BMP280_LE16(idx)    ((uint16_t)(calib_buf[(idx)] | (calib_buf[(idx) + 1] << 8)))
+    dev_addr->calib = (struct DEV_BMP280_CALIB) {
+        .dig_t1 = DEV_BMP280_LE16(0),           .dig_t2 = (int16_t)DEV_BMP280_LE16(2),  .dig_t3 = (int16_t)DEV_BMP280_LE16(4),
+        .dig_p1 = DEV_BMP280_LE16(6),           .dig_p2 = (int16_t)DEV_BMP280_LE16(8),  .dig_p3 = (int16_t)DEV_BMP280_LE16(10),
+        .dig_p4 = (int16_t)DEV_BMP280_LE16(12), .dig_p5 = (int16_t)DEV_BMP280_LE16(14), .dig_p6 = (int16_t)DEV_BMP280_LE16(16),
+        .dig_p7 = (int16_t)DEV_BMP280_LE16(18), .dig_p8 = (int16_t)DEV_BMP280_LE16(20), .dig_p9 = (int16_t)DEV_BMP280_LE16(22),
+    };
+    #undef DEV_BMP280_LE16
+    if (!dev_addr->calib.dig_t1 || !dev_addr->calib.dig_p1) { goto fail; } // all zero: not a trimmed part, or a bad read
+
+    // 3A Filter, then oversampling with sleep mode: config is only written reliably in sleep mode.
+    reg_val = (uint8_t)(filter << 2);
+    if (!sys_i2c_write(sys_i2c_id, i2c_addr_num, DEV_BMP280_REG_CONFIG, &reg_val, 1)) { goto fail; }
+    reg_val = (uint8_t)((osrs_t << 5) | (osrs_p << 2));
+    if (!sys_i2c_write(sys_i2c_id, i2c_addr_num, DEV_BMP280_REG_CTRL_MEAS, &reg_val, 1)) { goto fail; }
+
+    const uint32_t os_p = dev_bmp280_os_cnt(osrs_p);
+    dev_addr->sys_i2c_id    = sys_i2c_id;
+    dev_addr->i2c_addr_num  = i2c_addr_num;
+    dev_addr->ctrl_meas     = reg_val;
+    dev_addr->meas_us       = DEV_BMP280_MEAS_BASE_US + (DEV_BMP280_MEAS_OS_US * dev_bmp280_os_cnt(osrs_t))
+                            + ((os_p) ? ((DEV_BMP280_MEAS_OS_US * os_p) + DEV_BMP280_MEAS_PRESS_US) : 0);
+    dev_addr->ready_us      = 0;
+    dev_addr->ready_flag    = true;
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: dev_bmp280_init()
+
+bool dev_bmp280_force_start(struct DEV_BMP280 * dev_addr)
+{
+    TRACE_ENTER;
+    uint8_t reg_val;
+
+    if (!dev_addr || !dev_addr->ready_flag) { goto fail; }
+    dev_addr->ready_us = 0;
+
+    reg_val = dev_addr->ctrl_meas | DEV_BMP280_MODE_FORCED;
+    if (!sys_i2c_write(dev_addr->sys_i2c_id, dev_addr->i2c_addr_num, DEV_BMP280_REG_CTRL_MEAS, &reg_val, 1)) { goto fail; }
+    dev_addr->ready_us = esp_timer_get_time() + dev_addr->meas_us;
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: dev_bmp280_force_start()
+
+bool dev_bmp280_force_read(struct DEV_BMP280 * dev_addr, struct DEV_BMP280_SAMPLE * sample_addr)
+{
+    TRACE_ENTER;
+    if (!dev_addr || !dev_addr->ready_flag) { goto fail; }
+    if (!dev_addr->ready_us) { goto fail; } // dev_bmp280_force_start() not run, or failed
+
+    dev_bmp280_wait_until(dev_addr->ready_us); // I2C Bus free meanwhile
+    dev_addr->ready_us = 0;
+    if (!dev_bmp280_burst(dev_addr, sample_addr)) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: dev_bmp280_force_read()
+
+// @brief Start all, then read all in start order: that is also conversion done order.
+//
+bool dev_bmp280_force_all(struct DEV_BMP280 * const * dev_addr, struct DEV_BMP280_SAMPLE * sample_addr, size_t dev_cnt)
+{
+    TRACE_ENTER;
+    bool pass_flag = true;
+    size_t idx;
+
+    if (!dev_addr || !sample_addr || !dev_cnt) { goto fail; }
+
+    for (idx = 0; dev_cnt > idx; ++idx) {
+        if (!dev_bmp280_force_start(dev_addr[idx])) { pass_flag = false; }
+    }
+    for (idx = 0; dev_cnt > idx; ++idx) {
+        memset(&sample_addr[idx], 0, sizeof(sample_addr[idx]));
+        if (!dev_addr[idx] || !dev_addr[idx]->ready_us) { continue; } // start failed, already counted
+        if (!dev_bmp280_force_read(dev_addr[idx], &sample_addr[idx])) { pass_flag = false; }
+    }
+    if (!pass_flag) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: dev_bmp280_force_all()
+
+bool dev_bmp280_read(struct DEV_BMP280 * dev_addr, struct DEV_BMP280_SAMPLE * sample_addr)
+{
+    TRACE_ENTER;
+    if (!dev_addr || !dev_addr->ready_flag) { goto fail; }
+    if (!dev_bmp280_burst(dev_addr, sample_addr)) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: dev_bmp280_read()
+
+// @brief Datasheet 8.2: bmp280_compensate_T_int32(), bmp280_compensate_P_int64().
+// Left shifts of signed values written as multiplies: same results, no undefined behavior on negatives.
+//
+void dev_bmp280_compensate(const struct DEV_BMP280_CALIB * calib_addr, int32_t adc_t, int32_t adc_p, struct DEV_BMP280_SAMPLE * sample_addr)
+{
+    const struct DEV_BMP280_CALIB * const c = calib_addr;
+    int32_t t_var1;
+    int32_t t_var2;
+    int64_t p_var1;
+    int64_t p_var2;
+    int64_t p;
+
+    t_var1 = ((((adc_t >> 3) - ((int32_t)c->dig_t1 * 2))) * ((int32_t)c->dig_t2)) >> 11;
+    t_var2 = (((((adc_t >> 4) - ((int32_t)c->dig_t1)) * ((adc_t >> 4) - ((int32_t)c->dig_t1))) >> 12) * ((int32_t)c->dig_t3)) >> 14;
+    sample_addr->t_fine       = t_var1 + t_var2;
+    sample_addr->temp_centi_c = (sample_addr->t_fine * 5 + 128) >> 8;
+
+    sample_addr->press_q24_8 = 0;
+    if (DEV_BMP280_ADC_SKIPPED == adc_p) { return; }
+
+    p_var1 = ((int64_t)sample_addr->t_fine) - 128000;
+    p_var2 = p_var1 * p_var1 * (int64_t)c->dig_p6;
+    p_var2 = p_var2 + ((p_var1 * (int64_t)c->dig_p5) * (1LL << 17));
+    p_var2 = p_var2 + (((int64_t)c->dig_p4) * (1LL << 35));
+    p_var1 = ((p_var1 * p_var1 * (int64_t)c->dig_p3) >> 8) + ((p_var1 * (int64_t)c->dig_p2) * (1LL << 12));
+    p_var1 = (((1LL << 47) + p_var1) * ((int64_t)c->dig_p1)) >> 33;
+    if (!p_var1) { return; } // avoid division by zero
+    p = 1048576 - adc_p;
+    p = (((p * (1LL << 31)) - p_var2) * 3125) / p_var1;
+    p_var1 = (((int64_t)c->dig_p9) * (p >> 13) * (p >> 13)) >> 25;
+    p_var2 = (((int64_t)c->dig_p8) * p) >> 19;
+    p = ((p + p_var1 + p_var2) >> 8) + (((int64_t)c->dig_p7) * (1LL << 4));
+    sample_addr->press_q24_8 = (uint32_t)p;
+} // end: dev_bmp280_compensate()
+
+// @brief Interleaved, so drift in bus load hits both read paths alike. Forced cycles last: they sleep.
+//
+bool dev_bmp280_bench(struct DEV_BMP280 * dev_addr, uint32_t loop_cnt)
+{
+    TRACE_ENTER;
+    struct DEV_BMP280_SAMPLE sample;
+    uint8_t raw_buf[DEV_BMP280_BURST_SIZE];
+    int64_t burst_us = 0;
+    int64_t split_us = 0;
+    int64_t forced_us;
+    int64_t at_us;
+    uint32_t loop_idx;
+
+    if (!dev_addr || !dev_addr->ready_flag) { goto fail; }
+    if (!loop_cnt) { goto fail; }
+
+    for (loop_idx = 0; loop_cnt > loop_idx; ++loop_idx) {
+        at_us = esp_timer_get_time();
+        if (!dev_bmp280_burst(dev_addr, &sample)) { goto fail; }
+        burst_us += esp_timer_get_time() - at_us;
+
+        // Typical driver: temperature registers, then pressure registers, two transactions.
+        at_us = esp_timer_get_time();
+        if (!sys_i2c_read(dev_addr->sys_i2c_id, dev_addr->i2c_addr_num, DEV_BMP280_REG_TEMP, &raw_buf[3], 3)) { goto fail; }
+        if (!sys_i2c_read(dev_addr->sys_i2c_id, dev_addr->i2c_addr_num, DEV_BMP280_REG_PRESS, &raw_buf[0], 3)) { goto fail; }
+        dev_bmp280_compensate(&dev_addr->calib, (raw_buf[3] << 12) | (raw_buf[4] << 4) | (raw_buf[5] >> 4),
+                              (raw_buf[0] << 12) | (raw_buf[1] << 4) | (raw_buf[2] >> 4), &sample);
+        split_us += esp_timer_get_time() - at_us;
+    }
+
+    at_us = esp_timer_get_time();
+    for (loop_idx = 0; loop_cnt > loop_idx; ++loop_idx) {
+        if (!dev_bmp280_force_start(dev_addr)) { goto fail; }
+        if (!dev_bmp280_force_read(dev_addr, &sample)) { goto fail; }
+    }
+    forced_us = esp_timer_get_time() - at_us;
+
+    printf("\nBMP280 BENCH: SYS_I2C Bus = %d, i2c_addr = 0x%02X, %u samples each, conversion max = %u us\n",
+           dev_addr->sys_i2c_id, dev_addr->i2c_addr_num, loop_cnt, dev_addr->meas_us);
+    printf("%-22s %9u samples/s, %6u us each\n", "6 byte burst", (burst_us) ? (uint32_t)((1000000LL * loop_cnt) / burst_us) : 0,
+           (uint32_t)(burst_us / loop_cnt));
+    printf("%-22s %9u samples/s, %6u us each\n", "T, then P, two reads", (split_us) ? (uint32_t)((1000000LL * loop_cnt) / split_us) : 0,
+           (uint32_t)(split_us / loop_cnt));
+    printf("%-22s %9u samples/s, %6u us each\n", "forced mode cycle", (forced_us) ? (uint32_t)((1000000LL * loop_cnt) / forced_us) : 0,
+           (uint32_t)(forced_us / loop_cnt));
+    printf("last sample: %d.%02d C, %u Pa\n\n", sample.temp_centi_c / 100, (sample.temp_centi_c < 0) ? -(sample.temp_centi_c % 100) : (sample.temp_centi_c % 100),
+           sample.press_q24_8 >> 8);
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: dev_bmp280_bench()
+
+// @brief One 6 byte burst from 0xF7, pressure then temperature, 20 bit each; compensate.
+//
+static bool dev_bmp280_burst(struct DEV_BMP280 * dev_addr, struct DEV_BMP280_SAMPLE * sample_addr)
+{
+    uint8_t raw_buf[DEV_BMP280_BURST_SIZE];
+
+    if (!sample_addr) { return (false); }
+    if (!sys_i2c_read(dev_addr->sys_i2c_id, dev_addr->i2c_addr_num, DEV_BMP280_REG_PRESS, raw_buf, sizeof(raw_buf))) { return (false); }
+
+    const int32_t adc_p = (raw_buf[0] << 12) | (raw_buf[1] << 4) | (raw_buf[2] >> 4);
+    const int32_t adc_t = (raw_buf[3] << 12) | (raw_buf[4] << 4) | (raw_buf[5] >> 4);
+    if (DEV_BMP280_ADC_SKIPPED == adc_t) { return (false); } // no conversion since reset
+    dev_bmp280_compensate(&dev_addr->calib, adc_t, adc_p, sample_addr);
+    return (true);
+} // end: dev_bmp280_burst()
+
+// @brief Oversampling register value to sample count: 0, 1, 2, 4, 8, 16.
+//
+static uint32_t dev_bmp280_os_cnt(uint8_t osrs)
+{
+    return ((osrs) ? (1U << (osrs - 1)) : 0);
+} // end: dev_bmp280_os_cnt()
+
+// @brief Sleep until esp_timer_get_time() >= ready_us. Whole ticks first; the last part of a tick sleeps one tick.
+//
+static void dev_bmp280_wait_until(int64_t ready_us)
+{
+    const int64_t tick_us = 1000LL * portTICK_PERIOD_MS;
+    int64_t left_us;
+
+    while (0 < (left_us = ready_us - esp_timer_get_time())) {
+        const TickType_t tick_cnt = (TickType_t)(left_us / tick_us);
+        vTaskDelay((tick_cnt) ? tick_cnt : 1);
+    }
+} // end: dev_bmp280_wait_until()
+
+/* EOF dev_bmp280.c */
@@ -0,0 +1,139 @@
+//! @file   dev_bmp280.h
+//!
+//! @brief  Bosch BMP280 temperature / pressure sensor on a SYS_I2C Bus. Integer compensation, one burst per sample.
+//!
+//! @details
+//! - Init reads the chip id and the 24 byte calibration block, 0x88 - 0x9F, once, in one read; kept in struct DEV_BMP280.
+//! - Each sample is one 6 byte burst from 0xF7: press_msb, press_lsb, press_xlsb, temp_msb, temp_lsb, temp_xlsb.
+//!   Temperature and pressure of one sample come from the same conversion, the shadow registers lock during a burst.
+//! - Compensation: the datasheet 32 bit integer temperature and 64 bit integer pressure formulas. No floating point.
+//!   dev_bmp280_compensate() is a pure function of the calibration and the raw ADC values.
+//!
+//! Forced mode, one conversion per request: dev_bmp280_force_start() writes ctrl_meas and returns; the conversion
+//! runs in the sensor, the I2C Bus is free for other traffic meanwhile. dev_bmp280_force_read() sleeps only for what
+//! is left of the datasheet maximum conversion time, then does the burst. dev_bmp280_force_all() starts every
+//! sensor of a list first, then collects them: N sensors cost one conversion time, not N.
+//!
+//! How to use:
+//!
+//!     static struct DEV_BMP280 bmp;
+//!     struct DEV_BMP280_SAMPLE sample;
+//!     if (!dev_bmp280_init(&bmp, SYS_I2C_ID_04, DEV_BMP280_ADDR_HI, DEV_BMP280_OSRS_X2, DEV_BMP280_OSRS_X16, DEV_BMP280_FILTER_4)) { goto fail; }
+//!     for (;;) {
+//!         if (!dev_bmp280_force_start(&bmp)) { goto fail; }
+//!         ... other I2C Bus traffic ...
+//!         if (!dev_bmp280_force_read(&bmp, &sample)) { goto fail; }
+//!         printf("%d.%02d C, %u Pa\n", sample.temp_centi_c / 100, abs(sample.temp_centi_c % 100), sample.press_q24_8 >> 8);
+//!     }
+//!
+//!     (void)dev_bmp280_bench(&bmp, 200); // samples per second: one burst vs two reads, and forced mode
+//!
+//! @note
+//!     Application code SHALL include `app_config.h`, then this file.
+//!     #include "dev_bmp280.h" // BMP280 temperature / pressure sensor
+//!
+//! SPDX-FileCopyrightText: 2021 burtrum
+//! SPDX-License-Identifier: Apache-2.0
+//!
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT; includes sys_i2c.h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DEV_BMP280_ADDR_LO          (0x76U) // SDO to GND
+#define DEV_BMP280_ADDR_HI          (0x77U) // SDO to VDDIO
+
+// ctrl_meas osrs_t, osrs_p
+#define DEV_BMP280_OSRS_SKIP        (0U)    // measurement skipped; pressure needs temperature
+#define DEV_BMP280_OSRS_X1          (1U)
+#define DEV_BMP280_OSRS_X2          (2U)
+#define DEV_BMP280_OSRS_X4          (3U)
+#define DEV_BMP280_OSRS_X8          (4U)
+#define DEV_BMP280_OSRS_X16         (5U)
+
+// config filter
+#define DEV_BMP280_FILTER_OFF       (0U)
+#define DEV_BMP280_FILTER_2         (1U)
+#define DEV_BMP280_FILTER_4         (2U)
+#define DEV_BMP280_FILTER_8         (3U)
+#define DEV_BMP280_FILTER_16        (4U)
+
+//! @brief Trimming parameters, registers 0x88 - 0x9F, little endian.
+//!
+struct DEV_BMP280_CALIB {
+    uint16_t    dig_t1;
+    int16_t     dig_t2;
+    int16_t     dig_t3;
+    uint16_t    dig_p1;
+    int16_t     dig_p2;
+    int16_t     dig_p3;
+    int16_t     dig_p4;
+    int16_t     dig_p5;
+    int16_t     dig_p6;
+    int16_t     dig_p7;
+    int16_t     dig_p8;
+    int16_t     dig_p9;
+};
+
+//! @brief One sensor. Caller owned, filled by dev_bmp280_init(). Do not edit the fields.
+//!
+struct DEV_BMP280 {
+    uint8_t                 sys_i2c_id;
+    uint8_t                 i2c_addr_num;
+    uint8_t                 ctrl_meas;      // osrs_t, osrs_p; mode bits 0
+    uint32_t                meas_us;        // datasheet maximum conversion time at these oversampling settings
+    int64_t                 ready_us;       // forced conversion done, esp_timer_get_time(); 0: none started
+    struct DEV_BMP280_CALIB calib;
+    bool                    ready_flag;
+};
+
+//! @brief One compensated sample.
+//!
+struct DEV_BMP280_SAMPLE {
+    int32_t     temp_centi_c;   // 0.01 degC: 2508 = 25.08 degC
+    uint32_t    press_q24_8;    // Pa, Q24.8: 24674867 = 96386.2 Pa; 0: pressure skipped
+    int32_t     t_fine;         // fine temperature, carried into the pressure formula
+};
+
+//! @brief Check the chip id, reset, read the calibration once, set oversampling and filter; sensor left in sleep mode.
+//! @param [in] osrs_t, osrs_p: DEV_BMP280_OSRS_*; osrs_t SKIP not allowed. filter: DEV_BMP280_FILTER_*
+//! @return true/false; false: bad argument, no answer, chip id not 0x58.
+//! @note
+//! TASK SAFE: YES, on different dev_addr.
+//!
+bool dev_bmp280_init(struct DEV_BMP280 * dev_addr, uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t osrs_t, uint8_t osrs_p, uint8_t filter);
+
+//! @brief Start one forced mode conversion and return. The I2C Bus is free until dev_bmp280_force_read().
+//!
+bool dev_bmp280_force_start(struct DEV_BMP280 * dev_addr);
+
+//! @brief Wait out the rest of the conversion, then one 6 byte burst and compensation.
+//! @return true/false; false: no conversion started, read failed.
+//!
+bool dev_bmp280_force_read(struct DEV_BMP280 * dev_addr, struct DEV_BMP280_SAMPLE * sample_addr);
+
+//! @brief Forced conversions on dev_cnt sensors, any I2C Buses: start all, then read all. One conversion time in total.
+//! @return true/false; false: any sensor failed; the samples of the others are still written.
+//!
+bool dev_bmp280_force_all(struct DEV_BMP280 * const * dev_addr, struct DEV_BMP280_SAMPLE * sample_addr, size_t dev_cnt);
+
+//! @brief One 6 byte burst of the current result registers, and compensation. For normal mode, or after a forced read.
+//!
+bool dev_bmp280_read(struct DEV_BMP280 * dev_addr, struct DEV_BMP280_SAMPLE * sample_addr);
+
+//! @brief Datasheet integer compensation of one raw sample. No I2C.
+//! @param [in] adc_t, adc_p: 20 bit raw values; adc_p 0x80000: pressure skipped, press_q24_8 0.
+//!
+void dev_bmp280_compensate(const struct DEV_BMP280_CALIB * calib_addr, int32_t adc_t, int32_t adc_p, struct DEV_BMP280_SAMPLE * sample_addr);
+
+//! @brief Samples per second, loop_cnt samples each: one 6 byte burst vs separate temperature and pressure reads;
+//! and full forced mode cycles. Printed.
+//!
+bool dev_bmp280_bench(struct DEV_BMP280 * dev_addr, uint32_t loop_cnt);
+
+#ifdef __cplusplus
+}
+#endif
+/* EOF dev_bmp280.h */
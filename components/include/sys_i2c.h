@@ -57,6 +57,12 @@
 // ESP32_IDF
 #include "driver/gpio.h" // for gpio_num_t
 #include "driver/i2c.h" // for i2c_port_t, I2C_NUM_MAX
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h" // for SemaphoreHandle_t
+#include "freertos/task.h" // for TaskHandle_t
+#if (SYS_I2C_PM_ENABLE == true)
+#include "esp_pm.h" // for esp_pm_lock_handle_t; PM off: not pulled into every user
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -64,6 +70,8 @@ extern "C" {
 
 #define SYS_I2C_ADDR_INVALID    (128U)      // Quick i2c_addr_num range check 0 - 127
 #define SYS_I2C_CLOCK_MAX       (1000000U)  // ESP32_HW 1.O MHz SOC hardware limit
+#define SYS_I2C_MUX_CHANNEL_CNT (8U)        // TCA9548A channels, one control register bit each
+#define SYS_I2C_REF_TICK_CLOCK_MAX  (50000U) // I2C_SCLK_SRC_FLAG_AWARE_DFS: REF_TICK 1 MHz source, 50 KHz SCL limit
 
 // This is the SYS_I2C API Init and Operational Code
 bool sys_i2c_init_all(void); // Initialize all SYS_I2C Bus interfaces from I2C_config tables.
@@ -71,6 +79,20 @@ bool sys_i2c_read (uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num
 bool sys_i2c_write(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size);
 bool sys_i2c_probe(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool * found_flag_addr);
 bool sys_i2c_scan_print(void);
+bool sys_i2c_write_bulk(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size, size_t chunk_align, uint32_t bulk_flags);
+bool sys_i2c_read_bulk (uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size, size_t chunk_align, uint32_t bulk_flags);
+bool sys_i2c_write_broadcast(const uint8_t * sys_i2c_id_addr, size_t sys_i2c_id_cnt, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size, bool verify_flag);
+bool sys_i2c_bus_take(uint8_t sys_i2c_id);
+bool sys_i2c_bus_give(uint8_t sys_i2c_id);
+bool sys_i2c_read_locked (uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size);
+bool sys_i2c_write_locked(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size);
+bool sys_i2c_probe_locked(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool * found_flag_addr);
+
+// sys_i2c_write_bulk(), sys_i2c_read_bulk() 'bulk_flags', bitwise OR.
+#define SYS_I2C_BULK_REG_FIXED  (0U)        // Every chunk uses i2c_reg_num. Example: SSD1306 0x40 display data stream.
+#define SYS_I2C_BULK_REG_INCR   (1U << 0)   // Each chunk i2c_reg_num advances by the bytes already sent. Example: EEPROM page write.
+                                            // i2c_reg_num + buf_size above 256 rejected: the 8-bit register would wrap to 0.
+#define SYS_I2C_BULK_ACK_POLL   (1U << 1)   // After each write chunk, probe until the device ACKs. Example: EEPROM write cycle.
 
 // This is the SYS_I2C API Init Configuration Data, input to sys_i2c_init_all().
 
@@ -102,13 +124,27 @@ extern const struct BSP_I2C_CONFIG    BSP_I2C_config[BSP_ID_CNT]; // [bsp_id] bs
 //! uint32_t    clk_speed   = SYS_I2C_config.port[port_num].clk_speed; // Index is port_num, NOT sys_i2c_id.
 //! uint32_t    clk_flags   = SYS_I2C_config.port[port_num].clk_flags; // Index is port_num, NOT sys_i2c_id.
 //!
-//! @attention  .clk_flags is a new feature to me 4.3 IDF - WIP
+//! .clk_flags, ESP32-IDF >= 4.3, the clock source policy of the port_num:
 //!     https://docs.espressif.com/projects/esp-idf/en/latest/esp32s2/api-reference/peripherals/i2c.html?highlight=i2c_config_t#_CPPv4N12i2c_config_t9clk_flagsE
-//!     uint32_t clk_flags; // Bitwise of I2C_SCLK_SRC_FLAG_**FOR_DFS** for clk source choice
+//!     0:                           I2C_SCLK_SRC_FLAG_FOR_NOMAL, pick per transaction, see below.
+//!     I2C_SCLK_SRC_FLAG_AWARE_DFS: REF_TICK whenever the transaction clk_speed allows it. Port clk_speed <= 50 KHz.
+//!     I2C_SCLK_SRC_FLAG_LIGHT_SLEEP: no such clock source on ESP32, ESP32-S2; rejected.
+//! Per transaction, from the clk_speed of the device, sys_i2c_clock.h, and power management, Kconfig PM_ENABLE:
+//!     clk_speed > SYS_I2C_REF_TICK_CLOCK_MAX: APB. PM on: ESP_PM_APB_FREQ_MAX lock held while the pins are attached.
+//!     clk_speed <= SYS_I2C_REF_TICK_CLOCK_MAX and (PM on or AWARE_DFS): REF_TICK, immune to DFS.
+//!         PM on: ESP_PM_NO_LIGHT_SLEEP lock held while the pins are attached; APB may scale down meanwhile.
+//!     Else APB, no lock: APB is fixed without PM.
+//!
+//! Virtual I2C Bus, devices behind an I2C multiplexer channel (TCA9548A style), see sys_i2c_mux.h:
+//! .mux_addr != 0: this sys_i2c_id is channel .mux_channel of the mux at .mux_addr on bus .mux_parent_id.
+//! .port_num, and the BSP_I2C_config pins, are then taken from the parent; their entries are ignored.
 //!
 struct SYS_I2C_CONFIG {
     struct {
         i2c_port_t port_num;
+        uint8_t    mux_parent_id;   // sys_i2c_id the mux sits on, lower than this one; may be virtual itself: cascade
+        uint8_t    mux_addr;        // 0: physical I2C Bus. TCA9548A: 0x70 - 0x77
+        uint8_t    mux_channel;     // 0 - 7
     } unit[SYS_I2C_ID_CNT];
 
     struct {
@@ -133,22 +169,77 @@ extern const struct SYS_I2C_CONFIG    SYS_I2C_config;
 //! uint32_t    clk_speed   = SYS_I2C_runtime.unit[sys_i2c_id].clk_speed; // Index is sys_i2c_id, NOT port_num.
 //! uint32_t    clk_flags   = SYS_I2C_runtime.unit[sys_i2c_id].clk_flags; // Index is sys_i2c_id, NOT port_num.
 //! SemaphoreHandle_t      lock   = SYS_I2C_runtime.port[port_num].lock; // Index to'.port[] is port_num, Valid: I2C_NUM_0, I2C_NUM_1, NOT sys_i2c_id.
+//! Take and give the lock only through sys_i2c_bus_take() / sys_i2c_bus_give(): they keep .holder, the spin hint, in step.
+//!
+//! .unit points to SYS_I2C_ID_CNT entries. Either the RAM copy built by sys_i2c_runtime_init(), or with
+//! SYS_I2C_BOARD_GEN_ENABLE the FLASH table SYS_I2C_unit_gen[bsp_id] generated and validated at build time.
+//!
+//! Virtual I2C Bus: pins, port_num and clk_* are those of its physical root bus; mux_* as in SYS_I2C_config.
+//!
+struct SYS_I2C_UNIT {
+    gpio_num_t sda_io_num;
+    gpio_num_t scl_io_num;
+    i2c_port_t port_num;
+    uint32_t   clk_speed;
+    uint32_t   clk_flags;
+    uint8_t    mux_parent_id;
+    uint8_t    mux_addr;    // 0: physical I2C Bus
+    uint8_t    mux_channel;
+};
+
+#define SYS_I2C_PORT_ALIGN      (32U) // bytes, one cache line: hot port_num state never shares a line with .unit or the other port
+
+//! @brief Port lock counters, updated by the lock holder. See sys_i2c_lock.h.
+//!
+struct SYS_I2C_LOCK_STATS {
+    uint32_t take_cnt;      // every take
+    uint32_t spin_cnt;      // contended, won by spinning; no context switch
+    uint32_t block_cnt;     // contended, blocked on the mutex
+    uint32_t wait_max_us;   // longest contended wait
+};
+
+//! @brief Clock source counters, per port_num, updated by the lock holder at attach. See sys_i2c_clock.h.
 //!
+struct SYS_I2C_CLOCK_SRC_STATS {
+    uint32_t apb_cnt;       // attaches clocked from APB
+    uint32_t ref_tick_cnt;  // attaches clocked from REF_TICK
+};
+
+//! @brief Hot per-port_num state. Written on every transaction, so kept apart from the read-mostly .unit table.
+//!
+struct SYS_I2C_PORT {
+    SemaphoreHandle_t           lock;
+    TaskHandle_t volatile       holder;         // lock holder, mirror of the mutex, spun on without touching it; NULL: free
+    volatile UBaseType_t        holder_prio;    // holder priority at take; spinners read this, never the holder TCB
+    volatile BaseType_t         holder_core;    // holder affinity at take, tskNO_AFFINITY: either core
+    bool                        installed;      // i2c_driver_install() done; SYS_I2C_LAZY_INSTALL_ENABLE: on first use
+    volatile uint8_t            attached_id;    // sys_i2c_id with pads on this FSM now; SYS_I2C_ID_CNT: none
+    uint16_t                    spin_us;        // adaptive spin bound, 0 to spin_max_us
+    uint16_t                    spin_max_us;    // Kconfig SYS_I2C_LOCK_SPIN_MAX_US; sys_i2c_lock_spin_set()
+    struct SYS_I2C_LOCK_STATS   stats;
+    #if (SYS_I2C_PM_ENABLE == true)
+    esp_pm_lock_handle_t        pm_apb_lock;    // ESP_PM_APB_FREQ_MAX, APB clocked attach
+    esp_pm_lock_handle_t        pm_sleep_lock;  // ESP_PM_NO_LIGHT_SLEEP, REF_TICK clocked attach
+    esp_pm_lock_handle_t        pm_held;        // acquired at attach, released at detach; NULL: none
+    #endif
+    struct SYS_I2C_CLOCK_SRC_STATS src_stats;
+} __attribute__((aligned(SYS_I2C_PORT_ALIGN)));
+
 struct SYS_I2C_RUNTIME {
-    struct {
-        gpio_num_t sda_io_num;
-        gpio_num_t scl_io_num;
-        i2c_port_t port_num;
-        uint32_t   clk_speed;
-        uint32_t   clk_flags;
-    } unit[SYS_I2C_ID_CNT];
+    const struct SYS_I2C_UNIT * unit; // [SYS_I2C_ID_CNT]
 
-    struct {
-        SemaphoreHandle_t lock;
-    } port[I2C_NUM_MAX];
+    struct SYS_I2C_PORT port[I2C_NUM_MAX];
 };
 extern struct SYS_I2C_RUNTIME    SYS_I2C_runtime;
 
+#if (SYS_I2C_BOARD_GEN_ENABLE == true)
+//! @brief Build time generated runtime descriptors, one row per board. Source: main/bsp_i2c_board.cmake.
+//! Generated by components/sys_i2c/sys_i2c_board_gen.cmake into the build directory. Do not edit.
+//! GPIO validity, clock range, port_num and duplicate pins across buses already checked; CMake stops the build on error.
+//!
+extern const struct SYS_I2C_UNIT    SYS_I2C_unit_gen[BSP_ID_CNT][SYS_I2C_ID_CNT];
+#endif
+
 //! @brief
 //! Initialize all SYS_I2C Bus interfaces from I2C_config tables.
 //! Multiple 1,2,3,4...n buses supported, each bus with separate SCL/SDA GPIO pins.
@@ -248,6 +339,114 @@ bool sys_i2c_probe(
         bool * found_flag_addr
         );
 
+//! @brief write a large buffer as bounded chunks, releasing the I2C port lock between chunks.
+//! A full SSD1306 frame at 400 KHz is ~25 ms of wire time. One sys_i2c_write() holds the I2C_FSM for all of it,
+//! every other I2C Bus on the same 'port_num' waits. Chunks let waiting tasks run in between.
+//!
+//! @details
+//! Chunk size:
+//! - The largest multiple of 'chunk_align' whose wire time fits SYS_I2C_LOCK_HOLD_MAX_US at the device clk_speed,
+//!   sys_i2c_clock_get().
+//! - Never less than 'chunk_align'. 'chunk_align' is the protocol-safe boundary: display page, EEPROM page. 0 or 1: any byte.
+//! - SYS_I2C_BULK_REG_INCR: a chunk ends on the next 'chunk_align' boundary of its register number, one page at most.
+//!   An unaligned start gets a short first chunk; no chunk crosses an EEPROM page, where the device would wrap.
+//! Each chunk is one complete sys_i2c_write(), lock to unlock. Between chunks, taskYIELD() lets equal priority waiters in;
+//! higher priority waiters already run at the lock give.
+//!
+//! @param [in] sys_i2c_id
+//! @param [in] i2c_addr_num
+//! @param [in] i2c_reg_num: first chunk register; see SYS_I2C_BULK_REG_FIXED, SYS_I2C_BULK_REG_INCR
+//! @param [in] buf_addr: write data to I2C from this buffer
+//! @param [in] buf_size
+//! @param [in] chunk_align: chunk boundary in bytes; 0: none
+//! @param [in] bulk_flags: SYS_I2C_BULK_REG_FIXED, SYS_I2C_BULK_REG_INCR, SYS_I2C_BULK_ACK_POLL
+//! @return true/false; false: bad argument, SYS_I2C_BULK_REG_INCR past register 0xFF; a chunk failed, earlier chunks were written.
+//! @note
+//! TASK SAFE: YES. Other tasks may access the same I2C device between chunks.
+//!        if (!sys_i2c_write_bulk(sys_i2c_id, 0x3C, 0x40, frame_addr, 1024, 128, SYS_I2C_BULK_REG_FIXED)) { goto fail; }
+//!
+bool sys_i2c_write_bulk(
+        uint8_t sys_i2c_id,
+        uint8_t i2c_addr_num,
+        uint8_t i2c_reg_num,
+        uint8_t * buf_addr,
+        size_t buf_size,
+        size_t chunk_align,
+        uint32_t bulk_flags
+        );
+
+//! @brief read a large buffer as bounded chunks, releasing the I2C port lock between chunks.
+//! Same chunking as sys_i2c_write_bulk(). SYS_I2C_BULK_ACK_POLL is ignored.
+//! @return true/false; false: bad argument, SYS_I2C_BULK_REG_INCR past register 0xFF; buffer contents not valid
+//! @note
+//! TASK SAFE: YES.
+//!        if (!sys_i2c_read_bulk(sys_i2c_id, 0x50, 0x00, buf_addr, 256, 0, SYS_I2C_BULK_REG_INCR)) { goto fail; }
+//!
+bool sys_i2c_read_bulk(
+        uint8_t sys_i2c_id,
+        uint8_t i2c_addr_num,
+        uint8_t i2c_reg_num,
+        uint8_t * buf_addr,
+        size_t buf_size,
+        size_t chunk_align,
+        uint32_t bulk_flags
+        );
+
+//! @brief write identical data to the same I2C device address on several I2C Buses with ONE I2C transaction.
+//! Example: the same SSD1306 init sequence to 0x3C on five buses costs one transfer, not five.
+//!
+//! @details
+//! The ESP32_GPIO_MATRIX routes one I2C_FSM output signal to many GPIO pads.
+//! - sys_i2c_id_addr[0] is the ACK bus: fully attached, its device ACKs and clock stretching are seen by the I2C_FSM.
+//! - sys_i2c_id_addr[1 ..] get only the SCL/SDA outputs. Their device ACKs are not sampled.
+//! - All buses SHALL share one 'port_num', therefore one clk_speed.
+//! - Devices on the other buses SHALL NOT stretch the clock.
+//!
+//! @param [in] sys_i2c_id_addr: list of buses, first is the ACK bus
+//! @param [in] sys_i2c_id_cnt: entries in the list, 1 .. n; each bus at most once, a duplicate fails the call
+//! @param [in] i2c_addr_num, i2c_reg_num, buf_addr, buf_size: the same as sys_i2c_write()
+//! @param [in] verify_flag: true: after the write, probe i2c_addr_num on every other bus; any NACK fails.
+//! @return true/false; true: ACK bus device got the data, and if verify_flag, all other devices answered.
+//! @note
+//! TASK SAFE: YES.
+//!     const uint8_t oled_bus[] = { SYS_I2C_ID_00, SYS_I2C_ID_01, SYS_I2C_ID_02 };
+//!     if (!sys_i2c_write_broadcast(oled_bus, sizeof(oled_bus), 0x3C, 0x00, init_addr, init_size, true)) { goto fail; }
+//!
+bool sys_i2c_write_broadcast(
+        const uint8_t * sys_i2c_id_addr,
+        size_t sys_i2c_id_cnt,
+        uint8_t i2c_addr_num,
+        uint8_t i2c_reg_num,
+        uint8_t * buf_addr,
+        size_t buf_size,
+        bool verify_flag
+        );
+
+//! @brief hold one I2C Bus across several operations: no other task's transaction in between.
+//! Between take and give use only the *_locked() operations; sys_i2c_read(), sys_i2c_write(), sys_i2c_probe() would deadlock.
+//!
+//! @details
+//! The lock belongs to the ESP32_I2C_FSM 'port_num', not to the bus: every I2C Bus on the same port_num waits too.
+//! Keep the hold short. C++: sys_i2c::Hold<> in sys_i2c.hpp gives back on scope exit.
+//!
+//! @return true/false; take false: sys_i2c_id invalid or port driver install failed, lock not held.
+//! @note
+//! TASK SAFE: YES.
+//!     if (!sys_i2c_bus_take(sys_i2c_id)) { goto fail; }
+//!     bool pass_flag = sys_i2c_write_locked(sys_i2c_id, 0x76, 0xF4, &ctrl_num, 1)
+//!                   && sys_i2c_read_locked(sys_i2c_id, 0x76, 0xF7, data_addr, 6);
+//!     if (!sys_i2c_bus_give(sys_i2c_id) || !pass_flag) { goto fail; }
+//!
+bool sys_i2c_bus_take(uint8_t sys_i2c_id);
+bool sys_i2c_bus_give(uint8_t sys_i2c_id);
+
+//! @brief sys_i2c_read(), sys_i2c_write(), sys_i2c_probe() without the lock. Caller holds it, sys_i2c_bus_take().
+//! Same arguments and returns.
+//!
+bool sys_i2c_read_locked (uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size);
+bool sys_i2c_write_locked(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size);
+bool sys_i2c_probe_locked(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool * found_flag_addr);
+
 //! @brief print report for every I2C interface (0,1,2,3, ...)
 //! print report to uart console with printf().
 //! @return true/false; false: who knows it didn't work...
@@ -0,0 +1,239 @@
+//! @file   sys_i2c.hpp
+//!
+//! @brief  SYS_I2C C++ API, header only: bus and device as template parameters, typed registers, RAII bus hold.
+//!
+//! @details
+//! A thin layer over the C API in sys_i2c.h. Nothing here allocates, nothing is virtual, no exceptions.
+//! - Bus<SYS_I2C_ID_00>: sys_i2c_id checked against SYS_I2C_ID_CNT at compile time.
+//! - Device<Bus, 0x3C>: 7-bit device address checked at compile time, 0x08 - 0x77.
+//! - Reg<0xF4, uint8_t>: register number, value type, access, byte order. Wrong-way access does not compile.
+//! - Hold<Bus>: takes the port lock in the constructor, gives it back in the destructor. Operations given a Hold run
+//!   the *_locked() bodies; a Hold of another bus does not compile.
+//! - Buffers: std::array, C arrays, and std::span with C++20. Sizes from the type, never passed by hand.
+//!
+//! Cost: every member is an inline forwarding call with constant arguments, the same call the C code makes.
+//! Typed register byte order is a loop over a compile-time size, unrolled by the compiler. The address byte on the
+//! wire is built by the C API, as for C callers. Hold adds no unwind tables with C++ exceptions off, the IDF default.
+//!
+//! Returns stay bool, true/false, pass/fail, like the C API.
+//!
+//! How to use:
+//!
+//!     using Bus0   = sys_i2c::Bus<SYS_I2C_ID_00>;
+//!     using Bmp280 = sys_i2c::Device<Bus0, 0x76>;
+//!     using CtrlMeas = sys_i2c::Reg<0xF4, uint8_t>;
+//!     using ChipId   = sys_i2c::Reg<0xD0, uint8_t, sys_i2c::Access::Read>;
+//!
+//!     uint8_t chip_id;
+//!     if (!Bmp280::get<ChipId>(chip_id)) { goto fail; }
+//!
+//!     std::array<uint8_t, 6> raw;
+//!     {
+//!         sys_i2c::Hold<Bus0> hold; // no other transaction on this port until scope exit
+//!         if (!hold) { goto fail; }
+//!         if (!Bmp280::set<CtrlMeas>(hold, 0x25)) { goto fail; } // forced mode
+//!         if (!Bmp280::read(hold, 0xF7, raw)) { goto fail; }
+//!     }
+//!
+//! @note
+//!     C++ application code SHALL include `app_config.h`, then this file.
+//!     #include "sys_i2c.hpp" // SYS_I2C C++ API
+//!
+//! SPDX-FileCopyrightText: 2021 burtrum
+//! SPDX-License-Identifier: Apache-2.0
+//!
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT; includes sys_i2c.h
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#if (__cplusplus >= 202002L)
+#include <span>
+#endif
+
+#define SYS_I2C_HPP_ADDR_MIN    (0x08U) // I2C specification: 0x00 - 0x07 and 0x78 - 0x7F reserved
+#define SYS_I2C_HPP_ADDR_MAX    (0x77U)
+
+namespace sys_i2c {
+
+enum class Access : uint8_t { Read, Write, ReadWrite };
+enum class Endian : uint8_t { Big, Little }; // Big: first byte on the wire is the most significant
+
+//! @brief Typed register descriptor. T: unsigned, 1 to 4 bytes.
+//!
+template <uint8_t RegNum, typename T, Access Acc = Access::ReadWrite, Endian End = Endian::Big>
+struct Reg {
+    static_assert(std::is_unsigned<T>::value, "sys_i2c::Reg value type must be unsigned");
+    static_assert((1 <= sizeof(T)) && (4 >= sizeof(T)), "sys_i2c::Reg value type must be 1 to 4 bytes");
+
+    typedef T value_type;
+    static constexpr uint8_t    reg_num = RegNum;
+    static constexpr Access     access  = Acc;
+    static constexpr Endian     endian  = End;
+    static constexpr size_t     size    = sizeof(T);
+};
+
+//! @brief One SYS_I2C Bus.
+//!
+template <uint8_t SysI2cId>
+struct Bus {
+    static_assert(SYS_I2C_ID_CNT > SysI2cId, "sys_i2c::Bus id must be < SYS_I2C_ID_CNT, see enum SYS_I2C_ID in app_config.h");
+
+    static constexpr uint8_t sys_i2c_id = SysI2cId;
+
+    static bool probe(uint8_t i2c_addr_num, bool & found_flag)
+    {
+        return (sys_i2c_probe(SysI2cId, i2c_addr_num, &found_flag));
+    }
+};
+
+//! @brief RAII hold of the port lock of BusT. See sys_i2c_bus_take() in sys_i2c.h: the whole port_num waits.
+//! Check it: `if (!hold)`, the take can fail.
+//!
+template <typename BusT>
+class Hold {
+  public:
+    Hold() : held_flag_(sys_i2c_bus_take(BusT::sys_i2c_id)) {}
+    ~Hold() { if (held_flag_) { (void)sys_i2c_bus_give(BusT::sys_i2c_id); } }
+
+    Hold(const Hold &) = delete;
+    Hold & operator=(const Hold &) = delete;
+
+    explicit operator bool() const { return (held_flag_); }
+
+    //! Give back before scope exit. Later operations with this Hold fail.
+    bool release()
+    {
+        if (!held_flag_) { return (false); }
+        held_flag_ = false;
+        return (sys_i2c_bus_give(BusT::sys_i2c_id));
+    }
+
+  private:
+    bool held_flag_;
+};
+
+//! @brief One I2C device on BusT at 7-bit address Addr.
+//!
+template <typename BusT, uint8_t Addr>
+struct Device {
+    static_assert((SYS_I2C_HPP_ADDR_MIN <= Addr) && (SYS_I2C_HPP_ADDR_MAX >= Addr), "sys_i2c::Device address must be 7-bit 0x08 - 0x77");
+
+    typedef BusT bus_type;
+    typedef Hold<BusT> hold_type;
+    static constexpr uint8_t i2c_addr_num = Addr;
+
+    // Probe
+    static bool probe(bool & found_flag) { return (sys_i2c_probe(BusT::sys_i2c_id, Addr, &found_flag)); }
+    static bool probe(const hold_type & hold, bool & found_flag)
+    {
+        return (hold && sys_i2c_probe_locked(BusT::sys_i2c_id, Addr, &found_flag));
+    }
+
+    // Raw buffers. The C API does not write through the write buffer; const is cast away only to call it.
+    static bool read(uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size)
+    {
+        return (sys_i2c_read(BusT::sys_i2c_id, Addr, i2c_reg_num, buf_addr, buf_size));
+    }
+    static bool read(const hold_type & hold, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size)
+    {
+        return (hold && sys_i2c_read_locked(BusT::sys_i2c_id, Addr, i2c_reg_num, buf_addr, buf_size));
+    }
+    static bool write(uint8_t i2c_reg_num, const uint8_t * buf_addr, size_t buf_size)
+    {
+        return (sys_i2c_write(BusT::sys_i2c_id, Addr, i2c_reg_num, const_cast<uint8_t *>(buf_addr), buf_size));
+    }
+    static bool write(const hold_type & hold, uint8_t i2c_reg_num, const uint8_t * buf_addr, size_t buf_size)
+    {
+        return (hold && sys_i2c_write_locked(BusT::sys_i2c_id, Addr, i2c_reg_num, const_cast<uint8_t *>(buf_addr), buf_size));
+    }
+
+    // Sized buffers: std::array, C array, std::span (C++20). Zero size does not compile.
+    template <size_t N> static bool read(uint8_t i2c_reg_num, std::array<uint8_t, N> & buf)
+    {
+        static_assert(N, "sys_i2c::Device::read buffer must not be empty");
+        return (read(i2c_reg_num, buf.data(), N));
+    }
+    template <size_t N> static bool read(const hold_type & hold, uint8_t i2c_reg_num, std::array<uint8_t, N> & buf)
+    {
+        static_assert(N, "sys_i2c::Device::read buffer must not be empty");
+        return (read(hold, i2c_reg_num, buf.data(), N));
+    }
+    template <size_t N> static bool read(uint8_t i2c_reg_num, uint8_t (&buf)[N]) { return (read(i2c_reg_num, buf, N)); }
+    template <size_t N> static bool read(const hold_type & hold, uint8_t i2c_reg_num, uint8_t (&buf)[N]) { return (read(hold, i2c_reg_num, buf, N)); }
+
+    template <size_t N> static bool write(uint8_t i2c_reg_num, const std::array<uint8_t, N> & buf)
+    {
+        static_assert(N, "sys_i2c::Device::write buffer must not be empty");
+        return (write(i2c_reg_num, buf.data(), N));
+    }
+    template <size_t N> static bool write(const hold_type & hold, uint8_t i2c_reg_num, const std::array<uint8_t, N> & buf)
+    {
+        static_assert(N, "sys_i2c::Device::write buffer must not be empty");
+        return (write(hold, i2c_reg_num, buf.data(), N));
+    }
+    template <size_t N> static bool write(uint8_t i2c_reg_num, const uint8_t (&buf)[N]) { return (write(i2c_reg_num, buf, N)); }
+    template <size_t N> static bool write(const hold_type & hold, uint8_t i2c_reg_num, const uint8_t (&buf)[N]) { return (write(hold, i2c_reg_num, buf, N)); }
+
+#if (__cplusplus >= 202002L)
+    static bool read(uint8_t i2c_reg_num, std::span<uint8_t> buf) { return (read(i2c_reg_num, buf.data(), buf.size())); }
+    static bool read(const hold_type & hold, uint8_t i2c_reg_num, std::span<uint8_t> buf) { return (read(hold, i2c_reg_num, buf.data(), buf.size())); }
+    static bool write(uint8_t i2c_reg_num, std::span<const uint8_t> buf) { return (write(i2c_reg_num, buf.data(), buf.size())); }
+    static bool write(const hold_type & hold, uint8_t i2c_reg_num, std::span<const uint8_t> buf) { return (write(hold, i2c_reg_num, buf.data(), buf.size())); }
+#endif
+
+    // Typed registers
+    template <typename R> static bool get(typename R::value_type & value)
+    {
+        static_assert(Access::Write != R::access, "sys_i2c::Reg is write-only");
+        uint8_t buf[R::size];
+        if (!read(R::reg_num, buf, R::size)) { return (false); }
+        value = decode<R>(buf);
+        return (true);
+    }
+    template <typename R> static bool get(const hold_type & hold, typename R::value_type & value)
+    {
+        static_assert(Access::Write != R::access, "sys_i2c::Reg is write-only");
+        uint8_t buf[R::size];
+        if (!read(hold, R::reg_num, buf, R::size)) { return (false); }
+        value = decode<R>(buf);
+        return (true);
+    }
+    template <typename R> static bool set(typename R::value_type value)
+    {
+        static_assert(Access::Read != R::access, "sys_i2c::Reg is read-only");
+        uint8_t buf[R::size];
+        encode<R>(value, buf);
+        return (write(R::reg_num, buf, R::size));
+    }
+    template <typename R> static bool set(const hold_type & hold, typename R::value_type value)
+    {
+        static_assert(Access::Read != R::access, "sys_i2c::Reg is read-only");
+        uint8_t buf[R::size];
+        encode<R>(value, buf);
+        return (write(hold, R::reg_num, buf, R::size));
+    }
+
+  private:
+    template <typename R> static typename R::value_type decode(const uint8_t * buf_addr)
+    {
+        typename R::value_type value = 0;
+        for (size_t idx = 0; R::size > idx; ++idx) {
+            const size_t shift = 8 * ((Endian::Big == R::endian) ? (R::size - 1 - idx) : idx);
+            value |= (typename R::value_type)((typename R::value_type)buf_addr[idx] << shift);
+        }
+        return (value);
+    }
+    template <typename R> static void encode(typename R::value_type value, uint8_t * buf_addr)
+    {
+        for (size_t idx = 0; R::size > idx; ++idx) {
+            const size_t shift = 8 * ((Endian::Big == R::endian) ? (R::size - 1 - idx) : idx);
+            buf_addr[idx] = (uint8_t)(value >> shift);
+        }
+    }
+};
+
+} // namespace sys_i2c
+/* EOF sys_i2c.hpp */
@@ -0,0 +1,113 @@
+//! @file   sys_i2c_capture.h
+//!
+//! @brief  SYS_I2C workload capture: sequence, timing and shape of real sys_i2c_* calls, compact binary, for replay.
+//!
+//! @details
+//! Kconfig SYS_I2C_CAPTURE compiles a hook into sys_i2c_read(), sys_i2c_write(), sys_i2c_probe().
+//! Add-on modules built on them (bulk, snapshots...) are captured as the calls they make.
+//! Modules that run their own transaction under the port lock record it themselves:
+//! - sys_i2c_prep_exec(), sys_i2c_sched.h, sys_i2c_pipe.h: as the read or write they prepared.
+//! - sys_i2c_smbus.h: command code as i2c_reg_num, bytes after it as buf_size; Block Read with the count returned.
+//! - sys_i2c_read_coalesced(): one read per call, own range; a follower's latency is its wait for the leader.
+//! - sys_i2c_write_broadcast(): one write on the first I2C Bus of the list.
+//! Not captured: sys_i2c_bus_take() / *_locked() users, sys_i2c.hpp Hold, write-combining flushes, bus recovery,
+//! background probes.
+//! Latency is the caller's view: port lock wait plus wire time.
+//!
+//! Capture image, little-endian, caller-owned buffer, written in place:
+//!     header  8 bytes: 'S' 'C', SYS_I2C_CAPTURE_VERSION, SYS_I2C_CAPTURE_RECORD_SIZE, record count uint32
+//!     record 16 bytes:
+//!         0..3    start_us    uint32, from sys_i2c_capture_start(); wraps after 71 minutes
+//!         4..7    lat_us      uint32
+//!         8..9    buf_size    uint16; probe: 0
+//!         10      op          SYS_I2C_CAPTURE_OP_*; bit 7 set: call passed
+//!         11      sys_i2c_id
+//!         12      i2c_addr_num
+//!         13      i2c_reg_num
+//!         14      task_idx    order of first call per task, 0 - (SYS_I2C_CAPTURE_TASK_MAX - 1); last one shared
+//!         15      reserved, 0
+//! Shape only: no payload bytes are stored.
+//! Full buffer: later calls are counted in sys_i2c_capture_stop() drop count, not recorded.
+//!
+//! Save the image with any struct SYS_I2C_DEVMAP_STORE backend (NVS blob, file), load it the same way for replay.
+//!
+//! How to use:
+//!
+//!     static uint8_t capture_buf[16 * 1024];
+//!     if (!sys_i2c_capture_start(capture_buf, sizeof(capture_buf))) { goto fail; }
+//!     ... run the application ...
+//!     size_t capture_size;
+//!     uint32_t drop_cnt;
+//!     if (!sys_i2c_capture_stop(&capture_size, &drop_cnt)) { goto fail; }
+//!     if (!store.save(store.ctx, "i2c_cap", capture_buf, capture_size)) { goto fail; }
+//!
+//! @note
+//!     Application code SHALL include `app_config.h`, then this file.
+//!     #include "sys_i2c_capture.h" // SYS_I2C workload capture
+//!
+//! SPDX-FileCopyrightText: 2021 burtrum
+//! SPDX-License-Identifier: Apache-2.0
+//!
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT; includes sys_i2c.h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYS_I2C_CAPTURE_VERSION         (1U)
+#define SYS_I2C_CAPTURE_HEAD_SIZE       (8U)
+#define SYS_I2C_CAPTURE_RECORD_SIZE     (16U)
+#define SYS_I2C_CAPTURE_TASK_MAX        (8U)
+
+#define SYS_I2C_CAPTURE_OP_READ         (0U)
+#define SYS_I2C_CAPTURE_OP_WRITE        (1U)
+#define SYS_I2C_CAPTURE_OP_PROBE        (2U)
+#define SYS_I2C_CAPTURE_OP_MASK         (0x7FU)
+#define SYS_I2C_CAPTURE_OP_PASS         (0x80U)
+
+//! @brief One decoded record.
+//!
+struct SYS_I2C_CAPTURE_RECORD {
+    uint32_t    start_us;
+    uint32_t    lat_us;
+    uint16_t    buf_size;
+    uint8_t     op;             // SYS_I2C_CAPTURE_OP_READ, _WRITE, _PROBE
+    bool        pass_flag;
+    uint8_t     sys_i2c_id;
+    uint8_t     i2c_addr_num;
+    uint8_t     i2c_reg_num;
+    uint8_t     task_idx;
+};
+
+//! @brief Start recording into buf_addr. One capture at a time.
+//! @return true/false; false: Kconfig SYS_I2C_CAPTURE off, buffer too small for one record, or capture running.
+//! @note
+//! TASK SAFE: YES
+//!        if (!sys_i2c_capture_start(capture_buf, sizeof(capture_buf))) { goto fail; }
+//!
+bool sys_i2c_capture_start(uint8_t * buf_addr, size_t buf_size);
+
+//! @brief Stop recording, finish the header.
+//! @param [out] capture_size_addr: image bytes, header included
+//! @param [out] drop_cnt_addr: calls not recorded, buffer full. NULL allowed.
+//! @note
+//! TASK SAFE: YES. Calls in flight at stop are dropped, not torn.
+//!
+bool sys_i2c_capture_stop(size_t * capture_size_addr, uint32_t * drop_cnt_addr);
+
+//! @brief Check an image and read its record count.
+//! @note
+//!        uint32_t record_cnt;
+//!        if (!sys_i2c_capture_check(capture_addr, capture_size, &record_cnt)) { goto fail; }
+//!
+bool sys_i2c_capture_check(const uint8_t * capture_addr, size_t capture_size, uint32_t * record_cnt_addr);
+
+//! @brief Decode record record_idx of a checked image.
+//!
+bool sys_i2c_capture_record(const uint8_t * capture_addr, uint32_t record_idx, struct SYS_I2C_CAPTURE_RECORD * record_addr);
+
+#ifdef __cplusplus
+}
+#endif
+/* EOF sys_i2c_capture.h */
@@ -0,0 +1,102 @@
+//! @file   sys_i2c_clock.h
+//!
+//! @brief  SYS_I2C clock profiles: per-device SCL clk_speed, measured by calibration, applied on every transaction.
+//!
+//! @details
+//! SYS_I2C_config.port[].clk_speed is one guess per port_num, chosen for the weakest device and wiring.
+//! A clock profile overrides it for one (sys_i2c_id, i2c_addr_num) pair. The pins attach with i2c_param_config()
+//! on every transaction anyway, so the profile clk_speed costs nothing extra on the hot path.
+//!
+//! Calibration, per device:
+//! 1. Reference pass at the port clk_speed. Must pass, else calibration fails.
+//! 2. Step SCL up by SYS_I2C_CLOCK_STEP_HZ to SYS_I2C_CLOCK_MAX. Each step runs the test SYS_I2C_CLOCK_STEP_REPEAT times.
+//!    First failed step ends the sweep.
+//! 3. Profile = highest passing step derated to SYS_I2C_CLOCK_DERATE_PCT, never below the port clk_speed.
+//!
+//! The test, struct SYS_I2C_CLOCK_TEST:
+//! - Read: i2c_reg_num..+read_size read back, compared to the reference. Use a static register: chip ID, configuration.
+//! - Write, optional: the register is scratch read/write. Patterns 0x55, 0xAA written and read back, then the reference restored.
+//! - No test for a device: address ACK only. Weak, catches a dead bus but not a corrupted byte.
+//!
+//! Profiles live in RAM. Save and restore them with sys_i2c_clock_get() / sys_i2c_clock_set(), example with sys_i2c_devmap.h storage.
+//! sys_i2c_write_broadcast() drives every bus with the first bus profile: list the slowest bus first.
+//!
+//! Clock source, per transaction, from the clk_speed it runs at: see SYS_I2C_config .clk_flags in sys_i2c.h.
+//! A profile above SYS_I2C_REF_TICK_CLOCK_MAX runs on APB, whatever the port policy; sys_i2c_clock_print() counts both.
+//!
+//! How to use:
+//!
+//!     const struct SYS_I2C_CLOCK_TEST test[] = {
+//!         { .i2c_addr_num = 0x76, .i2c_reg_num = 0xD0, .read_size = 1, .write_flag = false }, // BMP280 chip id
+//!     };
+//!     if (!sys_i2c_clock_calibrate_bus(SYS_I2C_ID_00, test, 1)) { goto fail; }
+//!     if (!sys_i2c_clock_print()) { goto fail; }
+//!
+//! @note
+//!     Application code SHALL include `app_config.h`, then this file.
+//!     #include "sys_i2c_clock.h" // SYS_I2C per-device clock profiles
+//!
+//! SPDX-FileCopyrightText: 2021 burtrum
+//! SPDX-License-Identifier: Apache-2.0
+//!
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT; includes sys_i2c.h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYS_I2C_CLOCK_STEP_HZ       (100000U)   // sweep step
+#define SYS_I2C_CLOCK_STEP_REPEAT   (8U)        // test runs per step, all must pass
+#define SYS_I2C_CLOCK_DERATE_PCT    (80U)       // safety margin, profile = best step * 80%
+#define SYS_I2C_CLOCK_TEST_BUF_MAX  (16U)       // read_size limit
+
+//! @brief Calibration test for one device. See @details above.
+//!
+struct SYS_I2C_CLOCK_TEST {
+    uint8_t     i2c_addr_num;   // device
+    uint8_t     i2c_reg_num;    // first register compared
+    uint8_t     read_size;      // 1 to SYS_I2C_CLOCK_TEST_BUF_MAX
+    bool        write_flag;     // true: scratch read/write register, pattern write and restore
+};
+
+//! @brief Calibrate one device and store its profile.
+//! @param test_addr: NULL: address ACK only
+//! @param [out] clk_speed_addr: profile clk_speed, Hz. NULL allowed.
+//! @return true/false, pass/fail. On fail the profile is cleared: port clk_speed.
+//! @note
+//! TASK SAFE: YES. Port lock per step, other devices keep running between steps.
+//!        if (!sys_i2c_clock_calibrate(sys_i2c_id, i2c_addr_num, &test, &clk_speed)) { goto fail; }
+//!
+bool sys_i2c_clock_calibrate(uint8_t sys_i2c_id, uint8_t i2c_addr_num, const struct SYS_I2C_CLOCK_TEST * test_addr, uint32_t * clk_speed_addr);
+
+//! @brief Calibrate every device found on sys_i2c_id. Found: discovery map if ready, else probe 0x08 - 0x77.
+//! @param test_addr: test_cnt tests by i2c_addr_num; devices without a test: address ACK only. NULL, 0 allowed.
+//! @return true/false, pass/fail. Fail: at least one device failed; the others keep their profile.
+//! @note
+//! TASK SAFE: YES
+//!        if (!sys_i2c_clock_calibrate_bus(sys_i2c_id, test, test_cnt)) { goto fail; }
+//!
+bool sys_i2c_clock_calibrate_bus(uint8_t sys_i2c_id, const struct SYS_I2C_CLOCK_TEST * test_addr, size_t test_cnt);
+
+//! @brief Set or clear a profile. clk_speed 0: port clk_speed.
+//! @note
+//! TASK SAFE: YES. Takes effect on the next transaction.
+//!        if (!sys_i2c_clock_set(sys_i2c_id, i2c_addr_num, 800000U)) { goto fail; }
+//!
+bool sys_i2c_clock_set(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint32_t clk_speed);
+
+//! @brief clk_speed, Hz, the next transaction to (sys_i2c_id, i2c_addr_num) runs at. Profile or port clk_speed.
+//! @note
+//! TASK SAFE: YES. sys_i2c_id, i2c_addr_num pre-validated by caller.
+//!
+uint32_t sys_i2c_clock_get(uint8_t sys_i2c_id, uint8_t i2c_addr_num);
+
+//! @brief Print every profile, and per port_num the transactions run on APB and on REF_TICK; console.
+//!
+bool sys_i2c_clock_print(void);
+
+#ifdef __cplusplus
+}
+#endif
+/* EOF sys_i2c_clock.h */
@@ -0,0 +1,86 @@
+//! @file   sys_i2c_coalesce.h
+//!
+//! @brief  SYS_I2C read coalescing: concurrent reads of the same I2C device share one I2C Bus transaction.
+//!
+//! @details
+//! sys_i2c_read_coalesced() has the same arguments and result as sys_i2c_read(). When several tasks read
+//! the same `sys_i2c_id` and `i2c_addr_num` at nearly the same time:
+//! - Identical or covered range, transaction already on the wire: wait for it, copy the slice. No new transaction.
+//! - Overlapping or adjacent range, transaction queued (waiting for the I2C port lock): the queued range grows,
+//!   one auto-increment burst reads the union. Merged bursts are limited to SYS_I2C_COALESCE_BUF_MAX bytes.
+//! - Otherwise: a new transaction, with this task as its leader.
+//!
+//! @attention Opt-in, per call. Only for registers without read side-effects and with register auto-increment.
+//! FIFO data registers, clear-on-read status registers: use sys_i2c_read().
+//!
+//! How to use:
+//!
+//!     if (!sys_i2c_coalesce_init()) { goto fail; } // once, after sys_i2c_init_all()
+//!     if (!sys_i2c_read_coalesced(sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_addr, buf_size)) { goto fail; }
+//!
+//!     struct SYS_I2C_COALESCE_STATS stats;
+//!     if (!sys_i2c_coalesce_stats(&stats)) { goto fail; }
+//!     printf("I2C transactions saved = %u\n", stats.joined_cnt + stats.merged_cnt);
+//!
+//! @note
+//!     Application code SHALL include `app_config.h`, then this file.
+//!     #include "sys_i2c_coalesce.h" // SYS_I2C read coalescing
+//!
+//! SPDX-FileCopyrightText: 2021 burtrum
+//! SPDX-License-Identifier: Apache-2.0
+//!
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT; includes sys_i2c.h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYS_I2C_COALESCE_SLOT_CNT   (8U)  // Transactions queued or in flight at once, all buses
+#define SYS_I2C_COALESCE_BUF_MAX    (64U) // Largest merged burst. Larger reads pass straight to sys_i2c_read().
+
+//! @brief Coalescing counters, since sys_i2c_coalesce_init().
+//! I2C transactions saved = joined_cnt + merged_cnt.
+//!
+struct SYS_I2C_COALESCE_STATS {
+    uint32_t request_cnt;       // sys_i2c_read_coalesced() calls
+    uint32_t bus_cnt;           // I2C Bus transactions executed by leaders
+    uint32_t joined_cnt;        // requests served by a transaction already on the wire
+    uint32_t merged_cnt;        // requests merged into a queued transaction
+    uint32_t passthrough_cnt;   // requests too large, or no free slot: plain sys_i2c_read()
+};
+
+//! @brief Create slot semaphores, clear counters.
+//! @return true/false, pass/fail
+//! @note
+//! TASK SAFE: NO. Run once during boot, after sys_i2c_init_all().
+//!        if (!sys_i2c_coalesce_init()) { goto fail; }
+//!
+bool sys_i2c_coalesce_init(void);
+
+//! @brief sys_i2c_read() that may share its I2C Bus transaction with concurrent reads of the same device.
+//! @param [in] sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_addr, buf_size: the same as sys_i2c_read()
+//! @return true/false; true: valid data in buffer from I2C device; false: buffer contents not valid
+//! @note
+//! TASK SAFE: YES.
+//!        if (!sys_i2c_read_coalesced(sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_addr, buf_size)) { goto fail; }
+//!
+bool sys_i2c_read_coalesced(
+        uint8_t sys_i2c_id,
+        uint8_t i2c_addr_num,
+        uint8_t i2c_reg_num,
+        uint8_t * buf_addr,
+        size_t buf_size
+        );
+
+//! @brief Copy coalescing counters.
+//! @note
+//! TASK SAFE: YES.
+//!        if (!sys_i2c_coalesce_stats(&stats)) { goto fail; }
+//!
+bool sys_i2c_coalesce_stats(struct SYS_I2C_COALESCE_STATS * stats_addr);
+
+#ifdef __cplusplus
+}
+#endif
+/* EOF sys_i2c_coalesce.h */
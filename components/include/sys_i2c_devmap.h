@@ -0,0 +1,92 @@
+//! @file   sys_i2c_devmap.h
+//!
+//! @brief  SYS_I2C persisted device map: the discovered I2C devices per bsp_id, saved for the next warm boot.
+//!
+//! @details
+//! A cold boot runs the full discovery sweep, 112 addresses per I2C Bus. A warm boot (software reset, watchdog,
+//! deep sleep wake) reloads the saved map and discovery probes only the known addresses; see sys_i2c_discover.h.
+//! A known device missing falls back to a full scan of that bus, and the map is saved again.
+//!
+//! Record: compact, versioned, one per bsp_id, key "i2c_map_<bsp_id>":
+//!     byte 0..1   magic 'S' 'M'
+//!     byte 2      SYS_I2C_DEVMAP_VERSION
+//!     byte 3      bsp_id
+//!     byte 4      bus count, SYS_I2C_ID_CNT
+//!     byte 5..    16 bytes per I2C Bus: 128-bit address map, address 0 is bit 0 of the first byte
+//!     last byte   CRC-8 (SMBus PEC) over all bytes before it
+//! Any field different, or a bad CRC: the record is ignored. Changing the board, bus count or version costs one full scan.
+//!
+//! Storage backend is pluggable, struct SYS_I2C_DEVMAP_STORE:
+//! - SYS_I2C_devmap_store_nvs: NVS namespace "sys_i2c". Application calls nvs_flash_init() first.
+//! - sys_i2c_devmap_file_load()/_save(): one file per key in the directory `.ctx`. SPIFFS/FAT on target, host builds.
+//!
+//! How to use:
+//!
+//!     uint32_t known_map[SYS_I2C_ID_CNT][4];
+//!     if (warm_boot && sys_i2c_devmap_load(&SYS_I2C_devmap_store_nvs, APP_config.bsp_id, known_map)) {
+//!         if (!sys_i2c_discover_start_known(known_map)) { goto fail; }
+//!     } else {
+//!         if (!sys_i2c_discover_start()) { goto fail; }
+//!     }
+//!     if (!sys_i2c_discover_wait(portMAX_DELAY)) { goto fail; }
+//!     if (!sys_i2c_devmap_save(&SYS_I2C_devmap_store_nvs, APP_config.bsp_id)) { goto fail; } // only writes if changed
+//!
+//! @note
+//!     Application code SHALL include `app_config.h`, then this file.
+//!     #include "sys_i2c_devmap.h" // SYS_I2C persisted device map
+//!
+//! SPDX-FileCopyrightText: 2021 burtrum
+//! SPDX-License-Identifier: Apache-2.0
+//!
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT; includes sys_i2c.h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYS_I2C_DEVMAP_VERSION      (1U)
+#define SYS_I2C_DEVMAP_HEAD_SIZE    (5U)
+#define SYS_I2C_DEVMAP_BUS_SIZE     (16U) // 128 addresses, one bit each
+#define SYS_I2C_DEVMAP_RECORD_SIZE  (SYS_I2C_DEVMAP_HEAD_SIZE + (SYS_I2C_DEVMAP_BUS_SIZE * SYS_I2C_ID_CNT) + 1U)
+
+//! @brief Storage backend. Opaque bytes by key; the record format is not the backend's business.
+//! load: read up to buf_size bytes, true only if the key exists. save: replace the key, durable on return.
+//!
+struct SYS_I2C_DEVMAP_STORE {
+    bool (*load)(const void * ctx, const char * key, uint8_t * buf_addr, size_t buf_size, size_t * read_size_addr);
+    bool (*save)(const void * ctx, const char * key, const uint8_t * buf_addr, size_t buf_size);
+    const void * ctx; // NVS: namespace string; file: directory string
+};
+
+//! @brief NVS backend, namespace "sys_i2c". Target builds only.
+extern const struct SYS_I2C_DEVMAP_STORE    SYS_I2C_devmap_store_nvs;
+
+//! @brief File backend, stdio. ctx: directory, example "/spiffs" or "." on a host build.
+//!     const struct SYS_I2C_DEVMAP_STORE devmap_store_file = {
+//!         .load = sys_i2c_devmap_file_load, .save = sys_i2c_devmap_file_save, .ctx = "/spiffs" };
+//!
+bool sys_i2c_devmap_file_load(const void * ctx, const char * key, uint8_t * buf_addr, size_t buf_size, size_t * read_size_addr);
+bool sys_i2c_devmap_file_save(const void * ctx, const char * key, const uint8_t * buf_addr, size_t buf_size);
+
+//! @brief Load and check the saved map of bsp_id.
+//! @param [out] known_map: input to sys_i2c_discover_start_known()
+//! @return true: valid record; false: none, stale or corrupt. Use sys_i2c_discover_start().
+//! @note
+//! TASK SAFE: YES, with a task-safe backend.
+//!        if (!sys_i2c_devmap_load(&SYS_I2C_devmap_store_nvs, bsp_id, known_map)) { full scan }
+//!
+bool sys_i2c_devmap_load(const struct SYS_I2C_DEVMAP_STORE * store_addr, uint8_t bsp_id, uint32_t known_map[SYS_I2C_ID_CNT][4]);
+
+//! @brief Save the discovered map of bsp_id, after sys_i2c_discover_wait(). Writes only if the record changed.
+//! @return true/false, pass/fail
+//! @note
+//! TASK SAFE: YES, with a task-safe backend.
+//!        if (!sys_i2c_devmap_save(&SYS_I2C_devmap_store_nvs, bsp_id)) { goto fail; }
+//!
+bool sys_i2c_devmap_save(const struct SYS_I2C_DEVMAP_STORE * store_addr, uint8_t bsp_id);
+
+#ifdef __cplusplus
+}
+#endif
+/* EOF sys_i2c_devmap.h */
@@ -0,0 +1,113 @@
+//! @file   sys_i2c_discover.h
+//!
+//! @brief  SYS_I2C background device discovery: every I2C Bus scanned at boot while the application runs.
+//!
+//! @details
+//! sys_i2c_scan_print() probes every address of every I2C Bus before returning, seconds at boot.
+//! sys_i2c_discover_start() returns at once:
+//! - One low priority task per active port_num, "sys_i2c_disc0", "sys_i2c_disc1": both I2C_FSMs scan in parallel.
+//! - Each probe takes the I2C port lock like any sys_i2c_probe(); application transactions interleave.
+//! - Per-bus ready flag as each bus finishes; one "discovery complete" event when all are done.
+//! - Results kept as a 128-bit address map per I2C Bus. sys_i2c_discover_print() prints them, no I2C Bus traffic.
+//!
+//! Warm boot: sys_i2c_discover_start_known() with a saved map, see sys_i2c_devmap.h. Each bus probes only its
+//! known addresses; any known device missing, or an empty map: full scan of that bus. New devices on a verified bus
+//! are not seen until the next full scan.
+//!
+//! Address range 0x08 - 0x77: valid I2C device addresses, reserved addresses not probed.
+//! With SYS_I2C_LAZY_INSTALL_ENABLE each port_num driver is installed by its discovery task or by the application,
+//! whichever is first.
+//!
+//! How to use:
+//!
+//!     if (!sys_i2c_init_all()) { goto fail; }
+//!     if (!sys_i2c_discover_start()) { goto fail; }
+//!     ... application runs, I2C transactions allowed ...
+//!     if (sys_i2c_discover_ready(SYS_I2C_ID_00)) { ... }
+//!     if (!sys_i2c_discover_wait(portMAX_DELAY)) { goto fail; } // discovery complete
+//!     if (!sys_i2c_discover_found(SYS_I2C_ID_00, 0x3C, &found_flag)) { goto fail; }
+//!
+//! @note
+//!     Application code SHALL include `app_config.h`, then this file.
+//!     #include "sys_i2c_discover.h" // SYS_I2C background device discovery
+//!
+//! SPDX-FileCopyrightText: 2021 burtrum
+//! SPDX-License-Identifier: Apache-2.0
+//!
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT; includes sys_i2c.h
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYS_I2C_DISCOVER_ADDR_MIN   (0x08U) // first valid I2C device address
+#define SYS_I2C_DISCOVER_ADDR_MAX   (0x77U) // last valid I2C device address
+
+//! @brief Start one discovery task per active port_num. Returns at once.
+//! @return true/false, pass/fail; false: a task not created. None created: may be called again. Some created: they
+//! finish, sys_i2c_discover_wait() then returns false, sys_i2c_discover_ready() tells which I2C Buses are done.
+//! @note
+//! TASK SAFE: NO. Once, after sys_i2c_init_all().
+//!        if (!sys_i2c_discover_start()) { goto fail; }
+//!
+bool sys_i2c_discover_start(void);
+
+//! @brief Start discovery that first verifies a known device map. Returns at once.
+//! @param [in] known_map: 128-bit address map per I2C Bus, bit (i2c_addr_num % 32) of word (i2c_addr_num / 32). Copied.
+//! @return true/false, pass/fail
+//! @note
+//! TASK SAFE: NO. Once, after sys_i2c_init_all(), instead of sys_i2c_discover_start().
+//!        if (!sys_i2c_discover_start_known(known_map)) { goto fail; }
+//!
+bool sys_i2c_discover_start_known(const uint32_t known_map[SYS_I2C_ID_CNT][4]);
+
+//! @brief Wait for the "discovery complete" event.
+//! @param [in] ticks_to_wait: 0 to poll, portMAX_DELAY
+//! @return true: every I2C Bus scanned; false: not within ticks_to_wait, not started, or started in part
+//! @note
+//! TASK SAFE: YES. Any number of waiters.
+//!        if (!sys_i2c_discover_wait(portMAX_DELAY)) { goto fail; }
+//!
+bool sys_i2c_discover_wait(TickType_t ticks_to_wait);
+
+//! @brief Per-bus ready flag. Never blocks.
+//! @return true: this I2C Bus scanned, results valid
+//! @note
+//! TASK SAFE: YES.
+//!        if (sys_i2c_discover_ready(sys_i2c_id)) { ... }
+//!
+bool sys_i2c_discover_ready(uint8_t sys_i2c_id);
+
+//! @brief Discovery result for one address. No I2C Bus traffic.
+//! @param [out] found_flag_addr: true: the device ACKed during discovery
+//! @return true/false; false: bus not ready yet, or bad argument
+//! @note
+//! TASK SAFE: YES.
+//!        if (!sys_i2c_discover_found(sys_i2c_id, i2c_addr_num, &found_flag)) { goto fail; }
+//!
+bool sys_i2c_discover_found(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool * found_flag_addr);
+
+//! @brief Copy one I2C Bus address map.
+//! @param [out] found_map: 128-bit address map, same layout as sys_i2c_discover_start_known()
+//! @param [out] full_scan_flag_addr: optional, NULL allowed. true: full sweep ran, known map missing or not confirmed.
+//! @return true/false; false: bus not ready yet
+//! @note
+//! TASK SAFE: YES.
+//!        if (!sys_i2c_discover_map(sys_i2c_id, found_map, &full_scan_flag)) { goto fail; }
+//!
+bool sys_i2c_discover_map(uint8_t sys_i2c_id, uint32_t found_map[4], bool * full_scan_flag_addr);
+
+//! @brief Print the discovered I2C Bus maps, the same layout as sys_i2c_scan_print(). Ready buses only.
+//! @note
+//! TASK SAFE: YES.
+//!        if (!sys_i2c_discover_print()) { goto fail; }
+//!
+bool sys_i2c_discover_print(void);
+
+#ifdef __cplusplus
+}
+#endif
+/* EOF sys_i2c_discover.h */
@@ -0,0 +1,129 @@
+//! @file   sys_i2c_hotplug.h
+//!
+//! @brief  SYS_I2C hot-plug monitor: watched devices probed in the idle gaps of each I2C_FSM, attach/detach events.
+//!
+//! @details
+//! sys_i2c_scan_print() sweeps 112 addresses per bus, blocking, console only. The monitor probes only what it watches:
+//! - Expected devices, registered with sys_i2c_hotplug_watch(), each with an optional init hook.
+//! - Previously seen devices: the discovery map of every bus ready at sys_i2c_hotplug_start(), sys_i2c_discover.h.
+//!
+//! One task per active port_num, "sys_i2c_hp0", "sys_i2c_hp1", at idle priority. Each watched address is probed once
+//! per period, Kconfig SYS_I2C_HOTPLUG_PERIOD_MS:
+//! - Only while the I2C port lock is free: sys_i2c_port_try_take(), no spin, no wait in the lock queue. Busy: retried
+//!   a few ticks later, then left for the next period. One address byte per lock hold.
+//! - A foreground task arriving during a probe waits at most that one address byte; mutex priority inheritance lifts
+//!   the monitor meanwhile.
+//!
+//! Presence: an address on a bus discovered before start begins as the discovery map says; any other address, its
+//! first probe only records it, no event. Then:
+//! - Absent -> ACK: the init hook runs, monitor task, outside the port lock. Pass: SYS_I2C_HOTPLUG_ATTACH.
+//!   Fail: SYS_I2C_HOTPLUG_INIT_FAIL, the hook runs again next period while the device answers.
+//! - Present -> SYS_I2C_HOTPLUG_MISS_CNT probes in a row without ACK: SYS_I2C_HOTPLUG_DETACH.
+//! Events queue up to SYS_I2C_HOTPLUG_QUEUE_LEN; more are dropped and counted, presence stays correct.
+//!
+//! How to use:
+//!
+//!     static bool imu_init(uint8_t sys_i2c_id, uint8_t i2c_addr_num, void * arg) { ... configure registers ... }
+//!     if (!sys_i2c_hotplug_watch(SYS_I2C_ID_02, 0x68, imu_init, NULL)) { goto fail; }
+//!     if (!sys_i2c_hotplug_start()) { goto fail; } // after sys_i2c_init_all(), best after sys_i2c_discover_wait()
+//!     struct SYS_I2C_HOTPLUG_EVENT event;
+//!     while (sys_i2c_hotplug_event_get(&event, portMAX_DELAY)) { ... event.type, event.sys_i2c_id, event.i2c_addr_num ... }
+//!
+//! @note
+//!     Application code SHALL include `app_config.h`, then this file.
+//!     #include "sys_i2c_hotplug.h" // SYS_I2C hot-plug monitor
+//!
+//! SPDX-FileCopyrightText: 2021 burtrum
+//! SPDX-License-Identifier: Apache-2.0
+//!
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT, SYS_I2C_HOTPLUG_PERIOD_MS, SYS_I2C_HOTPLUG_MISS_CNT; includes sys_i2c.h
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYS_I2C_HOTPLUG_DEV_MAX     (16U)       // sys_i2c_hotplug_watch() entries
+#define SYS_I2C_HOTPLUG_QUEUE_LEN   (16U)       // pending events
+#define SYS_I2C_HOTPLUG_PERIOD_MAX  (60000U)    // ms, sys_i2c_hotplug_period_set() limit, same as Kconfig
+
+enum SYS_I2C_HOTPLUG_TYPE {
+    SYS_I2C_HOTPLUG_ATTACH,     // answers again, init hook passed or none
+    SYS_I2C_HOTPLUG_DETACH,     // SYS_I2C_HOTPLUG_MISS_CNT probes without ACK
+    SYS_I2C_HOTPLUG_INIT_FAIL,  // answers, init hook failed; retried next period
+};
+
+//! @brief One presence change.
+//!
+struct SYS_I2C_HOTPLUG_EVENT {
+    enum SYS_I2C_HOTPLUG_TYPE type;
+    uint8_t     sys_i2c_id;
+    uint8_t     i2c_addr_num;
+    int64_t     at_us;          // esp_timer_get_time() when raised, right after the deciding probe
+};
+
+//! @brief Device init hook, run by the monitor task on attach. Normal sys_i2c_* calls allowed.
+//! @return true: device ready
+//!
+typedef bool (*sys_i2c_hotplug_init_t)(uint8_t sys_i2c_id, uint8_t i2c_addr_num, void * arg);
+
+//! @brief Monitor counters, since sys_i2c_hotplug_start(). All port_num together.
+//!
+struct SYS_I2C_HOTPLUG_STATS {
+    uint32_t pass_cnt;      // periods run, per port_num summed
+    uint32_t probe_cnt;     // probes on the wire
+    uint32_t busy_cnt;      // probes left for the next period: port lock never free
+    uint32_t attach_cnt;
+    uint32_t detach_cnt;
+    uint32_t init_fail_cnt;
+    uint32_t drop_cnt;      // events lost, queue full
+};
+
+//! @brief Watch one device, with an optional init hook. Before or after sys_i2c_hotplug_start().
+//! @param [in] init_fn: NULL allowed, attach events only. arg: passed to init_fn.
+//! @return true/false; false: bad argument, table full. The same address again: hook replaced.
+//! @note
+//! TASK SAFE: YES.
+//!
+bool sys_i2c_hotplug_watch(uint8_t sys_i2c_id, uint8_t i2c_addr_num, sys_i2c_hotplug_init_t init_fn, void * arg);
+
+//! @brief Add the discovery map of every ready I2C Bus to the watch set, start one monitor task per active port_num.
+//! @return true/false, pass/fail
+//! @note
+//! TASK SAFE: NO. Once, after sys_i2c_init_all().
+//!        if (!sys_i2c_hotplug_start()) { goto fail; }
+//!
+bool sys_i2c_hotplug_start(void);
+
+//! @brief Next presence change event.
+//! @param [in] ticks_to_wait: 0 to poll, portMAX_DELAY
+//! @return true: event_addr filled; false: none within ticks_to_wait, or not started
+//! @note
+//! TASK SAFE: YES. Each event goes to one caller.
+//!
+bool sys_i2c_hotplug_event_get(struct SYS_I2C_HOTPLUG_EVENT * event_addr, TickType_t ticks_to_wait);
+
+//! @brief Presence of one watched address, as of its last probe. No I2C Bus traffic.
+//! @param [out] present_flag_addr: true: answering and, with a hook, initialized
+//! @return true/false; false: bad argument, not watched
+//!
+bool sys_i2c_hotplug_present(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool * present_flag_addr);
+
+//! @brief Probe period, 10 .. SYS_I2C_HOTPLUG_PERIOD_MAX ms. Applies from the next period.
+//!
+bool sys_i2c_hotplug_period_set(uint32_t period_ms);
+
+//! @brief Copy the counters.
+//!
+bool sys_i2c_hotplug_stats(struct SYS_I2C_HOTPLUG_STATS * stats_addr);
+
+//! @brief Print the watched devices with presence, and the counters.
+//!
+bool sys_i2c_hotplug_print(void);
+
+#ifdef __cplusplus
+}
+#endif
+/* EOF sys_i2c_hotplug.h */
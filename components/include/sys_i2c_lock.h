@@ -0,0 +1,67 @@
+//! @file   sys_i2c_lock.h
+//!
+//! @brief  SYS_I2C port lock: counters, spin bound control, contention benchmark.
+//!
+//! @details
+//! The I2C port lock of each ESP32_I2C_FSM is hybrid, see sys_i2c_port_take() in sys_i2c.c:
+//! - uncontended: one FreeRTOS mutex take, as before.
+//! - contended: spin on the lock holder mirror, no context switch, while the holder can give back without this
+//!   core; bounded by an adaptive spin_us, at most Kconfig SYS_I2C_LOCK_SPIN_MAX_US.
+//! - then block on the mutex; priority inheritance as before.
+//! Hot lock state lives in SYS_I2C_runtime.port[port_num], SYS_I2C_PORT_ALIGN aligned, apart from the read-mostly
+//! .unit table.
+//!
+//! Benchmark: 1 to task_max tasks, alternately pinned to core 0 and core 1, hammer one I2C Bus port lock, each
+//! holding it hold_us per take, busy, like a short transfer. Every task count runs twice: block only (spin bound 0),
+//! then hybrid. One printed row each: takes/s, average and max wait, spin wins, blocks.
+//!
+//! How to use:
+//!
+//!     (void)sys_i2c_lock_bench(SYS_I2C_ID_00, 4, 1000, 30); // 1 to 4 tasks, 1 s each, 30 us hold: 2 bytes at 1 MHz
+//!
+//! @note
+//!     Application code SHALL include `app_config.h`, then this file.
+//!     #include "sys_i2c_lock.h" // SYS_I2C port lock counters, benchmark
+//!
+//! SPDX-FileCopyrightText: 2021 burtrum
+//! SPDX-License-Identifier: Apache-2.0
+//!
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT; includes sys_i2c.h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYS_I2C_LOCK_BENCH_TASK_MAX     (8U)
+
+//! @brief Copy the counters and the current spin bound of the port lock of sys_i2c_id.
+//! Buses sharing a port_num share the lock and its counters.
+//! @param [out] stats_addr
+//! @param [out] spin_us_addr: NULL allowed
+//! @note
+//! TASK SAFE: YES
+//!
+bool sys_i2c_lock_stats(uint8_t sys_i2c_id, struct SYS_I2C_LOCK_STATS * stats_addr, uint16_t * spin_us_addr);
+
+//! @brief Clear the counters of every port lock.
+//!
+bool sys_i2c_lock_stats_reset(void);
+
+//! @brief Set the spin bound limit of every port lock, 0: block only. Default Kconfig SYS_I2C_LOCK_SPIN_MAX_US.
+//!
+bool sys_i2c_lock_spin_set(uint16_t spin_max_us);
+
+//! @brief Contention benchmark, prints one row per task count and lock mode. Blocks for 2 * task_max * run_ms.
+//! @return true/false; false: bad argument, task create failed. Each port's spin bound limit and adaptive spin_us,
+//! as before the run, are restored either way; the lock counters are not.
+//! @note
+//! TASK SAFE: YES, but other traffic on the same port_num skews the numbers.
+//!        if (!sys_i2c_lock_bench(SYS_I2C_ID_00, 4, 1000, 30)) { goto fail; }
+//!
+bool sys_i2c_lock_bench(uint8_t sys_i2c_id, uint8_t task_max, uint32_t run_ms, uint32_t hold_us);
+
+#ifdef __cplusplus
+}
+#endif
+/* EOF sys_i2c_lock.h */
@@ -0,0 +1,71 @@
+//! @file   sys_i2c_mux.h
+//!
+//! @brief  SYS_I2C multiplexer channels, TCA9548A style, as virtual I2C Buses with a channel-select cache.
+//!
+//! @details
+//! Out of GPIO pins: put a TCA9548A on an I2C Bus, each of its 8 channels becomes a virtual I2C Bus, a sys_i2c_id
+//! like any other. Declare it in the config tables, not in application code:
+//!
+//!     // app_config.h, enum SYS_I2C_ID: after its parent
+//!     SYS_I2C_ID_05, // TCA9548A 0x70 channel 0 on SYS_I2C_ID_00
+//!     // app_config.c, SYS_I2C_config.unit[]: port_num and the BSP_I2C_config pins come from the parent
+//!     [SYS_I2C_ID_05] = { .mux_parent_id = SYS_I2C_ID_00, .mux_addr = 0x70, .mux_channel = 0, },
+//!     // or main/bsp_i2c_board.cmake, Kconfig SYS_I2C_BOARD_GEN
+//!     sys_i2c_bus(SYS_I2C_ID_05 MUX SYS_I2C_ID_00 ADDR 0x70 CHANNEL 0)
+//!
+//! A mux may sit on a virtual bus: cascade. Every sys_i2c_* call on a virtual bus, under the same I2C port lock
+//! hold as its payload transaction, right after the pins attach:
+//! - on each bus from the physical root down to the target, every mux on that bus is set to: the channel toward
+//!   the target, or all channels closed. The target bus itself: all its muxes closed.
+//! - a mux control register already holding that value is not written. The driver remembers what it wrote.
+//! Back to back calls on one virtual bus: no select write at all. Alternating buses: one write per switch.
+//! Buses with no mux on or above them: no cost beyond one table read.
+//!
+//! Closing sibling muxes keeps identical devices on different channels apart. Mux writes run at the clk_speed
+//! attached for the target device: the mux must support it.
+//! The cache is lost if a mux resets, power cycle or its RESET pin: call sys_i2c_mux_invalidate(). A failed select
+//! write forgets that mux, the next access writes it again.
+//! sys_i2c_write_broadcast(): virtual buses can not be fanned out, only be the first, ACK checked, bus.
+//!
+//! @note
+//!     Application code SHALL include `app_config.h`, then this file.
+//!     #include "sys_i2c_mux.h" // SYS_I2C multiplexer virtual buses
+//!
+//! SPDX-FileCopyrightText: 2021 burtrum
+//! SPDX-License-Identifier: Apache-2.0
+//!
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT; includes sys_i2c.h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! @brief Channel-select counters, since sys_i2c_init_all().
+//!
+struct SYS_I2C_MUX_STATS {
+    uint32_t select_cnt;    // mux control register writes
+    uint32_t skip_cnt;      // writes not needed, register already held the value
+    uint32_t fail_cnt;      // failed writes
+};
+
+//! @brief Copy the counters.
+//! @note
+//! TASK SAFE: YES
+//!
+bool sys_i2c_mux_stats(struct SYS_I2C_MUX_STATS * stats_addr);
+
+//! @brief Forget every cached mux control register; the next access to each mux writes it.
+//! @note
+//! TASK SAFE: YES, takes each port lock.
+//!
+bool sys_i2c_mux_invalidate(void);
+
+//! @brief Print every mux: bus, address, cached channels, virtual buses behind it; and the counters.
+//!
+bool sys_i2c_mux_print(void);
+
+#ifdef __cplusplus
+}
+#endif
+/* EOF sys_i2c_mux.h */
@@ -0,0 +1,99 @@
+//! @file   sys_i2c_pipe.h
+//!
+//! @brief  SYS_I2C pipelined transfers: transaction N+1 is checked and built while transaction N is on the wire.
+//!
+//! @details
+//! sys_i2c_read() / sys_i2c_write() do their CPU work in series with the transfer, under the same port lock:
+//! argument checks, clock profile lookup, i2c_cmd link build, pin routing. Between two back-to-back transactions the
+//! I2C_FSM sits idle for all of it. sys_i2c_pipe_xfer() runs a sys_i2c_vec.h operation list as a pipeline:
+//! - Builder, the calling task: per operation, in list order, the prepare checks and the i2c_config, sys_i2c_prep.h,
+//!   then the complete i2c_cmd program. Up to SYS_I2C_PIPE_DEPTH built transactions wait per port_num.
+//! - Wire, one task per port_num, "sys_i2c_pipe0", "sys_i2c_pipe1": takes the port lock once, runs the built
+//!   transactions back to back. Pins stay attached while the I2C Bus and clk_speed stay the same; a switch is only
+//!   detach, attach. Both port_num run at once, so routing a bus on one I2C_FSM overlaps a transfer on the other.
+//! - While the wire task waits in i2c_master_cmd_begin(), the builder runs: on the other core, or on this one while
+//!   the wire task is blocked on the transfer. Builder ahead: the wire finds the next program ready on completion.
+//!
+//! Port lock: held from the first transaction of a batch to the last on that port_num. Builder behind, nothing
+//! ready: the wire task detaches and gives the lock, other tasks get in, and counts a starve.
+//!
+//! Bus idle gap: from the end of one i2c_master_cmd_begin() to the start of the next on the same port_num, within
+//! one batch. Everything left between two transfers: queue hand-over, a bus switch, a starve. See
+//! sys_i2c_pipe_print().
+//!
+//! Order: operations on one port_num run in list order, as sys_i2c_vec_xfer(). With SYS_I2C_WCOMB_ENABLE, deferred
+//! writes to a device are flushed when its operation is built, before any later transaction to it runs.
+//!
+//! How to use:
+//!
+//!     if (!sys_i2c_pipe_init()) { goto fail; } // once, after sys_i2c_init_all()
+//!     if (!sys_i2c_pipe_xfer(sweep, 5)) { ... check sweep[idx].pass_flag ... } // sweep: see sys_i2c_vec.h
+//!     (void)sys_i2c_pipe_print();
+//!     (void)sys_i2c_pipe_bench(sweep, 5, 100); // time per list: sys_i2c_vec_xfer() vs sys_i2c_pipe_xfer()
+//!
+//! @note
+//!     Application code SHALL include `app_config.h`, then this file.
+//!     #include "sys_i2c_pipe.h" // SYS_I2C pipelined transfers
+//!
+//! SPDX-FileCopyrightText: 2021 burtrum
+//! SPDX-License-Identifier: Apache-2.0
+//!
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT; includes sys_i2c.h
+#include "sys_i2c_vec.h" // struct SYS_I2C_VEC_OP
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYS_I2C_PIPE_DEPTH          (4U) // built transactions ahead of the wire, per port_num
+
+//! @brief Pipeline counters, since sys_i2c_pipe_init(). All port_num together.
+//!
+struct SYS_I2C_PIPE_STATS {
+    uint32_t batch_cnt;     // sys_i2c_pipe_xfer() calls
+    uint32_t op_cnt;        // transactions run
+    uint32_t switch_cnt;    // attaches: I2C Bus or clk_speed differs from the transaction before
+    uint32_t gap_cnt;       // back-to-back transaction pairs measured
+    uint32_t gap_sum_us;    // bus idle between them
+    uint32_t gap_max_us;
+    uint32_t starve_cnt;    // wire found nothing built: builder behind, port lock given meanwhile
+    uint32_t full_cnt;      // builder found every slot built: wire behind, the intended state
+};
+
+//! @brief Create one wire task, slot queues per active port_num. Clear counters.
+//! @return true/false, pass/fail
+//! @note
+//! TASK SAFE: NO. Run once during boot, after sys_i2c_init_all().
+//!        if (!sys_i2c_pipe_init()) { goto fail; }
+//!
+bool sys_i2c_pipe_init(void);
+
+//! @brief Run all operations pipelined, both I2C_FSMs concurrently. Blocks until every operation is done.
+//! @param [in,out] op_addr: operation list; .pass_flag written for every entry
+//! @param [in] op_cnt: entries in the list
+//! @return true/false; true: all operations passed; false: check each op_addr[idx].pass_flag
+//! @note
+//! TASK SAFE: YES. Callers run one batch at a time.
+//!        if (!sys_i2c_pipe_xfer(op_addr, op_cnt)) { goto fail; }
+//!
+bool sys_i2c_pipe_xfer(struct SYS_I2C_VEC_OP * op_addr, size_t op_cnt);
+
+//! @brief Copy the counters.
+//!
+bool sys_i2c_pipe_stats(struct SYS_I2C_PIPE_STATS * stats_addr);
+
+//! @brief Print the counters and the average bus idle gap.
+//!
+bool sys_i2c_pipe_print(void);
+
+//! @brief Time per list, loop_cnt lists each, interleaved: sys_i2c_vec_xfer() and sys_i2c_pipe_xfer(). Wire time is
+//! the same on both; the difference is the CPU work taken off the gaps. Printed, with the gaps of the pipelined runs.
+//! @return true/false; false: bad argument, an operation failed.
+//!
+bool sys_i2c_pipe_bench(struct SYS_I2C_VEC_OP * op_addr, size_t op_cnt, uint32_t loop_cnt);
+
+#ifdef __cplusplus
+}
+#endif
+/* EOF sys_i2c_pipe.h */
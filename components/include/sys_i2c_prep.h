@@ -0,0 +1,108 @@
+//! @file   sys_i2c_prep.h
+//!
+//! @brief  SYS_I2C prepared transactions: fix the shape of a read or write once, execute it many times.
+//!
+//! @details
+//! A control loop that reads the same bytes from the same device every few ms pays, per sys_i2c_read(), for
+//! argument checks, the clock profile lookup, a heap i2c_cmd link alloc, encoding and free.
+//! sys_i2c_prep_read() / sys_i2c_prep_write() do the checks once and keep the result in a caller owned
+//! struct SYS_I2C_PREP: bus, address bytes, register, buffer, size, the i2c_config to attach.
+//! sys_i2c_prep_exec() then only locks, attaches, runs, detaches and unlocks.
+//!
+//! The i2c_cmd program itself is emitted again by each execute: i2c_master_cmd_begin() consumes the link, it advances
+//! the data pointer and byte count of each command as the FIFO is filled. With ESP32-IDF >= 4.4,
+//! SYS_I2C_STATIC_ENABLE, the program is emitted into link_buf of the struct, i2c_cmd_link_create_static(): no heap,
+//! no lock inside malloc. Older IDF: one heap link per execute, as sys_i2c_read().
+//!
+//! The buffer is referenced, not copied: a prepared read lands in buf_addr on every execute, a prepared write sends
+//! the current content of buf_addr. The clk_speed is the clock profile of the device at prepare time; prepare again
+//! after sys_i2c_clock_set().
+//!
+//! How to use:
+//!
+//!     static struct SYS_I2C_PREP accel_prep; // link_buf inside, keep it off small task stacks
+//!     uint8_t accel_buf[6];
+//!     if (!sys_i2c_prep_read(&accel_prep, SYS_I2C_ID_00, 0x68, 0x3B, accel_buf, sizeof(accel_buf))) { goto fail; }
+//!     for (;;) {
+//!         if (!sys_i2c_prep_exec(&accel_prep)) { ... }
+//!         vTaskDelay(pdMS_TO_TICKS(2));
+//!     }
+//!
+//!     (void)sys_i2c_prep_bench(&accel_prep, 1000); // per call time: sys_i2c_read() vs sys_i2c_prep_exec()
+//!
+//! @note
+//!     Application code SHALL include `app_config.h`, then this file.
+//!     #include "sys_i2c_prep.h" // SYS_I2C prepared transactions
+//!
+//! SPDX-FileCopyrightText: 2021 burtrum
+//! SPDX-License-Identifier: Apache-2.0
+//!
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT, SYS_I2C_STATIC_ENABLE; includes sys_i2c.h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Static link size: a read is 8 commands, START W-ADDR REG START R-ADDR READ READ STOP; a write is 5.
+#if (SYS_I2C_STATIC_ENABLE == true)
+#define SYS_I2C_PREP_LINK_SIZE      I2C_LINK_RECOMMENDED_SIZE(2)
+#endif
+
+enum SYS_I2C_PREP_DIR {
+    SYS_I2C_PREP_READ,      // sys_i2c_read() shape
+    SYS_I2C_PREP_WRITE,     // sys_i2c_write() shape
+};
+
+//! @brief One prepared transaction. Caller owned, filled by sys_i2c_prep_read() / sys_i2c_prep_write().
+//! Do not edit the fields; prepare again to change the shape.
+//!
+struct SYS_I2C_PREP {
+    enum SYS_I2C_PREP_DIR dir;
+    uint8_t         sys_i2c_id;
+    uint8_t         i2c_addr_num;
+    uint8_t         i2c_reg_num;
+    uint8_t         addr_w_byte;    // i2c_addr_num << 1 | I2C_MASTER_WRITE
+    uint8_t         addr_r_byte;    // i2c_addr_num << 1 | I2C_MASTER_READ
+    uint8_t *       buf_addr;
+    size_t          buf_size;
+    i2c_port_t      port_num;
+    i2c_config_t    i2c_config;     // attach argument, clk_speed of the clock profile at prepare time
+    bool            ready_flag;
+    #if (SYS_I2C_STATIC_ENABLE == true)
+    uint8_t         link_buf[SYS_I2C_PREP_LINK_SIZE];
+    #endif
+};
+
+//! @brief Prepare a read of buf_size bytes from i2c_reg_num at i2c_addr_num into buf_addr.
+//! @return true/false; false: bad argument, sys_i2c_init_all() not run.
+//! @note
+//! TASK SAFE: YES, on different prep_addr.
+//!
+bool sys_i2c_prep_read(struct SYS_I2C_PREP * prep_addr, uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size);
+
+//! @brief Prepare a write of buf_size bytes from buf_addr to i2c_reg_num at i2c_addr_num.
+//!
+bool sys_i2c_prep_write(struct SYS_I2C_PREP * prep_addr, uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size);
+
+//! @brief Execute a prepared transaction: port lock, attach, run, detach, unlock.
+//! @note
+//! TASK SAFE: YES, one task per prep_addr at a time: link_buf is per prep.
+//!
+bool sys_i2c_prep_exec(struct SYS_I2C_PREP * prep_addr);
+
+//! @brief sys_i2c_prep_exec() body, for sys_i2c_bus_take() holders.
+//!
+bool sys_i2c_prep_exec_locked(struct SYS_I2C_PREP * prep_addr);
+
+//! @brief Per call time, loop_cnt calls each, interleaved: the same transaction through sys_i2c_read() or
+//! sys_i2c_write(), and through sys_i2c_prep_exec(). Wire time is the same on both; the difference is CPU time saved.
+//! Prints one line per path and the saving.
+//! @return true/false; false: bad argument, a transfer failed.
+//!
+bool sys_i2c_prep_bench(struct SYS_I2C_PREP * prep_addr, uint32_t loop_cnt);
+
+#ifdef __cplusplus
+}
+#endif
+/* EOF sys_i2c_prep.h */
@@ -0,0 +1,86 @@
+//! @file   sys_i2c_profile.h
+//!
+//! @brief  SYS_I2C hot-path phase profiler: where the CPU time of one sys_i2c_read(), sys_i2c_write(), sys_i2c_probe() goes.
+//!
+//! @details
+//! Kconfig SYS_I2C_PROFILE compiles CPU cycle counter stamps into the three calls. Each stamp charges the cycles
+//! since the last one to a phase:
+//!     LOCK_TAKE   argument check, sys_i2c_port_take(); includes any wait for another task
+//!     ATTACH      sys_i2c_attach_pins(): i2c_param_config() of the port_num
+//!     BUILD       i2c_cmd_link_create() ... i2c_master_stop(), and i2c_cmd_link_delete()
+//!     EXEC        i2c_master_cmd_begin(): FSM load, wire time, interrupt, wake up
+//!     DETACH      sys_i2c_detach_pins(): gpio_config() of SCL and SDA
+//!     LOCK_GIVE   sys_i2c_port_give()
+//! Next to EXEC each call adds its theoretical wire time: bits on the wire at the clk_speed attached for that device,
+//! sys_i2c_clock_get(). Everything in the total that is not wire time is overhead; the report shows where.
+//!
+//! Aggregated per I2C Bus: count, sum and max per phase. Every phase has its own count: *_locked() calls from
+//! sys_i2c_bus_take() holders add ATTACH ... DETACH only, failed calls stop adding at the failed phase.
+//! Cycle counters are per core. A phase that starts on one core and ends on the other, a task migrated while
+//! waiting for the lock, is dropped and counted in migrate_cnt.
+//! Cost: two counter reads and one short portMUX section per phase; the stamp restarts after them, phases exclude it.
+//!
+//! How to use:
+//!
+//!     (void)sys_i2c_profile_reset();
+//!     ... run the workload ...
+//!     (void)sys_i2c_profile_print(); // per bus: phase avg/max ns and share of the total, wire time, overhead
+//!
+//! @note
+//!     Application code SHALL include `app_config.h`, then this file.
+//!     #include "sys_i2c_profile.h" // SYS_I2C hot-path phase profiler
+//!
+//! SPDX-FileCopyrightText: 2021 burtrum
+//! SPDX-License-Identifier: Apache-2.0
+//!
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT; includes sys_i2c.h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum SYS_I2C_PROFILE_PHASE {
+    SYS_I2C_PROFILE_LOCK_TAKE,
+    SYS_I2C_PROFILE_ATTACH,
+    SYS_I2C_PROFILE_BUILD,
+    SYS_I2C_PROFILE_EXEC,
+    SYS_I2C_PROFILE_DETACH,
+    SYS_I2C_PROFILE_LOCK_GIVE,
+    SYS_I2C_PROFILE_PHASE_CNT // DO NOT RENAME, always last
+};
+
+struct SYS_I2C_PROFILE_STAT {
+    uint32_t    cnt;
+    uint32_t    max_cycle;
+    uint64_t    sum_cycle;
+};
+
+//! @brief One I2C Bus. Cycles of the core that ran the phase; convert with esp_rom_get_cpu_ticks_per_us().
+//!
+struct SYS_I2C_PROFILE_BUS {
+    struct SYS_I2C_PROFILE_STAT phase[SYS_I2C_PROFILE_PHASE_CNT];
+    struct SYS_I2C_PROFILE_STAT wire;       // theoretical wire time, in CPU cycles
+    uint32_t                    migrate_cnt;
+};
+
+//! @brief Clear every bus.
+//! @return true/false; false: Kconfig SYS_I2C_PROFILE off.
+//! @note
+//! TASK SAFE: YES
+//!
+bool sys_i2c_profile_reset(void);
+
+//! @brief Copy the counters of one bus, consistent snapshot.
+//! @param [out] bus_addr
+//!
+bool sys_i2c_profile_get(uint8_t sys_i2c_id, struct SYS_I2C_PROFILE_BUS * bus_addr);
+
+//! @brief Print every bus with traffic: per phase count, avg and max ns, % of the total; wire time and overhead.
+//!
+bool sys_i2c_profile_print(void);
+
+#ifdef __cplusplus
+}
+#endif
+/* EOF sys_i2c_profile.h */
@@ -0,0 +1,125 @@
+//! @file   sys_i2c_quota.h
+//!
+//! @brief  SYS_I2C bandwidth quotas: token bucket per client task or per device, charged before the port lock.
+//!
+//! @details
+//! Every I2C Bus mapped to one port_num shares one I2C_FSM. A task refreshing an OLED in a tight loop takes the port
+//! lock back to back; everyone else on that port_num waits behind it. A quota caps what a task, or a device, gets:
+//! - Unit: payload bytes, or bus time in us: the theoretical wire time at the device clk_speed, sys_i2c_clock_get(),
+//!   START, address, register, RESTART, STOP bits included.
+//! - Token bucket: refilled at .rate per second up to .burst. A transfer goes ahead while the bucket is not in debt,
+//!   then its cost is taken, so one transfer larger than .burst still passes and pays back after.
+//! - Over budget: SYS_I2C_QUOTA_DEFER sleeps the caller until the bucket refills, at most .defer_max_ms, then
+//!   rejects; SYS_I2C_QUOTA_REJECT fails the call at once. Either way before the port lock: a waiting task holds
+//!   nothing.
+//!
+//! Charged: sys_i2c_read(), sys_i2c_write(), sys_i2c_prep_exec(), sys_i2c_sched.h, sys_i2c_pipe.h,
+//! sys_i2c_read_coalesced() (every caller, shared read or not), sys_i2c_smbus.h (command code as the register byte;
+//! Block Read: count byte plus buf_size), sys_i2c_write_broadcast() (once per target bus); only calls that passed their
+//! argument checks. Probes, SMBus Quick Command, bus recovery, background flushes are not charged.
+//! Not charged either: sys_i2c_bus_take() with *_locked() calls, and the sys_i2c.hpp Hold guard. The caller holds the
+//! port lock itself for as long as it likes; a quota cannot cap it. Keep capped tasks off those paths.
+//! A call is charged to every matching entry: its task and its device. All must have budget.
+//!
+//! Critical traffic: give it no entry. It is never deferred, never rejected, and the I2C_FSM time the capped tasks
+//! can take is bounded by their rates, so its throughput does not depend on them.
+//!
+//! How to use, Kconfig SYS_I2C_QUOTA on:
+//!
+//!     struct SYS_I2C_QUOTA_CONFIG oled_quota = {
+//!         .task = oled_task_handle, .sys_i2c_id = SYS_I2C_ID_CNT, .i2c_addr_num = SYS_I2C_ADDR_INVALID,
+//!         .unit = SYS_I2C_QUOTA_BUS_US, .rate = 250000, .burst = 25000,   // 25% of the I2C_FSM, 25 ms at once
+//!         .policy = SYS_I2C_QUOTA_DEFER, .defer_max_ms = 1000,
+//!     };
+//!     uint8_t quota_idx;
+//!     if (!sys_i2c_quota_add(&oled_quota, &quota_idx)) { goto fail; }
+//!     (void)sys_i2c_quota_print(); // used per second vs quota, pass, defer, reject
+//!
+//! @note
+//!     Application code SHALL include `app_config.h`, then this file.
+//!     #include "sys_i2c_quota.h" // SYS_I2C bandwidth quotas
+//!
+//! SPDX-FileCopyrightText: 2021 burtrum
+//! SPDX-License-Identifier: Apache-2.0
+//!
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT, SYS_I2C_QUOTA_ENABLE; includes sys_i2c.h
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h" // TaskHandle_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYS_I2C_QUOTA_MAX           (8U)    // sys_i2c_quota_add() entries
+
+enum SYS_I2C_QUOTA_UNIT {
+    SYS_I2C_QUOTA_BYTES,        // payload bytes, buf_size
+    SYS_I2C_QUOTA_BUS_US,       // wire time, us
+};
+
+enum SYS_I2C_QUOTA_POLICY {
+    SYS_I2C_QUOTA_DEFER,        // wait for tokens, up to .defer_max_ms, then reject
+    SYS_I2C_QUOTA_REJECT,       // fail the call at once
+};
+
+//! @brief One quota. Match: every field set must equal the call; .task NULL, .sys_i2c_id SYS_I2C_ID_CNT,
+//! .i2c_addr_num SYS_I2C_ADDR_INVALID: any.
+//!
+struct SYS_I2C_QUOTA_CONFIG {
+    TaskHandle_t                task;           // client: calls from this task
+    uint8_t                     sys_i2c_id;     // device: I2C Bus
+    uint8_t                     i2c_addr_num;   // device: address
+    enum SYS_I2C_QUOTA_UNIT     unit;
+    uint32_t                    rate;           // unit per second, > 0
+    uint32_t                    burst;          // bucket size, unit, > 0; starts full
+    enum SYS_I2C_QUOTA_POLICY   policy;
+    uint32_t                    defer_max_ms;   // SYS_I2C_QUOTA_DEFER only
+};
+
+//! @brief Usage of one entry, since sys_i2c_quota_add() or sys_i2c_quota_set().
+//!
+struct SYS_I2C_QUOTA_STATS {
+    uint32_t    rate;           // quota, unit per second
+    uint32_t    burst;
+    int32_t     tokens;         // now; negative: in debt, next call waits or is rejected
+    uint32_t    used_per_s;     // unit per second, averaged over the last window of 1 s or more
+    uint64_t    used_sum;       // unit, all charged calls
+    uint32_t    pass_cnt;       // calls admitted at once
+    uint32_t    defer_cnt;      // calls admitted after a wait
+    uint32_t    reject_cnt;
+    uint32_t    defer_max_us;   // longest wait
+};
+
+//! @brief Add a quota. Takes effect on the next call.
+//! @param [out] quota_idx_addr: entry index, for sys_i2c_quota_set(), sys_i2c_quota_stats(); NULL allowed
+//! @return true/false; false: bad argument, table full, Kconfig SYS_I2C_QUOTA off
+//! @note
+//! TASK SAFE: YES.
+//!        if (!sys_i2c_quota_add(&config, &quota_idx)) { goto fail; }
+//!
+bool sys_i2c_quota_add(const struct SYS_I2C_QUOTA_CONFIG * config_addr, uint8_t * quota_idx_addr);
+
+//! @brief Change rate and burst of an entry. Bucket refilled, counters cleared.
+//! @return true/false; false: bad argument
+//!
+bool sys_i2c_quota_set(uint8_t quota_idx, uint32_t rate, uint32_t burst);
+
+//! @brief Remove every entry. Waiting callers finish their current wait.
+//!
+bool sys_i2c_quota_clear(void);
+
+//! @brief Copy the usage of an entry, tokens and used_per_s brought up to now.
+//! @return true/false; false: bad argument
+//!
+bool sys_i2c_quota_stats(uint8_t quota_idx, struct SYS_I2C_QUOTA_STATS * stats_addr);
+
+//! @brief Print every entry: match, quota, used per second, tokens, pass, defer, reject.
+//!
+bool sys_i2c_quota_print(void);
+
+#ifdef __cplusplus
+}
+#endif
+/* EOF sys_i2c_quota.h */
@@ -0,0 +1,109 @@
+//! @file   sys_i2c_replay.h
+//!
+//! @brief  SYS_I2C workload replay: re-issue a sys_i2c_capture.h image, report throughput and latency, compare builds.
+//!
+//! @details
+//! One worker task per captured task_idx issues that task's calls in captured order, so lock contention between
+//! tasks is replayed too. Timing:
+//! - asap_flag false: each call waits for its captured start time, relative to the replay start.
+//! - asap_flag true: back-to-back, as fast as the target goes. Throughput ceiling.
+//!
+//! Targets, struct SYS_I2C_REPLAY_TARGET:
+//! - SYS_I2C_replay_target_bus: real sys_i2c_read(), sys_i2c_probe(). Writes are never sent: each holds the port
+//!   lock for its modelled wire time instead. The payload is not captured, only its size.
+//! - Opt-in, real writes: a target { sys_i2c_replay_exec_bus, ctx `&SYS_I2C_replay_write_enable` } sends every
+//!   captured write as sys_i2c_write() of a zero-filled payload. It overwrites device registers with 0x00; use it
+//!   only with scratch devices or on a test bench. sys_i2c_replay_run() logs a warning with the write count.
+//! - SYS_I2C_replay_target_model: stand-in, no bus traffic. Every call takes the real port lock and holds it for
+//!   its modelled wire time, 9 bits per byte at the sys_i2c_clock_get() speed of that device. Result as captured.
+//!   Measures the lock, the port mapping and the scheduling without hardware.
+//!
+//! Report: op count, fail count, payload bytes, wall time; latency sum, max and a log2 histogram for p50/p99.
+//! sys_i2c_replay_capture_report() builds the same report from the latencies in the image itself.
+//! Save a report with any struct SYS_I2C_DEVMAP_STORE backend; the next build loads it as the baseline.
+//!
+//! How to use, regression check after a port mapping change:
+//!
+//!     struct SYS_I2C_REPLAY_REPORT base, now;
+//!     if (!sys_i2c_replay_load(&store, "i2c_rep", &base)) { baseline_flag = false; }
+//!     if (!sys_i2c_replay_run(capture_buf, capture_size, &SYS_I2C_replay_target_bus, false, &now)) { goto fail; }
+//!     (void)sys_i2c_replay_print(&now, (baseline_flag) ? &base : NULL); // % deltas vs the last build
+//!     if (!sys_i2c_replay_save(&store, "i2c_rep", &now)) { goto fail; }
+//!
+//! @note
+//!     Application code SHALL include `app_config.h`, then this file.
+//!     #include "sys_i2c_replay.h" // SYS_I2C workload replay
+//!
+//! SPDX-FileCopyrightText: 2021 burtrum
+//! SPDX-License-Identifier: Apache-2.0
+//!
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT; includes sys_i2c.h
+#include "sys_i2c_capture.h" // struct SYS_I2C_CAPTURE_RECORD
+#include "sys_i2c_devmap.h" // struct SYS_I2C_DEVMAP_STORE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYS_I2C_REPLAY_VERSION      (1U)
+#define SYS_I2C_REPLAY_HIST_CNT     (24U) // bucket n: latency < 2^n us; last bucket also holds everything slower
+
+//! @brief Replay target. exec: issue one captured call; buf_addr holds at least record buf_size bytes, zero-filled.
+//! Return the call result, true/false, pass/fail.
+//!
+struct SYS_I2C_REPLAY_TARGET {
+    bool (*exec)(const void * ctx, const struct SYS_I2C_CAPTURE_RECORD * record_addr, uint8_t * buf_addr);
+    const void * ctx;
+};
+
+extern const struct SYS_I2C_REPLAY_TARGET   SYS_I2C_replay_target_bus;      // real bus, writes modelled
+extern const struct SYS_I2C_REPLAY_TARGET   SYS_I2C_replay_target_model;    // stand-in, no bus traffic
+extern const bool                           SYS_I2C_replay_write_enable;    // ctx for real writes, see @details
+
+//! @brief Bus target exec, for the opt-in target with ctx `&SYS_I2C_replay_write_enable`. Zero-filled writes, see @details.
+//!     const struct SYS_I2C_REPLAY_TARGET target = { .exec = sys_i2c_replay_exec_bus, .ctx = &SYS_I2C_replay_write_enable };
+//!
+bool sys_i2c_replay_exec_bus(const void * ctx, const struct SYS_I2C_CAPTURE_RECORD * record_addr, uint8_t * buf_addr);
+
+//! @brief Results of one replay, or of one capture. Plain data, saved as is.
+//!
+struct SYS_I2C_REPLAY_REPORT {
+    uint16_t    version;        // SYS_I2C_REPLAY_VERSION
+    uint16_t    size;           // sizeof(struct SYS_I2C_REPLAY_REPORT)
+    uint32_t    op_cnt;
+    uint32_t    fail_cnt;
+    uint32_t    byte_cnt;       // payload bytes
+    uint32_t    wall_us;        // first call start to last call end
+    uint32_t    lat_max_us;
+    uint64_t    lat_sum_us;
+    uint32_t    lat_hist[SYS_I2C_REPLAY_HIST_CNT];
+};
+
+//! @brief Replay a capture image. Blocks until every call is issued.
+//! @param [out] report_addr
+//! @return true/false; false: bad image, bad target, out of memory, or another replay running. Failed calls are counted, not fatal.
+//! @note
+//! TASK SAFE: one replay at a time. Application I2C traffic running alongside is measured as interference.
+//!        if (!sys_i2c_replay_run(capture_buf, capture_size, &SYS_I2C_replay_target_model, true, &report)) { goto fail; }
+//!
+bool sys_i2c_replay_run(const uint8_t * capture_addr, size_t capture_size, const struct SYS_I2C_REPLAY_TARGET * target_addr,
+                        bool asap_flag, struct SYS_I2C_REPLAY_REPORT * report_addr);
+
+//! @brief Report of the captured run itself, from its recorded latencies. No bus traffic.
+//!
+bool sys_i2c_replay_capture_report(const uint8_t * capture_addr, size_t capture_size, struct SYS_I2C_REPLAY_REPORT * report_addr);
+
+//! @brief Print throughput, latency avg/p50/p99/max. base_addr not NULL: also the % delta of each against it.
+//!
+bool sys_i2c_replay_print(const struct SYS_I2C_REPLAY_REPORT * report_addr, const struct SYS_I2C_REPLAY_REPORT * base_addr);
+
+//! @brief Save or load a report by key. Load fails on a missing key or another report version.
+//!
+bool sys_i2c_replay_save(const struct SYS_I2C_DEVMAP_STORE * store_addr, const char * key, const struct SYS_I2C_REPLAY_REPORT * report_addr);
+bool sys_i2c_replay_load(const struct SYS_I2C_DEVMAP_STORE * store_addr, const char * key, struct SYS_I2C_REPLAY_REPORT * report_addr);
+
+#ifdef __cplusplus
+}
+#endif
+/* EOF sys_i2c_replay.h */
@@ -0,0 +1,104 @@
+//! @file   sys_i2c_sched.h
+//!
+//! @brief  SYS_I2C bus-switch-aware scheduling: waiting requests on one I2C_FSM are served grouped by I2C Bus and clock.
+//!
+//! @details
+//! Many I2C Buses share one port_num I2C_FSM. Tasks alternating between bus A and bus B pay a full pin re-route,
+//! detach, i2c_param_config(), attach, on every call; a different device clock pays a clock reprogram as well.
+//! sys_i2c_sched_read() and sys_i2c_sched_write() queue the request on its port_num instead:
+//! - The first requester, no server on that port_num yet, becomes the server: takes the I2C port lock and runs the
+//!   queued requests, its own and those arriving meanwhile, then hands over.
+//! - Pins stay attached from one request to the next with the same I2C Bus and clk_speed. A switch, re-route or
+//!   clock, happens only when the next request differs.
+//! - Next request: the oldest, once it has been passed over `window` times, or first after the lock is taken; else
+//!   the cheapest switch: same bus and clock, then same bus, clock only, then any other bus; ties in arrival order.
+//! - Bounds: a request is passed over by at most `window` later requests. A server runs at most
+//!   SYS_I2C_SCHED_SLOT_CNT requests per port lock hold, then gives the lock so plain sys_i2c_* callers get in.
+//!   Its own request done, it hands the server role to the oldest waiting requester and returns.
+//!
+//! Order: requests of one task never overtake each other, each call blocks until done. Requests of different tasks
+//! may run in any order within the window, as with any two tasks racing for the port lock.
+//!
+//! Counters: switches saved = fifo_switch_cnt - switch_cnt. Both count a switch each time a request's I2C Bus or
+//! clk_speed differs from the one before it on the port_num: in arrival order, and in the order actually run.
+//! Latency cost: bypass_max, wait_max_us. Window 0: arrival order, for a like-for-like comparison.
+//!
+//! How to use:
+//!
+//!     if (!sys_i2c_sched_init()) { goto fail; } // once, after sys_i2c_init_all()
+//!     // any number of tasks:
+//!     if (!sys_i2c_sched_read(SYS_I2C_ID_01, 0x48, 0x00, temp_buf, 2)) { goto fail; }
+//!     ...
+//!     (void)sys_i2c_sched_print();
+//!
+//! @note
+//!     Application code SHALL include `app_config.h`, then this file.
+//!     #include "sys_i2c_sched.h" // SYS_I2C bus-switch-aware scheduling
+//!
+//! SPDX-FileCopyrightText: 2021 burtrum
+//! SPDX-License-Identifier: Apache-2.0
+//!
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT, SYS_I2C_SCHED_WINDOW; includes sys_i2c.h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYS_I2C_SCHED_SLOT_CNT      (8U)  // Waiting requests per port_num; more: plain sys_i2c_read()/sys_i2c_write()
+#define SYS_I2C_SCHED_WINDOW_MAX    (32U) // sys_i2c_sched_window_set() limit, same as Kconfig
+
+//! @brief Scheduler counters, since sys_i2c_sched_init(). All port_num together.
+//!
+struct SYS_I2C_SCHED_STATS {
+    uint32_t req_cnt;           // requests run by a server
+    uint32_t passthrough_cnt;   // no free slot: plain sys_i2c_read()/sys_i2c_write()
+    uint32_t reorder_cnt;       // requests run ahead of an older waiting request
+    uint32_t fifo_switch_cnt;   // bus or clock switches arrival order would have cost
+    uint32_t switch_cnt;        // bus or clock switches in the order run
+    uint32_t clock_switch_cnt;  // of switch_cnt: same bus, other clk_speed
+    uint32_t handoff_cnt;       // server role handed to a waiting requester
+    uint32_t bypass_max;        // most later requests one request was passed over by, <= window
+    uint32_t wait_max_us;       // longest queue + run time of one request
+};
+
+//! @brief Create the slot semaphores, set the window from Kconfig SYS_I2C_SCHED_WINDOW, clear counters.
+//! @return true/false, pass/fail
+//! @note
+//! TASK SAFE: NO. Run once during boot, after sys_i2c_init_all().
+//!        if (!sys_i2c_sched_init()) { goto fail; }
+//!
+bool sys_i2c_sched_init(void);
+
+//! @brief sys_i2c_read(), scheduled. Blocks until done.
+//! @param [in] sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_addr, buf_size: the same as sys_i2c_read().
+//! @return true/false, pass/fail
+//! @note
+//! TASK SAFE: YES
+//!
+bool sys_i2c_sched_read(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size);
+
+//! @brief sys_i2c_write(), scheduled. Blocks until done.
+//! @param [in] sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_addr, buf_size: the same as sys_i2c_write().
+//! @return true/false, pass/fail
+//! @note
+//! TASK SAFE: YES
+//!
+bool sys_i2c_sched_write(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size);
+
+//! @brief Reordering window, 0 .. SYS_I2C_SCHED_WINDOW_MAX. 0: arrival order. Applies from the next pick.
+//!
+bool sys_i2c_sched_window_set(uint8_t window);
+
+//! @brief Copy the counters.
+//!
+bool sys_i2c_sched_stats(struct SYS_I2C_SCHED_STATS * stats_addr);
+
+//! @brief Print the counters and switches saved.
+//!
+bool sys_i2c_sched_print(void);
+
+#ifdef __cplusplus
+}
+#endif
+/* EOF sys_i2c_sched.h */
@@ -0,0 +1,116 @@
+//! @file   sys_i2c_smbus.h
+//!
+//! @brief  SYS_I2C SMBus: quick, byte, word, block and process-call protocols with optional PEC, on any SYS_I2C Bus.
+//!
+//! @details
+//! SMBus protocols on top of the sys_i2c I2C port lock and pin swapping. For battery gauges, power supplies, fan controllers.
+//! - PEC: Packet Error Code, CRC-8 poly 0x07, over every byte on the wire including address bytes.
+//!   Table driven, computed incrementally over the caller buffers in place. No copies.
+//!   Write: PEC appended. Read: PEC byte read last and checked; mismatch is a fail.
+//! - Words are little-endian on the wire: low byte first.
+//! - Block read: the device reports the byte count. Count, data and PEC are read inside ONE transaction:
+//!   the I2C_FSM holds SCL low after the count byte until the data segment is programmed. No STOP in between.
+//! - Timeout: SYS_I2C_SMBUS_TIMEOUT_TICK per transaction, from the SMBus 35ms clock low limit.
+//!
+//! How to use:
+//!
+//!     uint16_t voltage_mv;
+//!     if (!sys_i2c_smbus_read_word(SYS_I2C_ID_00, 0x0B, 0x09, &voltage_mv, true)) { goto fail; } // SBS Voltage()
+//!
+//!     uint8_t name_buf[SYS_I2C_SMBUS_BLOCK_MAX];
+//!     size_t  name_size;
+//!     if (!sys_i2c_smbus_block_read(SYS_I2C_ID_00, 0x0B, 0x21, name_buf, sizeof(name_buf), &name_size, true)) { goto fail; }
+//!
+//! @note
+//!     Application code SHALL include `app_config.h`, then this file.
+//!     #include "sys_i2c_smbus.h" // SYS_I2C SMBus protocols with PEC
+//!
+//! SPDX-FileCopyrightText: 2021 burtrum
+//! SPDX-License-Identifier: Apache-2.0
+//!
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT; includes sys_i2c.h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYS_I2C_SMBUS_BLOCK_MAX     (32U) // SMBus 2.0 block byte count limit
+
+//! @brief Quick Command: address byte only, the R/W bit is the data.
+//! @note
+//! TASK SAFE: YES. No PEC in this protocol.
+//!        if (!sys_i2c_smbus_quick(sys_i2c_id, i2c_addr_num, read_flag)) { goto fail; }
+//!
+bool sys_i2c_smbus_quick(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool read_flag);
+
+//! @brief Send Byte / Receive Byte: one data byte, no command code.
+//! @note
+//! TASK SAFE: YES.
+//!        if (!sys_i2c_smbus_send_byte(sys_i2c_id, i2c_addr_num, data_num, pec_flag)) { goto fail; }
+//!        if (!sys_i2c_smbus_recv_byte(sys_i2c_id, i2c_addr_num, &data_num, pec_flag)) { goto fail; }
+//!
+bool sys_i2c_smbus_send_byte(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t data_num, bool pec_flag);
+bool sys_i2c_smbus_recv_byte(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t * data_addr, bool pec_flag);
+
+//! @brief Write Byte / Read Byte: command code, one data byte.
+//! @note
+//! TASK SAFE: YES.
+//!        if (!sys_i2c_smbus_read_byte(sys_i2c_id, i2c_addr_num, cmd_num, &data_num, pec_flag)) { goto fail; }
+//!
+bool sys_i2c_smbus_write_byte(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t cmd_num, uint8_t data_num, bool pec_flag);
+bool sys_i2c_smbus_read_byte(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t cmd_num, uint8_t * data_addr, bool pec_flag);
+
+//! @brief Write Word / Read Word: command code, two data bytes, low byte first.
+//! @note
+//! TASK SAFE: YES.
+//!        if (!sys_i2c_smbus_read_word(sys_i2c_id, i2c_addr_num, cmd_num, &data_num, pec_flag)) { goto fail; }
+//!
+bool sys_i2c_smbus_write_word(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t cmd_num, uint16_t data_num, bool pec_flag);
+bool sys_i2c_smbus_read_word(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t cmd_num, uint16_t * data_addr, bool pec_flag);
+
+//! @brief Process Call: write a word, repeated START, read a word. One transaction.
+//! @note
+//! TASK SAFE: YES.
+//!        if (!sys_i2c_smbus_process_call(sys_i2c_id, i2c_addr_num, cmd_num, wr_num, &rd_num, pec_flag)) { goto fail; }
+//!
+bool sys_i2c_smbus_process_call(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t cmd_num, uint16_t wr_num, uint16_t * rd_addr, bool pec_flag);
+
+//! @brief Block Write: command code, byte count, 1 .. SYS_I2C_SMBUS_BLOCK_MAX data bytes.
+//! @note
+//! TASK SAFE: YES.
+//!        if (!sys_i2c_smbus_block_write(sys_i2c_id, i2c_addr_num, cmd_num, buf_addr, buf_size, pec_flag)) { goto fail; }
+//!
+bool sys_i2c_smbus_block_write(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t cmd_num, const uint8_t * buf_addr, size_t buf_size, bool pec_flag);
+
+//! @brief Block Read: command code, device reported byte count, data. One transaction.
+//! @param [out] buf_addr: data, count bytes
+//! @param [in] buf_size: buffer size; a device count of 0 or larger than buf_size is a fail
+//! @param [out] read_size_addr: device reported byte count
+//! @return true/false; true: valid data, and PEC checked if pec_flag
+//! @note
+//! TASK SAFE: YES.
+//!        if (!sys_i2c_smbus_block_read(sys_i2c_id, i2c_addr_num, cmd_num, buf_addr, buf_size, &read_size, pec_flag)) { goto fail; }
+//!
+bool sys_i2c_smbus_block_read(
+        uint8_t sys_i2c_id,
+        uint8_t i2c_addr_num,
+        uint8_t cmd_num,
+        uint8_t * buf_addr,
+        size_t buf_size,
+        size_t * read_size_addr,
+        bool pec_flag
+        );
+
+//! @brief SMBus PEC, CRC-8 poly 0x07, continued over buf_addr. Start a new PEC with pec_num = 0.
+//! @return updated PEC
+//! @note
+//! TASK SAFE: YES.
+//!        pec_num = sys_i2c_smbus_pec(pec_num, buf_addr, buf_size);
+//!
+uint8_t sys_i2c_smbus_pec(uint8_t pec_num, const uint8_t * buf_addr, size_t buf_size);
+
+#ifdef __cplusplus
+}
+#endif
+/* EOF sys_i2c_smbus.h */
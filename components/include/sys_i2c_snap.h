@@ -0,0 +1,132 @@
+//! @file   sys_i2c_snap.h
+//!
+//! @brief  SYS_I2C snapshot: one producer reads an I2C device, any number of tasks read the published copy.
+//!
+//! @details
+//! A snapshot is a timestamped copy of one register block of one I2C device, example: BMP280 0xF7..0xFC.
+//! One producer task owns the I2C Bus access and publishes. Consumer tasks, on either core, never touch the I2C Bus,
+//! never take the I2C port lock, and never block. Bus reads are decoupled from the number of consumers.
+//!
+//! Publication is a sequence lock (seqlock):
+//! - .seq is odd while the producer is copying new data in, even when the data is stable.
+//! - A consumer copies the data out, then re-reads .seq. Same even value before and after: the copy is consistent.
+//! - A consumer that raced the producer polls .seq until even, then copies again. Bounded by time,
+//!   SYS_I2C_SNAP_SPIN_MAX_US, not by a retry count: a publish in progress on the other core always finishes.
+//!   Only a producer preempted mid-publish, by the consumer itself on the same core, runs the bound out: fail.
+//!
+//! The producer is never delayed by consumers. Consumers only retry while a publish is in progress,
+//! a copy of SYS_I2C_SNAP_DATA_MAX bytes or less.
+//!
+//! How to use:
+//!
+//!     static struct SYS_I2C_SNAP bmp280_snap; // GLOBAL RAM, shared by all tasks
+//!
+//!     // Boot, before any producer or consumer runs.
+//!     if (!sys_i2c_snap_init(&bmp280_snap, SYS_I2C_ID_00, 0x76, 0xF7, 6)) { goto fail; }
+//!
+//!     // Producer task, ONLY ONE per snapshot.
+//!     for (;;) {
+//!         if (!sys_i2c_snap_update(&bmp280_snap)) { goto fail; } // sys_i2c_read() then publish
+//!         vTaskDelay(pdMS_TO_TICKS(100));
+//!     }
+//!
+//!     // Any consumer task, any number.
+//!     uint8_t buf_addr[6];
+//!     int64_t time_us;
+//!     if (!sys_i2c_snap_read(&bmp280_snap, buf_addr, sizeof(buf_addr), &time_us, NULL)) { goto fail; }
+//!
+//! @note
+//!     Application code SHALL include `app_config.h`, then this file.
+//!     #include "sys_i2c_snap.h" // SYS_I2C snapshot publish/subscribe
+//!
+//! SPDX-FileCopyrightText: 2021 burtrum
+//! SPDX-License-Identifier: Apache-2.0
+//!
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT; includes sys_i2c.h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYS_I2C_SNAP_DATA_MAX   (32U) // Largest published register block, bytes.
+#define SYS_I2C_SNAP_SPIN_MAX_US (100U) // Consumer spin while racing a publish, then fail. A publish is ~1 us.
+
+//! @brief One published I2C register block. Caller owned, usually GLOBAL RAM.
+//! All fields are written by sys_i2c_snap_init() and the producer only. Consumers use sys_i2c_snap_read().
+//!
+struct SYS_I2C_SNAP {
+    // Source, set once by sys_i2c_snap_init().
+    uint8_t  sys_i2c_id;
+    uint8_t  i2c_addr_num;
+    uint8_t  i2c_reg_num;
+    size_t   data_size;
+
+    // Published, seqlock protected.
+    volatile uint32_t seq;      // 0: never published; odd: publish in progress; even: stable. Wraps to 2, never 0.
+    int64_t  time_us;           // esp_timer_get_time() at publish
+    uint8_t  data[SYS_I2C_SNAP_DATA_MAX];
+};
+
+//! @brief Initialize a snapshot source. No I2C Bus access.
+//! @param [in] snap_addr: caller owned snapshot
+//! @param [in] sys_i2c_id, i2c_addr_num, i2c_reg_num: the same as sys_i2c_read()
+//! @param [in] data_size: 1 .. SYS_I2C_SNAP_DATA_MAX
+//! @return true/false, pass/fail
+//! @note
+//! TASK SAFE: NO. Call before producer and consumers start.
+//!        if (!sys_i2c_snap_init(&snap, sys_i2c_id, i2c_addr_num, i2c_reg_num, data_size)) { goto fail; }
+//!
+bool sys_i2c_snap_init(
+        struct SYS_I2C_SNAP * snap_addr,
+        uint8_t sys_i2c_id,
+        uint8_t i2c_addr_num,
+        uint8_t i2c_reg_num,
+        size_t data_size
+        );
+
+//! @brief Producer: read the I2C device with sys_i2c_read(), then publish.
+//! On I2C failure nothing is published, consumers keep the previous snapshot and its timestamp.
+//! @param [in] snap_addr
+//! @return true/false; true: new snapshot published
+//! @note
+//! TASK SAFE: ONE producer task per snapshot.
+//!        if (!sys_i2c_snap_update(&snap)) { goto fail; }
+//!
+bool sys_i2c_snap_update(struct SYS_I2C_SNAP * snap_addr);
+
+//! @brief Producer: publish data already read by the caller, example: a device driver with its own read sequence.
+//! @param [in] snap_addr
+//! @param [in] buf_addr: data to publish
+//! @param [in] buf_size: must equal snap_addr->data_size
+//! @return true/false; true: new snapshot published
+//! @note
+//! TASK SAFE: ONE producer task per snapshot.
+//!        if (!sys_i2c_snap_publish(&snap, buf_addr, buf_size)) { goto fail; }
+//!
+bool sys_i2c_snap_publish(struct SYS_I2C_SNAP * snap_addr, const uint8_t * buf_addr, size_t buf_size);
+
+//! @brief Consumer: copy the latest snapshot. Never blocks, never touches the I2C Bus.
+//! @param [in] snap_addr
+//! @param [in] buf_addr: copy snapshot data to this buffer
+//! @param [in] buf_size: 1 .. snap_addr->data_size; a shorter copy returns the leading bytes
+//! @param [in] time_us_addr: optional, NULL allowed. Publish time, esp_timer_get_time() microseconds.
+//! @param [in] seq_addr: optional, NULL allowed. Publish sequence, compare with a previous read to detect a new sample.
+//! @return true/false; true: valid data in buffer; false: nothing published yet, or a publish still in progress after
+//! SYS_I2C_SNAP_SPIN_MAX_US, producer preempted mid-publish
+//! @note
+//! TASK SAFE: YES. Any number of consumer tasks, either core.
+//!        if (!sys_i2c_snap_read(&snap, buf_addr, buf_size, &time_us, NULL)) { goto fail; }
+//!
+bool sys_i2c_snap_read(
+        const struct SYS_I2C_SNAP * snap_addr,
+        uint8_t * buf_addr,
+        size_t buf_size,
+        int64_t * time_us_addr,
+        uint32_t * seq_addr
+        );
+
+#ifdef __cplusplus
+}
+#endif
+/* EOF sys_i2c_snap.h */
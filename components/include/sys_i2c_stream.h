@@ -0,0 +1,145 @@
+//! @file   sys_i2c_stream.h
+//!
+//! @brief  SYS_I2C stream: continuous I2C FIFO burst reads into a ring of buffers. For IMU, ADC and other on-chip FIFO devices.
+//!
+//! @details
+//! A stream repeatedly drains one FIFO data register, `buf_size` bytes per burst, into a ring of `buf_cnt` buffers.
+//! - Bursts are triggered by a periodic timer (`period_us`), a data-ready GPIO edge (`drdy_io_num`), or both.
+//! - All streams share ONE service task "sys_i2c_stream". No task per sensor.
+//! - Full buffers are handed to the consumer zero-copy: a pointer into the ring. The consumer returns it when done.
+//! - No free buffer when a burst is due: the burst is skipped and counted as an overrun. The device FIFO keeps the data, or reports its own overflow.
+//! - Ring buffers are word aligned, internal DMA capable RAM (MALLOC_CAP_DMA).
+//!
+//! How to use:
+//!
+//!     static struct SYS_I2C_STREAM imu_stream; // GLOBAL RAM
+//!     const struct SYS_I2C_STREAM_CONFIG imu_stream_config = {
+//!         .sys_i2c_id     = SYS_I2C_ID_00,
+//!         .i2c_addr_num   = 0x68,
+//!         .i2c_reg_num    = 0x74,         // FIFO_DATA register
+//!         .buf_size       = 240,          // bytes per burst
+//!         .buf_cnt        = 2,            // double buffer
+//!         .period_us      = 0,            // data-ready GPIO only
+//!         .drdy_io_num    = GPIO_NUM_5,
+//!         .drdy_intr_type = GPIO_INTR_POSEDGE,
+//!     };
+//!     if (!sys_i2c_stream_start(&imu_stream, &imu_stream_config)) { goto fail; }
+//!
+//!     // consumer task
+//!     uint8_t * buf_addr;
+//!     size_t    buf_size;
+//!     if (!sys_i2c_stream_get(&imu_stream, &buf_addr, &buf_size, NULL, portMAX_DELAY)) { goto fail; }
+//!     ... use buf_addr[0 .. buf_size-1] ...
+//!     if (!sys_i2c_stream_put(&imu_stream, buf_addr)) { goto fail; }
+//!
+//! @note
+//!     Application code SHALL include `app_config.h`, then this file.
+//!     #include "sys_i2c_stream.h" // SYS_I2C FIFO streaming reads
+//!
+//! SPDX-FileCopyrightText: 2021 burtrum
+//! SPDX-License-Identifier: Apache-2.0
+//!
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT; includes sys_i2c.h
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYS_I2C_STREAM_BUF_CNT_MAX  (8U) // Ring depth limit. 2: double buffer.
+
+//! @brief Stream source and trigger. Caller owned, may be FLASH const.
+//!
+struct SYS_I2C_STREAM_CONFIG {
+    uint8_t         sys_i2c_id;
+    uint8_t         i2c_addr_num;
+    uint8_t         i2c_reg_num;    // FIFO data register, read with auto-increment disabled by the device
+    size_t          buf_size;       // bytes per burst, one ring buffer
+    uint8_t         buf_cnt;        // ring depth, 2 .. SYS_I2C_STREAM_BUF_CNT_MAX
+    uint32_t        period_us;      // burst cadence; 0: data-ready GPIO only
+    gpio_num_t      drdy_io_num;    // data-ready GPIO; GPIO_NUM_NC: timer only
+    gpio_int_type_t drdy_intr_type; // data-ready edge or level, example: GPIO_INTR_POSEDGE
+};
+
+//! @brief Stream runtime. Caller owned RAM, written by sys_i2c_stream_*() only.
+//!
+struct SYS_I2C_STREAM {
+    struct SYS_I2C_STREAM_CONFIG config;
+    uint8_t *           buf_addr[SYS_I2C_STREAM_BUF_CNT_MAX];
+    int64_t             time_us[SYS_I2C_STREAM_BUF_CNT_MAX]; // esp_timer_get_time() at burst end
+    QueueHandle_t       free_queue;     // ring buffer index, empty buffers
+    QueueHandle_t       full_queue;     // ring buffer index, ready for the consumer, oldest first
+    esp_timer_handle_t  timer;
+    bool                drdy_enabled;   // data-ready ISR handler added
+    volatile uint32_t   trigger_pending; // one trigger queued to the service task
+    volatile bool       running;
+
+    // statistics, read with sys_i2c_stream_stats()
+    volatile uint32_t   burst_cnt;      // bursts read into the ring
+    volatile uint32_t   overrun_cnt;    // bursts skipped: ring full, or trigger faster than the I2C Bus; atomic add, task/timer/ISR
+    volatile uint32_t   error_cnt;      // sys_i2c_read() failed
+};
+
+//! @brief Allocate the ring, create the service task on first use, start the trigger.
+//! @param [in] stream_addr: caller owned
+//! @param [in] config_addr: copied into stream_addr->config
+//! @return true/false, pass/fail
+//! @note
+//! TASK SAFE: NO, once per stream.
+//!        if (!sys_i2c_stream_start(&stream, &stream_config)) { goto fail; }
+//!
+bool sys_i2c_stream_start(struct SYS_I2C_STREAM * stream_addr, const struct SYS_I2C_STREAM_CONFIG * config_addr);
+
+//! @brief Stop the trigger, wait for an in-progress burst, free the ring. Buffers held by the consumer become invalid.
+//! @note
+//! TASK SAFE: NO, consumer must be done.
+//!        if (!sys_i2c_stream_stop(&stream)) { goto fail; }
+//!
+bool sys_i2c_stream_stop(struct SYS_I2C_STREAM * stream_addr);
+
+//! @brief Consumer: take the oldest full buffer, zero-copy.
+//! @param [in] stream_addr
+//! @param [out] buf_addr_addr: pointer into the ring, valid until sys_i2c_stream_put()
+//! @param [out] buf_size_addr: bytes in the buffer, always config.buf_size
+//! @param [out] time_us_addr: optional, NULL allowed. Burst time, esp_timer_get_time() microseconds.
+//! @param [in] ticks_to_wait: 0 to portMAX_DELAY
+//! @return true/false; false: no full buffer within ticks_to_wait
+//! @note
+//! TASK SAFE: YES, one consumer task per stream is the expected use.
+//!        if (!sys_i2c_stream_get(&stream, &buf_addr, &buf_size, NULL, portMAX_DELAY)) { goto fail; }
+//!
+bool sys_i2c_stream_get(
+        struct SYS_I2C_STREAM * stream_addr,
+        uint8_t ** buf_addr_addr,
+        size_t * buf_size_addr,
+        int64_t * time_us_addr,
+        TickType_t ticks_to_wait
+        );
+
+//! @brief Consumer: return a buffer from sys_i2c_stream_get() to the ring.
+//! @note
+//! TASK SAFE: YES.
+//!        if (!sys_i2c_stream_put(&stream, buf_addr)) { goto fail; }
+//!
+bool sys_i2c_stream_put(struct SYS_I2C_STREAM * stream_addr, const uint8_t * buf_addr);
+
+//! @brief Read stream statistics. Any pointer may be NULL.
+//! @note
+//! TASK SAFE: YES.
+//!        if (!sys_i2c_stream_stats(&stream, &burst_cnt, &overrun_cnt, &error_cnt)) { goto fail; }
+//!
+bool sys_i2c_stream_stats(
+        const struct SYS_I2C_STREAM * stream_addr,
+        uint32_t * burst_cnt_addr,
+        uint32_t * overrun_cnt_addr,
+        uint32_t * error_cnt_addr
+        );
+
+#ifdef __cplusplus
+}
+#endif
+/* EOF sys_i2c_stream.h */
@@ -0,0 +1,138 @@
+//! @file   sys_i2c_stress.h
+//!
+//! @brief  SYS_I2C soak and fault-injection stress harness: lock, pin and heap correctness under load and faults.
+//!
+//! @details
+//! The failure paths of sys_i2c_read(), sys_i2c_write(), sys_i2c_probe() (detach on error, lock release,
+//! command link cleanup) run only when a bus misbehaves. This harness makes buses misbehave on purpose.
+//!
+//! One run, three phases, on every I2C Bus at once:
+//!     warmup_ms   no faults: baseline throughput
+//!     fault_ms    faults injected at fault_rate[] per 65536 transactions
+//!     cooldown_ms no faults: throughput must come back
+//! task_cnt worker tasks loop over all buses, sys_i2c_read() of one register range, or sys_i2c_probe() if read_size is 0.
+//! The last write_task_cnt of them sys_i2c_write() instead: write_size bytes, a changing pattern, to write_reg_num at
+//! write_addr_num. Point it at scratch RAM or a register the device tolerates any value in, example DS1307 RAM
+//! 0x68, 0x08 - 0x3F. Never at configuration registers: the pattern lands there. 0: no write traffic.
+//! Every completed call is counted, pass or fail, into a time bucket with its latency; writes also on their own.
+//!
+//! Injected faults, Kconfig SYS_I2C_FAULT_INJECT required, hooks in sys_i2c.c:
+//! - NACK:       I2C_FSM result replaced by ESP_FAIL.
+//! - STRETCH:    SYS_I2C_STRESS_STRETCH_TICK extra hold of the port lock, real result kept. Slow device.
+//! - TIMEOUT:    SYS_I2C_STRESS_TIMEOUT_TICK hold, then ESP_ERR_TIMEOUT.
+//! - STUCK_SDA:  episode, the next SYS_I2C_STRESS_STUCK_OPS transactions on that bus all TIMEOUT. Device holding SDA low.
+//! - ALLOC:      i2c_cmd_link_create() skipped, as if it returned NULL.
+//!
+//! Checks after the run, any one failing fails the run:
+//! - No lock leak: no port lock has a holder.
+//! - No misrouted pins: every bus SCL/SDA pad output is plain GPIO, detached from its I2C_FSM.
+//! - No heap growth: free heap back within SYS_I2C_STRESS_HEAP_SLACK bytes.
+//! - Recovery: last cooldown bucket throughput >= SYS_I2C_STRESS_RECOVER_PCT of the warmup average.
+//!
+//! How to use, long soak example:
+//!
+//!     const struct SYS_I2C_STRESS_CONFIG cfg = {
+//!         .task_cnt = 6, .warmup_ms = 10000, .fault_ms = 600000, .cooldown_ms = 10000, .bucket_ms = 10000,
+//!         .i2c_addr_num = 0x3C, .read_size = 0,
+//!         .write_task_cnt = 2, .write_addr_num = 0x68, .write_reg_num = 0x08, .write_size = 8, // DS1307 RAM
+//!         .fault_rate = { [SYS_I2C_FAULT_NACK] = 655, [SYS_I2C_FAULT_TIMEOUT] = 65, [SYS_I2C_FAULT_STUCK_SDA] = 6 },
+//!     };
+//!     struct SYS_I2C_STRESS_REPORT report;
+//!     bool pass_flag = sys_i2c_stress_run(&cfg, &report);
+//!     (void)sys_i2c_stress_print(&report); // chart: throughput and latency per bucket, fault phase marked
+//!
+//! @note
+//!     Application code SHALL include `app_config.h`, then this file.
+//!     #include "sys_i2c_stress.h" // SYS_I2C stress harness
+//!
+//! SPDX-FileCopyrightText: 2021 burtrum
+//! SPDX-License-Identifier: Apache-2.0
+//!
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT; includes sys_i2c.h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYS_I2C_STRESS_TASK_MAX         (8U)
+#define SYS_I2C_STRESS_BUCKET_MAX       (128U)
+#define SYS_I2C_STRESS_READ_MAX         (32U)                   // read_size limit
+#define SYS_I2C_STRESS_WRITE_MAX        (16U)                   // write_size limit
+#define SYS_I2C_STRESS_STRETCH_TICK     (pdMS_TO_TICKS(10U))
+#define SYS_I2C_STRESS_TIMEOUT_TICK     (pdMS_TO_TICKS(50U))    // shorter than a real bus timeout, same code path
+#define SYS_I2C_STRESS_STUCK_OPS        (16U)                   // transactions per stuck SDA episode
+#define SYS_I2C_STRESS_HEAP_SLACK       (256U)                  // bytes, allocator noise
+#define SYS_I2C_STRESS_RECOVER_PCT      (90U)
+
+enum SYS_I2C_FAULT {
+    SYS_I2C_FAULT_NACK,
+    SYS_I2C_FAULT_STRETCH,
+    SYS_I2C_FAULT_TIMEOUT,
+    SYS_I2C_FAULT_STUCK_SDA,
+    SYS_I2C_FAULT_ALLOC,
+    SYS_I2C_FAULT_CNT // DO NOT RENAME, always last
+};
+
+//! @brief Run settings. Phase lengths are whole multiples of bucket_ms; warmup at least two buckets.
+//!
+struct SYS_I2C_STRESS_CONFIG {
+    uint8_t     task_cnt;                       // worker tasks, 1 to SYS_I2C_STRESS_TASK_MAX
+    uint32_t    warmup_ms;
+    uint32_t    fault_ms;
+    uint32_t    cooldown_ms;
+    uint32_t    bucket_ms;                      // chart resolution; total / bucket_ms <= SYS_I2C_STRESS_BUCKET_MAX
+    uint8_t     i2c_addr_num;                   // same device address on every bus
+    uint8_t     i2c_reg_num;
+    uint8_t     read_size;                      // 0: sys_i2c_probe()
+    uint8_t     write_task_cnt;                 // of task_cnt, workers that write; 0: none
+    uint8_t     write_addr_num;                 // scratch device, same address on every bus
+    uint8_t     write_reg_num;
+    uint8_t     write_size;                     // 1 to SYS_I2C_STRESS_WRITE_MAX
+    uint16_t    fault_rate[SYS_I2C_FAULT_CNT];  // per 65536 transactions, fault phase only
+};
+
+struct SYS_I2C_STRESS_BUCKET {
+    uint32_t    op_cnt;         // calls completed, pass or fail
+    uint32_t    fail_cnt;
+    uint32_t    fault_cnt;      // faults injected
+    uint32_t    lat_max_us;
+    uint64_t    lat_sum_us;
+};
+
+struct SYS_I2C_STRESS_REPORT {
+    uint32_t    op_cnt;
+    uint32_t    fail_cnt;
+    uint32_t    write_op_cnt;       // of op_cnt, sys_i2c_write() calls
+    uint32_t    write_fail_cnt;
+    uint32_t    fault_cnt[SYS_I2C_FAULT_CNT];
+    uint32_t    baseline_op_cnt;    // per bucket, warmup average
+    uint32_t    recovery_op_cnt;    // last bucket
+    int32_t     heap_delta;         // bytes, after - before; negative is growth in use
+    uint8_t     lock_leak_cnt;      // port locks still held
+    uint8_t     pin_misroute_cnt;   // pads still routed to an I2C_FSM
+    bool        pass_flag;
+    uint32_t    bucket_cnt;
+    uint32_t    bucket_ms;
+    uint32_t    fault_first;        // bucket index range of the fault phase
+    uint32_t    fault_last;
+    struct SYS_I2C_STRESS_BUCKET bucket[SYS_I2C_STRESS_BUCKET_MAX];
+};
+
+//! @brief Run the harness. Blocks for warmup_ms + fault_ms + cooldown_ms.
+//! @param [out] report_addr: counters, checks and chart buckets. Large, keep it off small task stacks.
+//! @return true: every check passed; false: a check failed, bad config, or fault rates set without Kconfig SYS_I2C_FAULT_INJECT.
+//! @note
+//! TASK SAFE: one run at a time. Application I2C traffic may run alongside; it is subject to the same faults.
+//!        if (!sys_i2c_stress_run(&cfg, &report)) { (void)sys_i2c_stress_print(&report); goto fail; }
+//!
+bool sys_i2c_stress_run(const struct SYS_I2C_STRESS_CONFIG * config_addr, struct SYS_I2C_STRESS_REPORT * report_addr);
+
+//! @brief Print the report: checks, then one chart line per bucket with throughput bar and latency. '*' marks the fault phase.
+//!
+bool sys_i2c_stress_print(const struct SYS_I2C_STRESS_REPORT * report_addr);
+
+#ifdef __cplusplus
+}
+#endif
+/* EOF sys_i2c_stress.h */
@@ -0,0 +1,87 @@
+//! @file   sys_i2c_vec.h
+//!
+//! @brief  SYS_I2C vectored transfers: a list of read/write operations on different I2C Buses, both I2C_FSMs in parallel.
+//!
+//! @details
+//! A sweep of one sensor on each of N I2C Buses is N sequential sys_i2c_read() calls. The ESP32 has two I2C_FSMs,
+//! I2C_NUM_0 and I2C_NUM_1, that can run at the same time.
+//! sys_i2c_vec_xfer() splits the operation list by the `port_num` of each operation's I2C Bus:
+//! - The calling task runs the operations of the first port_num in the list.
+//! - A worker task per port_num, "sys_i2c_vec0", "sys_i2c_vec1", runs the operations of the other port_num, concurrently.
+//! - Operations on the same port_num run in list order. Each takes and gives the I2C port lock, other tasks interleave.
+//! - Returns when all operations are done. Each operation has its own pass_flag.
+//!
+//! A sweep of N buses split over both ports takes about N/2 transfer times.
+//! Buses are mapped to a port_num, and so a clock speed, in the SYS_I2C_config table; the split follows that table.
+//! The split is static: an operation never moves to the other I2C_FSM, its bus lock and clock speed belong to its
+//! port_num.
+//!
+//! REQUIRED for any parallelism: SYS_I2C_config.unit[] maps the swept buses to BOTH I2C_NUM_0 and I2C_NUM_1, about
+//! half each. The default table in app_config.c maps every bus to I2C_NUM_0: sys_i2c_vec_xfer() then runs the whole
+//! list in the calling task, no worker, same result and time as a loop of sys_i2c_read()/sys_i2c_write().
+//! ESP32-C3 and other single I2C_FSM targets: never parallel.
+//!
+//! How to use:
+//!
+//!     uint8_t temp_buf[5][2];
+//!     struct SYS_I2C_VEC_OP sweep[5];
+//!     for (uint8_t idx = 0; 5 > idx; ++idx) {
+//!         sweep[idx] = (struct SYS_I2C_VEC_OP) { .dir = SYS_I2C_VEC_READ, .sys_i2c_id = idx, .i2c_addr_num = 0x48,
+//!                                                .i2c_reg_num = 0x00, .buf_addr = temp_buf[idx], .buf_size = 2 };
+//!     }
+//!     if (!sys_i2c_vec_init()) { goto fail; } // once, after sys_i2c_init_all()
+//!     if (!sys_i2c_vec_xfer(sweep, 5)) { ... check sweep[idx].pass_flag ... }
+//!
+//! @note
+//!     Application code SHALL include `app_config.h`, then this file.
+//!     #include "sys_i2c_vec.h" // SYS_I2C parallel multi-bus transfers
+//!
+//! SPDX-FileCopyrightText: 2021 burtrum
+//! SPDX-License-Identifier: Apache-2.0
+//!
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT; includes sys_i2c.h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum SYS_I2C_VEC_DIR {
+    SYS_I2C_VEC_READ,   // sys_i2c_read()
+    SYS_I2C_VEC_WRITE,  // sys_i2c_write()
+};
+
+//! @brief One operation. Caller owned, in RAM: pass_flag is written back.
+//!
+struct SYS_I2C_VEC_OP {
+    enum SYS_I2C_VEC_DIR dir;
+    uint8_t         sys_i2c_id;
+    uint8_t         i2c_addr_num;
+    uint8_t         i2c_reg_num;
+    uint8_t *       buf_addr;
+    size_t          buf_size;
+    bool            pass_flag;      // [out] true: this operation passed
+};
+
+//! @brief Create one worker task and job queue per active port_num.
+//! @return true/false, pass/fail
+//! @note
+//! TASK SAFE: NO. Run once during boot, after sys_i2c_init_all().
+//!        if (!sys_i2c_vec_init()) { goto fail; }
+//!
+bool sys_i2c_vec_init(void);
+
+//! @brief Run all operations, both I2C_FSMs concurrently. Blocks until every operation is done.
+//! @param [in,out] op_addr: operation list; .pass_flag written for every entry
+//! @param [in] op_cnt: entries in the list
+//! @return true/false; true: all operations passed; false: check each op_addr[idx].pass_flag
+//! @note
+//! TASK SAFE: YES. Any number of callers; jobs for one worker queue up.
+//!        if (!sys_i2c_vec_xfer(op_addr, op_cnt)) { goto fail; }
+//!
+bool sys_i2c_vec_xfer(struct SYS_I2C_VEC_OP * op_addr, size_t op_cnt);
+
+#ifdef __cplusplus
+}
+#endif
+/* EOF sys_i2c_vec.h */
@@ -0,0 +1,119 @@
+//! @file   sys_i2c_wcomb.h
+//!
+//! @brief  SYS_I2C write combining: small register writes to one device are queued and merged into bursts.
+//!
+//! @details
+//! Device configuration code issues many one-byte sys_i2c_write() calls, each a full locked transaction with
+//! attach and detach. For an enabled device, sys_i2c_write_deferred() queues the write instead:
+//! - A write that starts at the register right after the last queued write extends it: one auto-increment burst.
+//! - Any other write, gap, overlap, lower register, starts a new run. Nothing is reordered, nothing is dropped,
+//!   a register written twice is written twice.
+//! Queued runs are flushed in order, under one I2C port lock, by:
+//! - barrier:  sys_i2c_wcomb_flush(), sys_i2c_wcomb_flush_all(), sys_i2c_wcomb_disable().
+//! - access:   any transaction to the same device, before it runs: sys_i2c_read(), sys_i2c_write(),
+//!             sys_i2c_prep_exec(), sys_i2c_smbus.h, sys_i2c_read_coalesced(), sys_i2c_write_broadcast(),
+//!             sys_i2c_sched.h, sys_i2c_pipe.h.
+//! - full:     no room for the next write, SYS_I2C_WCOMB_BUF_MAX bytes or SYS_I2C_WCOMB_RUN_MAX runs.
+//! - timer:    flush_ms after the first queued write, by task "sys_i2c_wcomb". flush_ms 0: no timer.
+//! What the device sees is the same register writes, in the same order, as calling sys_i2c_write() one by one.
+//!
+//! Errors: sys_i2c_write_deferred() returns true once queued. A flush stops at the first failed run and drops
+//! the rest; the failure is kept and returned by the next barrier of that device.
+//!
+//! @attention Opt-in, per device. Only for devices with register auto-increment on write, the same requirement as
+//! a sys_i2c_write() of more than one byte. Kconfig SYS_I2C_WCOMB compiles the access flush into the calls above;
+//! without it, call sys_i2c_wcomb_flush() before reading back.
+//! sys_i2c_bus_take() holders, *_locked() calls, sys_i2c.hpp Hold: no access flush. Call sys_i2c_wcomb_flush() for
+//! the device yourself before taking the bus; do not call this API while holding it.
+//!
+//! How to use:
+//!
+//!     if (!sys_i2c_wcomb_init()) { goto fail; } // once, after sys_i2c_init_all()
+//!     if (!sys_i2c_wcomb_enable(SYS_I2C_ID_00, 0x68, 10)) { goto fail; }
+//!     for (idx = 0; cfg_cnt > idx; ++idx) {
+//!         (void)sys_i2c_write_deferred(SYS_I2C_ID_00, 0x68, cfg[idx].reg, &cfg[idx].val, 1);
+//!     }
+//!     if (!sys_i2c_wcomb_flush(SYS_I2C_ID_00, 0x68)) { goto fail; } // every queued write done, any failed?
+//!
+//! @note
+//!     Application code SHALL include `app_config.h`, then this file.
+//!     #include "sys_i2c_wcomb.h" // SYS_I2C write combining
+//!
+//! SPDX-FileCopyrightText: 2021 burtrum
+//! SPDX-License-Identifier: Apache-2.0
+//!
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT; includes sys_i2c.h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SYS_I2C_WCOMB_DEV_CNT       (8U)  // Devices enabled at once, all buses
+#define SYS_I2C_WCOMB_BUF_MAX       (32U) // Queued payload bytes per device. Larger writes pass straight to sys_i2c_write().
+#define SYS_I2C_WCOMB_RUN_MAX       (8U)  // Queued runs, transactions, per device
+
+enum SYS_I2C_WCOMB_CAUSE {
+    SYS_I2C_WCOMB_FLUSH_BARRIER,
+    SYS_I2C_WCOMB_FLUSH_ACCESS,
+    SYS_I2C_WCOMB_FLUSH_FULL,
+    SYS_I2C_WCOMB_FLUSH_TIMER,
+    SYS_I2C_WCOMB_CAUSE_CNT // DO NOT RENAME, always last
+};
+
+//! @brief Write combining counters, since sys_i2c_wcomb_init().
+//! I2C transactions saved = write_cnt - bus_cnt, once everything is flushed.
+//!
+struct SYS_I2C_WCOMB_STATS {
+    uint32_t write_cnt;         // writes queued
+    uint32_t merged_cnt;        // writes that extended the previous run
+    uint32_t passthrough_cnt;   // device not enabled, or write larger than SYS_I2C_WCOMB_BUF_MAX: plain sys_i2c_write()
+    uint32_t bus_cnt;           // write transactions run by flushes
+    uint32_t fail_cnt;          // flushes stopped by a failed transaction
+    uint32_t flush_cnt[SYS_I2C_WCOMB_CAUSE_CNT];
+};
+
+//! @brief Create the device locks and the flush timer task, clear counters.
+//! @return true/false, pass/fail
+//! @note
+//! TASK SAFE: NO. Run once during boot, after sys_i2c_init_all().
+//!        if (!sys_i2c_wcomb_init()) { goto fail; }
+//!
+bool sys_i2c_wcomb_init(void);
+
+//! @brief Queue writes to this device from now on. Enabled again: only flush_ms changes.
+//! @param [in] flush_ms: flush this long after the first queued write; 0: no timer, barrier, access and full only.
+//! @return true/false; false: bad argument, not initialized, SYS_I2C_WCOMB_DEV_CNT devices already enabled.
+//!
+bool sys_i2c_wcomb_enable(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint32_t flush_ms);
+
+//! @brief Flush, then stop queueing for this device.
+//! @return true/false; false: a queued write failed, now or since the last barrier.
+//!
+bool sys_i2c_wcomb_disable(uint8_t sys_i2c_id, uint8_t i2c_addr_num);
+
+//! @brief sys_i2c_write() that may be queued and merged, see above.
+//! @param [in] sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_addr, buf_size: the same as sys_i2c_write(). The bytes are copied.
+//! @return true/false; true: queued, or written; false: bad argument, or the plain write failed.
+//! @note
+//! TASK SAFE: YES. Writes of one task keep their order; writes of concurrent tasks interleave as with sys_i2c_write().
+//!
+bool sys_i2c_write_deferred(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, const uint8_t * buf_addr, size_t buf_size);
+
+//! @brief Barrier: every write queued for this device is on the wire when this returns.
+//! @return true/false; false: a queued write of this device failed since the last barrier. Clears that failure.
+//!
+bool sys_i2c_wcomb_flush(uint8_t sys_i2c_id, uint8_t i2c_addr_num);
+
+//! @brief Barrier for every enabled device.
+//!
+bool sys_i2c_wcomb_flush_all(void);
+
+//! @brief Copy write combining counters.
+//!
+bool sys_i2c_wcomb_stats(struct SYS_I2C_WCOMB_STATS * stats_addr);
+
+#ifdef __cplusplus
+}
+#endif
+/* EOF sys_i2c_wcomb.h */
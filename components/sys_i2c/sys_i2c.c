@@ -13,11 +13,17 @@
 static const char * TAG = "sys_i2c";
 #include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
 #include "app_config.h" // Application specific settings. IMPORTANT includes 'sys_i2c.h'
+#include "sys_i2c_priv.h" // sys_i2c component internal: port lock, *_locked() bodies
+#include "sys_i2c_clock.h" // sys_i2c_clock_get(), per-device clk_speed
+#include "sys_i2c_capture.h" // SYS_I2C_CAPTURE_OP_*, capture hook op codes
+#include "sys_i2c_profile.h" // SYS_I2C_PROFILE_* phases
 
 #include "driver/i2c.h"
 #include "driver/gpio.h"
+#include "esp_rom_gpio.h" // esp_rom_gpio_connect_out_signal(), broadcast fan-out
+#include "esp_timer.h" // esp_timer_get_time(), port lock spin bound
+#include "soc/i2c_periph.h" // i2c_periph_signal[port_num].scl_out_sig, .sda_out_sig
 
-#define ESP32_I2C_BUS_TIMEOUT_TICK      (pdMS_TO_TICKS(1000U)) // 1000ms timeout delay for normal I2C read/write
 #define ESP32_I2C_PROBE_TIMEOUT_TICK    (pdMS_TO_TICKS(30U))   //   30ms timeout delay for quick I2C probe, 3 ticks at 100 Hz
 
 // Only used for sys_i2c_scan_print(): Currently uses full I2C Address Range: 0x00 - 0x7F.
@@ -25,15 +31,18 @@ static const char * TAG = "sys_i2c";
 #define SYS_I2C_ADDR_NUM_MIN    (0x00) // (0x08) i2c_addr_num low
 #define SYS_I2C_ADDR_NUM_MAX    (0x7F) // (0x77) i2c_addr_num high
 
-#define ESP32_I2C_ACK_CHECK_EN  1
-#define ESP32_I2C_ACK_VAL       0
-#define ESP32_I2C_NACK_VAL      1
+// SYS_I2C_PROFILE_WIRE() wire time estimate. 9 SCL clocks per byte with ACK.
+#define SYS_I2C_BULK_BIT_PER_BYTE       (9U)
+#define SYS_I2C_PORT_SPIN_MIN_US        (2U)                    // adaptive spin bound floor, SYS_I2C_LOCK_SPIN_MAX_US > 0
 
 
 // sys_i2c_init_all() output goes into RAM runtime table.
 // GLOBAL RAM
 //
 struct SYS_I2C_RUNTIME SYS_I2C_runtime; // sys_i2c.h
+#if (SYS_I2C_BOARD_GEN_ENABLE != true)
+static struct SYS_I2C_UNIT sys_i2c_unit[SYS_I2C_ID_CNT]; // SYS_I2C_runtime.unit, filled by sys_i2c_runtime_init()
+#endif
 
 // @brief
 //
@@ -49,13 +58,20 @@ bool sys_i2c_read(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num,
 bool sys_i2c_write(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size);
 bool sys_i2c_probe(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool * found_flag_addr);
 bool sys_i2c_scan_print(void);
+bool sys_i2c_write_broadcast(const uint8_t * sys_i2c_id_addr, size_t sys_i2c_id_cnt, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size, bool verify_flag);
+bool sys_i2c_bus_take(uint8_t sys_i2c_id);
+bool sys_i2c_bus_give(uint8_t sys_i2c_id);
 
 // helper ESP32_I2C and ESP32_GPIO data validation
 static bool sys_i2c_runtime_init(void);
+static bool sys_i2c_port_install(uint8_t sys_i2c_id);
 
 // helper ESP32_GPIO_MATRIX
-static bool sys_i2c_attach_pins(uint8_t sys_i2c_id);
-static bool sys_i2c_detach_pins(uint8_t sys_i2c_id);
+static bool sys_i2c_fanout_pins(uint8_t sys_i2c_id, i2c_port_t port_num);
+static bool sys_i2c_port_spin(struct SYS_I2C_PORT * port_addr, int64_t start_us, bool * spun_flag_addr);
+static void sys_i2c_port_holder_set(struct SYS_I2C_PORT * port_addr);
+static bool sys_i2c_pm_hold(struct SYS_I2C_PORT * port_addr, bool ref_tick_flag);
+static void sys_i2c_pm_drop(struct SYS_I2C_PORT * port_addr);
 
 // The sys_i2c API
 
@@ -83,33 +99,35 @@ bool sys_i2c_init_all(void)
         if ((I2C_NUM_0 == port_num) && (done_0)) { continue; }
         if ((I2C_NUM_1 == port_num) && (done_1)) { continue; } // assumes two ESP32_I2C_FSMs, RISC-V only has 1
 
-        //2A Confiig `port_num`, just once.
-        const i2c_config_t i2c_config = {
-            .mode               = I2C_MODE_MASTER,
-            .sda_pullup_en      = (SYS_I2C_PULL_UP_ENABLE) ? GPIO_PULLUP_ENABLE : GPIO_PULLUP_DISABLE,
-            .scl_pullup_en      = (SYS_I2C_PULL_UP_ENABLE) ? GPIO_PULLUP_ENABLE : GPIO_PULLUP_DISABLE,
-            .sda_io_num         = SYS_I2C_runtime.unit[sys_i2c_id].sda_io_num,
-            .scl_io_num         = SYS_I2C_runtime.unit[sys_i2c_id].scl_io_num,
-            .master.clk_speed   = SYS_I2C_runtime.unit[sys_i2c_id].clk_speed,
-            #if (SYS_I2C_CLK_FLAGS_ENABLE == true)
-            .clk_flags          = SYS_I2C_runtime.unit[sys_i2c_id].clk_flags,
-            #endif
-        };
-        if (ESP_OK != i2c_param_config(port_num, &i2c_config)) { goto fail; }
-
-        //2B Install `port_num` driver, just once.
-        if (ESP_OK != i2c_driver_install(port_num, I2C_MODE_MASTER, 0, 0, 0)) { goto fail; }
-
-        //3A Each active 'port_num' gets a task-safe mutex lock.
+        //2A Each active 'port_num' gets a task-safe mutex lock.
         SYS_I2C_runtime.port[port_num].lock = xSemaphoreCreateMutex();
         assert(SYS_I2C_runtime.port[port_num].lock);
         if (!(SYS_I2C_runtime.port[port_num].lock)) { goto fail; }
+        SYS_I2C_runtime.port[port_num].installed   = false;
+        SYS_I2C_runtime.port[port_num].holder      = NULL;
+        SYS_I2C_runtime.port[port_num].holder_prio = 0;
+        SYS_I2C_runtime.port[port_num].holder_core = 0;
+        SYS_I2C_runtime.port[port_num].attached_id = SYS_I2C_ID_CNT;
+        SYS_I2C_runtime.port[port_num].spin_max_us = SYS_I2C_LOCK_SPIN_MAX_US;
+        SYS_I2C_runtime.port[port_num].spin_us     = SYS_I2C_LOCK_SPIN_MAX_US;
+        #if (SYS_I2C_PM_ENABLE == true)
+        SYS_I2C_runtime.port[port_num].pm_held     = NULL;
+        SYS_I2C_runtime.port[port_num].pm_apb_lock = NULL;
+        SYS_I2C_runtime.port[port_num].pm_sleep_lock = NULL;
+        if (ESP_OK != esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "sys_i2c_apb", &SYS_I2C_runtime.port[port_num].pm_apb_lock)) { goto fail; }
+        if (ESP_OK != esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "sys_i2c_sleep", &SYS_I2C_runtime.port[port_num].pm_sleep_lock)) { goto fail; }
+        #endif
 
-        //4A no 'default' needed, `port_num` pre-validated in sys_i2c_runtime_init().
+        //3A no 'default' needed, `port_num` pre-validated in sys_i2c_runtime_init().
         switch (port_num) {
             case I2C_NUM_0:    { done_0 = true; break; }
             case I2C_NUM_1:    { done_1 = true; break; }
         }
+
+        //4A Config and install `port_num` driver, just once. SYS_I2C_LAZY_INSTALL_ENABLE: on first sys_i2c_port_take().
+        #if (SYS_I2C_LAZY_INSTALL_ENABLE != true)
+        if (!sys_i2c_port_install(sys_i2c_id)) { goto fail; }
+        #endif
     }
 
   pass:
@@ -117,12 +135,52 @@ bool sys_i2c_init_all(void)
     return (true);
   fail:
     TRACE_FAIL;
-    if (done_0) { (void)vSemaphoreDelete(SYS_I2C_runtime.port[I2C_NUM_0].lock); }
-    if (done_1) { (void)vSemaphoreDelete(SYS_I2C_runtime.port[I2C_NUM_1].lock); }
+    // Every port_num set up so far, the one that failed half way included: mutex, PM locks.
+    for (port_num = 0; I2C_NUM_MAX > port_num; ++port_num) {
+        struct SYS_I2C_PORT * const port_addr = &SYS_I2C_runtime.port[port_num];
+        if (port_addr->lock) { (void)vSemaphoreDelete(port_addr->lock); port_addr->lock = NULL; }
+        #if (SYS_I2C_PM_ENABLE == true)
+        if (port_addr->pm_apb_lock) { (void)esp_pm_lock_delete(port_addr->pm_apb_lock); port_addr->pm_apb_lock = NULL; }
+        if (port_addr->pm_sleep_lock) { (void)esp_pm_lock_delete(port_addr->pm_sleep_lock); port_addr->pm_sleep_lock = NULL; }
+        #endif
+    }
     // i2c_driver_uninstall not even considered.
     return (false);
 } // end: sys_i2c_init_all()
 
+// @brief i2c_param_config() and i2c_driver_install() for the port_num of sys_i2c_id. Once per port_num.
+// Boot: from sys_i2c_init_all(). SYS_I2C_LAZY_INSTALL_ENABLE: from sys_i2c_port_take(), port lock held.
+//
+static bool sys_i2c_port_install(uint8_t sys_i2c_id)
+{
+    TRACE_ENTER;
+    const i2c_port_t port_num = SYS_I2C_runtime.unit[sys_i2c_id].port_num;
+
+    if (SYS_I2C_runtime.port[port_num].installed) { goto pass; }
+
+    const i2c_config_t i2c_config = {
+        .mode               = I2C_MODE_MASTER,
+        .sda_pullup_en      = (SYS_I2C_PULL_UP_ENABLE) ? GPIO_PULLUP_ENABLE : GPIO_PULLUP_DISABLE,
+        .scl_pullup_en      = (SYS_I2C_PULL_UP_ENABLE) ? GPIO_PULLUP_ENABLE : GPIO_PULLUP_DISABLE,
+        .sda_io_num         = SYS_I2C_runtime.unit[sys_i2c_id].sda_io_num,
+        .scl_io_num         = SYS_I2C_runtime.unit[sys_i2c_id].scl_io_num,
+        .master.clk_speed   = SYS_I2C_runtime.unit[sys_i2c_id].clk_speed,
+        #if (SYS_I2C_CLK_FLAGS_ENABLE == true)
+        .clk_flags          = sys_i2c_clock_source(sys_i2c_id, SYS_I2C_runtime.unit[sys_i2c_id].clk_speed),
+        #endif
+    };
+    if (ESP_OK != i2c_param_config(port_num, &i2c_config)) { goto fail; }
+    if (ESP_OK != i2c_driver_install(port_num, I2C_MODE_MASTER, 0, 0, 0)) { goto fail; }
+    SYS_I2C_runtime.port[port_num].installed = true;
+
+  pass:
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_port_install()
+
 // @brief
 // Merge and validate operational parameters from two GLOBAL-FLASH I2C_config tables to one GLOBAL-RAM I2C_runtime table.
 // These are the ESP32_IDF_I2C arguments for each I2C bus.
@@ -139,24 +197,42 @@ static bool sys_i2c_runtime_init(void)
     TRACE_ENTER;
     if (!SYS_I2C_ID_CNT) { goto fail; }
 
-    uint8_t sys_i2c_id;
     // 1A
     const uint8_t bsp_id  = APP_config.bsp_id; // FLASH lookup: Which target board?
     assert(BSP_ID_CNT > bsp_id); //  FYI: Already validated in app_main().
 
+    #if (SYS_I2C_BOARD_GEN_ENABLE == true)
+    // 1B Build time generated and validated; nothing to copy, nothing to check.
+    SYS_I2C_runtime.unit = SYS_I2C_unit_gen[bsp_id];
+    #else
+    uint8_t sys_i2c_id;
+
     // For each and all I2C Buses copy and validate each set of init data to `SYS_I2C_runtime`
     for (sys_i2c_id = 0; SYS_I2C_ID_CNT > sys_i2c_id; ++sys_i2c_id) {
+        // 1C Virtual I2C Bus behind a mux channel: the parent, validated above, has the pins and port_num.
+        const uint8_t mux_parent_id = SYS_I2C_config.unit[sys_i2c_id].mux_parent_id;
+        if (SYS_I2C_config.unit[sys_i2c_id].mux_addr) {
+            assert(sys_i2c_id > mux_parent_id);
+            assert(SYS_I2C_ADDR_INVALID > SYS_I2C_config.unit[sys_i2c_id].mux_addr);
+            assert(SYS_I2C_MUX_CHANNEL_CNT > SYS_I2C_config.unit[sys_i2c_id].mux_channel);
+            sys_i2c_unit[sys_i2c_id]               = sys_i2c_unit[mux_parent_id];
+            sys_i2c_unit[sys_i2c_id].mux_parent_id = mux_parent_id;
+            sys_i2c_unit[sys_i2c_id].mux_addr      = SYS_I2C_config.unit[sys_i2c_id].mux_addr;
+            sys_i2c_unit[sys_i2c_id].mux_channel   = SYS_I2C_config.unit[sys_i2c_id].mux_channel;
+            continue;
+        }
+
         // 2A
-        gpio_num_t scl_io_num = SYS_I2C_runtime.unit[sys_i2c_id].scl_io_num = BSP_I2C_config[bsp_id].unit[sys_i2c_id].scl_io_num;
-        gpio_num_t sda_io_num = SYS_I2C_runtime.unit[sys_i2c_id].sda_io_num = BSP_I2C_config[bsp_id].unit[sys_i2c_id].sda_io_num;
+        gpio_num_t scl_io_num = sys_i2c_unit[sys_i2c_id].scl_io_num = BSP_I2C_config[bsp_id].unit[sys_i2c_id].scl_io_num;
+        gpio_num_t sda_io_num = sys_i2c_unit[sys_i2c_id].sda_io_num = BSP_I2C_config[bsp_id].unit[sys_i2c_id].sda_io_num;
 
         // 3A
-        i2c_port_t port_num = SYS_I2C_runtime.unit[sys_i2c_id].port_num = SYS_I2C_config.unit[sys_i2c_id].port_num; // 1st
+        i2c_port_t port_num = sys_i2c_unit[sys_i2c_id].port_num = SYS_I2C_config.unit[sys_i2c_id].port_num; // 1st
         assert(I2C_NUM_MAX > port_num); // 2nd
 
         // 3B
-        uint32_t clk_speed                            = SYS_I2C_runtime.unit[sys_i2c_id].clk_speed = SYS_I2C_config.port[port_num].clk_speed; // 3rd; port_num to lookup clk_speed
-        uint32_t clk_flags  __attribute__ ((unused))  = SYS_I2C_runtime.unit[sys_i2c_id].clk_flags = SYS_I2C_config.port[port_num].clk_flags; // WIP new feature
+        uint32_t clk_speed                            = sys_i2c_unit[sys_i2c_id].clk_speed = SYS_I2C_config.port[port_num].clk_speed; // 3rd; port_num to lookup clk_speed
+        uint32_t clk_flags  __attribute__ ((unused))  = sys_i2c_unit[sys_i2c_id].clk_flags = SYS_I2C_config.port[port_num].clk_flags; // 4th; clock source policy
 
         // 4A
         assert(GPIO_NUM_NC != scl_io_num); // Because GPIO_IS_VALID_OUTPUT_GPIO((GPIO_NUM_NC) does not like GPIO_NUM_NC as (-1) ...
@@ -167,13 +243,18 @@ static bool sys_i2c_runtime_init(void)
 
         // 5A
         assert(clk_speed && (SYS_I2C_CLOCK_MAX >= clk_speed)); // 1 MHz
-        // 5B Untested
+        // 5B Clock source policy. ESP32, ESP32-S2 I2C sources: APB, REF_TICK. None runs in light sleep.
         #if (SYS_I2C_CLK_FLAGS_ENABLE == true)
-        assert((I2C_SCLK_SRC_FLAG_FOR_NOMAL | I2C_SCLK_SRC_FLAG_AWARE_DFS | I2C_SCLK_SRC_FLAG_LIGHT_SLEEP) >= clk_flags); // bit flags = 0 | 1 | 2 = 3.
-        // DOUBLE CHECK: assert(!((I2C_SCLK_SRC_FLAG_FOR_NOMAL != clk_flags) && (50000U < clk_speed))); // DFS-modes supports 50 KHz Max for ESP32S2 ?
+        assert((I2C_SCLK_SRC_FLAG_FOR_NOMAL | I2C_SCLK_SRC_FLAG_AWARE_DFS) >= clk_flags); // no I2C_SCLK_SRC_FLAG_LIGHT_SLEEP
+        assert(!((I2C_SCLK_SRC_FLAG_AWARE_DFS & clk_flags) && (SYS_I2C_REF_TICK_CLOCK_MAX < clk_speed))); // REF_TICK: 50 KHz max
         #endif
 
     }
+    SYS_I2C_runtime.unit = sys_i2c_unit;
+    #endif
+
+    // 6A Multiplexer channel-select cache, from the virtual I2C Buses in .unit
+    if (!sys_i2c_mux_init()) { goto fail; }
 
     TRACE_PASS;
     return (true);
@@ -187,39 +268,116 @@ static bool sys_i2c_runtime_init(void)
 // @details
 // I didn't have success with ESP32-IDF i2c_set_pin(). Left something in the GPIO_MATRIX connected?
 // So I used  a 'brute' force method.
-// if (!sys_i2c_attach_pins(sys_i2c_id)) { goto fail; }
+// clk_speed: clock profile of i2c_addr_num, else the port clk_speed. i2c_param_config() runs every attach anyway.
+// clk_flags: clock source for that clk_speed and the power management state, sys_i2c_clock_source().
+// if (!sys_i2c_attach_pins(sys_i2c_id, i2c_addr_num)) { goto fail; }
 // if (!sys_i2c_detach_pins(sys_i2c_id)) { goto fail; }
 //
-static bool sys_i2c_attach_pins(uint8_t sys_i2c_id)
+bool sys_i2c_attach_pins(uint8_t sys_i2c_id, uint8_t i2c_addr_num)
+{
+    TRACE_ENTER;
+    i2c_config_t i2c_config;
+
+    if (!sys_i2c_attach_config(sys_i2c_id, i2c_addr_num, &i2c_config)) { goto fail; }
+    if (!sys_i2c_attach_pins_config(sys_i2c_id, &i2c_config)) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_attach_pins()
+
+// @brief The i2c_config sys_i2c_attach_pins() applies for i2c_addr_num, for callers that keep it.
+//
+bool sys_i2c_attach_config(uint8_t sys_i2c_id, uint8_t i2c_addr_num, i2c_config_t * i2c_config_addr)
 {
     TRACE_ENTER;
     if(!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    if(!(SYS_I2C_ADDR_INVALID > i2c_addr_num)) { goto fail; }
+    if(!i2c_config_addr) { goto fail; }
 
-    i2c_port_t   port_num    = SYS_I2C_runtime.unit[sys_i2c_id].port_num;
-    i2c_config_t i2c_config = {
+    const uint32_t clk_speed = sys_i2c_clock_get(sys_i2c_id, i2c_addr_num);
+    const i2c_config_t i2c_config = {
         .mode               = I2C_MODE_MASTER,
         .sda_pullup_en      = (SYS_I2C_PULL_UP_ENABLE) ? GPIO_PULLUP_ENABLE : GPIO_PULLUP_DISABLE,
         .scl_pullup_en      = (SYS_I2C_PULL_UP_ENABLE) ? GPIO_PULLUP_ENABLE : GPIO_PULLUP_DISABLE,
         .sda_io_num         = SYS_I2C_runtime.unit[sys_i2c_id].sda_io_num,
         .scl_io_num         = SYS_I2C_runtime.unit[sys_i2c_id].scl_io_num,
-        .master.clk_speed   = SYS_I2C_runtime.unit[sys_i2c_id].clk_speed,
+        .master.clk_speed   = clk_speed,
         #if (SYS_I2C_CLK_FLAGS_ENABLE == true)
-        .clk_flags          = SYS_I2C_runtime.unit[sys_i2c_id].clk_flags, // new feature
+        .clk_flags          = sys_i2c_clock_source(sys_i2c_id, clk_speed), // APB or REF_TICK, this transaction
         #endif
     };
-    if (ESP_OK != i2c_param_config(port_num, &i2c_config)) { goto fail; }
+    *i2c_config_addr = i2c_config;
 
     TRACE_PASS;
     return (true);
   fail:
     TRACE_FAIL;
     return (false);
-} // end: sys_i2c_attach_pins()
+} // end: sys_i2c_attach_config()
+
+// @brief Attach with a ready i2c_config, from sys_i2c_attach_config(). Caller holds the port lock.
+// PM on: the PM lock of the clock source first, i2c_param_config() derives the SCL divider from the source as it is
+// now. Held until detach. See SYS_I2C_config .clk_flags in sys_i2c.h.
+// Virtual I2C Bus: then open the mux channels on the way to it, only those not open already. See sys_i2c_mux.c.
+//
+bool sys_i2c_attach_pins_config(uint8_t sys_i2c_id, const i2c_config_t * i2c_config_addr)
+{
+    TRACE_ENTER;
+    const i2c_port_t port_num = SYS_I2C_runtime.unit[sys_i2c_id].port_num;
+    struct SYS_I2C_PORT * const port_addr = &SYS_I2C_runtime.port[port_num];
+    #if (SYS_I2C_CLK_FLAGS_ENABLE == true)
+    const bool ref_tick_flag = (I2C_SCLK_SRC_FLAG_AWARE_DFS & i2c_config_addr->clk_flags);
+    #else
+    const bool ref_tick_flag = false;
+    #endif
+
+    if (!sys_i2c_pm_hold(port_addr, ref_tick_flag)) { goto fail; }
+    if (ESP_OK != i2c_param_config(port_num, i2c_config_addr)) { goto fail; }
+    port_addr->attached_id = sys_i2c_id;
+    if (ref_tick_flag) { port_addr->src_stats.ref_tick_cnt++; } else { port_addr->src_stats.apb_cnt++; }
+    if (!sys_i2c_mux_route(sys_i2c_id)) { goto fail; } // mux channel selects, same lock hold; none: no I2C traffic
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    if (sys_i2c_id != port_addr->attached_id) { sys_i2c_pm_drop(port_addr); } // attached: detach drops it
+    return (false);
+} // end: sys_i2c_attach_pins_config()
+
+// @brief Hold the PM lock the next transfer needs, REF_TICK or APB; swap if another is held. No PM: nothing to hold.
+//
+static bool sys_i2c_pm_hold(struct SYS_I2C_PORT * port_addr, bool ref_tick_flag)
+{
+    #if (SYS_I2C_PM_ENABLE == true)
+    const esp_pm_lock_handle_t pm_lock = (ref_tick_flag) ? port_addr->pm_sleep_lock : port_addr->pm_apb_lock;
+
+    if (pm_lock == port_addr->pm_held) { return (true); }
+    sys_i2c_pm_drop(port_addr);
+    if (ESP_OK != esp_pm_lock_acquire(pm_lock)) { return (false); }
+    port_addr->pm_held = pm_lock;
+    #endif
+    return (true);
+} // end: sys_i2c_pm_hold()
+
+// @brief Release the PM lock held since attach, if any.
+//
+static void sys_i2c_pm_drop(struct SYS_I2C_PORT * port_addr)
+{
+    #if (SYS_I2C_PM_ENABLE == true)
+    if (!port_addr->pm_held) { return; }
+    (void)esp_pm_lock_release(port_addr->pm_held);
+    port_addr->pm_held = NULL;
+    #endif
+} // end: sys_i2c_pm_drop()
 
 // @brief detach pins.
 // @note In app_main(): esp_log_level_set("gpio", ESP_LOG_NONE); // gpio_config() is too verbose during SYS_I2C operation
 //
-static bool sys_i2c_detach_pins(uint8_t sys_i2c_id)
+bool sys_i2c_detach_pins(uint8_t sys_i2c_id)
 {
     TRACE_ENTER;
     if(!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
@@ -237,6 +395,12 @@ static bool sys_i2c_detach_pins(uint8_t sys_i2c_id)
     cfg_gpio.pin_bit_mask = BIT64(SYS_I2C_runtime.unit[sys_i2c_id].sda_io_num);
     if (ESP_OK != gpio_config(&cfg_gpio)) { goto fail; }
 
+    struct SYS_I2C_PORT * const port_addr = &SYS_I2C_runtime.port[SYS_I2C_runtime.unit[sys_i2c_id].port_num];
+    if (sys_i2c_id == port_addr->attached_id) {
+        port_addr->attached_id = SYS_I2C_ID_CNT;
+        sys_i2c_pm_drop(port_addr); // transfer over: APB may scale, light sleep allowed
+    }
+
     TRACE_PASS;
     return (true);
   fail:
@@ -244,13 +408,390 @@ static bool sys_i2c_detach_pins(uint8_t sys_i2c_id)
     return (false);
 } // end: sys_i2c_detach_pins()
 
+// @brief Output-only attach: route the port_num FSM SCL/SDA outputs to this I2C Bus pads as well.
+// The FSM inputs stay on the bus attached with sys_i2c_attach_pins(); ACK and clock stretching are sampled there only.
+// Undo with sys_i2c_detach_pins(sys_i2c_id).
+//
+static bool sys_i2c_fanout_pins(uint8_t sys_i2c_id, i2c_port_t port_num)
+{
+    TRACE_ENTER;
+    if(!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+
+    const gpio_num_t io_num[2] = { SYS_I2C_runtime.unit[sys_i2c_id].scl_io_num, SYS_I2C_runtime.unit[sys_i2c_id].sda_io_num };
+    const uint32_t   sig_out[2] = { i2c_periph_signal[port_num].scl_out_sig, i2c_periph_signal[port_num].sda_out_sig };
+    uint8_t idx;
+
+    for (idx = 0; 2 > idx; ++idx) {
+        if (ESP_OK != gpio_set_level(io_num[idx], 1)) { goto fail; } // idle high before the pad turns open-drain output
+        esp_rom_gpio_pad_select_gpio(io_num[idx]);
+        if (ESP_OK != gpio_set_direction(io_num[idx], GPIO_MODE_INPUT_OUTPUT_OD)) { goto fail; }
+        if (ESP_OK != gpio_set_pull_mode(io_num[idx], (SYS_I2C_PULL_UP_ENABLE) ? GPIO_PULLUP_ONLY : GPIO_FLOATING)) { goto fail; }
+        esp_rom_gpio_connect_out_signal(io_num[idx], sig_out[idx], false, false);
+    }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_fanout_pins()
+
 // @brief Read from I2C Bus N bytes into a memory buffer from i2c_reg_num at i2c_addr_num on sys_i2c_id interface.
 // TASK SAFE: YES
 //
 bool sys_i2c_read(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size)
 {
     TRACE_ENTER;
+    SYS_I2C_WCOMB_HOOK(sys_i2c_id, i2c_addr_num); // deferred writes to this device go first
+    const int64_t capture_us = SYS_I2C_CAPTURE_START_US();
+    SYS_I2C_PROFILE_DECLARE(profile_stamp);
     bool lock_taken = false;
+
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    if (!(SYS_I2C_ADDR_INVALID > i2c_addr_num)) { goto fail; }
+    if (!buf_addr) { goto fail; }
+    if (!buf_size) { goto fail; }
+    if (!SYS_I2C_QUOTA_HOOK(sys_i2c_id, i2c_addr_num, buf_size, true)) { goto fail; } // over budget: wait or reject
+
+    // start: Task Safe, pin swapped I2C Read
+    if (!sys_i2c_port_take(sys_i2c_id)) { goto fail; }
+    lock_taken = true;
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_LOCK_TAKE, profile_stamp);
+
+    if (!sys_i2c_read_locked(sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_addr, buf_size)) { goto fail; }
+
+    lock_taken = false;
+    SYS_I2C_PROFILE_RESTART(profile_stamp);
+    if (!sys_i2c_port_give(sys_i2c_id)) { goto fail; }
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_LOCK_GIVE, profile_stamp);
+    // end: Task Safe
+
+    TRACE_PASS;
+    SYS_I2C_CAPTURE_HOOK(SYS_I2C_CAPTURE_OP_READ, sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_size, capture_us, true);
+    return (true);
+  fail:
+    TRACE_FAIL;
+    if (lock_taken) { (void)sys_i2c_port_give(sys_i2c_id); }
+    SYS_I2C_CAPTURE_HOOK(SYS_I2C_CAPTURE_OP_READ, sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_size, capture_us, false);
+    return (false);
+} // end: sys_i2c_read()
+
+// @brief Write to I2C bus N bytes from a memory buffer to i2c_reg_num at i2c_addr_num on esp32_I2C interface.
+// TASK SAFE: YES
+//
+bool sys_i2c_write(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size)
+{
+    TRACE_ENTER;
+    SYS_I2C_WCOMB_HOOK(sys_i2c_id, i2c_addr_num); // deferred writes to this device go first
+    const int64_t capture_us = SYS_I2C_CAPTURE_START_US();
+    SYS_I2C_PROFILE_DECLARE(profile_stamp);
+    bool lock_taken = false;
+
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    if (!(SYS_I2C_ADDR_INVALID > i2c_addr_num)) { goto fail; }
+    if (!buf_addr) { goto fail; }
+    if (!buf_size) { goto fail; }
+    if (!SYS_I2C_QUOTA_HOOK(sys_i2c_id, i2c_addr_num, buf_size, false)) { goto fail; } // over budget: wait or reject
+
+    // start: Task Safe, pin swapped I2C Write
+    if (!sys_i2c_port_take(sys_i2c_id)) { goto fail; }
+    lock_taken = true;
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_LOCK_TAKE, profile_stamp);
+
+    if (!sys_i2c_write_locked(sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_addr, buf_size)) { goto fail; }
+
+    lock_taken = false;
+    SYS_I2C_PROFILE_RESTART(profile_stamp);
+    if (!sys_i2c_port_give(sys_i2c_id)) { goto fail; }
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_LOCK_GIVE, profile_stamp);
+    // end: Task Safe
+
+    TRACE_PASS;
+    SYS_I2C_CAPTURE_HOOK(SYS_I2C_CAPTURE_OP_WRITE, sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_size, capture_us, true);
+    return (true);
+  fail:
+    TRACE_FAIL;
+    if (lock_taken) { (void)sys_i2c_port_give(sys_i2c_id); }
+    SYS_I2C_CAPTURE_HOOK(SYS_I2C_CAPTURE_OP_WRITE, sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_size, capture_us, false);
+    return (false);
+} // end: sys_i2c_write()
+
+// @brief Probe I2C Bus with I2C address, the i2c_addr_num, probe allowed from 0x00-0x7F
+// Look for i2c_device by writing the i2c_addr_num on the esp32_I2C interface.
+// Wait for ACK or short timeout.
+// bool found_flag;
+// if (!sys_i2c_probe(sys_i2c_id, i2c_addr_num, &found_flag)) { goto fail; }
+//
+// TASK SAFE: YES
+//
+bool sys_i2c_probe(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool * found_flag_addr)
+{
+    TRACE_ENTER;
+    const int64_t capture_us = SYS_I2C_CAPTURE_START_US();
+    SYS_I2C_PROFILE_DECLARE(profile_stamp);
+    bool lock_taken = false;
+
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+
+    // start: Task Safe, pin swapped I2C Write with short ACK timeout
+    if (!sys_i2c_port_take(sys_i2c_id)) { goto fail; }
+    lock_taken = true;
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_LOCK_TAKE, profile_stamp);
+
+    if (!sys_i2c_probe_locked(sys_i2c_id, i2c_addr_num, found_flag_addr)) { goto fail; }
+
+    lock_taken = false;
+    SYS_I2C_PROFILE_RESTART(profile_stamp);
+    if (!sys_i2c_port_give(sys_i2c_id)) { goto fail; }
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_LOCK_GIVE, profile_stamp);
+    // end: Task Safe
+
+    TRACE_PASS;
+    SYS_I2C_CAPTURE_HOOK(SYS_I2C_CAPTURE_OP_PROBE, sys_i2c_id, i2c_addr_num, 0, 0, capture_us, true);
+    return (true);
+  fail:
+    TRACE_FAIL;
+    if (lock_taken) { (void)sys_i2c_port_give(sys_i2c_id); }
+    SYS_I2C_CAPTURE_HOOK(SYS_I2C_CAPTURE_OP_PROBE, sys_i2c_id, i2c_addr_num, 0, 0, capture_us, false);
+    return (false);
+} // end: sys_i2c_probe()
+
+// @brief Write the same data to the same i2c_addr_num on many I2C Buses with ONE I2C transaction.
+// The first bus in the list is attached normally, its ACKs are checked. The other buses get only the FSM outputs.
+// Captured as one write on the first bus: one transaction on the wire.
+// if (!sys_i2c_write_broadcast(sys_i2c_id_addr, sys_i2c_id_cnt, i2c_addr_num, i2c_reg_num, buf_addr, buf_size, verify_flag)) { goto fail; }
+//
+// TASK SAFE: YES
+//
+bool sys_i2c_write_broadcast(const uint8_t * sys_i2c_id_addr, size_t sys_i2c_id_cnt, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size, bool verify_flag)
+{
+    TRACE_ENTER;
+    const int64_t capture_us = SYS_I2C_CAPTURE_START_US();
+    bool lock_taken = false;
+    size_t fanout_cnt = 0; // sys_i2c_id_addr[1 .. fanout_cnt] have FSM outputs routed
+    size_t idx;
+    size_t dup_idx;
+
+    const uint8_t ack_id = (sys_i2c_id_addr && sys_i2c_id_cnt) ? sys_i2c_id_addr[0] : SYS_I2C_ID_CNT; // captured as its bus
+
+    if (!sys_i2c_id_addr) { goto fail; }
+    if (!sys_i2c_id_cnt) { goto fail; }
+    if (!(SYS_I2C_ID_CNT > ack_id)) { goto fail; }
+    if (!(SYS_I2C_ADDR_INVALID > i2c_addr_num)) { goto fail; }
+    if (!buf_addr) { goto fail; }
+    if (!buf_size) { goto fail; }
+    const i2c_port_t port_num = SYS_I2C_runtime.unit[ack_id].port_num;
+
+    // 1A One FSM drives all pads: every bus must be on the same port_num. The first bus clk_speed drives them all.
+    for (idx = 1; sys_i2c_id_cnt > idx; ++idx) {
+        if (!(SYS_I2C_ID_CNT > sys_i2c_id_addr[idx])) { goto fail; }
+        if (port_num != SYS_I2C_runtime.unit[sys_i2c_id_addr[idx]].port_num) { goto fail; }
+        if (SYS_I2C_runtime.unit[sys_i2c_id_addr[idx]].mux_addr) { goto fail; } // virtual: pads shared, one channel open at a time
+        for (dup_idx = 0; idx > dup_idx; ++dup_idx) { // listed twice: routed, detached and charged twice
+            if (sys_i2c_id_addr[dup_idx] == sys_i2c_id_addr[idx]) { goto fail; }
+        }
+    }
+    for (idx = 0; sys_i2c_id_cnt > idx; ++idx) {
+        SYS_I2C_WCOMB_HOOK(sys_i2c_id_addr[idx], i2c_addr_num); // deferred writes to each target go first
+        if (!SYS_I2C_QUOTA_HOOK(sys_i2c_id_addr[idx], i2c_addr_num, buf_size, false)) { goto fail; } // each target bus, once
+    }
+
+    // start: Task Safe, pin fan-out I2C Write
+    if (!sys_i2c_port_take(ack_id)) { goto fail; }
+    lock_taken = true;
+
+    // 2A Fan-out first; sys_i2c_write_locked() attaches, then detaches, the ACK bus itself.
+    for (idx = 1; sys_i2c_id_cnt > idx; ++idx) {
+        fanout_cnt = idx;
+        if (!sys_i2c_fanout_pins(sys_i2c_id_addr[idx], port_num)) { goto fail; }
+    }
+    if (!sys_i2c_write_locked(ack_id, i2c_addr_num, i2c_reg_num, buf_addr, buf_size)) { goto fail; }
+    for (idx = 1; fanout_cnt >= idx; ++idx) {
+        if (!sys_i2c_detach_pins(sys_i2c_id_addr[idx])) { goto fail; }
+    }
+    fanout_cnt = 0;
+
+    // 3A Optional: each other bus must still ACK i2c_addr_num. Catches a missing device, not a corrupted byte.
+    if (verify_flag) {
+        for (idx = 1; sys_i2c_id_cnt > idx; ++idx) {
+            bool found_flag;
+            if (!sys_i2c_probe_locked(sys_i2c_id_addr[idx], i2c_addr_num, &found_flag)) { goto fail; }
+            if (!found_flag) { goto fail; }
+        }
+    }
+
+    lock_taken = false;
+    if (!sys_i2c_port_give(ack_id)) { goto fail; }
+    // end: Task Safe
+
+    TRACE_PASS;
+    SYS_I2C_CAPTURE_HOOK(SYS_I2C_CAPTURE_OP_WRITE, ack_id, i2c_addr_num, i2c_reg_num, buf_size, capture_us, true);
+    return (true);
+  fail:
+    TRACE_FAIL;
+    for (idx = 1; fanout_cnt >= idx; ++idx) { (void)sys_i2c_detach_pins(sys_i2c_id_addr[idx]); }
+    if (lock_taken) { (void)sys_i2c_port_give(ack_id); }
+    SYS_I2C_CAPTURE_HOOK(SYS_I2C_CAPTURE_OP_WRITE, ack_id, i2c_addr_num, i2c_reg_num, buf_size, capture_us, false);
+    return (false);
+} // end: sys_i2c_write_broadcast()
+
+// @brief Take the I2C port lock of the ESP32_I2C_FSM that drives sys_i2c_id.
+// Uncontended: one mutex take. Contended: spin up to spin_us on .holder, see sys_i2c_port_spin(), and retry the
+// mutex when it clears; no context switch if the holder gives back in time. Otherwise block on the mutex.
+// The spin bound adapts under the lock: a spin that wins doubles it, a spin that ends up blocking halves it.
+// if (!sys_i2c_port_take(sys_i2c_id)) { goto fail; }
+//
+bool sys_i2c_port_take(uint8_t sys_i2c_id)
+{
+    const i2c_port_t port_num = SYS_I2C_runtime.unit[sys_i2c_id].port_num;
+    struct SYS_I2C_PORT * const port_addr = &SYS_I2C_runtime.port[port_num];
+    int64_t start_us = 0;
+    bool contended_flag = false;
+    bool spin_win_flag = false;
+    bool spun_flag = false;
+
+    if (pdTRUE != xSemaphoreTake(port_addr->lock, 0)) {
+        contended_flag = true;
+        start_us = esp_timer_get_time();
+        spin_win_flag = sys_i2c_port_spin(port_addr, start_us, &spun_flag);
+        if (!spin_win_flag && (pdTRUE != xSemaphoreTake(port_addr->lock, portMAX_DELAY))) { return (false); }
+    }
+    sys_i2c_port_holder_set(port_addr);
+
+    // Lock held: counters and spin bound are the holder's to write.
+    port_addr->stats.take_cnt++;
+    if (contended_flag) {
+        const uint32_t wait_us = (uint32_t)(esp_timer_get_time() - start_us);
+        if (port_addr->stats.wait_max_us < wait_us) { port_addr->stats.wait_max_us = wait_us; }
+        if (spin_win_flag) {
+            port_addr->stats.spin_cnt++;
+            port_addr->spin_us = (port_addr->spin_max_us < (2 * port_addr->spin_us)) ? port_addr->spin_max_us : (2 * port_addr->spin_us);
+        } else {
+            port_addr->stats.block_cnt++;
+            if (spun_flag) { port_addr->spin_us /= 2; }
+        }
+        if (port_addr->spin_max_us && (SYS_I2C_PORT_SPIN_MIN_US > port_addr->spin_us)) { port_addr->spin_us = SYS_I2C_PORT_SPIN_MIN_US; }
+    }
+
+    // First use of a lazy port_num: install under the lock, once.
+    if (!port_addr->installed && !sys_i2c_port_install(sys_i2c_id)) {
+        port_addr->holder = NULL;
+        (void)xSemaphoreGive(port_addr->lock);
+        return (false);
+    }
+    return (true);
+} // end: sys_i2c_port_take()
+
+// @brief Take the I2C port lock only if it is free now: no spin, no block, no counters. Lazy install as take.
+// For background work that must never delay a foreground transaction. Mutex priority inheritance still lifts a
+// low priority holder while a foreground task waits.
+//
+bool sys_i2c_port_try_take(uint8_t sys_i2c_id)
+{
+    struct SYS_I2C_PORT * const port_addr = &SYS_I2C_runtime.port[SYS_I2C_runtime.unit[sys_i2c_id].port_num];
+
+    if (port_addr->holder) { return (false); } // no mutex call while busy
+    if (pdTRUE != xSemaphoreTake(port_addr->lock, 0)) { return (false); }
+    sys_i2c_port_holder_set(port_addr);
+
+    if (!port_addr->installed && !sys_i2c_port_install(sys_i2c_id)) {
+        port_addr->holder = NULL;
+        (void)xSemaphoreGive(port_addr->lock);
+        return (false);
+    }
+    return (true);
+} // end: sys_i2c_port_try_take()
+
+// @brief Give the I2C port lock back.
+// if (!sys_i2c_port_give(sys_i2c_id)) { goto fail; }
+//
+bool sys_i2c_port_give(uint8_t sys_i2c_id)
+{
+    struct SYS_I2C_PORT * const port_addr = &SYS_I2C_runtime.port[SYS_I2C_runtime.unit[sys_i2c_id].port_num];
+
+    port_addr->holder = NULL; // spinners on the other core see it first, then take the mutex
+    return (pdTRUE == xSemaphoreGive(port_addr->lock));
+} // end: sys_i2c_port_give()
+
+// @brief Spin phase of a contended take, bounded by spin_us. Each new holder is checked once: spinning helps only
+// if the holder can finish on the other core (not pinned to this one), or outranks this task so the FSM done
+// interrupt lets it preempt the spin. A holder that needs this core to give back: block instead.
+// The holder handle is only compared: the holder may give back and vTaskDelete() itself meanwhile. Its priority
+// and core come from .holder_prio, .holder_core; a stale pair from the previous holder only mis-hints one check.
+// @return true: lock taken. *spun_flag_addr: spun at all, input to the spin bound.
+//
+static bool sys_i2c_port_spin(struct SYS_I2C_PORT * port_addr, int64_t start_us, bool * spun_flag_addr)
+{
+    const int64_t end_us = start_us + port_addr->spin_us;
+    TaskHandle_t checked = NULL;
+
+    *spun_flag_addr = false;
+    while (end_us > esp_timer_get_time()) {
+        const TaskHandle_t holder = port_addr->holder;
+        if (!holder) {
+            if (pdTRUE == xSemaphoreTake(port_addr->lock, 0)) { return (true); }
+            continue;
+        }
+        if (holder != checked) {
+            bool useful_flag = (port_addr->holder_prio > uxTaskPriorityGet(NULL));
+            #if (portNUM_PROCESSORS > 1)
+            useful_flag = useful_flag || (xPortGetCoreID() != port_addr->holder_core); // not pinned to this core
+            #endif
+            if (!useful_flag) { break; }
+            checked = holder;
+        }
+        *spun_flag_addr = true;
+    }
+    return (false);
+} // end: sys_i2c_port_spin()
+
+// @brief Lock just taken: publish this task as holder. Priority and core first, then .holder, for the spinners.
+//
+static void sys_i2c_port_holder_set(struct SYS_I2C_PORT * port_addr)
+{
+    port_addr->holder_prio = uxTaskPriorityGet(NULL);
+    #if (portNUM_PROCESSORS > 1)
+    port_addr->holder_core = xTaskGetAffinity(NULL);
+    #else
+    port_addr->holder_core = 0;
+    #endif
+    port_addr->holder = xTaskGetCurrentTaskHandle();
+} // end: sys_i2c_port_holder_set()
+
+// @brief Public hold: validated sys_i2c_port_take() / sys_i2c_port_give().
+// TASK SAFE: YES
+//
+bool sys_i2c_bus_take(uint8_t sys_i2c_id)
+{
+    TRACE_ENTER;
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    if (!sys_i2c_port_take(sys_i2c_id)) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_bus_take()
+
+bool sys_i2c_bus_give(uint8_t sys_i2c_id)
+{
+    TRACE_ENTER;
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    if (!sys_i2c_port_give(sys_i2c_id)) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_bus_give()
+
+// @brief sys_i2c_read() body. Caller holds the port lock.
+//
+bool sys_i2c_read_locked(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size)
+{
+    TRACE_ENTER;
     i2c_cmd_handle_t i2c_cmd = 0;
 
     if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
@@ -260,14 +801,13 @@ bool sys_i2c_read(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num,
     if (!buf_size) { goto fail; }
 
     const i2c_port_t port_num = SYS_I2C_runtime.unit[sys_i2c_id].port_num;
+    SYS_I2C_PROFILE_DECLARE(profile_stamp);
 
-    // start: Task Safe, pin swapped I2C Read
-    if (pdTRUE != xSemaphoreTake(SYS_I2C_runtime.port[port_num].lock, portMAX_DELAY)) { goto fail; }
-    lock_taken = true;
-
-    if (!sys_i2c_attach_pins(sys_i2c_id)) { goto fail; }
+    if (!sys_i2c_attach_pins(sys_i2c_id, i2c_addr_num)) { goto fail; }
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_ATTACH, profile_stamp);
 
     // Compose standard I2C read command - program the ESP32_I2C_FSM
+    if (ESP_OK != SYS_I2C_FAULT_HOOK(sys_i2c_id, SYS_I2C_FAULT_POINT_ALLOC, ESP_OK)) { goto fail; }
     if (!(i2c_cmd = i2c_cmd_link_create())) { goto fail; }
     if (ESP_OK != i2c_master_start(i2c_cmd)) { goto fail; }
     if (ESP_OK != i2c_master_write_byte(i2c_cmd, i2c_addr_num << 1 | I2C_MASTER_WRITE, ESP32_I2C_ACK_CHECK_EN)) { goto fail; }
@@ -277,14 +817,17 @@ bool sys_i2c_read(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num,
     if (buf_size > 1) { if (ESP_OK != i2c_master_read(i2c_cmd, buf_addr, (buf_size - 1), ESP32_I2C_ACK_VAL)) { goto fail; } }
     if (ESP_OK != i2c_master_read_byte(i2c_cmd, (buf_addr + buf_size - 1), ESP32_I2C_NACK_VAL)) { goto fail; }
     if (ESP_OK != i2c_master_stop(i2c_cmd)){ goto fail; }
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_BUILD, profile_stamp);
 
-    if (ESP_OK != i2c_master_cmd_begin(port_num, i2c_cmd, ESP32_I2C_BUS_TIMEOUT_TICK)) { goto fail; } //1st:  execute the I2C_FSM program.
+    if (ESP_OK != SYS_I2C_FAULT_HOOK(sys_i2c_id, SYS_I2C_FAULT_POINT_EXEC, i2c_master_cmd_begin(port_num, i2c_cmd, ESP32_I2C_BUS_TIMEOUT_TICK))) { goto fail; } //1st:  execute the I2C_FSM program.
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_EXEC, profile_stamp);
     i2c_cmd_link_delete(i2c_cmd);   // 2nd: free i2c_cmd, No return to check
+    i2c_cmd = 0;
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_BUILD, profile_stamp); // link free charged to build
 
     if (!sys_i2c_detach_pins(sys_i2c_id)) { goto fail; }
-
-    if (pdTRUE != xSemaphoreGive(SYS_I2C_runtime.port[port_num].lock)) { goto fail; }
-    // end: Task Safe
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_DETACH, profile_stamp);
+    SYS_I2C_PROFILE_WIRE(sys_i2c_id, i2c_addr_num, ((buf_size + 3) * SYS_I2C_BULK_BIT_PER_BYTE) + 3); // START, RESTART, STOP bits
 
     TRACE_PASS;
     return (true);
@@ -292,17 +835,14 @@ bool sys_i2c_read(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num,
     TRACE_FAIL;
     (void)sys_i2c_detach_pins(sys_i2c_id);
     if (i2c_cmd) { i2c_cmd_link_delete(i2c_cmd); }
-    if (lock_taken) { (void)xSemaphoreGive(SYS_I2C_runtime.port[port_num].lock); }
     return (false);
-} // end: sys_i2c_read()
+} // end: sys_i2c_read_locked()
 
-// @brief Write to I2C bus N bytes from a memory buffer to i2c_reg_num at i2c_addr_num on esp32_I2C interface.
-// TASK SAFE: YES
+// @brief sys_i2c_write() body. Caller holds the port lock.
 //
-bool sys_i2c_write(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size)
+bool sys_i2c_write_locked(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size)
 {
     TRACE_ENTER;
-    bool lock_taken = false;
     i2c_cmd_handle_t i2c_cmd = 0;
 
     if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
@@ -312,28 +852,30 @@ bool sys_i2c_write(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num
     if (!buf_size) { goto fail; }
 
     const i2c_port_t port_num    = SYS_I2C_runtime.unit[sys_i2c_id].port_num;
+    SYS_I2C_PROFILE_DECLARE(profile_stamp);
 
-    // start: Task Safe, pin swapped I2C Write
-    if (pdTRUE != xSemaphoreTake(SYS_I2C_runtime.port[port_num].lock, portMAX_DELAY)) { goto fail; }
-    lock_taken = true;
-
-    if (!sys_i2c_attach_pins(sys_i2c_id)) { goto fail; }
+    if (!sys_i2c_attach_pins(sys_i2c_id, i2c_addr_num)) { goto fail; }
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_ATTACH, profile_stamp);
 
     // Compose standard I2C write command - program the ESP32_I2C_FSM
+    if (ESP_OK != SYS_I2C_FAULT_HOOK(sys_i2c_id, SYS_I2C_FAULT_POINT_ALLOC, ESP_OK)) { goto fail; }
     if (!(i2c_cmd = i2c_cmd_link_create())) { goto fail; }
     if (ESP_OK != i2c_master_start(i2c_cmd)) { goto fail; }
     if (ESP_OK != i2c_master_write_byte(i2c_cmd, i2c_addr_num << 1 | I2C_MASTER_WRITE, ESP32_I2C_ACK_CHECK_EN)) { goto fail; }
     if (ESP_OK != i2c_master_write_byte(i2c_cmd, i2c_reg_num, ESP32_I2C_ACK_CHECK_EN)) { goto fail; }
     if (ESP_OK != i2c_master_write(i2c_cmd, buf_addr, buf_size, ESP32_I2C_ACK_CHECK_EN)) { goto fail; }
     if (ESP_OK != i2c_master_stop(i2c_cmd)) { goto fail; }
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_BUILD, profile_stamp);
 
-    if (ESP_OK != i2c_master_cmd_begin(port_num, i2c_cmd, ESP32_I2C_BUS_TIMEOUT_TICK)) { goto fail; } //1st:  execute the I2C_FSM program.
+    if (ESP_OK != SYS_I2C_FAULT_HOOK(sys_i2c_id, SYS_I2C_FAULT_POINT_EXEC, i2c_master_cmd_begin(port_num, i2c_cmd, ESP32_I2C_BUS_TIMEOUT_TICK))) { goto fail; } //1st:  execute the I2C_FSM program.
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_EXEC, profile_stamp);
     i2c_cmd_link_delete(i2c_cmd);   // 2nd: free i2c_cmd, No return to check
+    i2c_cmd = 0;
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_BUILD, profile_stamp); // link free charged to build
 
     if (!sys_i2c_detach_pins(sys_i2c_id)) { goto fail; }
-
-    if (pdTRUE != xSemaphoreGive(SYS_I2C_runtime.port[port_num].lock)) { goto fail; }
-    // end: Task Safe
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_DETACH, profile_stamp);
+    SYS_I2C_PROFILE_WIRE(sys_i2c_id, i2c_addr_num, ((buf_size + 2) * SYS_I2C_BULK_BIT_PER_BYTE) + 2); // START, STOP bits
 
     TRACE_PASS;
     return (true);
@@ -341,22 +883,14 @@ bool sys_i2c_write(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num
     TRACE_FAIL;
     (void)sys_i2c_detach_pins(sys_i2c_id);
     if (i2c_cmd) { i2c_cmd_link_delete(i2c_cmd); }
-    if (lock_taken) { (void)xSemaphoreGive(SYS_I2C_runtime.port[port_num].lock); }
     return (false);
-} // end: sys_i2c_write()
+} // end: sys_i2c_write_locked()
 
-// @brief Probe I2C Bus with I2C address, the i2c_addr_num, probe allowed from 0x00-0x7F
-// Look for i2c_device by writing the i2c_addr_num on the esp32_I2C interface.
-// Wait for ACK or short timeout.
-// bool found_flag;
-// if (!sys_i2c_probe(sys_i2c_id, i2c_addr_num, &found_flag)) { goto fail; }
-//
-// TASK SAFE: YES
+// @brief sys_i2c_probe() body. Caller holds the port lock.
 //
-bool sys_i2c_probe(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool * found_flag_addr)
+bool sys_i2c_probe_locked(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool * found_flag_addr)
 {
     TRACE_ENTER;
-    bool lock_taken = false;
     i2c_cmd_handle_t i2c_cmd = 0;
 
     if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
@@ -365,26 +899,28 @@ bool sys_i2c_probe(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool * found_flag_a
     esp_err_t esp_err;
 
     const i2c_port_t port_num    = SYS_I2C_runtime.unit[sys_i2c_id].port_num;
+    SYS_I2C_PROFILE_DECLARE(profile_stamp);
 
-    // start: Task Safe, pin swapped I2C Write with short ACK timeout
-    if (pdTRUE != xSemaphoreTake(SYS_I2C_runtime.port[port_num].lock, portMAX_DELAY)) { goto fail; }
-    lock_taken = true;
-
-    if (!sys_i2c_attach_pins(sys_i2c_id)) { goto fail; }
+    if (!sys_i2c_attach_pins(sys_i2c_id, i2c_addr_num)) { goto fail; }
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_ATTACH, profile_stamp);
 
     // Compose standard I2C write address byte command
+    if (ESP_OK != SYS_I2C_FAULT_HOOK(sys_i2c_id, SYS_I2C_FAULT_POINT_ALLOC, ESP_OK)) { goto fail; }
     if (!(i2c_cmd = i2c_cmd_link_create())) { goto fail; }
     if (ESP_OK != i2c_master_start(i2c_cmd)) { goto fail; }
     if (ESP_OK != i2c_master_write_byte(i2c_cmd, i2c_addr_num << 1 | I2C_MASTER_WRITE, ESP32_I2C_ACK_CHECK_EN)) { goto fail; }
     if (ESP_OK != i2c_master_stop(i2c_cmd)) { goto fail; }
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_BUILD, profile_stamp);
 
-    esp_err = i2c_master_cmd_begin(port_num, i2c_cmd, ESP32_I2C_PROBE_TIMEOUT_TICK); //1st:  execute the I2C_FSM program.
+    esp_err = SYS_I2C_FAULT_HOOK(sys_i2c_id, SYS_I2C_FAULT_POINT_EXEC, i2c_master_cmd_begin(port_num, i2c_cmd, ESP32_I2C_PROBE_TIMEOUT_TICK)); //1st:  execute the I2C_FSM program.
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_EXEC, profile_stamp);
     i2c_cmd_link_delete(i2c_cmd);   // 2nd: free i2c_cmd, No return to check
+    i2c_cmd = 0;
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_BUILD, profile_stamp); // link free charged to build
 
     if (!sys_i2c_detach_pins(sys_i2c_id)) { goto fail; }
-
-    if (pdTRUE != xSemaphoreGive(SYS_I2C_runtime.port[port_num].lock)) { goto fail; }
-    // end: Task Safe
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_DETACH, profile_stamp);
+    SYS_I2C_PROFILE_WIRE(sys_i2c_id, i2c_addr_num, SYS_I2C_BULK_BIT_PER_BYTE + 2); // START, STOP bits
 
     // Is there a valid I2C ACK?
     switch (esp_err) {  // ESP_OK, ESP_FAIL; plus ESP_FAIL_ARG, ESP_ERR_TIMEOUT, ESP_FAIL_STATE
@@ -399,9 +935,8 @@ bool sys_i2c_probe(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool * found_flag_a
     TRACE_FAIL;
     (void)sys_i2c_detach_pins(sys_i2c_id);
     if (i2c_cmd) { i2c_cmd_link_delete(i2c_cmd); }
-    if (lock_taken) { (void)xSemaphoreGive(SYS_I2C_runtime.port[port_num].lock); }
     return (false);
-} // end: sys_i2c_probe()
+} // end: sys_i2c_probe_locked()
 
 
 // @brief Scan then print I2C bus for i2c_device by writing all ?legal? i2c_addr's on each I2C interface.
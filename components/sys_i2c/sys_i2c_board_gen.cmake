@@ -0,0 +1,228 @@
+# @file components/sys_i2c/sys_i2c_board_gen.cmake
+#
+# @brief Build time SYS_I2C runtime tables. Included by components/sys_i2c/CMakeLists.txt when CONFIG_SYS_I2C_BOARD_GEN=y.
+#
+# @details
+# 1. The board description file calls the functions below, example: main/bsp_i2c_board.cmake
+#      sys_i2c_port(I2C_NUM_0 CLK_SPEED 400000 CLK_FLAGS 0)   # clock per ESP32_I2C_FSM, like SYS_I2C_config.port[]
+#      sys_i2c_bus(SYS_I2C_ID_00 PORT I2C_NUM_0)               # port per I2C Bus, like SYS_I2C_config.unit[]
+#      sys_i2c_bus(SYS_I2C_ID_01 MUX SYS_I2C_ID_00 ADDR 0x70 CHANNEL 0) # virtual I2C Bus: mux channel, see sys_i2c_mux.h
+#      sys_i2c_board(BSP_0000_DEFAULT)                         # following pins belong to this board, like BSP_I2C_config[]
+#      sys_i2c_pins(SYS_I2C_ID_00 SDA 4 SCL 3)
+# 2. sys_i2c_board_gen_validate() checks everything sys_i2c_runtime_init() asserts at boot, and more:
+#      port_num, clk_speed 1 .. 1 MHz, clk_flags 0 .. 1 (1: clk_speed <= 50 KHz), valid output GPIO for IDF_TARGET, SDA != SCL,
+#      every bus on every board, no GPIO used twice across the buses of one board. Any error: FATAL_ERROR, no build.
+#      Virtual buses: parent declared before, ADDR 0x01 .. 0x7F, CHANNEL 0 .. 7; no PORT, no pins, both from the root.
+# 3. sys_i2c_board_gen_write() emits `sys_i2c_board_gen.c`: const SYS_I2C_unit_gen[BSP_ID_CNT][SYS_I2C_ID_CNT].
+#      Board and bus names become designated initializers; _Static_assert checks the counts against the enums.
+#
+# State is kept in GLOBAL properties, prefix SYS_I2C_GEN_. No IN_LIST: project cmake_minimum_required(VERSION 3.5).
+#
+
+function(sys_i2c_port port_name)
+    cmake_parse_arguments(ARG "" "CLK_SPEED;CLK_FLAGS" "" ${ARGN})
+    if(NOT DEFINED ARG_CLK_FLAGS)
+        set(ARG_CLK_FLAGS 0)
+    endif()
+    set_property(GLOBAL APPEND PROPERTY SYS_I2C_GEN_PORTS ${port_name})
+    set_property(GLOBAL PROPERTY SYS_I2C_GEN_PORT_${port_name}_CLK_SPEED "${ARG_CLK_SPEED}")
+    set_property(GLOBAL PROPERTY SYS_I2C_GEN_PORT_${port_name}_CLK_FLAGS "${ARG_CLK_FLAGS}")
+endfunction()
+
+function(sys_i2c_bus bus_name)
+    cmake_parse_arguments(ARG "" "PORT;MUX;ADDR;CHANNEL" "" ${ARGN})
+    set_property(GLOBAL APPEND PROPERTY SYS_I2C_GEN_BUSES ${bus_name})
+    set_property(GLOBAL PROPERTY SYS_I2C_GEN_BUS_${bus_name}_PORT "${ARG_PORT}")
+    set_property(GLOBAL PROPERTY SYS_I2C_GEN_BUS_${bus_name}_MUX "${ARG_MUX}")
+    set_property(GLOBAL PROPERTY SYS_I2C_GEN_BUS_${bus_name}_ADDR "${ARG_ADDR}")
+    set_property(GLOBAL PROPERTY SYS_I2C_GEN_BUS_${bus_name}_CHANNEL "${ARG_CHANNEL}")
+endfunction()
+
+# Physical root of a bus: itself, or up the MUX parents of a virtual bus.
+#
+function(sys_i2c_gen_root bus_name out_var)
+    set(root_name ${bus_name})
+    get_property(mux_name GLOBAL PROPERTY SYS_I2C_GEN_BUS_${root_name}_MUX)
+    while(mux_name)
+        set(root_name ${mux_name})
+        get_property(mux_name GLOBAL PROPERTY SYS_I2C_GEN_BUS_${root_name}_MUX)
+    endwhile()
+    set(${out_var} ${root_name} PARENT_SCOPE)
+endfunction()
+
+function(sys_i2c_board board_name)
+    set_property(GLOBAL APPEND PROPERTY SYS_I2C_GEN_BOARDS ${board_name})
+    set_property(GLOBAL PROPERTY SYS_I2C_GEN_BOARD_CURRENT ${board_name})
+endfunction()
+
+function(sys_i2c_pins bus_name)
+    cmake_parse_arguments(ARG "" "SDA;SCL" "" ${ARGN})
+    get_property(board_name GLOBAL PROPERTY SYS_I2C_GEN_BOARD_CURRENT)
+    if(NOT board_name)
+        message(FATAL_ERROR "sys_i2c_pins(${bus_name}): no sys_i2c_board() before it")
+    endif()
+    set_property(GLOBAL APPEND PROPERTY SYS_I2C_GEN_BOARD_${board_name}_BUSES ${bus_name})
+    set_property(GLOBAL PROPERTY SYS_I2C_GEN_PIN_${board_name}_${bus_name}_SDA "${ARG_SDA}")
+    set_property(GLOBAL PROPERTY SYS_I2C_GEN_PIN_${board_name}_${bus_name}_SCL "${ARG_SCL}")
+endfunction()
+
+# Valid output GPIO per target, from soc_caps.h SOC_GPIO_VALID_OUTPUT_GPIO_MASK.
+#
+function(sys_i2c_gen_gpio_check target gpio_num what)
+    if(NOT gpio_num MATCHES "^[0-9]+$")
+        message(FATAL_ERROR "${what}: GPIO '${gpio_num}' is not a GPIO number")
+    endif()
+    if(target STREQUAL "esp32")
+        set(invalid_list 20 24 28 29 30 31)
+        set(gpio_max 33) # 34 .. 39 input only
+    elseif(target STREQUAL "esp32s2")
+        set(invalid_list 22 23 24 25)
+        set(gpio_max 45) # 46 input only
+    else()
+        message(FATAL_ERROR "${what}: IDF_TARGET '${target}' not supported")
+    endif()
+    list(FIND invalid_list ${gpio_num} invalid_idx)
+    if((gpio_num GREATER gpio_max) OR (NOT invalid_idx EQUAL -1))
+        message(FATAL_ERROR "${what}: GPIO ${gpio_num} is not a valid output GPIO on ${target}")
+    endif()
+endfunction()
+
+function(sys_i2c_board_gen_validate target)
+    get_property(port_list GLOBAL PROPERTY SYS_I2C_GEN_PORTS)
+    get_property(bus_list GLOBAL PROPERTY SYS_I2C_GEN_BUSES)
+    get_property(board_list GLOBAL PROPERTY SYS_I2C_GEN_BOARDS)
+    if(NOT bus_list)
+        message(FATAL_ERROR "sys_i2c board: no sys_i2c_bus()")
+    endif()
+    if(NOT board_list)
+        message(FATAL_ERROR "sys_i2c board: no sys_i2c_board()")
+    endif()
+
+    # 1A ESP32_I2C_FSM clocks
+    foreach(port_name ${port_list})
+        if(NOT port_name MATCHES "^I2C_NUM_[01]$")
+            message(FATAL_ERROR "sys_i2c_port(${port_name}): must be I2C_NUM_0 or I2C_NUM_1")
+        endif()
+        get_property(clk_speed GLOBAL PROPERTY SYS_I2C_GEN_PORT_${port_name}_CLK_SPEED)
+        get_property(clk_flags GLOBAL PROPERTY SYS_I2C_GEN_PORT_${port_name}_CLK_FLAGS)
+        if((NOT clk_speed MATCHES "^[0-9]+$") OR (clk_speed LESS 1) OR (clk_speed GREATER 1000000))
+            message(FATAL_ERROR "sys_i2c_port(${port_name}): CLK_SPEED '${clk_speed}' not 1 .. 1000000")
+        endif()
+        if((NOT clk_flags MATCHES "^[0-9]+$") OR (clk_flags GREATER 1))
+            message(FATAL_ERROR "sys_i2c_port(${port_name}): CLK_FLAGS '${clk_flags}' not 0 .. 1, no light sleep clock on ESP32, ESP32-S2")
+        endif()
+        if((clk_flags EQUAL 1) AND (clk_speed GREATER 50000))
+            message(FATAL_ERROR "sys_i2c_port(${port_name}): CLK_FLAGS 1, REF_TICK, needs CLK_SPEED <= 50000, not ${clk_speed}")
+        endif()
+    endforeach()
+
+    # 1B Bus to port. Virtual bus: a parent declared before it, mux address and channel.
+    set(phys_list "")
+    set(seen_list "")
+    foreach(bus_name ${bus_list})
+        get_property(mux_name GLOBAL PROPERTY SYS_I2C_GEN_BUS_${bus_name}_MUX)
+        list(APPEND seen_list ${bus_name})
+        if(mux_name)
+            get_property(mux_addr GLOBAL PROPERTY SYS_I2C_GEN_BUS_${bus_name}_ADDR)
+            get_property(mux_channel GLOBAL PROPERTY SYS_I2C_GEN_BUS_${bus_name}_CHANNEL)
+            list(FIND seen_list "${mux_name}" mux_idx)
+            list(LENGTH seen_list seen_cnt)
+            math(EXPR self_idx "${seen_cnt} - 1")
+            if((mux_idx EQUAL -1) OR (mux_idx EQUAL self_idx))
+                message(FATAL_ERROR "sys_i2c_bus(${bus_name}): MUX '${mux_name}' is not a sys_i2c_bus() declared before it")
+            endif()
+            if((NOT mux_addr MATCHES "^(0x[0-7][0-9A-Fa-f]|[1-9]|[1-9][0-9]|1[01][0-9]|12[0-7])$") OR (mux_addr STREQUAL "0x00"))
+                message(FATAL_ERROR "sys_i2c_bus(${bus_name}): ADDR '${mux_addr}' not 0x01 .. 0x7F")
+            endif()
+            if(NOT mux_channel MATCHES "^[0-7]$")
+                message(FATAL_ERROR "sys_i2c_bus(${bus_name}): CHANNEL '${mux_channel}' not 0 .. 7")
+            endif()
+            continue()
+        endif()
+        list(APPEND phys_list ${bus_name})
+        get_property(port_name GLOBAL PROPERTY SYS_I2C_GEN_BUS_${bus_name}_PORT)
+        list(FIND port_list "${port_name}" port_idx)
+        if(port_idx EQUAL -1)
+            message(FATAL_ERROR "sys_i2c_bus(${bus_name}): PORT '${port_name}' has no sys_i2c_port()")
+        endif()
+    endforeach()
+
+    # 2A Pins, per board, physical buses only
+    foreach(board_name ${board_list})
+        get_property(board_bus_list GLOBAL PROPERTY SYS_I2C_GEN_BOARD_${board_name}_BUSES)
+        set(used_list "")
+        set(used_by_list "")
+        foreach(bus_name ${phys_list})
+            list(FIND board_bus_list ${bus_name} bus_idx)
+            if(bus_idx EQUAL -1)
+                message(FATAL_ERROR "sys_i2c_board(${board_name}): no sys_i2c_pins(${bus_name})")
+            endif()
+        endforeach()
+        foreach(bus_name ${board_bus_list})
+            list(FIND phys_list ${bus_name} bus_idx)
+            if(bus_idx EQUAL -1)
+                message(FATAL_ERROR "sys_i2c_board(${board_name}): sys_i2c_pins(${bus_name}) has no sys_i2c_bus(), or it is virtual")
+            endif()
+            get_property(sda GLOBAL PROPERTY SYS_I2C_GEN_PIN_${board_name}_${bus_name}_SDA)
+            get_property(scl GLOBAL PROPERTY SYS_I2C_GEN_PIN_${board_name}_${bus_name}_SCL)
+            sys_i2c_gen_gpio_check(${target} "${sda}" "${board_name} ${bus_name} SDA")
+            sys_i2c_gen_gpio_check(${target} "${scl}" "${board_name} ${bus_name} SCL")
+
+            # 2B Duplicate GPIO: SDA == SCL, or a pin already used by another bus, or the same bus twice.
+            foreach(pin_pair "SDA;${sda}" "SCL;${scl}")
+                list(GET pin_pair 0 pin_what)
+                list(GET pin_pair 1 gpio_num)
+                list(FIND used_list ${gpio_num} used_idx)
+                if(NOT used_idx EQUAL -1)
+                    list(GET used_by_list ${used_idx} used_by)
+                    message(FATAL_ERROR "sys_i2c_board(${board_name}): GPIO ${gpio_num} ${bus_name} ${pin_what} already used by ${used_by}")
+                endif()
+                list(APPEND used_list ${gpio_num})
+                list(APPEND used_by_list "${bus_name}_${pin_what}")
+            endforeach()
+        endforeach()
+    endforeach()
+endfunction()
+
+# Write the C table. Written only when the content changes: no needless rebuilds.
+#
+function(sys_i2c_board_gen_write out_file board_file)
+    get_property(bus_list GLOBAL PROPERTY SYS_I2C_GEN_BUSES)
+    get_property(board_list GLOBAL PROPERTY SYS_I2C_GEN_BOARDS)
+    list(LENGTH bus_list bus_cnt)
+    list(LENGTH board_list board_cnt)
+
+    set(c "// @file    sys_i2c_board_gen.c\n")
+    string(APPEND c "//\n// @brief  GENERATED by sys_i2c_board_gen.cmake from ${board_file}. Do not edit.\n//\n")
+    string(APPEND c "#include \"app_config.h\" // BSP_ID, SYS_I2C_ID; includes sys_i2c.h\n\n")
+    string(APPEND c "_Static_assert(BSP_ID_CNT == ${board_cnt}, \"enum BSP_ID and ${board_file} differ: board count\");\n")
+    string(APPEND c "_Static_assert(SYS_I2C_ID_CNT == ${bus_cnt}, \"enum SYS_I2C_ID and ${board_file} differ: bus count\");\n\n")
+    string(APPEND c "const struct SYS_I2C_UNIT\nSYS_I2C_unit_gen[BSP_ID_CNT][SYS_I2C_ID_CNT] = {\n")
+    foreach(board_name ${board_list})
+        string(APPEND c "    [${board_name}] = {\n")
+        foreach(bus_name ${bus_list})
+            sys_i2c_gen_root(${bus_name} root_name)
+            get_property(port_name GLOBAL PROPERTY SYS_I2C_GEN_BUS_${root_name}_PORT)
+            get_property(clk_speed GLOBAL PROPERTY SYS_I2C_GEN_PORT_${port_name}_CLK_SPEED)
+            get_property(clk_flags GLOBAL PROPERTY SYS_I2C_GEN_PORT_${port_name}_CLK_FLAGS)
+            get_property(sda GLOBAL PROPERTY SYS_I2C_GEN_PIN_${board_name}_${root_name}_SDA)
+            get_property(scl GLOBAL PROPERTY SYS_I2C_GEN_PIN_${board_name}_${root_name}_SCL)
+            string(APPEND c "        [${bus_name}] = { .sda_io_num = GPIO_NUM_${sda}, .scl_io_num = GPIO_NUM_${scl}, ")
+            string(APPEND c ".port_num = ${port_name}, .clk_speed = ${clk_speed}U, .clk_flags = ${clk_flags}U, ")
+            get_property(mux_name GLOBAL PROPERTY SYS_I2C_GEN_BUS_${bus_name}_MUX)
+            if(mux_name)
+                get_property(mux_addr GLOBAL PROPERTY SYS_I2C_GEN_BUS_${bus_name}_ADDR)
+                get_property(mux_channel GLOBAL PROPERTY SYS_I2C_GEN_BUS_${bus_name}_CHANNEL)
+                string(APPEND c ".mux_parent_id = ${mux_name}, .mux_addr = ${mux_addr}, .mux_channel = ${mux_channel}, ")
+            endif()
+            string(APPEND c "},\n")
+        endforeach()
+        string(APPEND c "    },\n")
+    endforeach()
+    string(APPEND c "};\n\n/* EOF sys_i2c_board_gen.c */\n")
+
+    file(WRITE "${out_file}.tmp" "${c}")
+    configure_file("${out_file}.tmp" "${out_file}" COPYONLY)
+endfunction()
+
+# EOF components/sys_i2c/sys_i2c_board_gen.cmake
@@ -0,0 +1,156 @@
+// @file    sys_i2c_bulk.c
+//
+// @brief  SYS_I2C bulk transfers: a large buffer as bounded chunks, the port lock free between chunks. See sys_i2c.h.
+//
+// @details
+// - Chunk size: wire time at the device clk_speed, sys_i2c_clock_get(), bounded by SYS_I2C_LOCK_HOLD_MAX_US.
+// - SYS_I2C_BULK_REG_INCR: a chunk ends on the next 'chunk_align' boundary of its register number, one EEPROM page at
+//   most; the device wraps inside a page, so a chunk across one would overwrite its start.
+// - SYS_I2C_BULK_REG_FIXED: multiples of 'chunk_align' counted from the first byte, display pages of the stream.
+// Plain sys_i2c_write() / sys_i2c_read() per chunk: hooks, quotas, capture as any other call.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+static const char * TAG = "sys_i2c_bulk";
+#include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
+#include "app_config.h" // SYS_I2C_ID_CNT, SYS_I2C_LOCK_HOLD_MAX_US; includes sys_i2c.h
+#include "sys_i2c_clock.h" // sys_i2c_clock_get(), per-device clk_speed
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h" // taskYIELD(), xTaskGetTickCount()
+
+// Wire time estimate. 9 SCL clocks per byte with ACK.
+#define SYS_I2C_BULK_BIT_PER_BYTE       (9U)
+#define SYS_I2C_BULK_REG_SPAN           (256U)                  // SYS_I2C_BULK_REG_INCR: 8-bit register numbers 0x00-0xFF
+#define SYS_I2C_BULK_OVERHEAD_BYTE      (3U)                    // START, address, register; read adds RESTART, address
+#define SYS_I2C_BULK_POLL_TIMEOUT_TICK  (pdMS_TO_TICKS(50U))   // SYS_I2C_BULK_ACK_POLL, EEPROM write cycle 5-10ms typical
+
+static size_t sys_i2c_bulk_chunk_size(uint8_t sys_i2c_id, uint8_t i2c_addr_num, size_t chunk_align);
+static size_t sys_i2c_bulk_next_size(size_t chunk_size, size_t chunk_align, bool incr_flag, size_t reg_num, size_t left_size);
+static bool sys_i2c_bulk_ack_poll(uint8_t sys_i2c_id, uint8_t i2c_addr_num);
+
+// @brief Write a large buffer as chunks, one sys_i2c_write() per chunk. The port lock is free between chunks.
+// if (!sys_i2c_write_bulk(sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_addr, buf_size, chunk_align, bulk_flags)) { goto fail; }
+//
+// TASK SAFE: YES
+//
+bool sys_i2c_write_bulk(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size, size_t chunk_align, uint32_t bulk_flags)
+{
+    TRACE_ENTER;
+    size_t done_size = 0;
+
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    if (!(SYS_I2C_ADDR_INVALID > i2c_addr_num)) { goto fail; }
+    if (!buf_addr) { goto fail; }
+    if (!buf_size) { goto fail; }
+    if ((bulk_flags & SYS_I2C_BULK_REG_INCR) && (SYS_I2C_BULK_REG_SPAN < (i2c_reg_num + buf_size))) { goto fail; } // 8-bit wrap
+
+    const bool incr_flag = (0 != (bulk_flags & SYS_I2C_BULK_REG_INCR));
+    const size_t chunk_size = sys_i2c_bulk_chunk_size(sys_i2c_id, i2c_addr_num, chunk_align);
+
+    while (buf_size > done_size) {
+        const size_t  size    = sys_i2c_bulk_next_size(chunk_size, chunk_align, incr_flag, (i2c_reg_num + done_size), buf_size - done_size);
+        const uint8_t reg_num = (incr_flag) ? (uint8_t)(i2c_reg_num + done_size) : i2c_reg_num;
+
+        if (!sys_i2c_write(sys_i2c_id, i2c_addr_num, reg_num, (buf_addr + done_size), size)) { goto fail; }
+        done_size += size;
+
+        if (bulk_flags & SYS_I2C_BULK_ACK_POLL) {
+            if (!sys_i2c_bulk_ack_poll(sys_i2c_id, i2c_addr_num)) { goto fail; }
+        }
+        if (buf_size > done_size) { taskYIELD(); } // equal priority waiters on this port_num get the lock now
+    }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_write_bulk()
+
+// @brief Read a large buffer as chunks, one sys_i2c_read() per chunk. The port lock is free between chunks.
+// if (!sys_i2c_read_bulk(sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_addr, buf_size, chunk_align, bulk_flags)) { goto fail; }
+//
+// TASK SAFE: YES
+//
+bool sys_i2c_read_bulk(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size, size_t chunk_align, uint32_t bulk_flags)
+{
+    TRACE_ENTER;
+    size_t done_size = 0;
+
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    if (!(SYS_I2C_ADDR_INVALID > i2c_addr_num)) { goto fail; }
+    if (!buf_addr) { goto fail; }
+    if (!buf_size) { goto fail; }
+    if ((bulk_flags & SYS_I2C_BULK_REG_INCR) && (SYS_I2C_BULK_REG_SPAN < (i2c_reg_num + buf_size))) { goto fail; } // 8-bit wrap
+
+    const bool incr_flag = (0 != (bulk_flags & SYS_I2C_BULK_REG_INCR));
+    const size_t chunk_size = sys_i2c_bulk_chunk_size(sys_i2c_id, i2c_addr_num, chunk_align);
+
+    while (buf_size > done_size) {
+        const size_t  size    = sys_i2c_bulk_next_size(chunk_size, chunk_align, incr_flag, (i2c_reg_num + done_size), buf_size - done_size);
+        const uint8_t reg_num = (incr_flag) ? (uint8_t)(i2c_reg_num + done_size) : i2c_reg_num;
+
+        if (!sys_i2c_read(sys_i2c_id, i2c_addr_num, reg_num, (buf_addr + done_size), size)) { goto fail; }
+        done_size += size;
+        if (buf_size > done_size) { taskYIELD(); }
+    }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_read_bulk()
+
+// @brief Bytes per chunk: largest multiple of chunk_align whose wire time at the device clk_speed fits
+// SYS_I2C_LOCK_HOLD_MAX_US. Never less than one chunk_align; the protocol boundary wins over the hold time.
+//
+static size_t sys_i2c_bulk_chunk_size(uint8_t sys_i2c_id, uint8_t i2c_addr_num, size_t chunk_align)
+{
+    const uint64_t clk_speed = sys_i2c_clock_get(sys_i2c_id, i2c_addr_num); // clock profile, else the port clk_speed
+    uint64_t byte_max = (SYS_I2C_LOCK_HOLD_MAX_US * clk_speed) / (SYS_I2C_BULK_BIT_PER_BYTE * 1000000ULL);
+    size_t   chunk_size;
+
+    if (!chunk_align) { chunk_align = 1; }
+    byte_max   = (SYS_I2C_BULK_OVERHEAD_BYTE < byte_max) ? (byte_max - SYS_I2C_BULK_OVERHEAD_BYTE) : 0;
+    chunk_size = (size_t)(byte_max / chunk_align) * chunk_align;
+
+    return ((chunk_size) ? chunk_size : chunk_align);
+} // end: sys_i2c_bulk_chunk_size()
+
+// @brief Next chunk at register reg_num. SYS_I2C_BULK_REG_INCR: up to the next chunk_align boundary of reg_num, an
+// unaligned start gets a short first chunk and no chunk crosses a page. Else chunk_size, a multiple of chunk_align.
+//
+static size_t sys_i2c_bulk_next_size(size_t chunk_size, size_t chunk_align, bool incr_flag, size_t reg_num, size_t left_size)
+{
+    const size_t size = (incr_flag && (chunk_align > 1)) ? (chunk_align - (reg_num % chunk_align)) : chunk_size;
+
+    return ((left_size < size) ? left_size : size);
+} // end: sys_i2c_bulk_next_size()
+
+// @brief Write cycle done? Probe until ACK, yielding the port between probes.
+//
+static bool sys_i2c_bulk_ack_poll(uint8_t sys_i2c_id, uint8_t i2c_addr_num)
+{
+    TRACE_ENTER;
+    const TickType_t start_tick = xTaskGetTickCount();
+    bool found_flag = false;
+
+    do {
+        if (!sys_i2c_probe(sys_i2c_id, i2c_addr_num, &found_flag)) { goto fail; }
+        if (found_flag) { goto pass; }
+        taskYIELD();
+    } while (SYS_I2C_BULK_POLL_TIMEOUT_TICK > (xTaskGetTickCount() - start_tick));
+    goto fail;
+
+  pass:
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_bulk_ack_poll()
+
+/* EOF sys_i2c_bulk.c */
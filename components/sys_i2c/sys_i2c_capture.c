@@ -0,0 +1,212 @@
+// @file    sys_i2c_capture.c
+//
+// @brief  SYS_I2C workload capture: hook, record encode/decode.
+//
+// @details
+// The hook runs in every captured call after it returns. A record slot is claimed inside one portMUX critical
+// section, then encoded outside it; the slot count published by sys_i2c_capture_stop() waits for writers in flight.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+static const char * TAG = "sys_i2c_capture";
+#include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
+#include "sys_i2c_capture.h" // includes app_config.h, sys_i2c.h
+#include "sys_i2c_priv.h" // sys_i2c_capture_hook() prototype
+
+#include "freertos/task.h"
+#include "esp_timer.h" // esp_timer_get_time()
+
+#define SYS_I2C_CAPTURE_MAGIC_0     ('S')
+#define SYS_I2C_CAPTURE_MAGIC_1     ('C')
+
+// GLOBAL RAM
+//
+static struct {
+    uint8_t *       buf_addr;
+    uint32_t        record_max;
+    uint32_t        record_cnt;                         // slots claimed
+    uint32_t        write_cnt;                          // claimed slots still being encoded
+    uint32_t        drop_cnt;
+    int64_t         start_us;
+    TaskHandle_t    task[SYS_I2C_CAPTURE_TASK_MAX];     // task_idx order of first call
+    volatile bool   active;
+} sys_i2c_capture;
+static portMUX_TYPE sys_i2c_capture_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void sys_i2c_capture_put32(uint8_t * addr, uint32_t num);
+static uint32_t sys_i2c_capture_get32(const uint8_t * addr);
+
+bool sys_i2c_capture_start(uint8_t * buf_addr, size_t buf_size)
+{
+    TRACE_ENTER;
+    bool start_flag = false;
+
+    if (SYS_I2C_CAPTURE_ENABLE != true) { goto fail; } // hook compiled out
+    if (!buf_addr) { goto fail; }
+    if ((SYS_I2C_CAPTURE_HEAD_SIZE + SYS_I2C_CAPTURE_RECORD_SIZE) > buf_size) { goto fail; }
+
+    portENTER_CRITICAL(&sys_i2c_capture_mux);
+    if (!sys_i2c_capture.active && !sys_i2c_capture.write_cnt) {
+        sys_i2c_capture.buf_addr   = buf_addr;
+        sys_i2c_capture.record_max = (buf_size - SYS_I2C_CAPTURE_HEAD_SIZE) / SYS_I2C_CAPTURE_RECORD_SIZE;
+        sys_i2c_capture.record_cnt = 0;
+        sys_i2c_capture.drop_cnt   = 0;
+        for (uint8_t task_idx = 0; SYS_I2C_CAPTURE_TASK_MAX > task_idx; ++task_idx) { sys_i2c_capture.task[task_idx] = NULL; }
+        sys_i2c_capture.start_us   = esp_timer_get_time();
+        sys_i2c_capture.active     = true;
+        start_flag = true;
+    }
+    portEXIT_CRITICAL(&sys_i2c_capture_mux);
+    if (!start_flag) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_capture_start()
+
+bool sys_i2c_capture_stop(size_t * capture_size_addr, uint32_t * drop_cnt_addr)
+{
+    TRACE_ENTER;
+    uint32_t write_cnt;
+
+    if (!capture_size_addr) { goto fail; }
+    if (!sys_i2c_capture.active) { goto fail; }
+
+    // 1A No new slots, then wait for slots being encoded.
+    portENTER_CRITICAL(&sys_i2c_capture_mux);
+    sys_i2c_capture.active = false;
+    portEXIT_CRITICAL(&sys_i2c_capture_mux);
+    do {
+        portENTER_CRITICAL(&sys_i2c_capture_mux);
+        write_cnt = sys_i2c_capture.write_cnt;
+        portEXIT_CRITICAL(&sys_i2c_capture_mux);
+        if (write_cnt) { vTaskDelay(1); }
+    } while (write_cnt);
+
+    // 2A Header.
+    uint8_t * const head_addr = sys_i2c_capture.buf_addr;
+    head_addr[0] = SYS_I2C_CAPTURE_MAGIC_0;
+    head_addr[1] = SYS_I2C_CAPTURE_MAGIC_1;
+    head_addr[2] = SYS_I2C_CAPTURE_VERSION;
+    head_addr[3] = SYS_I2C_CAPTURE_RECORD_SIZE;
+    sys_i2c_capture_put32(&head_addr[4], sys_i2c_capture.record_cnt);
+
+    *capture_size_addr = SYS_I2C_CAPTURE_HEAD_SIZE + (sys_i2c_capture.record_cnt * SYS_I2C_CAPTURE_RECORD_SIZE);
+    if (drop_cnt_addr) { *drop_cnt_addr = sys_i2c_capture.drop_cnt; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_capture_stop()
+
+bool sys_i2c_capture_check(const uint8_t * capture_addr, size_t capture_size, uint32_t * record_cnt_addr)
+{
+    TRACE_ENTER;
+    if (!capture_addr || !record_cnt_addr) { goto fail; }
+    if (SYS_I2C_CAPTURE_HEAD_SIZE > capture_size) { goto fail; }
+    if ((SYS_I2C_CAPTURE_MAGIC_0 != capture_addr[0]) || (SYS_I2C_CAPTURE_MAGIC_1 != capture_addr[1])) { goto fail; }
+    if (SYS_I2C_CAPTURE_VERSION != capture_addr[2]) { goto fail; }
+    if (SYS_I2C_CAPTURE_RECORD_SIZE != capture_addr[3]) { goto fail; }
+
+    const uint32_t record_cnt = sys_i2c_capture_get32(&capture_addr[4]);
+    if (((capture_size - SYS_I2C_CAPTURE_HEAD_SIZE) / SYS_I2C_CAPTURE_RECORD_SIZE) < record_cnt) { goto fail; } // truncated
+    *record_cnt_addr = record_cnt;
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_capture_check()
+
+bool sys_i2c_capture_record(const uint8_t * capture_addr, uint32_t record_idx, struct SYS_I2C_CAPTURE_RECORD * record_addr)
+{
+    TRACE_ENTER;
+    if (!capture_addr || !record_addr) { goto fail; }
+
+    const uint8_t * const r = &capture_addr[SYS_I2C_CAPTURE_HEAD_SIZE + (record_idx * SYS_I2C_CAPTURE_RECORD_SIZE)];
+    record_addr->start_us       = sys_i2c_capture_get32(&r[0]);
+    record_addr->lat_us         = sys_i2c_capture_get32(&r[4]);
+    record_addr->buf_size       = (uint16_t)(r[8] | (r[9] << 8));
+    record_addr->op             = r[10] & SYS_I2C_CAPTURE_OP_MASK;
+    record_addr->pass_flag      = (0 != (r[10] & SYS_I2C_CAPTURE_OP_PASS));
+    record_addr->sys_i2c_id     = r[11];
+    record_addr->i2c_addr_num   = r[12];
+    record_addr->i2c_reg_num    = r[13];
+    record_addr->task_idx       = r[14];
+    if (SYS_I2C_CAPTURE_OP_PROBE < record_addr->op) { goto fail; }
+    if (!(SYS_I2C_ID_CNT > record_addr->sys_i2c_id)) { goto fail; } // captured with another bus table
+    if (!(SYS_I2C_CAPTURE_TASK_MAX > record_addr->task_idx)) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_capture_record()
+
+#if (SYS_I2C_CAPTURE_ENABLE == true)
+// @brief Called by sys_i2c_read(), sys_i2c_write(), sys_i2c_probe() and the modules in sys_i2c_capture.h on return.
+// Cheap when no capture runs.
+//
+void sys_i2c_capture_hook(uint8_t op, uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, size_t buf_size, int64_t start_us, bool pass_flag)
+{
+    if (!sys_i2c_capture.active) { return; }
+    const int64_t end_us = esp_timer_get_time();
+    const TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    uint32_t record_idx = UINT32_MAX;
+    uint8_t task_idx;
+
+    // 1A Claim a slot and a task_idx.
+    portENTER_CRITICAL(&sys_i2c_capture_mux);
+    for (task_idx = 0; (SYS_I2C_CAPTURE_TASK_MAX - 1) > task_idx; ++task_idx) {
+        if (!sys_i2c_capture.task[task_idx]) { sys_i2c_capture.task[task_idx] = task; }
+        if (task == sys_i2c_capture.task[task_idx]) { break; }
+    }
+    if (sys_i2c_capture.active && (sys_i2c_capture.record_max > sys_i2c_capture.record_cnt)) {
+        record_idx = sys_i2c_capture.record_cnt++;
+        sys_i2c_capture.write_cnt++;
+    } else {
+        sys_i2c_capture.drop_cnt++;
+    }
+    portEXIT_CRITICAL(&sys_i2c_capture_mux);
+    if (UINT32_MAX == record_idx) { return; }
+
+    // 2A Encode outside the critical section.
+    uint8_t * const r = &sys_i2c_capture.buf_addr[SYS_I2C_CAPTURE_HEAD_SIZE + (record_idx * SYS_I2C_CAPTURE_RECORD_SIZE)];
+    sys_i2c_capture_put32(&r[0], (uint32_t)(start_us - sys_i2c_capture.start_us));
+    sys_i2c_capture_put32(&r[4], (uint32_t)(end_us - start_us));
+    r[8]  = (uint8_t)((UINT16_MAX < buf_size) ? UINT16_MAX : buf_size);
+    r[9]  = (uint8_t)(((UINT16_MAX < buf_size) ? UINT16_MAX : buf_size) >> 8);
+    r[10] = op | ((pass_flag) ? SYS_I2C_CAPTURE_OP_PASS : 0);
+    r[11] = sys_i2c_id;
+    r[12] = i2c_addr_num;
+    r[13] = i2c_reg_num;
+    r[14] = task_idx;
+    r[15] = 0;
+
+    portENTER_CRITICAL(&sys_i2c_capture_mux);
+    sys_i2c_capture.write_cnt--;
+    portEXIT_CRITICAL(&sys_i2c_capture_mux);
+} // end: sys_i2c_capture_hook()
+#endif // SYS_I2C_CAPTURE_ENABLE
+
+static void sys_i2c_capture_put32(uint8_t * addr, uint32_t num)
+{
+    addr[0] = (uint8_t)(num);
+    addr[1] = (uint8_t)(num >> 8);
+    addr[2] = (uint8_t)(num >> 16);
+    addr[3] = (uint8_t)(num >> 24);
+} // end: sys_i2c_capture_put32()
+
+static uint32_t sys_i2c_capture_get32(const uint8_t * addr)
+{
+    return ((uint32_t)addr[0] | ((uint32_t)addr[1] << 8) | ((uint32_t)addr[2] << 16) | ((uint32_t)addr[3] << 24));
+} // end: sys_i2c_capture_get32()
+
+/* EOF sys_i2c_capture.c */
@@ -0,0 +1,241 @@
+// @file    sys_i2c_clock.c
+//
+// @brief  SYS_I2C clock profiles: per-device clk_speed table, calibration sweep.
+//
+// @details
+// Profile table: kHz in uint16_t, 0 = port clk_speed. 256 bytes per I2C Bus, one lookup per transaction.
+// Read by sys_i2c_attach_pins() under the port lock; written only under the same port lock.
+// A calibration step writes the step clk_speed into the table, runs the test through the *_locked() bodies,
+// then clears it again, all inside one port lock hold.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+static const char * TAG = "sys_i2c_clock";
+#include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
+#include "sys_i2c_clock.h" // includes app_config.h, sys_i2c.h
+#include "sys_i2c_discover.h" // sys_i2c_discover_found(), SYS_I2C_DISCOVER_ADDR_MIN
+#include "sys_i2c_priv.h" // sys_i2c_port_take(), sys_i2c_read_locked(), sys_i2c_port_give()
+
+#include <stdio.h> // printf()
+#include <string.h> // memcmp(), memset()
+
+static const uint8_t sys_i2c_clock_pattern[] = { 0x55, 0xAA }; // every bit both ways, alternating neighbours
+
+// GLOBAL RAM
+//
+static uint16_t sys_i2c_clock_khz[SYS_I2C_ID_CNT][SYS_I2C_ADDR_INVALID];
+
+static bool sys_i2c_clock_step(uint8_t sys_i2c_id, uint8_t i2c_addr_num, const struct SYS_I2C_CLOCK_TEST * test_addr, uint32_t clk_speed, uint8_t * ref_addr);
+static bool sys_i2c_clock_test(uint8_t sys_i2c_id, uint8_t i2c_addr_num, const struct SYS_I2C_CLOCK_TEST * test_addr, const uint8_t * ref_addr);
+
+bool sys_i2c_clock_calibrate(uint8_t sys_i2c_id, uint8_t i2c_addr_num, const struct SYS_I2C_CLOCK_TEST * test_addr, uint32_t * clk_speed_addr)
+{
+    TRACE_ENTER;
+    uint8_t ref_buf[SYS_I2C_CLOCK_TEST_BUF_MAX];
+    uint32_t clk_speed;
+    uint32_t best_speed;
+
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    if (!(SYS_I2C_ADDR_INVALID > i2c_addr_num)) { goto fail; }
+    if (test_addr && (!test_addr->read_size || (SYS_I2C_CLOCK_TEST_BUF_MAX < test_addr->read_size))) { goto fail; }
+
+    const uint32_t port_speed = SYS_I2C_runtime.unit[sys_i2c_id].clk_speed;
+
+    // 1A Reference pass at the port clk_speed. Captures the register contents every step compares against.
+    if (!sys_i2c_clock_set(sys_i2c_id, i2c_addr_num, 0)) { goto fail; }
+    if (!sys_i2c_clock_step(sys_i2c_id, i2c_addr_num, test_addr, 0, ref_buf)) { goto fail; }
+
+    // 2A Sweep up; first failed step ends it.
+    best_speed = port_speed;
+    for (clk_speed = port_speed + SYS_I2C_CLOCK_STEP_HZ; SYS_I2C_CLOCK_MAX >= clk_speed; clk_speed += SYS_I2C_CLOCK_STEP_HZ) {
+        if (!sys_i2c_clock_step(sys_i2c_id, i2c_addr_num, test_addr, clk_speed, ref_buf)) { break; }
+        best_speed = clk_speed;
+    }
+
+    // 3A Derate, never below the port clk_speed.
+    clk_speed = (uint32_t)(((uint64_t)best_speed * SYS_I2C_CLOCK_DERATE_PCT) / 100U);
+    if (port_speed >= clk_speed) { clk_speed = port_speed; }
+    if (!sys_i2c_clock_set(sys_i2c_id, i2c_addr_num, (port_speed == clk_speed) ? 0 : clk_speed)) { goto fail; }
+    if (clk_speed_addr) { *clk_speed_addr = clk_speed; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_clock_calibrate()
+
+bool sys_i2c_clock_calibrate_bus(uint8_t sys_i2c_id, const struct SYS_I2C_CLOCK_TEST * test_addr, size_t test_cnt)
+{
+    TRACE_ENTER;
+    bool pass_flag = true;
+    bool found_flag;
+    uint8_t i2c_addr_num;
+    size_t test_idx;
+
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    if (!test_addr && test_cnt) { goto fail; }
+
+    for (i2c_addr_num = SYS_I2C_DISCOVER_ADDR_MIN; SYS_I2C_DISCOVER_ADDR_MAX >= i2c_addr_num; ++i2c_addr_num) {
+        const struct SYS_I2C_CLOCK_TEST * dev_test_addr = NULL;
+
+        if (sys_i2c_discover_ready(sys_i2c_id)) {
+            if (!sys_i2c_discover_found(sys_i2c_id, i2c_addr_num, &found_flag)) { goto fail; }
+        } else {
+            if (!sys_i2c_probe(sys_i2c_id, i2c_addr_num, &found_flag)) { goto fail; }
+        }
+        if (!found_flag) { continue; }
+
+        for (test_idx = 0; test_cnt > test_idx; ++test_idx) {
+            if (i2c_addr_num == test_addr[test_idx].i2c_addr_num) { dev_test_addr = &test_addr[test_idx]; break; }
+        }
+        if (!sys_i2c_clock_calibrate(sys_i2c_id, i2c_addr_num, dev_test_addr, NULL)) { pass_flag = false; }
+    }
+    if (!pass_flag) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_clock_calibrate_bus()
+
+bool sys_i2c_clock_set(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint32_t clk_speed)
+{
+    TRACE_ENTER;
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    if (!(SYS_I2C_ADDR_INVALID > i2c_addr_num)) { goto fail; }
+    if (SYS_I2C_CLOCK_MAX < clk_speed) { goto fail; }
+    if (clk_speed && (1000U > clk_speed)) { goto fail; } // table resolution 1 kHz
+
+    // start: Task Safe, no transaction sees half a change
+    if (!sys_i2c_port_take(sys_i2c_id)) { goto fail; }
+    sys_i2c_clock_khz[sys_i2c_id][i2c_addr_num] = (uint16_t)(clk_speed / 1000U);
+    if (!sys_i2c_port_give(sys_i2c_id)) { goto fail; }
+    // end: Task Safe
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_clock_set()
+
+uint32_t sys_i2c_clock_get(uint8_t sys_i2c_id, uint8_t i2c_addr_num)
+{
+    const uint16_t khz = sys_i2c_clock_khz[sys_i2c_id][i2c_addr_num];
+
+    return ((khz) ? (khz * 1000U) : SYS_I2C_runtime.unit[sys_i2c_id].clk_speed);
+} // end: sys_i2c_clock_get()
+
+// @brief REF_TICK, 1 MHz, stays put through DFS but divides down to SYS_I2C_REF_TICK_CLOCK_MAX only.
+// PM on: every transaction slow enough runs on it; APB needs the APB_FREQ_MAX lock for the whole transfer.
+//
+uint32_t sys_i2c_clock_source(uint8_t sys_i2c_id, uint32_t clk_speed)
+{
+    #if (SYS_I2C_CLK_FLAGS_ENABLE == true)
+    const uint32_t clk_flags = SYS_I2C_runtime.unit[sys_i2c_id].clk_flags;
+
+    if (SYS_I2C_REF_TICK_CLOCK_MAX < clk_speed) { return (I2C_SCLK_SRC_FLAG_FOR_NOMAL); }
+    if ((SYS_I2C_PM_ENABLE == true) || (I2C_SCLK_SRC_FLAG_AWARE_DFS & clk_flags)) { return (I2C_SCLK_SRC_FLAG_AWARE_DFS); }
+    #endif
+    return (0); // APB; ESP-IDF < 4.3: APB only
+} // end: sys_i2c_clock_source()
+
+bool sys_i2c_clock_print(void)
+{
+    TRACE_ENTER;
+    uint8_t sys_i2c_id;
+    uint8_t i2c_addr_num;
+    i2c_port_t port_num;
+
+    printf("\nI2C CLOCK SOURCE: power management %s\n", (SYS_I2C_PM_ENABLE == true) ? "ON" : "OFF");
+    for (port_num = 0; I2C_NUM_MAX > port_num; ++port_num) {
+        const struct SYS_I2C_CLOCK_SRC_STATS src = SYS_I2C_runtime.port[port_num].src_stats; // counters, no lock
+        printf("  port_num = %d: APB = %u, REF_TICK = %u\n", port_num, src.apb_cnt, src.ref_tick_cnt);
+    }
+
+    printf("\nI2C CLOCK PROFILES: :: %d :: I2C Buses [SYS_I2C_ID_CNT]\n", SYS_I2C_ID_CNT);
+    for (sys_i2c_id = 0; SYS_I2C_ID_CNT > sys_i2c_id; ++sys_i2c_id) {
+        printf("\nI2C Bus sys_i2c_id = %d, port clk_speed = %u, clk_flags = %u\n", sys_i2c_id, // runtime: BOARD_GEN may differ
+               SYS_I2C_runtime.unit[sys_i2c_id].clk_speed, SYS_I2C_runtime.unit[sys_i2c_id].clk_flags);
+        for (i2c_addr_num = 0; SYS_I2C_ADDR_INVALID > i2c_addr_num; ++i2c_addr_num) {
+            if (!sys_i2c_clock_khz[sys_i2c_id][i2c_addr_num]) { continue; }
+            printf("  i2c_addr_num = 0x%.2x: clk_speed = %u\n", i2c_addr_num, sys_i2c_clock_get(sys_i2c_id, i2c_addr_num));
+        }
+    }
+    printf("\n");
+
+    TRACE_PASS;
+    return (true);
+} // end: sys_i2c_clock_print()
+
+// @brief One sweep step: SYS_I2C_CLOCK_STEP_REPEAT tests at clk_speed, one port lock hold. clk_speed 0: reference pass.
+// Reference pass fills ref_addr[]; later steps compare against it.
+//
+static bool sys_i2c_clock_step(uint8_t sys_i2c_id, uint8_t i2c_addr_num, const struct SYS_I2C_CLOCK_TEST * test_addr, uint32_t clk_speed, uint8_t * ref_addr)
+{
+    TRACE_ENTER;
+    bool pass_flag = true;
+    bool ref_flag = (0 != clk_speed); // ref_addr[] valid, safe to restore from
+    uint32_t repeat_idx;
+
+    // start: Task Safe
+    if (!sys_i2c_port_take(sys_i2c_id)) { goto fail; }
+    sys_i2c_clock_khz[sys_i2c_id][i2c_addr_num] = (uint16_t)(clk_speed / 1000U);
+
+    if (!clk_speed && test_addr) {
+        pass_flag = ref_flag = sys_i2c_read_locked(sys_i2c_id, i2c_addr_num, test_addr->i2c_reg_num, ref_addr, test_addr->read_size);
+    }
+    for (repeat_idx = 0; pass_flag && (SYS_I2C_CLOCK_STEP_REPEAT > repeat_idx); ++repeat_idx) {
+        pass_flag = sys_i2c_clock_test(sys_i2c_id, i2c_addr_num, test_addr, ref_addr);
+    }
+
+    // Scratch register: restore the reference at the port clk_speed, whatever the step left behind.
+    sys_i2c_clock_khz[sys_i2c_id][i2c_addr_num] = 0;
+    if (ref_flag && test_addr && test_addr->write_flag) {
+        uint8_t restore_buf[SYS_I2C_CLOCK_TEST_BUF_MAX];
+        memcpy(restore_buf, ref_addr, test_addr->read_size);
+        if (!sys_i2c_write_locked(sys_i2c_id, i2c_addr_num, test_addr->i2c_reg_num, restore_buf, test_addr->read_size)) { pass_flag = false; }
+    }
+    if (!sys_i2c_port_give(sys_i2c_id)) { goto fail; }
+    // end: Task Safe
+
+    if (!pass_flag) { goto fail; }
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_clock_step()
+
+// @brief One test run. Caller holds the port lock.
+//
+static bool sys_i2c_clock_test(uint8_t sys_i2c_id, uint8_t i2c_addr_num, const struct SYS_I2C_CLOCK_TEST * test_addr, const uint8_t * ref_addr)
+{
+    uint8_t buf[SYS_I2C_CLOCK_TEST_BUF_MAX];
+    bool found_flag;
+    uint8_t pattern_idx;
+
+    if (!test_addr) {
+        return (sys_i2c_probe_locked(sys_i2c_id, i2c_addr_num, &found_flag) && found_flag);
+    }
+
+    if (!sys_i2c_read_locked(sys_i2c_id, i2c_addr_num, test_addr->i2c_reg_num, buf, test_addr->read_size)) { return (false); }
+    if (memcmp(buf, ref_addr, test_addr->read_size)) { return (false); }
+    if (!test_addr->write_flag) { return (true); }
+
+    for (pattern_idx = 0; sizeof(sys_i2c_clock_pattern) > pattern_idx; ++pattern_idx) {
+        uint8_t pattern_buf[SYS_I2C_CLOCK_TEST_BUF_MAX];
+        memset(pattern_buf, sys_i2c_clock_pattern[pattern_idx], test_addr->read_size);
+        if (!sys_i2c_write_locked(sys_i2c_id, i2c_addr_num, test_addr->i2c_reg_num, pattern_buf, test_addr->read_size)) { return (false); }
+        if (!sys_i2c_read_locked(sys_i2c_id, i2c_addr_num, test_addr->i2c_reg_num, buf, test_addr->read_size)) { return (false); }
+        if (memcmp(buf, pattern_buf, test_addr->read_size)) { return (false); }
+    }
+    // next run compares against the reference again
+    memcpy(buf, ref_addr, test_addr->read_size);
+    return (sys_i2c_write_locked(sys_i2c_id, i2c_addr_num, test_addr->i2c_reg_num, buf, test_addr->read_size));
+} // end: sys_i2c_clock_test()
+
+/* EOF sys_i2c_clock.c */
@@ -0,0 +1,254 @@
+// @file    sys_i2c_coalesce.c
+//
+// @brief  SYS_I2C read coalescing. One leader task per I2C Bus transaction, any number of followers.
+//
+// @details
+// Slot life cycle, all state changes inside one portMUX critical section, no blocking calls inside:
+//   free -> queued   leader claims a slot with its register range
+//   queued           followers with overlapping or adjacent ranges merge in, range grows
+//   queued -> wire   leader holds the I2C port lock: range frozen
+//   wire             followers with covered ranges join
+//   wire -> done     leader wakes followers; each requester copies its slice
+//   done -> free     last requester out frees the slot
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+static const char * TAG = "sys_i2c_coalesce";
+#include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
+#include "sys_i2c_coalesce.h" // includes app_config.h, sys_i2c.h
+#include "sys_i2c_priv.h" // sys_i2c_port_take(), sys_i2c_read_locked(), sys_i2c_port_give(), hooks
+#include "sys_i2c_capture.h" // SYS_I2C_CAPTURE_OP_READ
+
+#include <string.h> // memcpy(), memset()
+
+enum SYS_I2C_COALESCE_STATE {
+    SYS_I2C_COALESCE_FREE,
+    SYS_I2C_COALESCE_QUEUED,
+    SYS_I2C_COALESCE_WIRE,
+    SYS_I2C_COALESCE_DONE,
+};
+
+struct SYS_I2C_COALESCE_SLOT {
+    enum SYS_I2C_COALESCE_STATE state;
+    uint8_t             sys_i2c_id;
+    uint8_t             i2c_addr_num;
+    uint16_t            reg_lo;         // first register
+    uint16_t            reg_hi;         // last register + 1
+    uint32_t            ref_cnt;        // leader + followers still to copy their slice
+    bool                pass_flag;      // leader sys_i2c_read_locked() result
+    SemaphoreHandle_t   done_sem;       // counting, one give per follower
+    uint8_t             buf_addr[SYS_I2C_COALESCE_BUF_MAX];
+};
+
+// GLOBAL RAM
+//
+static struct SYS_I2C_COALESCE_SLOT     sys_i2c_coalesce_slot[SYS_I2C_COALESCE_SLOT_CNT];
+static struct SYS_I2C_COALESCE_STATS    sys_i2c_coalesce_stat;
+static portMUX_TYPE                     sys_i2c_coalesce_mux = portMUX_INITIALIZER_UNLOCKED;
+static bool                             sys_i2c_coalesce_ready = false;
+
+static bool sys_i2c_coalesce_lead(struct SYS_I2C_COALESCE_SLOT * slot_addr);
+static void sys_i2c_coalesce_leave(struct SYS_I2C_COALESCE_SLOT * slot_addr, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size);
+
+// @brief One counting semaphore per slot.
+//
+bool sys_i2c_coalesce_init(void)
+{
+    TRACE_ENTER;
+    uint8_t slot_idx;
+
+    for (slot_idx = 0; SYS_I2C_COALESCE_SLOT_CNT > slot_idx; ++slot_idx) {
+        struct SYS_I2C_COALESCE_SLOT * slot_addr = &sys_i2c_coalesce_slot[slot_idx];
+        if (!slot_addr->done_sem) {
+            if (!(slot_addr->done_sem = xSemaphoreCreateCounting(UINT16_MAX, 0))) { goto fail; }
+        }
+        slot_addr->state = SYS_I2C_COALESCE_FREE;
+    }
+    memset(&sys_i2c_coalesce_stat, 0, sizeof(sys_i2c_coalesce_stat));
+    sys_i2c_coalesce_ready = true;
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_coalesce_init()
+
+// @brief Find a transaction to share, or lead a new one.
+// Captured once per call, the caller's view: a follower is recorded with its own range and wait.
+// TASK SAFE: YES
+//
+bool sys_i2c_read_coalesced(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size)
+{
+    TRACE_ENTER;
+    const int64_t capture_us = SYS_I2C_CAPTURE_START_US();
+    struct SYS_I2C_COALESCE_SLOT * slot_addr = NULL;
+    struct SYS_I2C_COALESCE_SLOT * free_addr = NULL;
+    bool capture_flag = true; // false: sys_i2c_read() passthrough, captured there
+    bool leader = false;
+    bool pass_flag;
+    uint8_t slot_idx;
+
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    if (!(SYS_I2C_ADDR_INVALID > i2c_addr_num)) { goto fail; }
+    if (!buf_addr) { goto fail; }
+    if (!buf_size) { goto fail; }
+
+    const uint16_t reg_lo = i2c_reg_num;
+    const uint16_t reg_hi = i2c_reg_num + buf_size;
+    if (!sys_i2c_coalesce_ready || (SYS_I2C_COALESCE_BUF_MAX < buf_size) || (0x100U < reg_hi)) { goto passthrough; }
+    SYS_I2C_WCOMB_HOOK(sys_i2c_id, i2c_addr_num); // deferred writes go first, before sharing a read on the wire
+    if (!SYS_I2C_QUOTA_HOOK(sys_i2c_id, i2c_addr_num, buf_size, true)) { goto fail; } // every caller, shared or not
+
+    // 1A Share, merge or claim. Critical section: table scan only.
+    portENTER_CRITICAL(&sys_i2c_coalesce_mux);
+    sys_i2c_coalesce_stat.request_cnt++;
+    for (slot_idx = 0; SYS_I2C_COALESCE_SLOT_CNT > slot_idx; ++slot_idx) {
+        struct SYS_I2C_COALESCE_SLOT * const s = &sys_i2c_coalesce_slot[slot_idx];
+
+        if (SYS_I2C_COALESCE_FREE == s->state) { if (!free_addr) { free_addr = s; } continue; }
+        if ((sys_i2c_id != s->sys_i2c_id) || (i2c_addr_num != s->i2c_addr_num)) { continue; }
+
+        if ((SYS_I2C_COALESCE_WIRE == s->state) && (s->reg_lo <= reg_lo) && (reg_hi <= s->reg_hi)) {
+            sys_i2c_coalesce_stat.joined_cnt++;
+            slot_addr = s;
+            break;
+        }
+        if ((SYS_I2C_COALESCE_QUEUED == s->state) && (reg_lo <= s->reg_hi) && (s->reg_lo <= reg_hi)) {
+            const uint16_t lo = (reg_lo < s->reg_lo) ? reg_lo : s->reg_lo;
+            const uint16_t hi = (reg_hi > s->reg_hi) ? reg_hi : s->reg_hi;
+            if (SYS_I2C_COALESCE_BUF_MAX < (size_t)(hi - lo)) { continue; }
+            s->reg_lo = lo;
+            s->reg_hi = hi;
+            sys_i2c_coalesce_stat.merged_cnt++;
+            slot_addr = s;
+            break;
+        }
+    }
+    if (slot_addr) {
+        slot_addr->ref_cnt++;
+    } else if (free_addr) {
+        slot_addr               = free_addr;
+        slot_addr->state        = SYS_I2C_COALESCE_QUEUED;
+        slot_addr->sys_i2c_id   = sys_i2c_id;
+        slot_addr->i2c_addr_num = i2c_addr_num;
+        slot_addr->reg_lo       = reg_lo;
+        slot_addr->reg_hi       = reg_hi;
+        slot_addr->ref_cnt      = 1;
+        slot_addr->pass_flag    = false;
+        leader                  = true;
+    }
+    portEXIT_CRITICAL(&sys_i2c_coalesce_mux);
+
+    if (!slot_addr) { // all slots busy: plain locked read, this call already counted for capture
+        portENTER_CRITICAL(&sys_i2c_coalesce_mux);
+        sys_i2c_coalesce_stat.passthrough_cnt++;
+        portEXIT_CRITICAL(&sys_i2c_coalesce_mux);
+        if (!sys_i2c_port_take(sys_i2c_id)) { goto fail; }
+        pass_flag = sys_i2c_read_locked(sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_addr, buf_size);
+        if (!sys_i2c_port_give(sys_i2c_id)) { pass_flag = false; }
+        if (!pass_flag) { goto fail; }
+        goto pass;
+    }
+
+    // 2A Leader runs the I2C Bus transaction. Followers wait for it.
+    if (leader) {
+        (void)sys_i2c_coalesce_lead(slot_addr);
+    } else {
+        (void)xSemaphoreTake(slot_addr->done_sem, portMAX_DELAY);
+    }
+
+    // 3A Copy own slice, free the slot if last out.
+    pass_flag = slot_addr->pass_flag;
+    sys_i2c_coalesce_leave(slot_addr, i2c_reg_num, buf_addr, buf_size);
+    if (!pass_flag) { goto fail; }
+
+  pass:
+    TRACE_PASS;
+    SYS_I2C_CAPTURE_HOOK(SYS_I2C_CAPTURE_OP_READ, sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_size, capture_us, true);
+    return (true);
+  passthrough:
+    capture_flag = false;
+    portENTER_CRITICAL(&sys_i2c_coalesce_mux);
+    sys_i2c_coalesce_stat.passthrough_cnt++;
+    portEXIT_CRITICAL(&sys_i2c_coalesce_mux);
+    if (!sys_i2c_read(sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_addr, buf_size)) { goto fail; }
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    if (capture_flag) {
+        SYS_I2C_CAPTURE_HOOK(SYS_I2C_CAPTURE_OP_READ, sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_size, capture_us, false);
+    }
+    return (false);
+} // end: sys_i2c_read_coalesced()
+
+bool sys_i2c_coalesce_stats(struct SYS_I2C_COALESCE_STATS * stats_addr)
+{
+    TRACE_ENTER;
+    if (!stats_addr) { goto fail; }
+
+    portENTER_CRITICAL(&sys_i2c_coalesce_mux);
+    *stats_addr = sys_i2c_coalesce_stat;
+    portEXIT_CRITICAL(&sys_i2c_coalesce_mux);
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_coalesce_stats()
+
+// @brief Leader: wait for the port lock (merge window), freeze range, one burst, wake followers.
+//
+static bool sys_i2c_coalesce_lead(struct SYS_I2C_COALESCE_SLOT * slot_addr)
+{
+    TRACE_ENTER;
+    bool pass_flag = false;
+    uint32_t follower_cnt;
+    uint16_t reg_lo;
+    uint16_t reg_hi;
+
+    if (sys_i2c_port_take(slot_addr->sys_i2c_id)) {
+        portENTER_CRITICAL(&sys_i2c_coalesce_mux);
+        slot_addr->state = SYS_I2C_COALESCE_WIRE;
+        reg_lo = slot_addr->reg_lo;
+        reg_hi = slot_addr->reg_hi;
+        sys_i2c_coalesce_stat.bus_cnt++;
+        portEXIT_CRITICAL(&sys_i2c_coalesce_mux);
+
+        pass_flag = sys_i2c_read_locked(slot_addr->sys_i2c_id, slot_addr->i2c_addr_num, (uint8_t)reg_lo, slot_addr->buf_addr, (reg_hi - reg_lo));
+        if (!sys_i2c_port_give(slot_addr->sys_i2c_id)) { pass_flag = false; }
+    }
+
+    portENTER_CRITICAL(&sys_i2c_coalesce_mux);
+    slot_addr->pass_flag = pass_flag;
+    slot_addr->state     = SYS_I2C_COALESCE_DONE; // no more followers
+    follower_cnt         = slot_addr->ref_cnt - 1;
+    portEXIT_CRITICAL(&sys_i2c_coalesce_mux);
+
+    while (follower_cnt--) { (void)xSemaphoreGive(slot_addr->done_sem); }
+
+    if (!pass_flag) { goto fail; }
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_coalesce_lead()
+
+// @brief Copy this requester's slice out of the merged burst, release the slot.
+//
+static void sys_i2c_coalesce_leave(struct SYS_I2C_COALESCE_SLOT * slot_addr, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size)
+{
+    if (slot_addr->pass_flag) {
+        memcpy(buf_addr, &slot_addr->buf_addr[i2c_reg_num - slot_addr->reg_lo], buf_size);
+    }
+
+    portENTER_CRITICAL(&sys_i2c_coalesce_mux);
+    if (!--slot_addr->ref_cnt) { slot_addr->state = SYS_I2C_COALESCE_FREE; }
+    portEXIT_CRITICAL(&sys_i2c_coalesce_mux);
+} // end: sys_i2c_coalesce_leave()
+
+/* EOF sys_i2c_coalesce.c */
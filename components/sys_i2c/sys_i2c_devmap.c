@@ -0,0 +1,221 @@
+// @file    sys_i2c_devmap.c
+//
+// @brief  SYS_I2C persisted device map: record encode/decode, NVS and file backends.
+//
+// @details
+// Record layout in sys_i2c_devmap.h. Encoded byte by byte: no struct padding, no endianness in the record.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+static const char * TAG = "sys_i2c_devmap";
+#include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
+#include "sys_i2c_devmap.h" // includes app_config.h, sys_i2c.h
+#include "sys_i2c_discover.h" // sys_i2c_discover_map()
+#include "sys_i2c_smbus.h" // sys_i2c_smbus_pec(), record CRC-8
+
+#include <stdio.h> // fopen(), snprintf()
+#include <string.h> // memcmp(), memset()
+#ifdef ESP_PLATFORM
+#include "nvs.h"
+#endif
+
+#define SYS_I2C_DEVMAP_MAGIC_0      ('S')
+#define SYS_I2C_DEVMAP_MAGIC_1      ('M')
+#define SYS_I2C_DEVMAP_KEY_FMT      "i2c_map_%u"    // NVS key limit 15 characters
+#define SYS_I2C_DEVMAP_KEY_SIZE     (16U)
+#define SYS_I2C_DEVMAP_PATH_SIZE    (64U)
+
+static void sys_i2c_devmap_encode(uint8_t * rec_addr, uint8_t bsp_id, const uint32_t found_map[SYS_I2C_ID_CNT][4]);
+
+#ifdef ESP_PLATFORM
+static bool sys_i2c_devmap_nvs_load(const void * ctx, const char * key, uint8_t * buf_addr, size_t buf_size, size_t * read_size_addr);
+static bool sys_i2c_devmap_nvs_save(const void * ctx, const char * key, const uint8_t * buf_addr, size_t buf_size);
+
+// FLASH const
+//
+const struct SYS_I2C_DEVMAP_STORE SYS_I2C_devmap_store_nvs = {
+    .load   = sys_i2c_devmap_nvs_load,
+    .save   = sys_i2c_devmap_nvs_save,
+    .ctx    = "sys_i2c",
+};
+#endif
+
+bool sys_i2c_devmap_load(const struct SYS_I2C_DEVMAP_STORE * store_addr, uint8_t bsp_id, uint32_t known_map[SYS_I2C_ID_CNT][4])
+{
+    TRACE_ENTER;
+    uint8_t rec_buf[SYS_I2C_DEVMAP_RECORD_SIZE];
+    char key[SYS_I2C_DEVMAP_KEY_SIZE];
+    size_t read_size = 0;
+    uint8_t sys_i2c_id;
+    uint8_t byte_idx;
+
+    if (!store_addr || !store_addr->load) { goto fail; }
+    if (!known_map) { goto fail; }
+
+    (void)snprintf(key, sizeof(key), SYS_I2C_DEVMAP_KEY_FMT, bsp_id);
+    if (!store_addr->load(store_addr->ctx, key, rec_buf, sizeof(rec_buf), &read_size)) { goto fail; }
+
+    // 1A Same format, same board, same bus count, intact.
+    if (sizeof(rec_buf) != read_size) { goto fail; }
+    if ((SYS_I2C_DEVMAP_MAGIC_0 != rec_buf[0]) || (SYS_I2C_DEVMAP_MAGIC_1 != rec_buf[1])) { goto fail; }
+    if (SYS_I2C_DEVMAP_VERSION != rec_buf[2]) { goto fail; }
+    if (bsp_id != rec_buf[3]) { goto fail; }
+    if (SYS_I2C_ID_CNT != rec_buf[4]) { goto fail; }
+    if (sys_i2c_smbus_pec(0, rec_buf, sizeof(rec_buf) - 1) != rec_buf[sizeof(rec_buf) - 1]) { goto fail; }
+
+    // 2A Bytes to 32-bit words.
+    memset(known_map, 0, sizeof(uint32_t) * 4 * SYS_I2C_ID_CNT);
+    for (sys_i2c_id = 0; SYS_I2C_ID_CNT > sys_i2c_id; ++sys_i2c_id) {
+        const uint8_t * const bus_addr = &rec_buf[SYS_I2C_DEVMAP_HEAD_SIZE + (SYS_I2C_DEVMAP_BUS_SIZE * sys_i2c_id)];
+        for (byte_idx = 0; SYS_I2C_DEVMAP_BUS_SIZE > byte_idx; ++byte_idx) {
+            known_map[sys_i2c_id][byte_idx / 4] |= ((uint32_t)bus_addr[byte_idx] << (8 * (byte_idx % 4)));
+        }
+    }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_devmap_load()
+
+bool sys_i2c_devmap_save(const struct SYS_I2C_DEVMAP_STORE * store_addr, uint8_t bsp_id)
+{
+    TRACE_ENTER;
+    uint32_t found_map[SYS_I2C_ID_CNT][4];
+    uint8_t rec_buf[SYS_I2C_DEVMAP_RECORD_SIZE];
+    uint8_t old_buf[SYS_I2C_DEVMAP_RECORD_SIZE];
+    char key[SYS_I2C_DEVMAP_KEY_SIZE];
+    size_t read_size = 0;
+    uint8_t sys_i2c_id;
+
+    if (!store_addr || !store_addr->load || !store_addr->save) { goto fail; }
+
+    for (sys_i2c_id = 0; SYS_I2C_ID_CNT > sys_i2c_id; ++sys_i2c_id) {
+        if (!sys_i2c_discover_map(sys_i2c_id, found_map[sys_i2c_id], NULL)) { goto fail; } // discovery not done
+    }
+    sys_i2c_devmap_encode(rec_buf, bsp_id, (const uint32_t (*)[4])found_map);
+
+    // 1A Unchanged: no write. Saves NVS wear on every warm boot.
+    (void)snprintf(key, sizeof(key), SYS_I2C_DEVMAP_KEY_FMT, bsp_id);
+    if (store_addr->load(store_addr->ctx, key, old_buf, sizeof(old_buf), &read_size)
+            && (sizeof(old_buf) == read_size) && !memcmp(old_buf, rec_buf, sizeof(rec_buf))) { goto pass; }
+
+    if (!store_addr->save(store_addr->ctx, key, rec_buf, sizeof(rec_buf))) { goto fail; }
+
+  pass:
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_devmap_save()
+
+bool sys_i2c_devmap_file_load(const void * ctx, const char * key, uint8_t * buf_addr, size_t buf_size, size_t * read_size_addr)
+{
+    TRACE_ENTER;
+    char path[SYS_I2C_DEVMAP_PATH_SIZE];
+    FILE * file = NULL;
+
+    if (!ctx || !key || !buf_addr || !read_size_addr) { goto fail; }
+    if (sizeof(path) <= (size_t)snprintf(path, sizeof(path), "%s/%s.bin", (const char *)ctx, key)) { goto fail; }
+    if (!(file = fopen(path, "rb"))) { goto fail; }
+    *read_size_addr = fread(buf_addr, 1, buf_size, file);
+    if (ferror(file)) { goto fail; }
+    (void)fclose(file);
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    if (file) { (void)fclose(file); }
+    return (false);
+} // end: sys_i2c_devmap_file_load()
+
+bool sys_i2c_devmap_file_save(const void * ctx, const char * key, const uint8_t * buf_addr, size_t buf_size)
+{
+    TRACE_ENTER;
+    char path[SYS_I2C_DEVMAP_PATH_SIZE];
+    FILE * file = NULL;
+
+    if (!ctx || !key || !buf_addr) { goto fail; }
+    if (sizeof(path) <= (size_t)snprintf(path, sizeof(path), "%s/%s.bin", (const char *)ctx, key)) { goto fail; }
+    if (!(file = fopen(path, "wb"))) { goto fail; }
+    if (buf_size != fwrite(buf_addr, 1, buf_size, file)) { goto fail; }
+    if (0 != fclose(file)) { file = NULL; goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    if (file) { (void)fclose(file); }
+    return (false);
+} // end: sys_i2c_devmap_file_save()
+
+// @brief Words to record bytes, header and CRC.
+//
+static void sys_i2c_devmap_encode(uint8_t * rec_addr, uint8_t bsp_id, const uint32_t found_map[SYS_I2C_ID_CNT][4])
+{
+    uint8_t sys_i2c_id;
+    uint8_t byte_idx;
+
+    rec_addr[0] = SYS_I2C_DEVMAP_MAGIC_0;
+    rec_addr[1] = SYS_I2C_DEVMAP_MAGIC_1;
+    rec_addr[2] = SYS_I2C_DEVMAP_VERSION;
+    rec_addr[3] = bsp_id;
+    rec_addr[4] = SYS_I2C_ID_CNT;
+    for (sys_i2c_id = 0; SYS_I2C_ID_CNT > sys_i2c_id; ++sys_i2c_id) {
+        uint8_t * const bus_addr = &rec_addr[SYS_I2C_DEVMAP_HEAD_SIZE + (SYS_I2C_DEVMAP_BUS_SIZE * sys_i2c_id)];
+        for (byte_idx = 0; SYS_I2C_DEVMAP_BUS_SIZE > byte_idx; ++byte_idx) {
+            bus_addr[byte_idx] = (uint8_t)(found_map[sys_i2c_id][byte_idx / 4] >> (8 * (byte_idx % 4)));
+        }
+    }
+    rec_addr[SYS_I2C_DEVMAP_RECORD_SIZE - 1] = sys_i2c_smbus_pec(0, rec_addr, SYS_I2C_DEVMAP_RECORD_SIZE - 1);
+} // end: sys_i2c_devmap_encode()
+
+#ifdef ESP_PLATFORM
+static bool sys_i2c_devmap_nvs_load(const void * ctx, const char * key, uint8_t * buf_addr, size_t buf_size, size_t * read_size_addr)
+{
+    TRACE_ENTER;
+    nvs_handle_t nvs = 0;
+    bool open_flag = false;
+
+    if (!ctx || !key || !buf_addr || !read_size_addr) { goto fail; }
+    if (ESP_OK != nvs_open((const char *)ctx, NVS_READONLY, &nvs)) { goto fail; } // first boot: namespace not found
+    open_flag = true;
+    *read_size_addr = buf_size;
+    if (ESP_OK != nvs_get_blob(nvs, key, buf_addr, read_size_addr)) { goto fail; } // too small: ESP_ERR_NVS_INVALID_LENGTH
+    nvs_close(nvs);
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    if (open_flag) { nvs_close(nvs); }
+    return (false);
+} // end: sys_i2c_devmap_nvs_load()
+
+static bool sys_i2c_devmap_nvs_save(const void * ctx, const char * key, const uint8_t * buf_addr, size_t buf_size)
+{
+    TRACE_ENTER;
+    nvs_handle_t nvs = 0;
+    bool open_flag = false;
+
+    if (!ctx || !key || !buf_addr) { goto fail; }
+    if (ESP_OK != nvs_open((const char *)ctx, NVS_READWRITE, &nvs)) { goto fail; }
+    open_flag = true;
+    if (ESP_OK != nvs_set_blob(nvs, key, buf_addr, buf_size)) { goto fail; }
+    if (ESP_OK != nvs_commit(nvs)) { goto fail; }
+    nvs_close(nvs);
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    if (open_flag) { nvs_close(nvs); }
+    return (false);
+} // end: sys_i2c_devmap_nvs_save()
+#endif // ESP_PLATFORM
+
+/* EOF sys_i2c_devmap.c */
@@ -0,0 +1,288 @@
+// @file    sys_i2c_discover.c
+//
+// @brief  SYS_I2C background device discovery, one task per active ESP32_I2C_FSM port_num.
+//
+// @details
+// - Each task scans, in sys_i2c_id order, only the I2C Buses mapped to its port_num, then deletes itself.
+// - Known map, from sys_i2c_discover_start_known(): probe the known addresses only. One missing: full scan of that bus.
+// - Per-bus ready flag set after its address map is complete: release store, acquire load.
+// - Last task out sets SYS_I2C_DISCOVER_DONE_BIT in the event group.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+static const char * TAG = "sys_i2c_discover";
+#include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
+#include "sys_i2c_discover.h" // includes app_config.h, sys_i2c.h
+
+#include <stdio.h> // printf(), snprintf()
+#include <string.h> // memcpy(), memset()
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+
+#define SYS_I2C_DISCOVER_TASK_NAME      "sys_i2c_disc%d"
+#define SYS_I2C_DISCOVER_TASK_STACK     (2048U)
+#define SYS_I2C_DISCOVER_TASK_PRIORITY  (tskIDLE_PRIORITY + 1) // Background: the application runs first
+#define SYS_I2C_DISCOVER_DONE_BIT       (1U << 0)
+
+// GLOBAL RAM
+//
+static struct {
+    EventGroupHandle_t  event;
+    uint32_t            task_cnt;                       // discovery tasks still running
+    bool                partial_flag;                   // a task was not created: its buses never get ready
+    uint32_t            found_map[SYS_I2C_ID_CNT][4];   // 128 addresses, bit per address
+    uint32_t            known_map[SYS_I2C_ID_CNT][4];   // sys_i2c_discover_start_known() copy
+    bool                known_flag;                     // verify known_map before any full scan
+    bool                full_scan[SYS_I2C_ID_CNT];      // bus needed the full address sweep
+    bool                ready[SYS_I2C_ID_CNT];
+} sys_i2c_discover;
+
+static bool sys_i2c_discover_launch(void);
+static bool sys_i2c_discover_verify(uint8_t sys_i2c_id);
+static void sys_i2c_discover_scan(uint8_t sys_i2c_id);
+
+static void sys_i2c_discover_task(void * arg);
+
+bool sys_i2c_discover_start(void)
+{
+    TRACE_ENTER;
+    sys_i2c_discover.known_flag = false;
+    if (!sys_i2c_discover_launch()) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_discover_start()
+
+bool sys_i2c_discover_start_known(const uint32_t known_map[SYS_I2C_ID_CNT][4])
+{
+    TRACE_ENTER;
+    if (!known_map) { goto fail; }
+
+    memcpy(sys_i2c_discover.known_map, known_map, sizeof(sys_i2c_discover.known_map));
+    sys_i2c_discover.known_flag = true;
+    if (!sys_i2c_discover_launch()) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_discover_start_known()
+
+
+bool sys_i2c_discover_wait(TickType_t ticks_to_wait)
+{
+    TRACE_ENTER;
+    if (!sys_i2c_discover.event) { goto fail; }
+    if (!(SYS_I2C_DISCOVER_DONE_BIT & xEventGroupWaitBits(sys_i2c_discover.event, SYS_I2C_DISCOVER_DONE_BIT,
+                                                          pdFALSE, pdTRUE, ticks_to_wait))) { goto fail; }
+    if (sys_i2c_discover.partial_flag) { goto fail; } // done, but not every I2C Bus; see sys_i2c_discover_ready()
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_discover_wait()
+
+bool sys_i2c_discover_ready(uint8_t sys_i2c_id)
+{
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { return (false); }
+    return (__atomic_load_n(&sys_i2c_discover.ready[sys_i2c_id], __ATOMIC_ACQUIRE));
+} // end: sys_i2c_discover_ready()
+
+bool sys_i2c_discover_found(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool * found_flag_addr)
+{
+    TRACE_ENTER;
+    if (!(SYS_I2C_ADDR_INVALID > i2c_addr_num)) { goto fail; }
+    if (!found_flag_addr) { goto fail; }
+    if (!sys_i2c_discover_ready(sys_i2c_id)) { goto fail; }
+
+    *found_flag_addr = (0 != (sys_i2c_discover.found_map[sys_i2c_id][i2c_addr_num / 32] & (1UL << (i2c_addr_num % 32))));
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_discover_found()
+
+bool sys_i2c_discover_map(uint8_t sys_i2c_id, uint32_t found_map[4], bool * full_scan_flag_addr)
+{
+    TRACE_ENTER;
+    if (!found_map) { goto fail; }
+    if (!sys_i2c_discover_ready(sys_i2c_id)) { goto fail; }
+
+    memcpy(found_map, sys_i2c_discover.found_map[sys_i2c_id], sizeof(sys_i2c_discover.found_map[sys_i2c_id]));
+    if (full_scan_flag_addr) { *full_scan_flag_addr = sys_i2c_discover.full_scan[sys_i2c_id]; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_discover_map()
+
+bool sys_i2c_discover_print(void)
+{
+    TRACE_ENTER;
+    uint8_t sys_i2c_id;
+    uint8_t i2c_addr_num;
+    bool found_flag;
+    uint found_cnt = 0;
+
+    printf("\nI2C DISCOVERY: :: %d :: I2C Buses [SYS_I2C_ID_CNT]\n", SYS_I2C_ID_CNT);
+    for (sys_i2c_id = 0; SYS_I2C_ID_CNT > sys_i2c_id; ++sys_i2c_id) {
+        printf("\nI2C Bus sys_i2c_id = %d\n", sys_i2c_id);
+        printf("sda_io_num = %d, scl_io_num = %d, i2c_port_num = %d\n", SYS_I2C_runtime.unit[sys_i2c_id].sda_io_num,
+               SYS_I2C_runtime.unit[sys_i2c_id].scl_io_num, SYS_I2C_runtime.unit[sys_i2c_id].port_num);
+        if (!sys_i2c_discover_ready(sys_i2c_id)) {
+            printf("...discovery not done\n");
+            continue;
+        }
+        printf("     0  1  2  3  4  5  6  7  8  9  a  b  c  d  e  f");
+        for (i2c_addr_num = 0; SYS_I2C_ADDR_INVALID > i2c_addr_num; ++i2c_addr_num) {
+            if (i2c_addr_num % 16 == 0) { printf("\n%.2x:", i2c_addr_num); }
+            if ((SYS_I2C_DISCOVER_ADDR_MIN > i2c_addr_num) || (SYS_I2C_DISCOVER_ADDR_MAX < i2c_addr_num)) {
+                printf("   "); // not probed
+                continue;
+            }
+            if (!sys_i2c_discover_found(sys_i2c_id, i2c_addr_num, &found_flag)) { goto fail; }
+            if (found_flag) {
+                printf(" %.2x", i2c_addr_num);
+                found_cnt++;
+            } else {
+                printf(" --");
+            }
+        }
+        printf("\n");
+    }
+    printf("\nEND I2C DISCOVERY: :: %d :: devices\n\n", found_cnt);
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_discover_print()
+
+// @brief Event group, then one task per active port_num.
+// A task not created: taken off task_cnt, so the last one running still sets DONE and waiters return. None created:
+// event group deleted, launch can be retried.
+//
+static bool sys_i2c_discover_launch(void)
+{
+    TRACE_ENTER;
+    bool port_used[I2C_NUM_MAX] = { false };
+    char task_name[configMAX_TASK_NAME_LEN];
+    uint32_t launch_cnt = 0;
+    uint32_t left_cnt = 0; // counted, not created yet
+    uint8_t sys_i2c_id;
+    i2c_port_t port_num;
+
+    if (sys_i2c_discover.event) { goto fail; } // once
+    if (!(sys_i2c_discover.event = xEventGroupCreate())) { goto fail; }
+
+    for (sys_i2c_id = 0; SYS_I2C_ID_CNT > sys_i2c_id; ++sys_i2c_id) {
+        port_used[SYS_I2C_runtime.unit[sys_i2c_id].port_num] = true;
+    }
+    for (port_num = 0; I2C_NUM_MAX > port_num; ++port_num) {
+        if (port_used[port_num]) { launch_cnt++; }
+    }
+    sys_i2c_discover.partial_flag = false;
+    __atomic_store_n(&sys_i2c_discover.task_cnt, launch_cnt, __ATOMIC_RELEASE); // all counted before any task can finish
+    left_cnt = launch_cnt;
+    for (port_num = 0; I2C_NUM_MAX > port_num; ++port_num) {
+        if (!port_used[port_num]) { continue; }
+        (void)snprintf(task_name, sizeof(task_name), SYS_I2C_DISCOVER_TASK_NAME, port_num);
+        if (pdPASS != xTaskCreate(sys_i2c_discover_task, task_name, SYS_I2C_DISCOVER_TASK_STACK,
+                                  (void *)(intptr_t)port_num, SYS_I2C_DISCOVER_TASK_PRIORITY, NULL)) { goto fail; }
+        left_cnt--;
+    }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    if (left_cnt && (launch_cnt == left_cnt)) { // nothing running: undo, retry allowed
+        __atomic_store_n(&sys_i2c_discover.task_cnt, 0, __ATOMIC_RELEASE);
+        vEventGroupDelete(sys_i2c_discover.event);
+        sys_i2c_discover.event = NULL;
+    } else if (left_cnt) {
+        sys_i2c_discover.partial_flag = true;
+        if (0 == __atomic_sub_fetch(&sys_i2c_discover.task_cnt, left_cnt, __ATOMIC_ACQ_REL)) { // the others all done
+            (void)xEventGroupSetBits(sys_i2c_discover.event, SYS_I2C_DISCOVER_DONE_BIT);
+        }
+    }
+    return (false);
+} // end: sys_i2c_discover_launch()
+
+// @brief Scan every I2C Bus on one port_num. arg: port_num.
+//
+static void sys_i2c_discover_task(void * arg)
+{
+    const i2c_port_t port_num = (i2c_port_t)(intptr_t)arg;
+    uint8_t sys_i2c_id;
+
+    for (sys_i2c_id = 0; SYS_I2C_ID_CNT > sys_i2c_id; ++sys_i2c_id) {
+        if (port_num != SYS_I2C_runtime.unit[sys_i2c_id].port_num) { continue; }
+
+        if (!sys_i2c_discover.known_flag || !sys_i2c_discover_verify(sys_i2c_id)) {
+            sys_i2c_discover.full_scan[sys_i2c_id] = true;
+            sys_i2c_discover_scan(sys_i2c_id);
+        }
+        __atomic_store_n(&sys_i2c_discover.ready[sys_i2c_id], true, __ATOMIC_RELEASE);
+    }
+
+    if (0 == __atomic_sub_fetch(&sys_i2c_discover.task_cnt, 1, __ATOMIC_ACQ_REL)) {
+        (void)xEventGroupSetBits(sys_i2c_discover.event, SYS_I2C_DISCOVER_DONE_BIT);
+    }
+    vTaskDelete(NULL);
+} // end: sys_i2c_discover_task()
+
+// @brief Targeted probes of the known addresses only. Any one missing: false, caller falls back to a full scan.
+// An empty known map is never trusted.
+//
+static bool sys_i2c_discover_verify(uint8_t sys_i2c_id)
+{
+    TRACE_ENTER;
+    const uint32_t * const known_map = sys_i2c_discover.known_map[sys_i2c_id];
+    uint8_t i2c_addr_num;
+    bool found_flag;
+    uint found_cnt = 0;
+
+    for (i2c_addr_num = SYS_I2C_DISCOVER_ADDR_MIN; SYS_I2C_DISCOVER_ADDR_MAX >= i2c_addr_num; ++i2c_addr_num) {
+        if (!(known_map[i2c_addr_num / 32] & (1UL << (i2c_addr_num % 32)))) { continue; }
+        if (!sys_i2c_probe(sys_i2c_id, i2c_addr_num, &found_flag)) { goto fail; }
+        if (!found_flag) { goto fail; }
+        found_cnt++;
+    }
+    if (!found_cnt) { goto fail; }
+    memcpy(sys_i2c_discover.found_map[sys_i2c_id], known_map, sizeof(sys_i2c_discover.found_map[sys_i2c_id]));
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_discover_verify()
+
+// @brief Full address sweep of one I2C Bus.
+//
+static void sys_i2c_discover_scan(uint8_t sys_i2c_id)
+{
+    uint8_t i2c_addr_num;
+    bool found_flag;
+
+    memset(sys_i2c_discover.found_map[sys_i2c_id], 0, sizeof(sys_i2c_discover.found_map[sys_i2c_id]));
+    for (i2c_addr_num = SYS_I2C_DISCOVER_ADDR_MIN; SYS_I2C_DISCOVER_ADDR_MAX >= i2c_addr_num; ++i2c_addr_num) {
+        if (!sys_i2c_probe(sys_i2c_id, i2c_addr_num, &found_flag)) { found_flag = false; } // bus fault: nothing found
+        if (found_flag) { sys_i2c_discover.found_map[sys_i2c_id][i2c_addr_num / 32] |= (1UL << (i2c_addr_num % 32)); }
+    }
+} // end: sys_i2c_discover_scan()
+
+/* EOF sys_i2c_discover.c */
@@ -0,0 +1,362 @@
+// @file    sys_i2c_hotplug.c
+//
+// @brief  SYS_I2C hot-plug monitor, one idle priority task per active ESP32_I2C_FSM port_num.
+//
+// @details
+// - Watch set: 128-bit address map per I2C Bus, registered devices plus the discovery map at start.
+// - Presence state per watched address, written only by the monitor task of its port_num. The portMUX guards the
+//   watch set, the device table and the counters; probes and init hooks run outside it.
+// - Probe: sys_i2c_port_try_take(), sys_i2c_probe_locked(), give. Lock busy: a tick later, SYS_I2C_HOTPLUG_BUSY_TRY
+//   times, then the address waits for the next period with its state unchanged.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+static const char * TAG = "sys_i2c_hotplug";
+#include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
+#include "sys_i2c_hotplug.h" // includes app_config.h, sys_i2c.h
+#include "sys_i2c_discover.h" // sys_i2c_discover_map(), SYS_I2C_DISCOVER_ADDR_MIN
+#include "sys_i2c_priv.h" // sys_i2c_port_try_take(), sys_i2c_port_give()
+
+#include <stdio.h> // printf(), snprintf()
+#include <string.h> // memset()
+#include "esp_timer.h" // esp_timer_get_time()
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#define SYS_I2C_HOTPLUG_TASK_NAME       "sys_i2c_hp%d"
+#define SYS_I2C_HOTPLUG_TASK_STACK      (3072U) // init hooks run here
+#define SYS_I2C_HOTPLUG_TASK_PRIORITY   (tskIDLE_PRIORITY) // Lowest: every application task runs first
+#define SYS_I2C_HOTPLUG_BUSY_TRY        (4U) // port lock tries per probe, one tick apart
+#define SYS_I2C_HOTPLUG_PERIOD_MIN      (10U) // ms
+
+enum SYS_I2C_HOTPLUG_STATE {
+    SYS_I2C_HOTPLUG_UNKNOWN,    // not probed yet: the first result is recorded, no event
+    SYS_I2C_HOTPLUG_ABSENT,
+    SYS_I2C_HOTPLUG_PRESENT,    // answering, init hook passed or none
+    SYS_I2C_HOTPLUG_INIT_WAIT,  // answering, init hook failed; run again next period
+};
+
+struct SYS_I2C_HOTPLUG_DEV {
+    uint8_t                 sys_i2c_id;
+    uint8_t                 i2c_addr_num;
+    sys_i2c_hotplug_init_t  init_fn;
+    void *                  arg;
+};
+
+// GLOBAL RAM
+//
+static struct {
+    struct SYS_I2C_HOTPLUG_DEV      dev[SYS_I2C_HOTPLUG_DEV_MAX];
+    uint8_t                         dev_cnt;
+    uint32_t                        watch_map[SYS_I2C_ID_CNT][4];   // bit per address, same layout as discovery
+    uint8_t                         state[SYS_I2C_ID_CNT][SYS_I2C_ADDR_INVALID];
+    uint8_t                         miss_cnt[SYS_I2C_ID_CNT][SYS_I2C_ADDR_INVALID];
+    QueueHandle_t                   event_queue;
+    uint32_t                        period_ms;
+    struct SYS_I2C_HOTPLUG_STATS    stats;
+} sys_i2c_hotplug = { .period_ms = SYS_I2C_HOTPLUG_PERIOD_MS };
+static portMUX_TYPE sys_i2c_hotplug_mux = portMUX_INITIALIZER_UNLOCKED;
+
+#define SYS_I2C_HOTPLUG_BIT(map, i2c_addr_num)  ((map)[(i2c_addr_num) / 32] & (1UL << ((i2c_addr_num) % 32)))
+
+static bool sys_i2c_hotplug_probe(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool * ack_flag_addr);
+static void sys_i2c_hotplug_update(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool ack_flag);
+static void sys_i2c_hotplug_event(enum SYS_I2C_HOTPLUG_TYPE type, uint8_t sys_i2c_id, uint8_t i2c_addr_num);
+static void sys_i2c_hotplug_task(void * arg);
+
+bool sys_i2c_hotplug_watch(uint8_t sys_i2c_id, uint8_t i2c_addr_num, sys_i2c_hotplug_init_t init_fn, void * arg)
+{
+    TRACE_ENTER;
+    uint8_t dev_idx;
+
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    if ((SYS_I2C_DISCOVER_ADDR_MIN > i2c_addr_num) || (SYS_I2C_DISCOVER_ADDR_MAX < i2c_addr_num)) { goto fail; }
+
+    portENTER_CRITICAL(&sys_i2c_hotplug_mux);
+    for (dev_idx = 0; sys_i2c_hotplug.dev_cnt > dev_idx; ++dev_idx) {
+        if ((sys_i2c_id == sys_i2c_hotplug.dev[dev_idx].sys_i2c_id) && (i2c_addr_num == sys_i2c_hotplug.dev[dev_idx].i2c_addr_num)) { break; }
+    }
+    if (SYS_I2C_HOTPLUG_DEV_MAX > dev_idx) {
+        sys_i2c_hotplug.dev[dev_idx] = (struct SYS_I2C_HOTPLUG_DEV) { .sys_i2c_id = sys_i2c_id, .i2c_addr_num = i2c_addr_num,
+                                                                      .init_fn = init_fn, .arg = arg };
+        if (sys_i2c_hotplug.dev_cnt == dev_idx) { sys_i2c_hotplug.dev_cnt++; }
+        sys_i2c_hotplug.watch_map[sys_i2c_id][i2c_addr_num / 32] |= (1UL << (i2c_addr_num % 32));
+    }
+    portEXIT_CRITICAL(&sys_i2c_hotplug_mux);
+    if (!(SYS_I2C_HOTPLUG_DEV_MAX > dev_idx)) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_hotplug_watch()
+
+// @brief Discovery map of the ready buses into the watch set, as present; their registered devices not in it, as
+// absent: a later ACK is a real attach. Buses not discovered start unknown.
+//
+bool sys_i2c_hotplug_start(void)
+{
+    TRACE_ENTER;
+    bool port_used[I2C_NUM_MAX] = { false };
+    char task_name[configMAX_TASK_NAME_LEN];
+    uint32_t found_map[4];
+    uint8_t sys_i2c_id;
+    uint8_t i2c_addr_num;
+    uint8_t word_idx;
+    i2c_port_t port_num;
+
+    if (sys_i2c_hotplug.event_queue) { goto fail; } // once
+    if (!(sys_i2c_hotplug.event_queue = xQueueCreate(SYS_I2C_HOTPLUG_QUEUE_LEN, sizeof(struct SYS_I2C_HOTPLUG_EVENT)))) { goto fail; }
+
+    for (sys_i2c_id = 0; SYS_I2C_ID_CNT > sys_i2c_id; ++sys_i2c_id) {
+        port_used[SYS_I2C_runtime.unit[sys_i2c_id].port_num] = true;
+        if (!sys_i2c_discover_ready(sys_i2c_id)) { continue; }
+        if (!sys_i2c_discover_map(sys_i2c_id, found_map, NULL)) { continue; }
+
+        portENTER_CRITICAL(&sys_i2c_hotplug_mux);
+        for (word_idx = 0; 4 > word_idx; ++word_idx) { sys_i2c_hotplug.watch_map[sys_i2c_id][word_idx] |= found_map[word_idx]; }
+        for (i2c_addr_num = SYS_I2C_DISCOVER_ADDR_MIN; SYS_I2C_DISCOVER_ADDR_MAX >= i2c_addr_num; ++i2c_addr_num) {
+            if (!SYS_I2C_HOTPLUG_BIT(sys_i2c_hotplug.watch_map[sys_i2c_id], i2c_addr_num)) { continue; }
+            sys_i2c_hotplug.state[sys_i2c_id][i2c_addr_num] = (SYS_I2C_HOTPLUG_BIT(found_map, i2c_addr_num))
+                                                              ? SYS_I2C_HOTPLUG_PRESENT : SYS_I2C_HOTPLUG_ABSENT;
+        }
+        portEXIT_CRITICAL(&sys_i2c_hotplug_mux);
+    }
+    memset(&sys_i2c_hotplug.stats, 0, sizeof(sys_i2c_hotplug.stats));
+
+    for (port_num = 0; I2C_NUM_MAX > port_num; ++port_num) {
+        if (!port_used[port_num]) { continue; }
+        (void)snprintf(task_name, sizeof(task_name), SYS_I2C_HOTPLUG_TASK_NAME, port_num);
+        if (pdPASS != xTaskCreate(sys_i2c_hotplug_task, task_name, SYS_I2C_HOTPLUG_TASK_STACK,
+                                  (void *)(intptr_t)port_num, SYS_I2C_HOTPLUG_TASK_PRIORITY, NULL)) { goto fail; }
+    }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_hotplug_start()
+
+bool sys_i2c_hotplug_event_get(struct SYS_I2C_HOTPLUG_EVENT * event_addr, TickType_t ticks_to_wait)
+{
+    TRACE_ENTER;
+    if (!event_addr) { goto fail; }
+    if (!sys_i2c_hotplug.event_queue) { goto fail; }
+    if (pdTRUE != xQueueReceive(sys_i2c_hotplug.event_queue, event_addr, ticks_to_wait)) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_hotplug_event_get()
+
+bool sys_i2c_hotplug_present(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool * present_flag_addr)
+{
+    TRACE_ENTER;
+    bool watch_flag;
+
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    if (!(SYS_I2C_ADDR_INVALID > i2c_addr_num)) { goto fail; }
+    if (!present_flag_addr) { goto fail; }
+
+    portENTER_CRITICAL(&sys_i2c_hotplug_mux);
+    watch_flag = (0 != SYS_I2C_HOTPLUG_BIT(sys_i2c_hotplug.watch_map[sys_i2c_id], i2c_addr_num));
+    *present_flag_addr = (SYS_I2C_HOTPLUG_PRESENT == sys_i2c_hotplug.state[sys_i2c_id][i2c_addr_num]);
+    portEXIT_CRITICAL(&sys_i2c_hotplug_mux);
+    if (!watch_flag) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_hotplug_present()
+
+bool sys_i2c_hotplug_period_set(uint32_t period_ms)
+{
+    TRACE_ENTER;
+    if ((SYS_I2C_HOTPLUG_PERIOD_MIN > period_ms) || (SYS_I2C_HOTPLUG_PERIOD_MAX < period_ms)) { goto fail; }
+    __atomic_store_n(&sys_i2c_hotplug.period_ms, period_ms, __ATOMIC_RELAXED);
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_hotplug_period_set()
+
+bool sys_i2c_hotplug_stats(struct SYS_I2C_HOTPLUG_STATS * stats_addr)
+{
+    TRACE_ENTER;
+    if (!stats_addr) { goto fail; }
+
+    portENTER_CRITICAL(&sys_i2c_hotplug_mux);
+    *stats_addr = sys_i2c_hotplug.stats;
+    portEXIT_CRITICAL(&sys_i2c_hotplug_mux);
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_hotplug_stats()
+
+bool sys_i2c_hotplug_print(void)
+{
+    TRACE_ENTER;
+    static const char state_char[] = { '?', '-', 'P', 'I' }; // enum SYS_I2C_HOTPLUG_STATE
+    struct SYS_I2C_HOTPLUG_STATS stats;
+    uint8_t sys_i2c_id;
+    uint8_t i2c_addr_num;
+
+    if (!sys_i2c_hotplug_stats(&stats)) { goto fail; }
+
+    printf("\nI2C HOT-PLUG: period = %u ms, miss count = %d; P present, - absent, I init failed, ? not probed yet\n",
+           sys_i2c_hotplug.period_ms, SYS_I2C_HOTPLUG_MISS_CNT);
+    for (sys_i2c_id = 0; SYS_I2C_ID_CNT > sys_i2c_id; ++sys_i2c_id) {
+        printf("I2C Bus sys_i2c_id = %d:", sys_i2c_id);
+        for (i2c_addr_num = SYS_I2C_DISCOVER_ADDR_MIN; SYS_I2C_DISCOVER_ADDR_MAX >= i2c_addr_num; ++i2c_addr_num) {
+            if (!SYS_I2C_HOTPLUG_BIT(sys_i2c_hotplug.watch_map[sys_i2c_id], i2c_addr_num)) { continue; }
+            printf(" %.2x%c", i2c_addr_num, state_char[sys_i2c_hotplug.state[sys_i2c_id][i2c_addr_num]]);
+        }
+        printf("\n");
+    }
+    printf("periods = %u, probes = %u, busy = %u, attach = %u, detach = %u, init failed = %u, events dropped = %u\n\n",
+           stats.pass_cnt, stats.probe_cnt, stats.busy_cnt, stats.attach_cnt, stats.detach_cnt, stats.init_fail_cnt, stats.drop_cnt);
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_hotplug_print()
+
+// @brief Monitor of one port_num. arg: port_num. Every watched address of its buses once per period.
+//
+static void sys_i2c_hotplug_task(void * arg)
+{
+    const i2c_port_t port_num = (i2c_port_t)(intptr_t)arg;
+    uint8_t sys_i2c_id;
+    uint8_t i2c_addr_num;
+    bool watch_flag;
+    bool ack_flag;
+
+    for (;;) {
+        for (sys_i2c_id = 0; SYS_I2C_ID_CNT > sys_i2c_id; ++sys_i2c_id) {
+            if (port_num != SYS_I2C_runtime.unit[sys_i2c_id].port_num) { continue; }
+
+            for (i2c_addr_num = SYS_I2C_DISCOVER_ADDR_MIN; SYS_I2C_DISCOVER_ADDR_MAX >= i2c_addr_num; ++i2c_addr_num) {
+                portENTER_CRITICAL(&sys_i2c_hotplug_mux);
+                watch_flag = (0 != SYS_I2C_HOTPLUG_BIT(sys_i2c_hotplug.watch_map[sys_i2c_id], i2c_addr_num));
+                portEXIT_CRITICAL(&sys_i2c_hotplug_mux);
+                if (!watch_flag) { continue; }
+
+                if (!sys_i2c_hotplug_probe(sys_i2c_id, i2c_addr_num, &ack_flag)) { continue; } // busy: next period
+                sys_i2c_hotplug_update(sys_i2c_id, i2c_addr_num, ack_flag);
+            }
+        }
+
+        portENTER_CRITICAL(&sys_i2c_hotplug_mux);
+        sys_i2c_hotplug.stats.pass_cnt++;
+        portEXIT_CRITICAL(&sys_i2c_hotplug_mux);
+        vTaskDelay(pdMS_TO_TICKS(__atomic_load_n(&sys_i2c_hotplug.period_ms, __ATOMIC_RELAXED)) + 1); // at least one tick
+    }
+} // end: sys_i2c_hotplug_task()
+
+// @brief One probe, only while the port lock is free. Bus fault: no ACK.
+// @return true: probed, *ack_flag_addr valid; false: port lock busy every try.
+//
+static bool sys_i2c_hotplug_probe(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool * ack_flag_addr)
+{
+    uint8_t try_idx;
+    bool found_flag = false;
+
+    for (try_idx = 0; SYS_I2C_HOTPLUG_BUSY_TRY > try_idx; ++try_idx) {
+        if (try_idx) { vTaskDelay(1); }
+        if (!sys_i2c_port_try_take(sys_i2c_id)) { continue; }
+
+        *ack_flag_addr = (sys_i2c_probe_locked(sys_i2c_id, i2c_addr_num, &found_flag) && found_flag);
+        (void)sys_i2c_port_give(sys_i2c_id);
+
+        portENTER_CRITICAL(&sys_i2c_hotplug_mux);
+        sys_i2c_hotplug.stats.probe_cnt++;
+        portEXIT_CRITICAL(&sys_i2c_hotplug_mux);
+        return (true);
+    }
+
+    portENTER_CRITICAL(&sys_i2c_hotplug_mux);
+    sys_i2c_hotplug.stats.busy_cnt++;
+    portEXIT_CRITICAL(&sys_i2c_hotplug_mux);
+    return (false);
+} // end: sys_i2c_hotplug_probe()
+
+// @brief Presence state machine of one address, see sys_i2c_hotplug.h. The init hook runs here, no lock held.
+//
+static void sys_i2c_hotplug_update(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool ack_flag)
+{
+    uint8_t * const state_addr = &sys_i2c_hotplug.state[sys_i2c_id][i2c_addr_num];
+    uint8_t * const miss_addr  = &sys_i2c_hotplug.miss_cnt[sys_i2c_id][i2c_addr_num];
+    sys_i2c_hotplug_init_t init_fn = NULL;
+    void * init_arg = NULL;
+    uint8_t state = *state_addr;
+    uint8_t dev_idx;
+
+    if (!ack_flag) {
+        if (SYS_I2C_HOTPLUG_UNKNOWN == state) {
+            state = SYS_I2C_HOTPLUG_ABSENT;
+        } else if ((SYS_I2C_HOTPLUG_ABSENT != state) && (SYS_I2C_HOTPLUG_MISS_CNT <= ++(*miss_addr))) {
+            state = SYS_I2C_HOTPLUG_ABSENT;
+            sys_i2c_hotplug_event(SYS_I2C_HOTPLUG_DETACH, sys_i2c_id, i2c_addr_num);
+        }
+    } else {
+        *miss_addr = 0;
+        if (SYS_I2C_HOTPLUG_UNKNOWN == state) {
+            state = SYS_I2C_HOTPLUG_PRESENT; // first pass: record only
+        } else if (SYS_I2C_HOTPLUG_PRESENT != state) {
+            portENTER_CRITICAL(&sys_i2c_hotplug_mux);
+            for (dev_idx = 0; sys_i2c_hotplug.dev_cnt > dev_idx; ++dev_idx) {
+                if ((sys_i2c_id == sys_i2c_hotplug.dev[dev_idx].sys_i2c_id) && (i2c_addr_num == sys_i2c_hotplug.dev[dev_idx].i2c_addr_num)) {
+                    init_fn  = sys_i2c_hotplug.dev[dev_idx].init_fn;
+                    init_arg = sys_i2c_hotplug.dev[dev_idx].arg;
+                    break;
+                }
+            }
+            portEXIT_CRITICAL(&sys_i2c_hotplug_mux);
+
+            if (!init_fn || init_fn(sys_i2c_id, i2c_addr_num, init_arg)) {
+                state = SYS_I2C_HOTPLUG_PRESENT;
+                sys_i2c_hotplug_event(SYS_I2C_HOTPLUG_ATTACH, sys_i2c_id, i2c_addr_num);
+            } else {
+                state = SYS_I2C_HOTPLUG_INIT_WAIT;
+                sys_i2c_hotplug_event(SYS_I2C_HOTPLUG_INIT_FAIL, sys_i2c_id, i2c_addr_num);
+            }
+        }
+    }
+    if (SYS_I2C_HOTPLUG_ABSENT == state) { *miss_addr = 0; }
+
+    portENTER_CRITICAL(&sys_i2c_hotplug_mux);
+    *state_addr = state;
+    portEXIT_CRITICAL(&sys_i2c_hotplug_mux);
+} // end: sys_i2c_hotplug_update()
+
+// @brief Count and queue one event. Queue full: dropped, counted.
+//
+static void sys_i2c_hotplug_event(enum SYS_I2C_HOTPLUG_TYPE type, uint8_t sys_i2c_id, uint8_t i2c_addr_num)
+{
+    const struct SYS_I2C_HOTPLUG_EVENT event = { .type = type, .sys_i2c_id = sys_i2c_id, .i2c_addr_num = i2c_addr_num,
+                                                 .at_us = esp_timer_get_time() };
+    const bool sent_flag = (pdTRUE == xQueueSend(sys_i2c_hotplug.event_queue, &event, 0));
+
+    portENTER_CRITICAL(&sys_i2c_hotplug_mux);
+    if (SYS_I2C_HOTPLUG_ATTACH == type) { sys_i2c_hotplug.stats.attach_cnt++; }
+    if (SYS_I2C_HOTPLUG_DETACH == type) { sys_i2c_hotplug.stats.detach_cnt++; }
+    if (SYS_I2C_HOTPLUG_INIT_FAIL == type) { sys_i2c_hotplug.stats.init_fail_cnt++; }
+    if (!sent_flag) { sys_i2c_hotplug.stats.drop_cnt++; }
+    portEXIT_CRITICAL(&sys_i2c_hotplug_mux);
+} // end: sys_i2c_hotplug_event()
+
+/* EOF sys_i2c_hotplug.c */
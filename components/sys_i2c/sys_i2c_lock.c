@@ -0,0 +1,229 @@
+// @file    sys_i2c_lock.c
+//
+// @brief  SYS_I2C port lock: counters, spin bound control, contention benchmark.
+//
+// @details
+// The lock itself is sys_i2c_port_take() / sys_i2c_port_give() in sys_i2c.c. Counters and spin_us are written by
+// the lock holder only; reset and spin bound changes here take the lock first. A plain read of the counters may be
+// one take apart between fields, fine for a report.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+static const char * TAG = "sys_i2c_lock";
+#include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
+#include "sys_i2c_lock.h" // includes app_config.h, sys_i2c.h
+#include "sys_i2c_priv.h" // sys_i2c_port_take(), sys_i2c_port_give()
+
+#include <stdio.h> // printf()
+#include <string.h> // memset()
+#include "freertos/task.h"
+#include "esp_timer.h" // esp_timer_get_time()
+#include "esp_rom_sys.h" // esp_rom_delay_us()
+
+#define SYS_I2C_LOCK_BENCH_TASK_NAME        "sys_i2c_lck%d"
+#define SYS_I2C_LOCK_BENCH_TASK_STACK       (2048U)
+#define SYS_I2C_LOCK_BENCH_TASK_PRIORITY    (tskIDLE_PRIORITY + 2)
+
+// GLOBAL RAM
+//
+static struct {
+    uint8_t             sys_i2c_id;
+    uint32_t            hold_us;
+    int64_t             end_us;
+    uint32_t            op_cnt;
+    uint64_t            wait_sum_us;
+    uint32_t            wait_max_us;
+    SemaphoreHandle_t   done_sem;       // one give per worker exit
+} sys_i2c_lock_bench_run;
+static portMUX_TYPE sys_i2c_lock_bench_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool sys_i2c_lock_each(bool reset_flag, const uint16_t * spin_max_us_addr, const uint16_t * spin_us_addr);
+static bool sys_i2c_lock_bench_row(uint8_t task_cnt, uint32_t run_ms, uint16_t spin_max_us);
+static void sys_i2c_lock_bench_task(void * arg);
+
+bool sys_i2c_lock_stats(uint8_t sys_i2c_id, struct SYS_I2C_LOCK_STATS * stats_addr, uint16_t * spin_us_addr)
+{
+    TRACE_ENTER;
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    if (!stats_addr) { goto fail; }
+
+    const struct SYS_I2C_PORT * const port_addr = &SYS_I2C_runtime.port[SYS_I2C_runtime.unit[sys_i2c_id].port_num];
+    if (!port_addr->lock) { goto fail; } // sys_i2c_init_all() not run
+    *stats_addr = port_addr->stats;
+    if (spin_us_addr) { *spin_us_addr = port_addr->spin_us; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_lock_stats()
+
+bool sys_i2c_lock_stats_reset(void)
+{
+    TRACE_ENTER;
+    if (!sys_i2c_lock_each(true, NULL, NULL)) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_lock_stats_reset()
+
+bool sys_i2c_lock_spin_set(uint16_t spin_max_us)
+{
+    TRACE_ENTER;
+    uint16_t spin_us[I2C_NUM_MAX];
+    i2c_port_t port_num;
+
+    for (port_num = 0; I2C_NUM_MAX > port_num; ++port_num) { spin_us[port_num] = spin_max_us; }
+    if (!sys_i2c_lock_each(false, spin_us, spin_us)) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_lock_spin_set()
+
+bool sys_i2c_lock_bench(uint8_t sys_i2c_id, uint8_t task_max, uint32_t run_ms, uint32_t hold_us)
+{
+    TRACE_ENTER;
+    uint16_t spin_max_save[I2C_NUM_MAX];
+    uint16_t spin_save[I2C_NUM_MAX];
+    i2c_port_t port_num;
+    uint8_t task_cnt;
+    bool pass_flag = true;
+
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    if (!task_max || (SYS_I2C_LOCK_BENCH_TASK_MAX < task_max)) { goto fail; }
+    if (!run_ms) { goto fail; }
+
+    // Each port's own spin bound, limit and adaptive value, put back after the rows. Plain reads, see @details.
+    for (port_num = 0; I2C_NUM_MAX > port_num; ++port_num) {
+        spin_max_save[port_num] = SYS_I2C_runtime.port[port_num].spin_max_us;
+        spin_save[port_num]     = SYS_I2C_runtime.port[port_num].spin_us;
+    }
+
+    sys_i2c_lock_bench_run.sys_i2c_id = sys_i2c_id;
+    sys_i2c_lock_bench_run.hold_us    = hold_us;
+    if (!(sys_i2c_lock_bench_run.done_sem = xSemaphoreCreateCounting(SYS_I2C_LOCK_BENCH_TASK_MAX, 0))) { goto fail; }
+
+    printf("\nI2C PORT LOCK BENCH: SYS_I2C Bus = %d, port_num = %d, hold = %u us, %u ms per row, %d core(s)\n",
+           sys_i2c_id, SYS_I2C_runtime.unit[sys_i2c_id].port_num, hold_us, run_ms, portNUM_PROCESSORS);
+    printf("%5s %-6s %9s %9s %9s %8s %8s\n", "tasks", "lock", "takes/s", "wait_avg", "wait_max", "spin", "block");
+    for (task_cnt = 1; pass_flag && (task_max >= task_cnt); ++task_cnt) {
+        pass_flag = sys_i2c_lock_bench_row(task_cnt, run_ms, 0)
+                 && sys_i2c_lock_bench_row(task_cnt, run_ms, SYS_I2C_LOCK_SPIN_MAX_US);
+    }
+    printf("\n");
+
+    vSemaphoreDelete(sys_i2c_lock_bench_run.done_sem);
+    sys_i2c_lock_bench_run.done_sem = NULL;
+    if (!sys_i2c_lock_each(false, spin_max_save, spin_save)) { goto fail; }
+    if (!pass_flag) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_lock_bench()
+
+// @brief Every port_num in use, under its lock: clear the counters, or set the spin bound limit and spin bound.
+// spin_max_us_addr, spin_us_addr: I2C_NUM_MAX entries, indexed by port_num; unused with reset_flag.
+//
+static bool sys_i2c_lock_each(bool reset_flag, const uint16_t * spin_max_us_addr, const uint16_t * spin_us_addr)
+{
+    bool done_flag[I2C_NUM_MAX] = { false };
+    uint8_t sys_i2c_id;
+
+    for (sys_i2c_id = 0; SYS_I2C_ID_CNT > sys_i2c_id; ++sys_i2c_id) {
+        const i2c_port_t port_num = SYS_I2C_runtime.unit[sys_i2c_id].port_num;
+        struct SYS_I2C_PORT * const port_addr = &SYS_I2C_runtime.port[port_num];
+        if (done_flag[port_num]) { continue; }
+        if (!port_addr->lock) { return (false); } // sys_i2c_init_all() not run
+
+        if (!sys_i2c_port_take(sys_i2c_id)) { return (false); }
+        if (reset_flag) {
+            memset(&port_addr->stats, 0, sizeof(port_addr->stats));
+        } else {
+            port_addr->spin_max_us = spin_max_us_addr[port_num];
+            port_addr->spin_us     = spin_us_addr[port_num];
+        }
+        if (!sys_i2c_port_give(sys_i2c_id)) { return (false); }
+        done_flag[port_num] = true;
+    }
+    return (true);
+} // end: sys_i2c_lock_each()
+
+// @brief One benchmark row: task_cnt workers for run_ms with spin bound limit spin_max_us.
+//
+static bool sys_i2c_lock_bench_row(uint8_t task_cnt, uint32_t run_ms, uint16_t spin_max_us)
+{
+    struct SYS_I2C_LOCK_STATS stats;
+    uint8_t task_idx;
+    bool pass_flag = true;
+
+    if (!sys_i2c_lock_spin_set(spin_max_us)) { return (false); }
+    if (!sys_i2c_lock_stats_reset()) { return (false); }
+    sys_i2c_lock_bench_run.op_cnt      = 0;
+    sys_i2c_lock_bench_run.wait_sum_us = 0;
+    sys_i2c_lock_bench_run.wait_max_us = 0;
+    sys_i2c_lock_bench_run.end_us      = esp_timer_get_time() + (1000LL * run_ms);
+
+    for (task_idx = 0; task_cnt > task_idx; ++task_idx) {
+        char task_name[configMAX_TASK_NAME_LEN];
+        (void)snprintf(task_name, sizeof(task_name), SYS_I2C_LOCK_BENCH_TASK_NAME, task_idx);
+        if (pdPASS != xTaskCreatePinnedToCore(sys_i2c_lock_bench_task, task_name, SYS_I2C_LOCK_BENCH_TASK_STACK, NULL,
+                                              SYS_I2C_LOCK_BENCH_TASK_PRIORITY, NULL, task_idx % portNUM_PROCESSORS)) {
+            pass_flag = false;
+            break;
+        }
+    }
+    for (; task_idx; --task_idx) { (void)xSemaphoreTake(sys_i2c_lock_bench_run.done_sem, portMAX_DELAY); }
+    if (!pass_flag) { return (false); }
+    if (!sys_i2c_lock_stats(sys_i2c_lock_bench_run.sys_i2c_id, &stats, NULL)) { return (false); }
+
+    const uint32_t op_cnt = sys_i2c_lock_bench_run.op_cnt;
+    printf("%5d %-6s %9u %9u %9u %8u %8u\n", task_cnt, (spin_max_us) ? "hybrid" : "block",
+           (uint32_t)((1000ULL * op_cnt) / run_ms), (op_cnt) ? (uint32_t)(sys_i2c_lock_bench_run.wait_sum_us / op_cnt) : 0,
+           sys_i2c_lock_bench_run.wait_max_us, stats.spin_cnt, stats.block_cnt);
+    return (true);
+} // end: sys_i2c_lock_bench_row()
+
+// @brief Worker: take, hold hold_us busy, give, until end_us. Wait time measured around the take.
+//
+static void sys_i2c_lock_bench_task(void * arg)
+{
+    const uint8_t sys_i2c_id = sys_i2c_lock_bench_run.sys_i2c_id;
+    uint32_t op_cnt = 0;
+    uint64_t wait_sum_us = 0;
+    uint32_t wait_max_us = 0;
+    int64_t at_us;
+
+    (void)arg;
+    while (sys_i2c_lock_bench_run.end_us > (at_us = esp_timer_get_time())) {
+        if (!sys_i2c_bus_take(sys_i2c_id)) { break; }
+        const uint32_t wait_us = (uint32_t)(esp_timer_get_time() - at_us);
+        esp_rom_delay_us(sys_i2c_lock_bench_run.hold_us);
+        (void)sys_i2c_bus_give(sys_i2c_id);
+
+        op_cnt++;
+        wait_sum_us += wait_us;
+        if (wait_max_us < wait_us) { wait_max_us = wait_us; }
+    }
+
+    portENTER_CRITICAL(&sys_i2c_lock_bench_mux);
+    sys_i2c_lock_bench_run.op_cnt      += op_cnt;
+    sys_i2c_lock_bench_run.wait_sum_us += wait_sum_us;
+    if (sys_i2c_lock_bench_run.wait_max_us < wait_max_us) { sys_i2c_lock_bench_run.wait_max_us = wait_max_us; }
+    portEXIT_CRITICAL(&sys_i2c_lock_bench_mux);
+
+    (void)xSemaphoreGive(sys_i2c_lock_bench_run.done_sem);
+    vTaskDelete(NULL);
+} // end: sys_i2c_lock_bench_task()
+
+/* EOF sys_i2c_lock.c */
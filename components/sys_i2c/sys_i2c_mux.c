@@ -0,0 +1,215 @@
+// @file    sys_i2c_mux.c
+//
+// @brief  SYS_I2C multiplexer channels: mux table, channel-select cache, route on attach.
+//
+// @details
+// One entry per mux, found once at init from the virtual I2C Buses in SYS_I2C_runtime.unit: the pair
+// (mux_parent_id, mux_addr). Virtual buses share the port_num of their physical root, so every route and every
+// cached control register of one mux tree is touched only under that one I2C port lock. The portMUX guards the
+// counters only.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+static const char * TAG = "sys_i2c_mux";
+#include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
+#include "sys_i2c_mux.h" // includes app_config.h, sys_i2c.h
+#include "sys_i2c_priv.h" // sys_i2c_port_take(), sys_i2c_port_give(), ESP32_I2C_* arguments
+
+#include <stdio.h> // printf()
+#include <string.h> // memset()
+
+#define SYS_I2C_MUX_NONE        (0xFFU)     // .mux_idx[]: not a virtual bus
+#define SYS_I2C_MUX_SEL_UNKNOWN (-1)        // .sel_mask: control register not known, write it
+
+struct SYS_I2C_MUX {
+    uint8_t     parent_id;      // I2C Bus the mux sits on
+    uint8_t     mux_addr;
+    int16_t     sel_mask;       // last written control register, or SYS_I2C_MUX_SEL_UNKNOWN
+};
+
+// GLOBAL RAM
+//
+static struct {
+    struct SYS_I2C_MUX          mux[SYS_I2C_ID_CNT];        // at most one mux per virtual bus
+    uint8_t                     mux_cnt;
+    uint8_t                     mux_idx[SYS_I2C_ID_CNT];    // virtual bus: its mux; else SYS_I2C_MUX_NONE
+    bool                        route_flag[SYS_I2C_ID_CNT]; // virtual, or a mux sits on it: route on attach
+    struct SYS_I2C_MUX_STATS    stats;
+} sys_i2c_mux;
+static portMUX_TYPE sys_i2c_mux_stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool sys_i2c_mux_set(uint8_t sys_i2c_id, uint8_t mux_idx, int16_t sel_mask);
+
+bool sys_i2c_mux_stats(struct SYS_I2C_MUX_STATS * stats_addr)
+{
+    TRACE_ENTER;
+    if (!stats_addr) { goto fail; }
+
+    portENTER_CRITICAL(&sys_i2c_mux_stats_mux);
+    *stats_addr = sys_i2c_mux.stats;
+    portEXIT_CRITICAL(&sys_i2c_mux_stats_mux);
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_mux_stats()
+
+bool sys_i2c_mux_invalidate(void)
+{
+    TRACE_ENTER;
+    uint8_t mux_idx;
+
+    for (mux_idx = 0; sys_i2c_mux.mux_cnt > mux_idx; ++mux_idx) {
+        const uint8_t parent_id = sys_i2c_mux.mux[mux_idx].parent_id;
+        if (!sys_i2c_port_take(parent_id)) { goto fail; }
+        sys_i2c_mux.mux[mux_idx].sel_mask = SYS_I2C_MUX_SEL_UNKNOWN;
+        if (!sys_i2c_port_give(parent_id)) { goto fail; }
+    }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_mux_invalidate()
+
+bool sys_i2c_mux_print(void)
+{
+    TRACE_ENTER;
+    struct SYS_I2C_MUX_STATS stats;
+    uint8_t mux_idx;
+    uint8_t sys_i2c_id;
+
+    if (!sys_i2c_mux_stats(&stats)) { goto fail; }
+
+    printf("\nI2C MUX: %d mux(es), selects = %u, skipped = %u, failed = %u\n", sys_i2c_mux.mux_cnt,
+           stats.select_cnt, stats.skip_cnt, stats.fail_cnt);
+    printf("%-6s %-6s %-8s %s\n", "bus", "addr", "channels", "virtual buses (channel)");
+    for (mux_idx = 0; sys_i2c_mux.mux_cnt > mux_idx; ++mux_idx) {
+        const struct SYS_I2C_MUX * const m = &sys_i2c_mux.mux[mux_idx];
+        if (SYS_I2C_MUX_SEL_UNKNOWN == m->sel_mask) {
+            printf("%-6d 0x%02X   %-8s", m->parent_id, m->mux_addr, "?");
+        } else {
+            printf("%-6d 0x%02X   0x%02X    ", m->parent_id, m->mux_addr, (unsigned)m->sel_mask);
+        }
+        for (sys_i2c_id = 0; SYS_I2C_ID_CNT > sys_i2c_id; ++sys_i2c_id) {
+            if (mux_idx == sys_i2c_mux.mux_idx[sys_i2c_id]) { printf(" %d(%d)", sys_i2c_id, SYS_I2C_runtime.unit[sys_i2c_id].mux_channel); }
+        }
+        printf("\n");
+    }
+    printf("\n");
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_mux_print()
+
+// @brief Find the muxes of the virtual I2C Buses. From sys_i2c_runtime_init(), before any lock exists.
+// Every control register starts unknown: the first access writes it.
+//
+bool sys_i2c_mux_init(void)
+{
+    TRACE_ENTER;
+    uint8_t sys_i2c_id;
+    uint8_t mux_idx;
+
+    memset(&sys_i2c_mux, 0, sizeof(sys_i2c_mux));
+    for (sys_i2c_id = 0; SYS_I2C_ID_CNT > sys_i2c_id; ++sys_i2c_id) {
+        const struct SYS_I2C_UNIT * const u = &SYS_I2C_runtime.unit[sys_i2c_id];
+        sys_i2c_mux.mux_idx[sys_i2c_id] = SYS_I2C_MUX_NONE;
+        if (!u->mux_addr) { continue; }
+        if (!(sys_i2c_id > u->mux_parent_id)) { goto fail; } // parent first; also no loops
+        if (!(SYS_I2C_MUX_CHANNEL_CNT > u->mux_channel)) { goto fail; }
+
+        for (mux_idx = 0; sys_i2c_mux.mux_cnt > mux_idx; ++mux_idx) {
+            if ((u->mux_parent_id == sys_i2c_mux.mux[mux_idx].parent_id) && (u->mux_addr == sys_i2c_mux.mux[mux_idx].mux_addr)) { break; }
+        }
+        if (sys_i2c_mux.mux_cnt == mux_idx) {
+            sys_i2c_mux.mux[mux_idx] = (struct SYS_I2C_MUX) { .parent_id = u->mux_parent_id, .mux_addr = u->mux_addr,
+                                                              .sel_mask = SYS_I2C_MUX_SEL_UNKNOWN };
+            sys_i2c_mux.mux_cnt++;
+        }
+        sys_i2c_mux.mux_idx[sys_i2c_id]             = mux_idx;
+        sys_i2c_mux.route_flag[sys_i2c_id]          = true;
+        sys_i2c_mux.route_flag[u->mux_parent_id]    = true; // its muxes close when the parent itself is used
+    }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_mux_init()
+
+// @brief Set every mux from the physical root down to sys_i2c_id, see sys_i2c_mux.h. Caller holds the port lock,
+// pins attached. Writes only control registers that differ from the cache.
+//
+bool sys_i2c_mux_route(uint8_t sys_i2c_id)
+{
+    uint8_t path_id[SYS_I2C_ID_CNT]; // path_id[0] = sys_i2c_id, up to the first virtual bus below the root
+    uint8_t depth = 0;
+    uint8_t bus_id;
+    uint8_t mux_idx;
+
+    if (!sys_i2c_mux.route_flag[sys_i2c_id]) { return (true); }
+
+    for (bus_id = sys_i2c_id; SYS_I2C_MUX_NONE != sys_i2c_mux.mux_idx[bus_id]; bus_id = SYS_I2C_runtime.unit[bus_id].mux_parent_id) {
+        path_id[depth++] = bus_id;
+    }
+
+    // bus_id: the physical root. Walk down; on each bus open the mux toward the target, close the others.
+    for (;;) {
+        const uint8_t next_id  = (depth) ? path_id[depth - 1] : SYS_I2C_MUX_NONE;
+        const uint8_t next_mux = (depth) ? sys_i2c_mux.mux_idx[next_id] : SYS_I2C_MUX_NONE;
+
+        for (mux_idx = 0; sys_i2c_mux.mux_cnt > mux_idx; ++mux_idx) {
+            if (bus_id != sys_i2c_mux.mux[mux_idx].parent_id) { continue; }
+            const int16_t sel_mask = (next_mux == mux_idx) ? (int16_t)BIT(SYS_I2C_runtime.unit[next_id].mux_channel) : 0;
+            if (!sys_i2c_mux_set(bus_id, mux_idx, sel_mask)) { return (false); }
+        }
+        if (!depth) { break; }
+        bus_id = path_id[--depth];
+    }
+    return (true);
+} // end: sys_i2c_mux_route()
+
+// @brief Write one mux control register, unless the cache says it holds sel_mask already.
+// sys_i2c_id: the bus the mux sits on; its pads are attached, same pads as the target.
+//
+static bool sys_i2c_mux_set(uint8_t sys_i2c_id, uint8_t mux_idx, int16_t sel_mask)
+{
+    struct SYS_I2C_MUX * const m = &sys_i2c_mux.mux[mux_idx];
+    i2c_cmd_handle_t i2c_cmd = 0;
+    bool pass_flag = false;
+
+    if (sel_mask == m->sel_mask) {
+        portENTER_CRITICAL(&sys_i2c_mux_stats_mux);
+        sys_i2c_mux.stats.skip_cnt++;
+        portEXIT_CRITICAL(&sys_i2c_mux_stats_mux);
+        return (true);
+    }
+
+    m->sel_mask = SYS_I2C_MUX_SEL_UNKNOWN; // until the write is known good
+    if ((i2c_cmd = i2c_cmd_link_create())) {
+        pass_flag = (ESP_OK == i2c_master_start(i2c_cmd))
+                 && (ESP_OK == i2c_master_write_byte(i2c_cmd, m->mux_addr << 1 | I2C_MASTER_WRITE, ESP32_I2C_ACK_CHECK_EN))
+                 && (ESP_OK == i2c_master_write_byte(i2c_cmd, (uint8_t)sel_mask, ESP32_I2C_ACK_CHECK_EN))
+                 && (ESP_OK == i2c_master_stop(i2c_cmd))
+                 && (ESP_OK == i2c_master_cmd_begin(SYS_I2C_runtime.unit[sys_i2c_id].port_num, i2c_cmd, ESP32_I2C_BUS_TIMEOUT_TICK));
+        i2c_cmd_link_delete(i2c_cmd);
+    }
+    if (pass_flag) { m->sel_mask = sel_mask; }
+
+    portENTER_CRITICAL(&sys_i2c_mux_stats_mux);
+    sys_i2c_mux.stats.select_cnt++;
+    if (!pass_flag) { sys_i2c_mux.stats.fail_cnt++; }
+    portEXIT_CRITICAL(&sys_i2c_mux_stats_mux);
+    return (pass_flag);
+} // end: sys_i2c_mux_set()
+
+/* EOF sys_i2c_mux.c */
@@ -0,0 +1,353 @@
+// @file    sys_i2c_pipe.c
+//
+// @brief  SYS_I2C pipelined transfers: builder in the calling task, one wire task per I2C_FSM port_num.
+//
+// @details
+// Slots, per port_num, pass between two queues of slot indexes; whoever holds an index owns the slot:
+//   free_queue  -> builder: prepare, build the i2c_cmd link  -> ready_queue
+//   ready_queue -> wire: attach if needed, run, result out   -> free_queue
+// Static link, SYS_I2C_STATIC_ENABLE: the program is built into link_buf of the slot prep, no heap on either side.
+// The last slot of a batch on a port_num carries last_flag: the wire task detaches, gives the port lock and done_sem.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+static const char * TAG = "sys_i2c_pipe";
+#include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
+#include "sys_i2c_pipe.h" // includes app_config.h, sys_i2c.h, sys_i2c_vec.h
+#include "sys_i2c_prep.h" // struct SYS_I2C_PREP, sys_i2c_prep_read(), sys_i2c_prep_write()
+#include "sys_i2c_priv.h" // sys_i2c_port_take(), sys_i2c_prep_build(), sys_i2c_prep_run_attached(), hooks
+#include "sys_i2c_capture.h" // SYS_I2C_CAPTURE_OP_READ, SYS_I2C_CAPTURE_OP_WRITE
+
+#include <stdio.h> // printf(), snprintf()
+#include <string.h> // memset()
+#include "esp_timer.h" // esp_timer_get_time()
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+#define SYS_I2C_PIPE_TASK_NAME      "sys_i2c_pipe%d"
+#define SYS_I2C_PIPE_TASK_STACK     (2048U)
+#define SYS_I2C_PIPE_TASK_PRIORITY  (configMAX_PRIORITIES - 3) // Above application tasks, same as sys_i2c_vec
+
+struct SYS_I2C_PIPE_SLOT {
+    struct SYS_I2C_PREP     prep;           // checked transaction, attach i2c_config; link_buf
+    i2c_cmd_handle_t        i2c_cmd;        // built program; 0: check or build failed, not run
+    struct SYS_I2C_VEC_OP * op_addr;        // result out
+    int64_t                 capture_us;
+    bool                    last_flag;      // last operation of the batch on this port_num
+};
+
+struct SYS_I2C_PIPE_PORT {
+    struct SYS_I2C_PIPE_SLOT slot[SYS_I2C_PIPE_DEPTH];
+    QueueHandle_t   free_queue;     // slot indexes the builder may fill; NULL: port_num not used by any I2C Bus
+    QueueHandle_t   ready_queue;    // built slot indexes, list order
+};
+
+// GLOBAL RAM
+//
+static struct {
+    struct SYS_I2C_PIPE_PORT    port[I2C_NUM_MAX];
+    SemaphoreHandle_t           xfer_lock;  // one batch at a time
+    SemaphoreHandle_t           done_sem;   // one give per port_num at batch end
+    struct SYS_I2C_PIPE_STATS   stats;
+} sys_i2c_pipe;
+static portMUX_TYPE sys_i2c_pipe_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void sys_i2c_pipe_build(struct SYS_I2C_PIPE_SLOT * slot_addr, struct SYS_I2C_VEC_OP * op);
+static void sys_i2c_pipe_task(void * arg);
+
+#define SYS_I2C_PIPE_CLK(slot_addr)     ((slot_addr)->prep.i2c_config.master.clk_speed)
+
+bool sys_i2c_pipe_init(void)
+{
+    TRACE_ENTER;
+    char task_name[configMAX_TASK_NAME_LEN];
+    uint8_t sys_i2c_id;
+    uint8_t slot_idx;
+
+    if (!sys_i2c_pipe.xfer_lock) {
+        if (!(sys_i2c_pipe.xfer_lock = xSemaphoreCreateMutex())) { goto fail; }
+        if (!(sys_i2c_pipe.done_sem = xSemaphoreCreateCounting(I2C_NUM_MAX, 0))) { goto fail; }
+    }
+
+    for (sys_i2c_id = 0; SYS_I2C_ID_CNT > sys_i2c_id; ++sys_i2c_id) {
+        const i2c_port_t port_num = SYS_I2C_runtime.unit[sys_i2c_id].port_num;
+        struct SYS_I2C_PIPE_PORT * const port_addr = &sys_i2c_pipe.port[port_num];
+        if (port_addr->free_queue) { continue; } // one wire task per port_num
+
+        if (!(port_addr->ready_queue = xQueueCreate(SYS_I2C_PIPE_DEPTH, sizeof(uint8_t)))) { goto fail; }
+        if (!(port_addr->free_queue = xQueueCreate(SYS_I2C_PIPE_DEPTH, sizeof(uint8_t)))) { goto fail; }
+        for (slot_idx = 0; SYS_I2C_PIPE_DEPTH > slot_idx; ++slot_idx) {
+            (void)xQueueSend(port_addr->free_queue, &slot_idx, 0);
+        }
+        (void)snprintf(task_name, sizeof(task_name), SYS_I2C_PIPE_TASK_NAME, port_num);
+        if (pdPASS != xTaskCreate(sys_i2c_pipe_task, task_name, SYS_I2C_PIPE_TASK_STACK,
+                                  port_addr, SYS_I2C_PIPE_TASK_PRIORITY, NULL)) { goto fail; }
+    }
+    memset(&sys_i2c_pipe.stats, 0, sizeof(sys_i2c_pipe.stats));
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_pipe_init()
+
+// @brief Build every operation in list order into its port_num slots; the wire tasks drain them meanwhile.
+// TASK SAFE: YES
+//
+bool sys_i2c_pipe_xfer(struct SYS_I2C_VEC_OP * op_addr, size_t op_cnt)
+{
+    TRACE_ENTER;
+    size_t last_idx[I2C_NUM_MAX];
+    uint32_t port_cnt = 0;
+    bool pass_flag = true;
+    size_t idx;
+    i2c_port_t port_num;
+    uint8_t slot_idx;
+
+    if (!sys_i2c_pipe.xfer_lock) { goto fail; }
+    if (!op_addr) { goto fail; }
+    if (!op_cnt) { goto fail; }
+
+    // 1A Validate all, before any I2C Bus activity. Last operation per port_num ends its batch there.
+    for (port_num = 0; I2C_NUM_MAX > port_num; ++port_num) { last_idx[port_num] = op_cnt; }
+    for (idx = 0; op_cnt > idx; ++idx) {
+        op_addr[idx].pass_flag = false;
+        if (!(SYS_I2C_ID_CNT > op_addr[idx].sys_i2c_id)) { goto fail; }
+        port_num = SYS_I2C_runtime.unit[op_addr[idx].sys_i2c_id].port_num;
+        if (!sys_i2c_pipe.port[port_num].free_queue) { goto fail; }
+        if (op_cnt == last_idx[port_num]) { port_cnt++; }
+        last_idx[port_num] = idx;
+    }
+
+    // start: one batch at a time, the slots and done_sem are shared
+    (void)xSemaphoreTake(sys_i2c_pipe.xfer_lock, portMAX_DELAY);
+
+    // 2A Build ahead. A full ring blocks here until the wire frees a slot.
+    for (idx = 0; op_cnt > idx; ++idx) {
+        struct SYS_I2C_VEC_OP * const op = &op_addr[idx];
+        port_num = SYS_I2C_runtime.unit[op->sys_i2c_id].port_num;
+        struct SYS_I2C_PIPE_PORT * const port_addr = &sys_i2c_pipe.port[port_num];
+
+        SYS_I2C_WCOMB_HOOK(op->sys_i2c_id, op->i2c_addr_num); // deferred writes to this device go first
+        if (!uxQueueMessagesWaiting(port_addr->free_queue)) {
+            portENTER_CRITICAL(&sys_i2c_pipe_mux);
+            sys_i2c_pipe.stats.full_cnt++;
+            portEXIT_CRITICAL(&sys_i2c_pipe_mux);
+        }
+        (void)xQueueReceive(port_addr->free_queue, &slot_idx, portMAX_DELAY);
+
+        struct SYS_I2C_PIPE_SLOT * const slot_addr = &port_addr->slot[slot_idx];
+        sys_i2c_pipe_build(slot_addr, op);
+        slot_addr->last_flag = (last_idx[port_num] == idx);
+        (void)xQueueSend(port_addr->ready_queue, &slot_idx, portMAX_DELAY);
+    }
+
+    // 3A Wait for every port_num batch end.
+    while (port_cnt--) { (void)xSemaphoreTake(sys_i2c_pipe.done_sem, portMAX_DELAY); }
+    portENTER_CRITICAL(&sys_i2c_pipe_mux);
+    sys_i2c_pipe.stats.batch_cnt++;
+    portEXIT_CRITICAL(&sys_i2c_pipe_mux);
+
+    (void)xSemaphoreGive(sys_i2c_pipe.xfer_lock);
+    // end: one batch at a time
+
+    for (idx = 0; op_cnt > idx; ++idx) {
+        if (!op_addr[idx].pass_flag) { pass_flag = false; }
+    }
+    if (!pass_flag) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_pipe_xfer()
+
+bool sys_i2c_pipe_stats(struct SYS_I2C_PIPE_STATS * stats_addr)
+{
+    TRACE_ENTER;
+    if (!stats_addr) { goto fail; }
+
+    portENTER_CRITICAL(&sys_i2c_pipe_mux);
+    *stats_addr = sys_i2c_pipe.stats;
+    portEXIT_CRITICAL(&sys_i2c_pipe_mux);
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_pipe_stats()
+
+bool sys_i2c_pipe_print(void)
+{
+    TRACE_ENTER;
+    struct SYS_I2C_PIPE_STATS stats;
+
+    if (!sys_i2c_pipe_stats(&stats)) { goto fail; }
+
+    printf("\nI2C PIPE: depth = %u, batches = %u, transactions = %u, bus switches = %u\n",
+           SYS_I2C_PIPE_DEPTH, stats.batch_cnt, stats.op_cnt, stats.switch_cnt);
+    printf("bus idle gap: %u measured, avg = %u us, max = %u us\n", stats.gap_cnt,
+           (stats.gap_cnt) ? (stats.gap_sum_us / stats.gap_cnt) : 0, stats.gap_max_us);
+    printf("builder behind (starve) = %u, wire behind (full) = %u\n\n", stats.starve_cnt, stats.full_cnt);
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_pipe_print()
+
+bool sys_i2c_pipe_bench(struct SYS_I2C_VEC_OP * op_addr, size_t op_cnt, uint32_t loop_cnt)
+{
+    TRACE_ENTER;
+    struct SYS_I2C_PIPE_STATS before;
+    struct SYS_I2C_PIPE_STATS after;
+    int64_t vec_us = 0;
+    int64_t pipe_us = 0;
+    int64_t at_us;
+    uint32_t loop_idx;
+
+    if (!op_addr || !op_cnt) { goto fail; }
+    if (!loop_cnt) { goto fail; }
+    if (!sys_i2c_pipe_stats(&before)) { goto fail; }
+
+    // Interleaved, so drift in bus load or clock hits both paths alike.
+    for (loop_idx = 0; loop_cnt > loop_idx; ++loop_idx) {
+        at_us = esp_timer_get_time();
+        if (!sys_i2c_vec_xfer(op_addr, op_cnt)) { goto fail; }
+        vec_us += esp_timer_get_time() - at_us;
+
+        at_us = esp_timer_get_time();
+        if (!sys_i2c_pipe_xfer(op_addr, op_cnt)) { goto fail; }
+        pipe_us += esp_timer_get_time() - at_us;
+    }
+    if (!sys_i2c_pipe_stats(&after)) { goto fail; }
+
+    const uint32_t vec_list_us  = (uint32_t)(vec_us / loop_cnt);
+    const uint32_t pipe_list_us = (uint32_t)(pipe_us / loop_cnt);
+    const uint32_t gap_cnt      = after.gap_cnt - before.gap_cnt;
+    printf("\nI2C PIPE BENCH: %u operations per list, %u lists each, static link = %s\n",
+           (unsigned)op_cnt, loop_cnt, (SYS_I2C_STATIC_ENABLE == true) ? "yes" : "no");
+    printf("%-20s %9u us per list\n", "sys_i2c_vec_xfer()", vec_list_us);
+    printf("%-20s %9u us per list\n", "sys_i2c_pipe_xfer()", pipe_list_us);
+    printf("saved = %d us per list, %d%%; pipelined bus idle gap avg = %u us, starves = %u\n\n",
+           (int)(vec_list_us - pipe_list_us), (vec_list_us) ? (int)((100LL * ((int64_t)vec_list_us - pipe_list_us)) / vec_list_us) : 0,
+           (gap_cnt) ? ((after.gap_sum_us - before.gap_sum_us) / gap_cnt) : 0, after.starve_cnt - before.starve_cnt);
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_pipe_bench()
+
+// @brief Builder side of one slot: the prepare checks and i2c_config, then the program. No port lock.
+// A failure leaves i2c_cmd 0; the slot still goes to the wire, in order, to carry last_flag.
+//
+static void sys_i2c_pipe_build(struct SYS_I2C_PIPE_SLOT * slot_addr, struct SYS_I2C_VEC_OP * op)
+{
+    bool pass_flag;
+
+    slot_addr->op_addr    = op;
+    slot_addr->i2c_cmd    = 0;
+    slot_addr->capture_us = SYS_I2C_CAPTURE_START_US();
+    pass_flag = (SYS_I2C_VEC_WRITE == op->dir) ? sys_i2c_prep_write(&slot_addr->prep, op->sys_i2c_id, op->i2c_addr_num, op->i2c_reg_num, op->buf_addr, op->buf_size)
+                                               : sys_i2c_prep_read(&slot_addr->prep, op->sys_i2c_id, op->i2c_addr_num, op->i2c_reg_num, op->buf_addr, op->buf_size);
+    pass_flag = pass_flag && SYS_I2C_QUOTA_HOOK(op->sys_i2c_id, op->i2c_addr_num, op->buf_size, (SYS_I2C_VEC_WRITE != op->dir));
+    if (pass_flag) { slot_addr->i2c_cmd = sys_i2c_prep_build(&slot_addr->prep); }
+} // end: sys_i2c_pipe_build()
+
+// @brief Wire side, one per port_num. arg: its struct SYS_I2C_PIPE_PORT.
+// Port lock from the first ready slot to last_flag; nothing ready in between: give it, count a starve.
+// Pins stay attached while sys_i2c_id and clk_speed stay the same. A failed transfer leaves the bus detached.
+// Never waits for the builder under the port lock: the builder may need it, SYS_I2C_WCOMB_HOOK() flushes.
+//
+static void sys_i2c_pipe_task(void * arg)
+{
+    struct SYS_I2C_PIPE_PORT * const port_addr = arg;
+    uint8_t lock_id = SYS_I2C_ID_CNT;       // sys_i2c_id the port lock was taken with; SYS_I2C_ID_CNT: not held
+    uint8_t attached_id = SYS_I2C_ID_CNT;
+    uint32_t attached_clk = 0;
+    int64_t end_us = 0;                     // last i2c_master_cmd_begin() done, this batch; 0: none yet
+    uint8_t slot_idx;
+
+    for (;;) {
+        if (pdTRUE != xQueueReceive(port_addr->ready_queue, &slot_idx, (SYS_I2C_ID_CNT != lock_id) ? 0 : portMAX_DELAY)) {
+            // Builder behind, mid batch: do not hold the I2C_FSM idle under the port lock.
+            if (SYS_I2C_ID_CNT != attached_id) { (void)sys_i2c_detach_pins(attached_id); }
+            attached_id = SYS_I2C_ID_CNT;
+            (void)sys_i2c_port_give(lock_id);
+            lock_id = SYS_I2C_ID_CNT;
+            portENTER_CRITICAL(&sys_i2c_pipe_mux);
+            sys_i2c_pipe.stats.starve_cnt++;
+            portEXIT_CRITICAL(&sys_i2c_pipe_mux);
+            continue;
+        }
+        struct SYS_I2C_PIPE_SLOT * const slot_addr = &port_addr->slot[slot_idx];
+        const uint8_t sys_i2c_id = slot_addr->prep.sys_i2c_id;
+        bool pass_flag = (0 != slot_addr->i2c_cmd);
+        bool switch_flag = false;
+        bool gap_flag = false;
+        uint32_t gap_us = 0;
+
+        if (pass_flag && (SYS_I2C_ID_CNT == lock_id)) {
+            if (sys_i2c_port_take(sys_i2c_id)) { lock_id = sys_i2c_id; } else { pass_flag = false; }
+        }
+        if (pass_flag && ((sys_i2c_id != attached_id) || (SYS_I2C_PIPE_CLK(slot_addr) != attached_clk))) {
+            if (SYS_I2C_ID_CNT != attached_id) { (void)sys_i2c_detach_pins(attached_id); }
+            attached_id = SYS_I2C_ID_CNT;
+            pass_flag = sys_i2c_attach_pins_config(sys_i2c_id, &slot_addr->prep.i2c_config);
+            if (pass_flag) {
+                attached_id  = sys_i2c_id;
+                attached_clk = SYS_I2C_PIPE_CLK(slot_addr);
+                switch_flag  = true;
+            }
+        }
+        if (pass_flag) {
+            const int64_t start_us = esp_timer_get_time();
+            if ((gap_flag = (0 != end_us))) { gap_us = (uint32_t)(start_us - end_us); }
+            pass_flag = sys_i2c_prep_run_attached(&slot_addr->prep, slot_addr->i2c_cmd); // frees the link
+            end_us = esp_timer_get_time();
+        } else {
+            sys_i2c_prep_unbuild(slot_addr->i2c_cmd);
+        }
+        slot_addr->i2c_cmd = 0;
+        if (!pass_flag && (SYS_I2C_ID_CNT != attached_id)) {
+            (void)sys_i2c_detach_pins(attached_id);
+            attached_id = SYS_I2C_ID_CNT;
+        }
+
+        portENTER_CRITICAL(&sys_i2c_pipe_mux);
+        sys_i2c_pipe.stats.op_cnt++;
+        if (switch_flag) { sys_i2c_pipe.stats.switch_cnt++; }
+        if (gap_flag) {
+            sys_i2c_pipe.stats.gap_cnt++;
+            sys_i2c_pipe.stats.gap_sum_us += gap_us;
+            if (sys_i2c_pipe.stats.gap_max_us < gap_us) { sys_i2c_pipe.stats.gap_max_us = gap_us; }
+        }
+        portEXIT_CRITICAL(&sys_i2c_pipe_mux);
+
+        struct SYS_I2C_VEC_OP * const op = slot_addr->op_addr; // prep fields are stale if the check failed
+        SYS_I2C_CAPTURE_HOOK((SYS_I2C_VEC_WRITE == op->dir) ? SYS_I2C_CAPTURE_OP_WRITE : SYS_I2C_CAPTURE_OP_READ,
+                             op->sys_i2c_id, op->i2c_addr_num, op->i2c_reg_num, op->buf_size, slot_addr->capture_us, pass_flag);
+        const bool last_flag = slot_addr->last_flag;
+        op->pass_flag = pass_flag;
+        (void)xQueueSend(port_addr->free_queue, &slot_idx, 0); // slot back to the builder, never full
+
+        if (last_flag) {
+            if (SYS_I2C_ID_CNT != attached_id) { (void)sys_i2c_detach_pins(attached_id); }
+            attached_id = SYS_I2C_ID_CNT;
+            if (SYS_I2C_ID_CNT != lock_id) { (void)sys_i2c_port_give(lock_id); }
+            lock_id = SYS_I2C_ID_CNT;
+            end_us = 0;
+            (void)xSemaphoreGive(sys_i2c_pipe.done_sem);
+        }
+    }
+} // end: sys_i2c_pipe_task()
+
+/* EOF sys_i2c_pipe.c */
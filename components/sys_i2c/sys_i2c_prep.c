@@ -0,0 +1,280 @@
+// @file    sys_i2c_prep.c
+//
+// @brief  SYS_I2C prepared transactions: prepare, execute, benchmark.
+//
+// @details
+// Execute follows sys_i2c_read() / sys_i2c_read_locked() step for step: same port lock, same fault, capture and
+// profile hooks, so the stress harness, replay and the phase profiler see prepared calls like any other.
+// What it skips is everything prepare already did.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+static const char * TAG = "sys_i2c_prep";
+#include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
+#include "sys_i2c_prep.h" // includes app_config.h, sys_i2c.h
+#include "sys_i2c_priv.h" // sys_i2c_port_take(), sys_i2c_attach_pins_config(), hooks
+#include "sys_i2c_capture.h" // SYS_I2C_CAPTURE_OP_READ, SYS_I2C_CAPTURE_OP_WRITE
+#include "sys_i2c_profile.h" // SYS_I2C_PROFILE_* phases
+
+#include <stdio.h> // printf()
+#include "esp_timer.h" // esp_timer_get_time()
+
+#define SYS_I2C_PREP_BIT_PER_BYTE   (9U) // 8 data + ACK, profiler wire time
+
+#if (SYS_I2C_STATIC_ENABLE == true)
+#define SYS_I2C_PREP_LINK_CREATE(prep_addr)     i2c_cmd_link_create_static((prep_addr)->link_buf, sizeof((prep_addr)->link_buf))
+#define SYS_I2C_PREP_LINK_DELETE(i2c_cmd)       i2c_cmd_link_delete_static(i2c_cmd)
+#else
+#define SYS_I2C_PREP_LINK_CREATE(prep_addr)     i2c_cmd_link_create()
+#define SYS_I2C_PREP_LINK_DELETE(i2c_cmd)       i2c_cmd_link_delete(i2c_cmd)
+#endif
+
+static bool sys_i2c_prep_shape(struct SYS_I2C_PREP * prep_addr, enum SYS_I2C_PREP_DIR dir, uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size);
+static bool sys_i2c_prep_emit(const struct SYS_I2C_PREP * prep_addr, i2c_cmd_handle_t i2c_cmd);
+
+bool sys_i2c_prep_read(struct SYS_I2C_PREP * prep_addr, uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size)
+{
+    TRACE_ENTER;
+    if (!sys_i2c_prep_shape(prep_addr, SYS_I2C_PREP_READ, sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_addr, buf_size)) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_prep_read()
+
+bool sys_i2c_prep_write(struct SYS_I2C_PREP * prep_addr, uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size)
+{
+    TRACE_ENTER;
+    if (!sys_i2c_prep_shape(prep_addr, SYS_I2C_PREP_WRITE, sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_addr, buf_size)) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_prep_write()
+
+bool sys_i2c_prep_exec(struct SYS_I2C_PREP * prep_addr)
+{
+    TRACE_ENTER;
+    const int64_t capture_us = SYS_I2C_CAPTURE_START_US();
+    SYS_I2C_PROFILE_DECLARE(profile_stamp);
+    bool lock_taken = false;
+
+    if (!prep_addr || !prep_addr->ready_flag) { goto fail; }
+    const uint8_t sys_i2c_id = prep_addr->sys_i2c_id;
+    SYS_I2C_WCOMB_HOOK(sys_i2c_id, prep_addr->i2c_addr_num); // deferred writes to this device go first
+    if (!SYS_I2C_QUOTA_HOOK(sys_i2c_id, prep_addr->i2c_addr_num, prep_addr->buf_size, (SYS_I2C_PREP_READ == prep_addr->dir))) { goto fail; }
+
+    // start: Task Safe, pin swapped prepared transaction
+    if (!sys_i2c_port_take(sys_i2c_id)) { goto fail; }
+    lock_taken = true;
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_LOCK_TAKE, profile_stamp);
+
+    if (!sys_i2c_prep_exec_locked(prep_addr)) { goto fail; }
+
+    lock_taken = false;
+    SYS_I2C_PROFILE_RESTART(profile_stamp);
+    if (!sys_i2c_port_give(sys_i2c_id)) { goto fail; }
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_LOCK_GIVE, profile_stamp);
+    // end: Task Safe
+
+    TRACE_PASS;
+    SYS_I2C_CAPTURE_HOOK((SYS_I2C_PREP_READ == prep_addr->dir) ? SYS_I2C_CAPTURE_OP_READ : SYS_I2C_CAPTURE_OP_WRITE,
+                         sys_i2c_id, prep_addr->i2c_addr_num, prep_addr->i2c_reg_num, prep_addr->buf_size, capture_us, true);
+    return (true);
+  fail:
+    TRACE_FAIL;
+    if (lock_taken) { (void)sys_i2c_port_give(prep_addr->sys_i2c_id); }
+    if (prep_addr && prep_addr->ready_flag) {
+        SYS_I2C_CAPTURE_HOOK((SYS_I2C_PREP_READ == prep_addr->dir) ? SYS_I2C_CAPTURE_OP_READ : SYS_I2C_CAPTURE_OP_WRITE,
+                             prep_addr->sys_i2c_id, prep_addr->i2c_addr_num, prep_addr->i2c_reg_num, prep_addr->buf_size, capture_us, false);
+    }
+    return (false);
+} // end: sys_i2c_prep_exec()
+
+bool sys_i2c_prep_exec_locked(struct SYS_I2C_PREP * prep_addr)
+{
+    TRACE_ENTER;
+    if (!prep_addr || !prep_addr->ready_flag) { goto fail; }
+    const uint8_t sys_i2c_id = prep_addr->sys_i2c_id;
+    SYS_I2C_PROFILE_DECLARE(profile_stamp);
+
+    if (!sys_i2c_attach_pins_config(sys_i2c_id, &prep_addr->i2c_config)) { goto fail; }
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_ATTACH, profile_stamp);
+
+    if (!sys_i2c_prep_exec_attached(prep_addr)) { goto fail; }
+
+    SYS_I2C_PROFILE_RESTART(profile_stamp);
+    if (!sys_i2c_detach_pins(sys_i2c_id)) { goto fail; }
+    SYS_I2C_PROFILE_LAP(sys_i2c_id, SYS_I2C_PROFILE_DETACH, profile_stamp);
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    if (prep_addr && prep_addr->ready_flag) { (void)sys_i2c_detach_pins(prep_addr->sys_i2c_id); }
+    return (false);
+} // end: sys_i2c_prep_exec_locked()
+
+// @brief Build and run the program only. Caller holds the port lock, pins attached with prep_addr->i2c_config.
+//
+bool sys_i2c_prep_exec_attached(struct SYS_I2C_PREP * prep_addr)
+{
+    TRACE_ENTER;
+    i2c_cmd_handle_t i2c_cmd;
+
+    if (!(i2c_cmd = sys_i2c_prep_build(prep_addr))) { goto fail; }
+    if (!sys_i2c_prep_run_attached(prep_addr, i2c_cmd)) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_prep_exec_attached()
+
+// @brief Create the link, emit the program. No port lock needed: touches only prep_addr and its link_buf.
+//
+i2c_cmd_handle_t sys_i2c_prep_build(struct SYS_I2C_PREP * prep_addr)
+{
+    i2c_cmd_handle_t i2c_cmd = 0;
+
+    if (!prep_addr || !prep_addr->ready_flag) { return (0); }
+    SYS_I2C_PROFILE_DECLARE(profile_stamp);
+
+    if (ESP_OK != SYS_I2C_FAULT_HOOK(prep_addr->sys_i2c_id, SYS_I2C_FAULT_POINT_ALLOC, ESP_OK)) { return (0); }
+    if (!(i2c_cmd = SYS_I2C_PREP_LINK_CREATE(prep_addr))) { return (0); }
+    if (!sys_i2c_prep_emit(prep_addr, i2c_cmd)) {
+        SYS_I2C_PREP_LINK_DELETE(i2c_cmd);
+        return (0);
+    }
+    SYS_I2C_PROFILE_LAP(prep_addr->sys_i2c_id, SYS_I2C_PROFILE_BUILD, profile_stamp);
+    return (i2c_cmd);
+} // end: sys_i2c_prep_build()
+
+// @brief Free a link from sys_i2c_prep_build() that will not run.
+//
+void sys_i2c_prep_unbuild(i2c_cmd_handle_t i2c_cmd)
+{
+    if (i2c_cmd) { SYS_I2C_PREP_LINK_DELETE(i2c_cmd); }
+} // end: sys_i2c_prep_unbuild()
+
+// @brief Run a link from sys_i2c_prep_build(), then free it, pass or fail. Caller holds the port lock, pins attached.
+//
+bool sys_i2c_prep_run_attached(struct SYS_I2C_PREP * prep_addr, i2c_cmd_handle_t i2c_cmd)
+{
+    TRACE_ENTER;
+    if (!i2c_cmd) { goto fail; }
+    if (!prep_addr || !prep_addr->ready_flag) { goto fail; }
+    SYS_I2C_PROFILE_DECLARE(profile_stamp);
+
+    if (ESP_OK != SYS_I2C_FAULT_HOOK(prep_addr->sys_i2c_id, SYS_I2C_FAULT_POINT_EXEC, i2c_master_cmd_begin(prep_addr->port_num, i2c_cmd, ESP32_I2C_BUS_TIMEOUT_TICK))) { goto fail; }
+    SYS_I2C_PROFILE_LAP(prep_addr->sys_i2c_id, SYS_I2C_PROFILE_EXEC, profile_stamp);
+    SYS_I2C_PREP_LINK_DELETE(i2c_cmd);
+    i2c_cmd = 0;
+    SYS_I2C_PROFILE_LAP(prep_addr->sys_i2c_id, SYS_I2C_PROFILE_BUILD, profile_stamp); // link free charged to build
+    SYS_I2C_PROFILE_WIRE(prep_addr->sys_i2c_id, prep_addr->i2c_addr_num, (SYS_I2C_PREP_READ == prep_addr->dir)
+                         ? (((prep_addr->buf_size + 3) * SYS_I2C_PREP_BIT_PER_BYTE) + 3)   // START, RESTART, STOP bits
+                         : (((prep_addr->buf_size + 2) * SYS_I2C_PREP_BIT_PER_BYTE) + 2)); // START, STOP bits
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    sys_i2c_prep_unbuild(i2c_cmd);
+    return (false);
+} // end: sys_i2c_prep_run_attached()
+
+bool sys_i2c_prep_bench(struct SYS_I2C_PREP * prep_addr, uint32_t loop_cnt)
+{
+    TRACE_ENTER;
+    int64_t plain_us = 0;
+    int64_t prep_us = 0;
+    int64_t at_us;
+    uint32_t loop_idx;
+
+    if (!prep_addr || !prep_addr->ready_flag) { goto fail; }
+    if (!loop_cnt) { goto fail; }
+
+    // Interleaved, so drift in bus load or clock hits both paths alike.
+    for (loop_idx = 0; loop_cnt > loop_idx; ++loop_idx) {
+        at_us = esp_timer_get_time();
+        if (SYS_I2C_PREP_READ == prep_addr->dir) {
+            if (!sys_i2c_read(prep_addr->sys_i2c_id, prep_addr->i2c_addr_num, prep_addr->i2c_reg_num, prep_addr->buf_addr, prep_addr->buf_size)) { goto fail; }
+        } else {
+            if (!sys_i2c_write(prep_addr->sys_i2c_id, prep_addr->i2c_addr_num, prep_addr->i2c_reg_num, prep_addr->buf_addr, prep_addr->buf_size)) { goto fail; }
+        }
+        plain_us += esp_timer_get_time() - at_us;
+
+        at_us = esp_timer_get_time();
+        if (!sys_i2c_prep_exec(prep_addr)) { goto fail; }
+        prep_us += esp_timer_get_time() - at_us;
+    }
+
+    const uint32_t plain_ns = (uint32_t)((1000LL * plain_us) / loop_cnt);
+    const uint32_t prep_ns  = (uint32_t)((1000LL * prep_us) / loop_cnt);
+    printf("\nI2C PREP BENCH: SYS_I2C Bus = %d, i2c_addr = 0x%02X, reg = 0x%02X, %s %u bytes, %u calls each, static link = %s\n",
+           prep_addr->sys_i2c_id, prep_addr->i2c_addr_num, prep_addr->i2c_reg_num, (SYS_I2C_PREP_READ == prep_addr->dir) ? "read" : "write",
+           (unsigned)prep_addr->buf_size, loop_cnt, (SYS_I2C_STATIC_ENABLE == true) ? "yes" : "no");
+    printf("%-18s %9u ns per call\n", (SYS_I2C_PREP_READ == prep_addr->dir) ? "sys_i2c_read()" : "sys_i2c_write()", plain_ns);
+    printf("%-18s %9u ns per call\n", "sys_i2c_prep_exec()", prep_ns);
+    printf("saved = %d ns per call, %d%%\n\n", (int)(plain_ns - prep_ns), (plain_ns) ? (int)((100LL * ((int64_t)plain_ns - prep_ns)) / plain_ns) : 0);
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_prep_bench()
+
+// @brief The checks of sys_i2c_read_locked() / sys_i2c_write_locked(), once; keep what execute needs.
+//
+static bool sys_i2c_prep_shape(struct SYS_I2C_PREP * prep_addr, enum SYS_I2C_PREP_DIR dir, uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size)
+{
+    if (!prep_addr) { return (false); }
+    prep_addr->ready_flag = false;
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { return (false); }
+    if (!(SYS_I2C_ADDR_INVALID > i2c_addr_num)) { return (false); }
+    // no check on i2c_reg_num needed 0x0 - 0xFF allowed
+    if (!buf_addr) { return (false); }
+    if (!buf_size) { return (false); }
+    if (!SYS_I2C_runtime.port[SYS_I2C_runtime.unit[sys_i2c_id].port_num].lock) { return (false); } // sys_i2c_init_all() not run
+    if (!sys_i2c_attach_config(sys_i2c_id, i2c_addr_num, &prep_addr->i2c_config)) { return (false); }
+
+    prep_addr->dir          = dir;
+    prep_addr->sys_i2c_id   = sys_i2c_id;
+    prep_addr->i2c_addr_num = i2c_addr_num;
+    prep_addr->i2c_reg_num  = i2c_reg_num;
+    prep_addr->addr_w_byte  = (uint8_t)(i2c_addr_num << 1 | I2C_MASTER_WRITE);
+    prep_addr->addr_r_byte  = (uint8_t)(i2c_addr_num << 1 | I2C_MASTER_READ);
+    prep_addr->buf_addr     = buf_addr;
+    prep_addr->buf_size     = buf_size;
+    prep_addr->port_num     = SYS_I2C_runtime.unit[sys_i2c_id].port_num;
+    prep_addr->ready_flag   = true;
+    return (true);
+} // end: sys_i2c_prep_shape()
+
+// @brief Emit the i2c_cmd program of a prepared shape. Same command sequence as sys_i2c_read_locked() / sys_i2c_write_locked().
+//
+static bool sys_i2c_prep_emit(const struct SYS_I2C_PREP * prep_addr, i2c_cmd_handle_t i2c_cmd)
+{
+    if (ESP_OK != i2c_master_start(i2c_cmd)) { return (false); }
+    if (ESP_OK != i2c_master_write_byte(i2c_cmd, prep_addr->addr_w_byte, ESP32_I2C_ACK_CHECK_EN)) { return (false); }
+    if (ESP_OK != i2c_master_write_byte(i2c_cmd, prep_addr->i2c_reg_num, ESP32_I2C_ACK_CHECK_EN)) { return (false); }
+    if (SYS_I2C_PREP_READ == prep_addr->dir) {
+        if (ESP_OK != i2c_master_start(i2c_cmd)) { return (false); }
+        if (ESP_OK != i2c_master_write_byte(i2c_cmd, prep_addr->addr_r_byte, ESP32_I2C_ACK_CHECK_EN)) { return (false); }
+        if (prep_addr->buf_size > 1) { if (ESP_OK != i2c_master_read(i2c_cmd, prep_addr->buf_addr, (prep_addr->buf_size - 1), ESP32_I2C_ACK_VAL)) { return (false); } }
+        if (ESP_OK != i2c_master_read_byte(i2c_cmd, (prep_addr->buf_addr + prep_addr->buf_size - 1), ESP32_I2C_NACK_VAL)) { return (false); }
+    } else {
+        if (ESP_OK != i2c_master_write(i2c_cmd, prep_addr->buf_addr, prep_addr->buf_size, ESP32_I2C_ACK_CHECK_EN)) { return (false); }
+    }
+    if (ESP_OK != i2c_master_stop(i2c_cmd)) { return (false); }
+    return (true);
+} // end: sys_i2c_prep_emit()
+
+/* EOF sys_i2c_prep.c */
@@ -0,0 +1,139 @@
+// @file    sys_i2c_priv.h
+//
+// @brief  SYS_I2C component internal API. NOT for application code; sys_i2c component sources only.
+//
+// @details
+// Every public sys_i2c_read(), sys_i2c_write(), sys_i2c_probe() is:
+//   sys_i2c_port_take()  -> sys_i2c_*_locked() -> sys_i2c_port_give()
+//
+// Add-on modules that must hold one I2C port lock across more than one step use the same pieces.
+// Example, request coalescing: take the lock, freeze the merged register range, then read it.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+#pragma once
+#include "app_config.h" // SYS_I2C_ID_CNT; includes sys_i2c.h
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// i2c_master_*() ack arguments
+#define ESP32_I2C_ACK_CHECK_EN  1
+#define ESP32_I2C_ACK_VAL       0
+#define ESP32_I2C_NACK_VAL      1
+
+// i2c_master_cmd_begin() timeout of normal transfers
+#define ESP32_I2C_BUS_TIMEOUT_TICK      (pdMS_TO_TICKS(1000U)) // 1000ms timeout delay for normal I2C read/write
+
+// Fault injection points, driven by sys_i2c_stress.c. Kconfig SYS_I2C_FAULT_INJECT off: the hook is the esp_err argument.
+#define SYS_I2C_FAULT_POINT_ALLOC   (0U) // before i2c_cmd_link_create(); non-ESP_OK: allocation failed
+#define SYS_I2C_FAULT_POINT_EXEC    (1U) // around i2c_master_cmd_begin(); may delay, may replace the result
+#if (SYS_I2C_FAULT_INJECT_ENABLE == true)
+esp_err_t sys_i2c_fault_hook(uint8_t sys_i2c_id, uint8_t fault_point, esp_err_t esp_err);
+#define SYS_I2C_FAULT_HOOK(sys_i2c_id, fault_point, esp_err)   sys_i2c_fault_hook((sys_i2c_id), (fault_point), (esp_err))
+#else
+#define SYS_I2C_FAULT_HOOK(sys_i2c_id, fault_point, esp_err)   (esp_err)
+#endif
+
+// Workload capture hook, driven by sys_i2c_capture.c. Kconfig SYS_I2C_CAPTURE off: no clock read, no call.
+#if (SYS_I2C_CAPTURE_ENABLE == true)
+#include "esp_timer.h" // esp_timer_get_time()
+void sys_i2c_capture_hook(uint8_t op, uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, size_t buf_size, int64_t start_us, bool pass_flag);
+#define SYS_I2C_CAPTURE_START_US()  esp_timer_get_time()
+#define SYS_I2C_CAPTURE_HOOK(op, sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_size, start_us, pass_flag) \
+        sys_i2c_capture_hook((op), (sys_i2c_id), (i2c_addr_num), (i2c_reg_num), (buf_size), (start_us), (pass_flag))
+#else
+#define SYS_I2C_CAPTURE_START_US()  (0)
+#define SYS_I2C_CAPTURE_HOOK(op, sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_size, start_us, pass_flag) ((void)(start_us))
+#endif
+
+// Hot-path phase profiler, driven by sys_i2c_profile.c. Kconfig SYS_I2C_PROFILE off: no stamp, no call.
+// SYS_I2C_PROFILE_DECLARE() opens a stamp; each SYS_I2C_PROFILE_LAP() charges the cycles since the last stamp to a phase.
+#if (SYS_I2C_PROFILE_ENABLE == true)
+#include "hal/cpu_hal.h" // cpu_hal_get_cycle_count()
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h" // xPortGetCoreID()
+struct SYS_I2C_PROFILE_STAMP {
+    uint32_t    cycle;
+    BaseType_t  core_id; // cycle counters are per core; a lap across cores is dropped
+};
+void sys_i2c_profile_lap(uint8_t sys_i2c_id, uint8_t phase, struct SYS_I2C_PROFILE_STAMP * stamp_addr);
+void sys_i2c_profile_wire(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint32_t bit_cnt);
+#define SYS_I2C_PROFILE_DECLARE(stamp)  struct SYS_I2C_PROFILE_STAMP stamp = { cpu_hal_get_cycle_count(), xPortGetCoreID() }
+#define SYS_I2C_PROFILE_RESTART(stamp)  do { (stamp).cycle = cpu_hal_get_cycle_count(); (stamp).core_id = xPortGetCoreID(); } while (0)
+#define SYS_I2C_PROFILE_LAP(sys_i2c_id, phase, stamp)           sys_i2c_profile_lap((sys_i2c_id), (phase), &(stamp))
+#define SYS_I2C_PROFILE_WIRE(sys_i2c_id, i2c_addr_num, bit_cnt) sys_i2c_profile_wire((sys_i2c_id), (i2c_addr_num), (bit_cnt))
+#else
+#define SYS_I2C_PROFILE_DECLARE(stamp)
+#define SYS_I2C_PROFILE_RESTART(stamp)                          ((void)0)
+#define SYS_I2C_PROFILE_LAP(sys_i2c_id, phase, stamp)           ((void)0)
+#define SYS_I2C_PROFILE_WIRE(sys_i2c_id, i2c_addr_num, bit_cnt) ((void)0)
+#endif
+
+// Write-combining access flush, driven by sys_i2c_wcomb.c. Kconfig SYS_I2C_WCOMB off: no call.
+// Before the port lock: the flush takes it itself.
+#if (SYS_I2C_WCOMB_ENABLE == true)
+void sys_i2c_wcomb_hook(uint8_t sys_i2c_id, uint8_t i2c_addr_num);
+#define SYS_I2C_WCOMB_HOOK(sys_i2c_id, i2c_addr_num)    sys_i2c_wcomb_hook((sys_i2c_id), (i2c_addr_num))
+#else
+#define SYS_I2C_WCOMB_HOOK(sys_i2c_id, i2c_addr_num)    ((void)0)
+#endif
+
+// Bandwidth quota admission, driven by sys_i2c_quota.c. Kconfig SYS_I2C_QUOTA off: always admitted, no call.
+// Before the port lock: a deferred caller sleeps holding nothing. false: rejected, the call fails.
+#if (SYS_I2C_QUOTA_ENABLE == true)
+bool sys_i2c_quota_hook(uint8_t sys_i2c_id, uint8_t i2c_addr_num, size_t buf_size, bool read_flag);
+#define SYS_I2C_QUOTA_HOOK(sys_i2c_id, i2c_addr_num, buf_size, read_flag) \
+    sys_i2c_quota_hook((sys_i2c_id), (i2c_addr_num), (buf_size), (read_flag))
+#else
+#define SYS_I2C_QUOTA_HOOK(sys_i2c_id, i2c_addr_num, buf_size, read_flag)  (true)
+#endif
+
+// I2C port lock of the ESP32_I2C_FSM mapped to sys_i2c_id. sys_i2c_id pre-validated by caller.
+bool sys_i2c_port_take(uint8_t sys_i2c_id);
+bool sys_i2c_port_give(uint8_t sys_i2c_id);
+// Non-blocking take: false at once when held, for background probes. Give with sys_i2c_port_give().
+bool sys_i2c_port_try_take(uint8_t sys_i2c_id);
+
+// Route the I2C Bus SCL/SDA pads to its port_num I2C_FSM, and back to GPIO. Caller holds the port lock.
+// Attach sets the clk_speed of i2c_addr_num: its clock profile, else the port clk_speed. See sys_i2c_clock.h.
+// For add-on modules that compose their own i2c_cmd programs.
+bool sys_i2c_attach_pins(uint8_t sys_i2c_id, uint8_t i2c_addr_num);
+bool sys_i2c_detach_pins(uint8_t sys_i2c_id);
+
+// Clock source of one transaction at clk_speed, sys_i2c_clock.c: I2C_SCLK_SRC_FLAG_AWARE_DFS, REF_TICK, or
+// I2C_SCLK_SRC_FLAG_FOR_NOMAL, APB. From the port clk_flags policy, clk_speed and SYS_I2C_PM_ENABLE; see sys_i2c.h.
+uint32_t sys_i2c_clock_source(uint8_t sys_i2c_id, uint32_t clk_speed);
+
+// sys_i2c_attach_pins() in two steps, for add-on modules that build the i2c_config once and attach it many times.
+// A kept i2c_config holds the clk_speed of its build; sys_i2c_clock_set() changes later do not reach it.
+bool sys_i2c_attach_config(uint8_t sys_i2c_id, uint8_t i2c_addr_num, i2c_config_t * i2c_config_addr);
+bool sys_i2c_attach_pins_config(uint8_t sys_i2c_id, const i2c_config_t * i2c_config_addr);
+
+// sys_i2c_prep_exec_locked() without attach and detach, sys_i2c_prep.c. For add-on modules that run several
+// prepared transactions on one attach: caller holds the port lock, pins attached with prep_addr->i2c_config.
+struct SYS_I2C_PREP;
+bool sys_i2c_prep_exec_attached(struct SYS_I2C_PREP * prep_addr);
+
+// sys_i2c_prep_exec_attached() in two steps, for add-on modules that build the next program while the I2C_FSM runs
+// the one before. Build: no port lock, 0 on failure. Run: as exec_attached; frees the link, pass or fail.
+// Unbuild: free a built link that will not run. Static link: one built link per prep_addr at a time.
+i2c_cmd_handle_t sys_i2c_prep_build(struct SYS_I2C_PREP * prep_addr);
+bool sys_i2c_prep_run_attached(struct SYS_I2C_PREP * prep_addr, i2c_cmd_handle_t i2c_cmd);
+void sys_i2c_prep_unbuild(i2c_cmd_handle_t i2c_cmd);
+
+// I2C multiplexer channel-select cache, sys_i2c_mux.c. Init: from sys_i2c_runtime_init(). Route: from attach,
+// caller holds the port lock; opens the channels to sys_i2c_id, closes the others on the way, skips what is set.
+bool sys_i2c_mux_init(void);
+bool sys_i2c_mux_route(uint8_t sys_i2c_id);
+
+// Public operation bodies sys_i2c_read_locked(), sys_i2c_write_locked(), sys_i2c_probe_locked(): attach pins,
+// execute, detach pins. Caller holds the port lock. Declared in sys_i2c.h, for sys_i2c_bus_take() holders.
+
+#ifdef __cplusplus
+}
+#endif
+/* EOF sys_i2c_priv.h */
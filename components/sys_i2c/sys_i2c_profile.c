@@ -0,0 +1,168 @@
+// @file    sys_i2c_profile.c
+//
+// @brief  SYS_I2C hot-path phase profiler: lap accumulation, snapshot, report.
+//
+// @details
+// Laps of the buses of one port_num mostly run under that port lock, but LOCK_GIVE runs after it; one portMUX
+// for all buses keeps the 64-bit sums whole. The section is a few adds, nothing blocks inside.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+static const char * TAG = "sys_i2c_profile";
+#include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
+#include "sys_i2c_profile.h" // includes app_config.h, sys_i2c.h
+#include "sys_i2c_priv.h" // sys_i2c_profile_lap() prototype, struct SYS_I2C_PROFILE_STAMP
+#include "sys_i2c_clock.h" // sys_i2c_clock_get(), wire time
+
+#include <stdio.h> // printf()
+#include <string.h> // memset()
+#include "esp_rom_sys.h" // esp_rom_get_cpu_ticks_per_us()
+
+static const char * const sys_i2c_profile_name[SYS_I2C_PROFILE_PHASE_CNT] = {
+    [SYS_I2C_PROFILE_LOCK_TAKE] = "lock take",
+    [SYS_I2C_PROFILE_ATTACH]    = "attach",
+    [SYS_I2C_PROFILE_BUILD]     = "cmd build",
+    [SYS_I2C_PROFILE_EXEC]      = "execute",
+    [SYS_I2C_PROFILE_DETACH]    = "detach",
+    [SYS_I2C_PROFILE_LOCK_GIVE] = "lock give",
+};
+
+// GLOBAL RAM
+//
+static struct SYS_I2C_PROFILE_BUS sys_i2c_profile[SYS_I2C_ID_CNT];
+static portMUX_TYPE sys_i2c_profile_mux = portMUX_INITIALIZER_UNLOCKED;
+
+#if (SYS_I2C_PROFILE_ENABLE == true)
+static void sys_i2c_profile_add(struct SYS_I2C_PROFILE_STAT * stat_addr, uint32_t cycle);
+#endif
+static uint32_t sys_i2c_profile_ns(uint64_t cycle);
+
+bool sys_i2c_profile_reset(void)
+{
+    TRACE_ENTER;
+    if (SYS_I2C_PROFILE_ENABLE != true) { goto fail; } // stamps compiled out
+
+    portENTER_CRITICAL(&sys_i2c_profile_mux);
+    memset(sys_i2c_profile, 0, sizeof(sys_i2c_profile));
+    portEXIT_CRITICAL(&sys_i2c_profile_mux);
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_profile_reset()
+
+bool sys_i2c_profile_get(uint8_t sys_i2c_id, struct SYS_I2C_PROFILE_BUS * bus_addr)
+{
+    TRACE_ENTER;
+    if (SYS_I2C_PROFILE_ENABLE != true) { goto fail; }
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    if (!bus_addr) { goto fail; }
+
+    portENTER_CRITICAL(&sys_i2c_profile_mux);
+    *bus_addr = sys_i2c_profile[sys_i2c_id];
+    portEXIT_CRITICAL(&sys_i2c_profile_mux);
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_profile_get()
+
+bool sys_i2c_profile_print(void)
+{
+    TRACE_ENTER;
+    struct SYS_I2C_PROFILE_BUS bus;
+    uint8_t sys_i2c_id;
+    uint8_t phase;
+
+    if (SYS_I2C_PROFILE_ENABLE != true) { goto fail; }
+
+    printf("\nI2C PROFILE: CPU %u MHz\n", (unsigned)esp_rom_get_cpu_ticks_per_us());
+    for (sys_i2c_id = 0; SYS_I2C_ID_CNT > sys_i2c_id; ++sys_i2c_id) {
+        if (!sys_i2c_profile_get(sys_i2c_id, &bus)) { goto fail; }
+        if (!bus.phase[SYS_I2C_PROFILE_EXEC].cnt) { continue; }
+
+        // Total: the sum of the phase averages, one typical call.
+        uint64_t total_cycle = 0;
+        for (phase = 0; SYS_I2C_PROFILE_PHASE_CNT > phase; ++phase) {
+            if (bus.phase[phase].cnt) { total_cycle += bus.phase[phase].sum_cycle / bus.phase[phase].cnt; }
+        }
+        if (!total_cycle) { total_cycle = 1; }
+        const uint64_t wire_cycle = (bus.wire.cnt) ? (bus.wire.sum_cycle / bus.wire.cnt) : 0;
+
+        printf("\nSYS_I2C Bus = %d, migrated laps dropped = %u\n", sys_i2c_id, bus.migrate_cnt);
+        printf("%-10s %8s %9s %9s %5s\n", "phase", "count", "avg_ns", "max_ns", "%");
+        for (phase = 0; SYS_I2C_PROFILE_PHASE_CNT > phase; ++phase) {
+            const struct SYS_I2C_PROFILE_STAT * const p = &bus.phase[phase];
+            const uint64_t avg_cycle = (p->cnt) ? (p->sum_cycle / p->cnt) : 0;
+            printf("%-10s %8u %9u %9u %5u\n", sys_i2c_profile_name[phase], p->cnt, sys_i2c_profile_ns(avg_cycle),
+                   sys_i2c_profile_ns(p->max_cycle), (unsigned)((avg_cycle * 100) / total_cycle));
+        }
+        printf("%-10s %8s %9u\n", "total", "", sys_i2c_profile_ns(total_cycle));
+        printf("%-10s %8u %9u %9s %5u\n", "wire", bus.wire.cnt, sys_i2c_profile_ns(wire_cycle), "",
+               (unsigned)((wire_cycle * 100) / total_cycle));
+        const uint64_t exec_cycle = bus.phase[SYS_I2C_PROFILE_EXEC].sum_cycle / bus.phase[SYS_I2C_PROFILE_EXEC].cnt;
+        const uint64_t over_cycle = (total_cycle > wire_cycle) ? (total_cycle - wire_cycle) : 0;
+        printf("overhead = %u ns per call, %u%% of the total; execute beyond wire = %u ns\n", sys_i2c_profile_ns(over_cycle),
+               (unsigned)((over_cycle * 100) / total_cycle), sys_i2c_profile_ns((exec_cycle > wire_cycle) ? (exec_cycle - wire_cycle) : 0));
+    }
+    printf("\n");
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_profile_print()
+
+#if (SYS_I2C_PROFILE_ENABLE == true)
+// @brief Charge the cycles since *stamp_addr to phase, restart the stamp. Called from sys_i2c.c.
+//
+void sys_i2c_profile_lap(uint8_t sys_i2c_id, uint8_t phase, struct SYS_I2C_PROFILE_STAMP * stamp_addr)
+{
+    const uint32_t cycle = cpu_hal_get_cycle_count();
+    const BaseType_t core_id = xPortGetCoreID();
+
+    portENTER_CRITICAL(&sys_i2c_profile_mux);
+    if (core_id != stamp_addr->core_id) {
+        sys_i2c_profile[sys_i2c_id].migrate_cnt++;
+    } else {
+        sys_i2c_profile_add(&sys_i2c_profile[sys_i2c_id].phase[phase], cycle - stamp_addr->cycle);
+    }
+    portEXIT_CRITICAL(&sys_i2c_profile_mux);
+
+    stamp_addr->cycle   = cpu_hal_get_cycle_count(); // profiler cost not charged to the next phase
+    stamp_addr->core_id = core_id;
+} // end: sys_i2c_profile_lap()
+
+// @brief Add the theoretical wire time of one transaction, bit_cnt at the attached clk_speed.
+//
+void sys_i2c_profile_wire(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint32_t bit_cnt)
+{
+    const uint32_t clk_hz = sys_i2c_clock_get(sys_i2c_id, i2c_addr_num);
+    if (!clk_hz) { return; }
+    const uint32_t cycle = (uint32_t)(((uint64_t)bit_cnt * esp_rom_get_cpu_ticks_per_us() * 1000000ULL) / clk_hz);
+
+    portENTER_CRITICAL(&sys_i2c_profile_mux);
+    sys_i2c_profile_add(&sys_i2c_profile[sys_i2c_id].wire, cycle);
+    portEXIT_CRITICAL(&sys_i2c_profile_mux);
+} // end: sys_i2c_profile_wire()
+
+static void sys_i2c_profile_add(struct SYS_I2C_PROFILE_STAT * stat_addr, uint32_t cycle)
+{
+    stat_addr->cnt++;
+    stat_addr->sum_cycle += cycle;
+    if (stat_addr->max_cycle < cycle) { stat_addr->max_cycle = cycle; }
+} // end: sys_i2c_profile_add()
+#endif // SYS_I2C_PROFILE_ENABLE
+
+static uint32_t sys_i2c_profile_ns(uint64_t cycle)
+{
+    return ((uint32_t)((cycle * 1000) / esp_rom_get_cpu_ticks_per_us()));
+} // end: sys_i2c_profile_ns()
+
+/* EOF sys_i2c_profile.c */
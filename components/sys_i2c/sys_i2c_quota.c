@@ -0,0 +1,303 @@
+// @file    sys_i2c_quota.c
+//
+// @brief  SYS_I2C bandwidth quotas, token bucket admission before the I2C port lock.
+//
+// @details
+// - Tokens kept in unit x 1000000: a refill is rate x elapsed us, no division on the hot path.
+// - One portMUX for the table: refill, check and charge of every matching entry in one section, so two tasks
+//   sharing a device quota cannot both spend the same tokens. Nothing blocks inside; the wait is outside.
+// - No entry anywhere: the hook is one volatile read.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+static const char * TAG = "sys_i2c_quota";
+#include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
+#include "sys_i2c_quota.h" // includes app_config.h, sys_i2c.h
+#include "sys_i2c_priv.h" // sys_i2c_quota_hook() prototype
+#include "sys_i2c_clock.h" // sys_i2c_clock_get(), wire time
+
+#include <stdio.h> // printf()
+#include <string.h> // memset()
+#include "esp_timer.h" // esp_timer_get_time()
+
+#define SYS_I2C_QUOTA_SCALE         (1000000LL) // tokens_x per unit
+#define SYS_I2C_QUOTA_WINDOW_US     (1000000LL) // used_per_s window
+#define SYS_I2C_QUOTA_REFILL_MAX_US (1000000000LL) // elapsed clamp, keeps rate x elapsed in int64_t
+#define SYS_I2C_QUOTA_BIT_PER_BYTE  (9U) // 8 data + ACK, bus time
+
+struct SYS_I2C_QUOTA_ENTRY {
+    struct SYS_I2C_QUOTA_CONFIG config;
+    bool                        in_use;
+    int64_t                     tokens_x;   // unit x SYS_I2C_QUOTA_SCALE; negative: debt
+    int64_t                     refill_us;  // last refill
+    int64_t                     window_us;  // used_window start
+    uint32_t                    used_window;
+    struct SYS_I2C_QUOTA_STATS  stats;
+};
+
+// GLOBAL RAM
+//
+static struct {
+    struct SYS_I2C_QUOTA_ENTRY  entry[SYS_I2C_QUOTA_MAX];
+    volatile uint8_t            entry_cnt;  // in use; 0: hook admits at once
+} sys_i2c_quota;
+static portMUX_TYPE sys_i2c_quota_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void sys_i2c_quota_reset(struct SYS_I2C_QUOTA_ENTRY * entry_addr, int64_t now_us);
+static void sys_i2c_quota_refill(struct SYS_I2C_QUOTA_ENTRY * entry_addr, int64_t now_us);
+
+bool sys_i2c_quota_add(const struct SYS_I2C_QUOTA_CONFIG * config_addr, uint8_t * quota_idx_addr)
+{
+    TRACE_ENTER;
+    uint8_t quota_idx;
+
+    if (SYS_I2C_QUOTA_ENABLE != true) { goto fail; } // hook compiled out
+    if (!config_addr) { goto fail; }
+    if (!(SYS_I2C_ID_CNT >= config_addr->sys_i2c_id)) { goto fail; }
+    if (!(SYS_I2C_ADDR_INVALID >= config_addr->i2c_addr_num)) { goto fail; }
+    if ((SYS_I2C_QUOTA_BYTES != config_addr->unit) && (SYS_I2C_QUOTA_BUS_US != config_addr->unit)) { goto fail; }
+    if ((SYS_I2C_QUOTA_DEFER != config_addr->policy) && (SYS_I2C_QUOTA_REJECT != config_addr->policy)) { goto fail; }
+    if (!config_addr->rate || !config_addr->burst) { goto fail; }
+
+    portENTER_CRITICAL(&sys_i2c_quota_mux);
+    for (quota_idx = 0; SYS_I2C_QUOTA_MAX > quota_idx; ++quota_idx) {
+        if (!sys_i2c_quota.entry[quota_idx].in_use) { break; }
+    }
+    if (SYS_I2C_QUOTA_MAX > quota_idx) {
+        struct SYS_I2C_QUOTA_ENTRY * const entry_addr = &sys_i2c_quota.entry[quota_idx];
+        entry_addr->config = *config_addr;
+        entry_addr->in_use = true;
+        sys_i2c_quota_reset(entry_addr, esp_timer_get_time());
+        sys_i2c_quota.entry_cnt++;
+    }
+    portEXIT_CRITICAL(&sys_i2c_quota_mux);
+    if (!(SYS_I2C_QUOTA_MAX > quota_idx)) { goto fail; }
+    if (quota_idx_addr) { *quota_idx_addr = quota_idx; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_quota_add()
+
+bool sys_i2c_quota_set(uint8_t quota_idx, uint32_t rate, uint32_t burst)
+{
+    TRACE_ENTER;
+    bool in_use = false;
+
+    if (!(SYS_I2C_QUOTA_MAX > quota_idx)) { goto fail; }
+    if (!rate || !burst) { goto fail; }
+
+    portENTER_CRITICAL(&sys_i2c_quota_mux);
+    struct SYS_I2C_QUOTA_ENTRY * const entry_addr = &sys_i2c_quota.entry[quota_idx];
+    if ((in_use = entry_addr->in_use)) {
+        entry_addr->config.rate  = rate;
+        entry_addr->config.burst = burst;
+        sys_i2c_quota_reset(entry_addr, esp_timer_get_time());
+    }
+    portEXIT_CRITICAL(&sys_i2c_quota_mux);
+    if (!in_use) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_quota_set()
+
+bool sys_i2c_quota_clear(void)
+{
+    TRACE_ENTER;
+    portENTER_CRITICAL(&sys_i2c_quota_mux);
+    memset(sys_i2c_quota.entry, 0, sizeof(sys_i2c_quota.entry));
+    sys_i2c_quota.entry_cnt = 0;
+    portEXIT_CRITICAL(&sys_i2c_quota_mux);
+    TRACE_PASS;
+    return (true);
+} // end: sys_i2c_quota_clear()
+
+bool sys_i2c_quota_stats(uint8_t quota_idx, struct SYS_I2C_QUOTA_STATS * stats_addr)
+{
+    TRACE_ENTER;
+    bool in_use = false;
+
+    if (!(SYS_I2C_QUOTA_MAX > quota_idx)) { goto fail; }
+    if (!stats_addr) { goto fail; }
+
+    portENTER_CRITICAL(&sys_i2c_quota_mux);
+    struct SYS_I2C_QUOTA_ENTRY * const entry_addr = &sys_i2c_quota.entry[quota_idx];
+    if ((in_use = entry_addr->in_use)) {
+        sys_i2c_quota_refill(entry_addr, esp_timer_get_time());
+        *stats_addr = entry_addr->stats;
+    }
+    portEXIT_CRITICAL(&sys_i2c_quota_mux);
+    if (!in_use) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_quota_stats()
+
+bool sys_i2c_quota_print(void)
+{
+    TRACE_ENTER;
+    static const char * const unit_name[] = { "bytes", "bus us" }; // enum SYS_I2C_QUOTA_UNIT
+    struct SYS_I2C_QUOTA_STATS stats;
+    struct SYS_I2C_QUOTA_CONFIG config;
+    uint8_t quota_idx;
+
+    if (SYS_I2C_QUOTA_ENABLE != true) { goto fail; }
+
+    printf("\nI2C QUOTA: %u of %u entries; used per second vs quota, tokens now, negative: in debt\n",
+           sys_i2c_quota.entry_cnt, SYS_I2C_QUOTA_MAX);
+    for (quota_idx = 0; SYS_I2C_QUOTA_MAX > quota_idx; ++quota_idx) {
+        portENTER_CRITICAL(&sys_i2c_quota_mux);
+        config = sys_i2c_quota.entry[quota_idx].config;
+        portEXIT_CRITICAL(&sys_i2c_quota_mux);
+        if (!sys_i2c_quota_stats(quota_idx, &stats)) { continue; } // not in use
+
+        printf("[%d] task ", quota_idx);
+        if (config.task) { printf("%p", (void *)config.task); } else { printf("any"); }
+        printf(", sys_i2c_id ");
+        if (SYS_I2C_ID_CNT > config.sys_i2c_id) { printf("%d", config.sys_i2c_id); } else { printf("any"); }
+        printf(", addr ");
+        if (SYS_I2C_ADDR_INVALID > config.i2c_addr_num) { printf("0x%.2x", config.i2c_addr_num); } else { printf("any"); }
+        printf(", %s, %s\n", unit_name[config.unit], (SYS_I2C_QUOTA_DEFER == config.policy) ? "defer" : "reject");
+        printf("    used = %u / %u per s, burst = %u, tokens = %d, total = %llu\n",
+               stats.used_per_s, stats.rate, stats.burst, stats.tokens, (unsigned long long)stats.used_sum);
+        printf("    pass = %u, defer = %u, reject = %u, wait max = %u us\n",
+               stats.pass_cnt, stats.defer_cnt, stats.reject_cnt, stats.defer_max_us);
+    }
+    printf("\n");
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_quota_print()
+
+#if (SYS_I2C_QUOTA_ENABLE == true)
+// @brief Admission, called before the port lock. Charge every matching entry, or wait while any is in debt.
+// Out of range sys_i2c_id, i2c_addr_num: admitted, the call fails its own checks. Task context only.
+// @return true: go ahead, charged; false: rejected, nothing charged
+//
+bool sys_i2c_quota_hook(uint8_t sys_i2c_id, uint8_t i2c_addr_num, size_t buf_size, bool read_flag)
+{
+    if (!sys_i2c_quota.entry_cnt) { return (true); }
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id) || !(SYS_I2C_ADDR_INVALID > i2c_addr_num)) { return (true); }
+
+    const TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    const uint64_t bit_cnt = (read_flag) ? (((buf_size + 3) * SYS_I2C_QUOTA_BIT_PER_BYTE) + 3)   // START, RESTART, STOP bits
+                                         : (((buf_size + 2) * SYS_I2C_QUOTA_BIT_PER_BYTE) + 2);  // START, STOP bits
+    const uint32_t clk_hz = sys_i2c_clock_get(sys_i2c_id, i2c_addr_num);
+    const uint32_t bus_us = (clk_hz) ? (uint32_t)(((bit_cnt * 1000000ULL) + clk_hz - 1) / clk_hz) : 0;
+    const int64_t start_us = esp_timer_get_time();
+    bool wait_flag = false;
+
+    for (;;) {
+        bool reject_flag = false;
+        int64_t wait_us = 0;
+        uint32_t match_map = 0;
+        uint8_t quota_idx;
+
+        // 1A Refill and check every matching entry; all have budget: charge them all.
+        portENTER_CRITICAL(&sys_i2c_quota_mux);
+        const int64_t now_us = esp_timer_get_time();
+        for (quota_idx = 0; SYS_I2C_QUOTA_MAX > quota_idx; ++quota_idx) {
+            struct SYS_I2C_QUOTA_ENTRY * const entry_addr = &sys_i2c_quota.entry[quota_idx];
+            const struct SYS_I2C_QUOTA_CONFIG * const config = &entry_addr->config;
+            if (!entry_addr->in_use) { continue; }
+            if (config->task && (task != config->task)) { continue; }
+            if ((SYS_I2C_ID_CNT != config->sys_i2c_id) && (sys_i2c_id != config->sys_i2c_id)) { continue; }
+            if ((SYS_I2C_ADDR_INVALID != config->i2c_addr_num) && (i2c_addr_num != config->i2c_addr_num)) { continue; }
+            match_map |= (1UL << quota_idx);
+
+            sys_i2c_quota_refill(entry_addr, now_us);
+            if (0 <= entry_addr->tokens_x) { continue; }
+            const int64_t need_us = ((-entry_addr->tokens_x) + config->rate - 1) / config->rate;
+            if ((SYS_I2C_QUOTA_REJECT == config->policy)
+                || (((now_us - start_us) + need_us) > ((int64_t)config->defer_max_ms * 1000))) {
+                reject_flag = true;
+            }
+            if (wait_us < need_us) { wait_us = need_us; }
+        }
+        for (quota_idx = 0; SYS_I2C_QUOTA_MAX > quota_idx; ++quota_idx) {
+            if (!(match_map & (1UL << quota_idx))) { continue; }
+            struct SYS_I2C_QUOTA_ENTRY * const entry_addr = &sys_i2c_quota.entry[quota_idx];
+            if (reject_flag) {
+                entry_addr->stats.reject_cnt++;
+            } else if (!wait_us) {
+                const uint32_t cost = (SYS_I2C_QUOTA_BYTES == entry_addr->config.unit) ? (uint32_t)buf_size : bus_us;
+                entry_addr->tokens_x -= (int64_t)cost * SYS_I2C_QUOTA_SCALE;
+                entry_addr->used_window += cost;
+                entry_addr->stats.used_sum += cost;
+                if (wait_flag) {
+                    const uint32_t defer_us = (uint32_t)(now_us - start_us);
+                    entry_addr->stats.defer_cnt++;
+                    if (entry_addr->stats.defer_max_us < defer_us) { entry_addr->stats.defer_max_us = defer_us; }
+                } else {
+                    entry_addr->stats.pass_cnt++;
+                }
+            }
+        }
+        portEXIT_CRITICAL(&sys_i2c_quota_mux);
+
+        // 1B Over budget: out, or sleep until the deepest debt is paid, then check again.
+        if (reject_flag) { return (false); }
+        if (!wait_us) { return (true); }
+        wait_flag = true;
+        const TickType_t wait_ticks = (TickType_t)((wait_us + (portTICK_PERIOD_MS * 1000) - 1) / (portTICK_PERIOD_MS * 1000));
+        vTaskDelay(wait_ticks);
+    }
+} // end: sys_i2c_quota_hook()
+#endif // SYS_I2C_QUOTA_ENABLE
+
+// @brief Bucket full, counters cleared. Caller holds sys_i2c_quota_mux.
+//
+static void sys_i2c_quota_reset(struct SYS_I2C_QUOTA_ENTRY * entry_addr, int64_t now_us)
+{
+    entry_addr->tokens_x    = (int64_t)entry_addr->config.burst * SYS_I2C_QUOTA_SCALE;
+    entry_addr->refill_us   = now_us;
+    entry_addr->window_us   = now_us;
+    entry_addr->used_window = 0;
+    memset(&entry_addr->stats, 0, sizeof(entry_addr->stats));
+    entry_addr->stats.rate   = entry_addr->config.rate;
+    entry_addr->stats.burst  = entry_addr->config.burst;
+    entry_addr->stats.tokens = (int32_t)((entry_addr->config.burst > INT32_MAX) ? INT32_MAX : entry_addr->config.burst);
+} // end: sys_i2c_quota_reset()
+
+// @brief Tokens for the time since the last refill, capped at burst. Roll the used_per_s window. Caller holds
+// sys_i2c_quota_mux.
+//
+static void sys_i2c_quota_refill(struct SYS_I2C_QUOTA_ENTRY * entry_addr, int64_t now_us)
+{
+    const int64_t burst_x = (int64_t)entry_addr->config.burst * SYS_I2C_QUOTA_SCALE;
+    int64_t elapsed_us = now_us - entry_addr->refill_us;
+    int64_t tokens;
+
+    if (SYS_I2C_QUOTA_REFILL_MAX_US < elapsed_us) { elapsed_us = SYS_I2C_QUOTA_REFILL_MAX_US; }
+    if (0 < elapsed_us) {
+        entry_addr->tokens_x += (int64_t)entry_addr->config.rate * elapsed_us;
+        if (burst_x < entry_addr->tokens_x) { entry_addr->tokens_x = burst_x; }
+    }
+    entry_addr->refill_us = now_us;
+
+    const int64_t window_us = now_us - entry_addr->window_us;
+    if (SYS_I2C_QUOTA_WINDOW_US <= window_us) {
+        entry_addr->stats.used_per_s = (uint32_t)(((int64_t)entry_addr->used_window * 1000000LL) / window_us);
+        entry_addr->used_window = 0;
+        entry_addr->window_us   = now_us;
+    }
+
+    tokens = entry_addr->tokens_x / SYS_I2C_QUOTA_SCALE;
+    if (INT32_MAX < tokens) { tokens = INT32_MAX; }
+    if (INT32_MIN > tokens) { tokens = INT32_MIN; }
+    entry_addr->stats.tokens = (int32_t)tokens;
+} // end: sys_i2c_quota_refill()
+
+/* EOF sys_i2c_quota.c */
@@ -0,0 +1,401 @@
+// @file    sys_i2c_replay.c
+//
+// @brief  SYS_I2C workload replay: worker per captured task, bus and model targets, report, compare, persist.
+//
+// @details
+// - Every worker walks the whole image and issues only its own task_idx records; the image is read-only, shared.
+// - Original timing: vTaskDelay() for whole ticks, then esp_timer spin to the captured start. Late calls go at once.
+// - Workers count into the caller's report, portMUX protected, no blocking inside.
+// - Modelled wire time holds the real port lock with esp_rom_delay_us(): other tasks see the same contention a
+//   transfer of that size would cause, without a device.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+static const char * TAG = "sys_i2c_replay";
+#include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
+#include "sys_i2c_replay.h" // includes app_config.h, sys_i2c.h, sys_i2c_capture.h
+#include "sys_i2c_clock.h" // sys_i2c_clock_get(), modelled wire time
+
+#include <stdio.h> // printf()
+#include <stdlib.h> // calloc(), free()
+#include <string.h> // memset()
+#include "freertos/task.h"
+#include "esp_timer.h" // esp_timer_get_time()
+#include "esp_rom_sys.h" // esp_rom_delay_us()
+
+#define SYS_I2C_REPLAY_TASK_NAME        "sys_i2c_rep%d"
+#define SYS_I2C_REPLAY_TASK_STACK       (2048U)
+#define SYS_I2C_REPLAY_TASK_PRIORITY    (tskIDLE_PRIORITY + 2)
+#define SYS_I2C_REPLAY_CLK_DEFAULT      (100000U)   // Hz, device without a clock profile or bus speed
+#define SYS_I2C_REPLAY_FRAME_BITS       (3U)        // START, repeated START or STOP bit times per call, rounded
+
+// GLOBAL RAM
+//
+static struct {
+    const uint8_t *                     capture_addr;
+    uint32_t                            record_cnt;
+    const struct SYS_I2C_REPLAY_TARGET * target_addr;
+    struct SYS_I2C_REPLAY_REPORT *      report_addr;
+    bool                                asap_flag;
+    size_t                              buf_size;       // largest captured buf_size
+    int64_t                             start_us;
+    int64_t                             first_us;       // first call start
+    int64_t                             last_us;        // last call end
+    bool                                alloc_fail;
+    SemaphoreHandle_t                   done_sem;       // one give per worker exit
+    bool                                busy;           // one replay at a time
+} sys_i2c_replay;
+static portMUX_TYPE sys_i2c_replay_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool sys_i2c_replay_exec_model(const void * ctx, const struct SYS_I2C_CAPTURE_RECORD * record_addr, uint8_t * buf_addr);
+static bool sys_i2c_replay_hold(const struct SYS_I2C_CAPTURE_RECORD * record_addr);
+static void sys_i2c_replay_task(void * arg);
+static void sys_i2c_replay_count(struct SYS_I2C_REPLAY_REPORT * report_addr, uint32_t buf_size, bool pass_flag, uint32_t lat_us);
+static uint32_t sys_i2c_replay_pct(const struct SYS_I2C_REPLAY_REPORT * report_addr, uint32_t pct);
+static uint32_t sys_i2c_replay_ops_per_s(const struct SYS_I2C_REPLAY_REPORT * report_addr);
+static uint32_t sys_i2c_replay_lat_avg(const struct SYS_I2C_REPLAY_REPORT * report_addr);
+static void sys_i2c_replay_print_line(const char * name_addr, uint32_t now_num, const uint32_t * base_num_addr);
+
+const bool SYS_I2C_replay_write_enable = true;
+
+const struct SYS_I2C_REPLAY_TARGET SYS_I2C_replay_target_bus = {
+    .exec = sys_i2c_replay_exec_bus,
+    .ctx  = NULL,
+};
+
+const struct SYS_I2C_REPLAY_TARGET SYS_I2C_replay_target_model = {
+    .exec = sys_i2c_replay_exec_model,
+    .ctx  = NULL,
+};
+
+bool sys_i2c_replay_run(const uint8_t * capture_addr, size_t capture_size, const struct SYS_I2C_REPLAY_TARGET * target_addr,
+                        bool asap_flag, struct SYS_I2C_REPLAY_REPORT * report_addr)
+{
+    TRACE_ENTER;
+    bool busy_taken = false;
+    bool task_used[SYS_I2C_CAPTURE_TASK_MAX] = { false };
+    uint32_t task_cnt = 0;
+    uint32_t write_cnt = 0;
+    uint32_t record_cnt;
+    uint32_t record_idx;
+    uint8_t task_idx;
+
+    if (!capture_addr || !target_addr || !target_addr->exec || !report_addr) { goto fail; }
+    if (!sys_i2c_capture_check(capture_addr, capture_size, &record_cnt)) { goto fail; }
+
+    portENTER_CRITICAL(&sys_i2c_replay_mux);
+    if (!sys_i2c_replay.busy) { sys_i2c_replay.busy = busy_taken = true; }
+    portEXIT_CRITICAL(&sys_i2c_replay_mux);
+    if (!busy_taken) { goto fail; }
+
+    // 1A Check every record once, find the tasks and the largest buffer.
+    sys_i2c_replay.buf_size = 1;
+    for (record_idx = 0; record_cnt > record_idx; ++record_idx) {
+        struct SYS_I2C_CAPTURE_RECORD record;
+        if (!sys_i2c_capture_record(capture_addr, record_idx, &record)) { goto fail; }
+        task_used[record.task_idx] = true;
+        if (sys_i2c_replay.buf_size < record.buf_size) { sys_i2c_replay.buf_size = record.buf_size; }
+        if (SYS_I2C_CAPTURE_OP_WRITE == record.op) { write_cnt++; }
+    }
+
+    // 1B Real writes only with the explicit opt-in: zero-filled payloads overwrite device registers.
+    if (write_cnt && (sys_i2c_replay_exec_bus == target_addr->exec) && (&SYS_I2C_replay_write_enable == target_addr->ctx)) {
+        ESP_LOGW(TAG, "replay: %u captured writes go to the devices with a zero-filled payload", write_cnt);
+    }
+
+    memset(report_addr, 0, sizeof(*report_addr));
+    report_addr->version = SYS_I2C_REPLAY_VERSION;
+    report_addr->size    = sizeof(*report_addr);
+
+    // 2A One worker per captured task.
+    if (!(sys_i2c_replay.done_sem = xSemaphoreCreateCounting(SYS_I2C_CAPTURE_TASK_MAX, 0))) { goto fail; }
+    sys_i2c_replay.capture_addr = capture_addr;
+    sys_i2c_replay.record_cnt   = record_cnt;
+    sys_i2c_replay.target_addr  = target_addr;
+    sys_i2c_replay.report_addr  = report_addr;
+    sys_i2c_replay.asap_flag    = asap_flag;
+    sys_i2c_replay.alloc_fail   = false;
+    sys_i2c_replay.first_us     = INT64_MAX;
+    sys_i2c_replay.last_us      = 0;
+    sys_i2c_replay.start_us     = esp_timer_get_time();
+
+    for (task_idx = 0; SYS_I2C_CAPTURE_TASK_MAX > task_idx; ++task_idx) {
+        char task_name[configMAX_TASK_NAME_LEN];
+        if (!task_used[task_idx]) { continue; }
+        (void)snprintf(task_name, sizeof(task_name), SYS_I2C_REPLAY_TASK_NAME, task_idx);
+        if (pdPASS != xTaskCreate(sys_i2c_replay_task, task_name, SYS_I2C_REPLAY_TASK_STACK, (void *)(uintptr_t)task_idx,
+                                  SYS_I2C_REPLAY_TASK_PRIORITY, NULL)) { goto fail; }
+        task_cnt++;
+    }
+
+    // 3A Wait for every worker.
+    for (; task_cnt; --task_cnt) { (void)xSemaphoreTake(sys_i2c_replay.done_sem, portMAX_DELAY); }
+    vSemaphoreDelete(sys_i2c_replay.done_sem);
+    sys_i2c_replay.done_sem = NULL;
+    if (sys_i2c_replay.alloc_fail) { goto fail; }
+    if (report_addr->op_cnt) { report_addr->wall_us = (uint32_t)(sys_i2c_replay.last_us - sys_i2c_replay.first_us); }
+    sys_i2c_replay.busy = false;
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    if (sys_i2c_replay.done_sem) {
+        // workers already started run to the end of the image; wait before the report goes out of scope
+        for (; task_cnt; --task_cnt) { (void)xSemaphoreTake(sys_i2c_replay.done_sem, portMAX_DELAY); }
+        vSemaphoreDelete(sys_i2c_replay.done_sem);
+        sys_i2c_replay.done_sem = NULL;
+    }
+    if (busy_taken) { sys_i2c_replay.busy = false; }
+    return (false);
+} // end: sys_i2c_replay_run()
+
+bool sys_i2c_replay_capture_report(const uint8_t * capture_addr, size_t capture_size, struct SYS_I2C_REPLAY_REPORT * report_addr)
+{
+    TRACE_ENTER;
+    uint32_t first_us = UINT32_MAX;
+    uint32_t last_us = 0;
+    uint32_t record_cnt;
+    uint32_t record_idx;
+
+    if (!capture_addr || !report_addr) { goto fail; }
+    if (!sys_i2c_capture_check(capture_addr, capture_size, &record_cnt)) { goto fail; }
+
+    memset(report_addr, 0, sizeof(*report_addr));
+    report_addr->version = SYS_I2C_REPLAY_VERSION;
+    report_addr->size    = sizeof(*report_addr);
+
+    for (record_idx = 0; record_cnt > record_idx; ++record_idx) {
+        struct SYS_I2C_CAPTURE_RECORD record;
+        if (!sys_i2c_capture_record(capture_addr, record_idx, &record)) { goto fail; }
+        sys_i2c_replay_count(report_addr, record.buf_size, record.pass_flag, record.lat_us);
+        if (first_us > record.start_us) { first_us = record.start_us; }
+        if (last_us < (record.start_us + record.lat_us)) { last_us = record.start_us + record.lat_us; }
+    }
+    if (report_addr->op_cnt) { report_addr->wall_us = last_us - first_us; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_replay_capture_report()
+
+bool sys_i2c_replay_print(const struct SYS_I2C_REPLAY_REPORT * report_addr, const struct SYS_I2C_REPLAY_REPORT * base_addr)
+{
+    TRACE_ENTER;
+    uint32_t base_num[7];
+
+    if (!report_addr) { goto fail; }
+    const struct SYS_I2C_REPLAY_REPORT * const r = report_addr;
+    const struct SYS_I2C_REPLAY_REPORT * const b = base_addr;
+    if (b) {
+        base_num[0] = b->op_cnt;
+        base_num[1] = b->fail_cnt;
+        base_num[2] = sys_i2c_replay_ops_per_s(b);
+        base_num[3] = sys_i2c_replay_lat_avg(b);
+        base_num[4] = sys_i2c_replay_pct(b, 50);
+        base_num[5] = sys_i2c_replay_pct(b, 99);
+        base_num[6] = b->lat_max_us;
+    }
+
+    printf("\nI2C REPLAY: bytes = %u, wall = %u ms\n", r->byte_cnt, r->wall_us / 1000);
+    printf("%-14s %10s %10s %8s\n", "", "now", (b) ? "base" : "", (b) ? "delta" : "");
+    sys_i2c_replay_print_line("ops",          r->op_cnt,                        (b) ? &base_num[0] : NULL);
+    sys_i2c_replay_print_line("fail",         r->fail_cnt,                      (b) ? &base_num[1] : NULL);
+    sys_i2c_replay_print_line("ops/s",        sys_i2c_replay_ops_per_s(r),      (b) ? &base_num[2] : NULL);
+    sys_i2c_replay_print_line("lat avg us",   sys_i2c_replay_lat_avg(r),        (b) ? &base_num[3] : NULL);
+    sys_i2c_replay_print_line("lat p50 us <", sys_i2c_replay_pct(r, 50),        (b) ? &base_num[4] : NULL);
+    sys_i2c_replay_print_line("lat p99 us <", sys_i2c_replay_pct(r, 99),        (b) ? &base_num[5] : NULL);
+    sys_i2c_replay_print_line("lat max us",   r->lat_max_us,                    (b) ? &base_num[6] : NULL);
+    printf("\n");
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_replay_print()
+
+bool sys_i2c_replay_save(const struct SYS_I2C_DEVMAP_STORE * store_addr, const char * key, const struct SYS_I2C_REPLAY_REPORT * report_addr)
+{
+    TRACE_ENTER;
+    if (!store_addr || !store_addr->save || !key || !report_addr) { goto fail; }
+    if (!store_addr->save(store_addr->ctx, key, (const uint8_t *)report_addr, sizeof(*report_addr))) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_replay_save()
+
+bool sys_i2c_replay_load(const struct SYS_I2C_DEVMAP_STORE * store_addr, const char * key, struct SYS_I2C_REPLAY_REPORT * report_addr)
+{
+    TRACE_ENTER;
+    size_t read_size = 0;
+
+    if (!store_addr || !store_addr->load || !key || !report_addr) { goto fail; }
+    if (!store_addr->load(store_addr->ctx, key, (uint8_t *)report_addr, sizeof(*report_addr), &read_size)) { goto fail; }
+    if (sizeof(*report_addr) != read_size) { goto fail; }
+    if ((SYS_I2C_REPLAY_VERSION != report_addr->version) || (sizeof(*report_addr) != report_addr->size)) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_replay_load()
+
+// @brief Bus target: reads and probes on the bus; writes modelled unless ctx is &SYS_I2C_replay_write_enable.
+// Any other ctx, NULL or not, never writes: the opt-in is that one address, not any true flag.
+//
+bool sys_i2c_replay_exec_bus(const void * ctx, const struct SYS_I2C_CAPTURE_RECORD * record_addr, uint8_t * buf_addr)
+{
+    const struct SYS_I2C_CAPTURE_RECORD * const rec = record_addr;
+    bool found_flag;
+
+    switch (rec->op) {
+        case SYS_I2C_CAPTURE_OP_READ:
+            return (sys_i2c_read(rec->sys_i2c_id, rec->i2c_addr_num, rec->i2c_reg_num, buf_addr, rec->buf_size));
+        case SYS_I2C_CAPTURE_OP_WRITE:
+            if (&SYS_I2C_replay_write_enable != ctx) { return (sys_i2c_replay_hold(rec)); }
+            return (sys_i2c_write(rec->sys_i2c_id, rec->i2c_addr_num, rec->i2c_reg_num, buf_addr, rec->buf_size));
+        case SYS_I2C_CAPTURE_OP_PROBE:
+            return (sys_i2c_probe(rec->sys_i2c_id, rec->i2c_addr_num, &found_flag));
+        default:
+            return (false);
+    }
+} // end: sys_i2c_replay_exec_bus()
+
+// @brief Model target: lock plus modelled wire time for every call, captured result.
+//
+static bool sys_i2c_replay_exec_model(const void * ctx, const struct SYS_I2C_CAPTURE_RECORD * record_addr, uint8_t * buf_addr)
+{
+    (void)ctx;
+    (void)buf_addr;
+    return (sys_i2c_replay_hold(record_addr) && record_addr->pass_flag);
+} // end: sys_i2c_replay_exec_model()
+
+// @brief Hold the port lock of the record's bus for its modelled wire time.
+// Bytes: payload plus address and register bytes; a read adds the repeated-START address byte. 9 bits per byte.
+//
+static bool sys_i2c_replay_hold(const struct SYS_I2C_CAPTURE_RECORD * record_addr)
+{
+    const struct SYS_I2C_CAPTURE_RECORD * const rec = record_addr;
+    uint32_t clk_hz = sys_i2c_clock_get(rec->sys_i2c_id, rec->i2c_addr_num);
+    uint32_t byte_cnt = rec->buf_size;
+
+    if (!clk_hz) { clk_hz = SYS_I2C_REPLAY_CLK_DEFAULT; }
+    if (SYS_I2C_CAPTURE_OP_READ  == rec->op) { byte_cnt += 3; }
+    if (SYS_I2C_CAPTURE_OP_WRITE == rec->op) { byte_cnt += 2; }
+    if (SYS_I2C_CAPTURE_OP_PROBE == rec->op) { byte_cnt += 1; }
+    const uint32_t wire_us = (uint32_t)((((uint64_t)byte_cnt * 9 + SYS_I2C_REPLAY_FRAME_BITS) * 1000000ULL + clk_hz - 1) / clk_hz);
+
+    if (!sys_i2c_bus_take(rec->sys_i2c_id)) { return (false); }
+    esp_rom_delay_us(wire_us);
+    return (sys_i2c_bus_give(rec->sys_i2c_id));
+} // end: sys_i2c_replay_hold()
+
+// @brief Worker: issue the records of task_idx arg in order, at captured time or back-to-back.
+//
+static void sys_i2c_replay_task(void * arg)
+{
+    const uint8_t task_idx = (uint8_t)(uintptr_t)arg;
+    const struct SYS_I2C_REPLAY_TARGET * const t = sys_i2c_replay.target_addr;
+    uint8_t * const buf_addr = calloc(1, sys_i2c_replay.buf_size);
+    uint32_t record_idx;
+
+    if (!buf_addr) { sys_i2c_replay.alloc_fail = true; }
+    for (record_idx = 0; buf_addr && (sys_i2c_replay.record_cnt > record_idx); ++record_idx) {
+        struct SYS_I2C_CAPTURE_RECORD record;
+        (void)sys_i2c_capture_record(sys_i2c_replay.capture_addr, record_idx, &record); // checked by sys_i2c_replay_run()
+        if (task_idx != record.task_idx) { continue; }
+
+        if (!sys_i2c_replay.asap_flag) {
+            const int64_t due_us = sys_i2c_replay.start_us + record.start_us;
+            const int64_t wait_us = due_us - esp_timer_get_time();
+            const TickType_t wait_tick = (0 < wait_us) ? pdMS_TO_TICKS((uint32_t)(wait_us / 1000)) : 0;
+            if (1 < wait_tick) { vTaskDelay(wait_tick - 1); } // last tick spun, tick edges are not aligned to due_us
+            while (due_us > esp_timer_get_time()) { ; }
+        }
+        if (SYS_I2C_CAPTURE_OP_WRITE == record.op) { memset(buf_addr, 0, record.buf_size); } // payload: shape only
+
+        const int64_t at_us = esp_timer_get_time();
+        const bool pass_flag = t->exec(t->ctx, &record, buf_addr);
+        const int64_t end_us = esp_timer_get_time();
+
+        portENTER_CRITICAL(&sys_i2c_replay_mux);
+        if (sys_i2c_replay.first_us > at_us) { sys_i2c_replay.first_us = at_us; }
+        if (sys_i2c_replay.last_us < end_us) { sys_i2c_replay.last_us = end_us; }
+        sys_i2c_replay_count(sys_i2c_replay.report_addr, record.buf_size, pass_flag, (uint32_t)(end_us - at_us));
+        portEXIT_CRITICAL(&sys_i2c_replay_mux);
+    }
+
+    free(buf_addr);
+    (void)xSemaphoreGive(sys_i2c_replay.done_sem);
+    vTaskDelete(NULL);
+} // end: sys_i2c_replay_task()
+
+// @brief Add one call to a report. Caller holds sys_i2c_replay_mux when workers share the report.
+//
+static void sys_i2c_replay_count(struct SYS_I2C_REPLAY_REPORT * report_addr, uint32_t buf_size, bool pass_flag, uint32_t lat_us)
+{
+    struct SYS_I2C_REPLAY_REPORT * const r = report_addr;
+    uint32_t hist_idx = 0;
+
+    while (((SYS_I2C_REPLAY_HIST_CNT - 1) > hist_idx) && ((1UL << hist_idx) <= lat_us)) { hist_idx++; }
+    r->op_cnt++;
+    if (!pass_flag) { r->fail_cnt++; }
+    r->byte_cnt   += buf_size;
+    r->lat_sum_us += lat_us;
+    if (r->lat_max_us < lat_us) { r->lat_max_us = lat_us; }
+    r->lat_hist[hist_idx]++;
+} // end: sys_i2c_replay_count()
+
+// @brief Latency percentile, upper bound of its log2 bucket, microseconds.
+//
+static uint32_t sys_i2c_replay_pct(const struct SYS_I2C_REPLAY_REPORT * report_addr, uint32_t pct)
+{
+    const uint64_t want_cnt = ((uint64_t)report_addr->op_cnt * pct + 99) / 100;
+    uint64_t sum_cnt = 0;
+    uint32_t hist_idx;
+
+    if (!report_addr->op_cnt) { return (0); }
+    for (hist_idx = 0; (SYS_I2C_REPLAY_HIST_CNT - 1) > hist_idx; ++hist_idx) {
+        sum_cnt += report_addr->lat_hist[hist_idx];
+        if (want_cnt <= sum_cnt) { break; }
+    }
+    return ((uint32_t)(1UL << hist_idx));
+} // end: sys_i2c_replay_pct()
+
+static uint32_t sys_i2c_replay_ops_per_s(const struct SYS_I2C_REPLAY_REPORT * report_addr)
+{
+    if (!report_addr->wall_us) { return (0); }
+    return ((uint32_t)(((uint64_t)report_addr->op_cnt * 1000000ULL) / report_addr->wall_us));
+} // end: sys_i2c_replay_ops_per_s()
+
+static uint32_t sys_i2c_replay_lat_avg(const struct SYS_I2C_REPLAY_REPORT * report_addr)
+{
+    if (!report_addr->op_cnt) { return (0); }
+    return ((uint32_t)(report_addr->lat_sum_us / report_addr->op_cnt));
+} // end: sys_i2c_replay_lat_avg()
+
+// @brief One metric line: now, and with a baseline also base and the signed % change.
+//
+static void sys_i2c_replay_print_line(const char * name_addr, uint32_t now_num, const uint32_t * base_num_addr)
+{
+    if (!base_num_addr) {
+        printf("%-14s %10u\n", name_addr, now_num);
+        return;
+    }
+    if (!*base_num_addr) {
+        printf("%-14s %10u %10u %8s\n", name_addr, now_num, *base_num_addr, "-");
+        return;
+    }
+    const int32_t delta_pct = (int32_t)((((int64_t)now_num - (int64_t)*base_num_addr) * 100) / (int64_t)*base_num_addr);
+    printf("%-14s %10u %10u %+7d%%\n", name_addr, now_num, *base_num_addr, (int)delta_pct);
+} // end: sys_i2c_replay_print_line()
+
+/* EOF sys_i2c_replay.c */
@@ -0,0 +1,408 @@
+// @file    sys_i2c_sched.c
+//
+// @brief  SYS_I2C bus-switch-aware scheduling. One server task per port_num at a time, any number of waiters.
+//
+// @details
+// Slot life cycle, all state changes inside one portMUX critical section, no blocking calls inside:
+//   free -> claimed  requester owns the slot, prepares its transaction outside the critical section
+//   claimed -> queued    arrival order stamped; no server on the port_num: the requester becomes it
+//   queued -> wire   picked by the server, see sys_i2c_sched_pick()
+//   wire -> done     server gives the waiter, not itself, its wake_sem
+//   done -> free     requester copies the result out
+// A queued slot is woken once: done, or handed the server role.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+static const char * TAG = "sys_i2c_sched";
+#include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
+#include "sys_i2c_sched.h" // includes app_config.h, sys_i2c.h
+#include "sys_i2c_prep.h" // struct SYS_I2C_PREP, sys_i2c_prep_read(), sys_i2c_prep_write()
+#include "sys_i2c_priv.h" // sys_i2c_port_take(), sys_i2c_attach_pins_config(), sys_i2c_prep_exec_attached(), hooks
+#include "sys_i2c_capture.h" // SYS_I2C_CAPTURE_OP_READ, SYS_I2C_CAPTURE_OP_WRITE
+
+#include <stdio.h> // printf()
+#include <string.h> // memset()
+#include "esp_timer.h" // esp_timer_get_time()
+
+enum SYS_I2C_SCHED_STATE {
+    SYS_I2C_SCHED_FREE,
+    SYS_I2C_SCHED_CLAIMED,
+    SYS_I2C_SCHED_QUEUED,
+    SYS_I2C_SCHED_WIRE,
+    SYS_I2C_SCHED_DONE,
+};
+
+struct SYS_I2C_SCHED_SLOT {
+    enum SYS_I2C_SCHED_STATE state;
+    bool                serve_flag;     // woken to take over the server role
+    bool                pass_flag;      // server result
+    uint8_t             bypass_cnt;     // later requests run ahead of this one
+    uint32_t            seq;            // arrival order on the port_num
+    int64_t             enq_us;
+    SemaphoreHandle_t   wake_sem;       // binary, one give per queued slot
+    struct SYS_I2C_PREP prep;           // checked transaction, attach i2c_config with its clk_speed
+};
+
+struct SYS_I2C_SCHED_PORT {
+    struct SYS_I2C_SCHED_SLOT slot[SYS_I2C_SCHED_SLOT_CNT];
+    bool        server_flag;    // a task serves this port_num now
+    uint32_t    seq;            // next arrival
+    uint8_t     arrive_id;      // last arrival: arrival order switch count; SYS_I2C_ID_CNT: none
+    uint32_t    arrive_clk;
+    uint8_t     run_id;         // last picked: run order switch count; SYS_I2C_ID_CNT: none
+    uint32_t    run_clk;
+};
+
+// GLOBAL RAM
+//
+static struct {
+    struct SYS_I2C_SCHED_PORT   port[I2C_NUM_MAX];
+    struct SYS_I2C_SCHED_STATS  stats;
+    uint8_t                     window;
+    bool                        ready_flag;
+} sys_i2c_sched;
+static portMUX_TYPE sys_i2c_sched_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool sys_i2c_sched_xfer(enum SYS_I2C_PREP_DIR dir, uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size);
+static void sys_i2c_sched_serve(struct SYS_I2C_SCHED_PORT * port_addr, struct SYS_I2C_SCHED_SLOT * self_addr);
+static struct SYS_I2C_SCHED_SLOT * sys_i2c_sched_pick(struct SYS_I2C_SCHED_PORT * port_addr, uint8_t attached_id, uint32_t attached_clk);
+static struct SYS_I2C_SCHED_SLOT * sys_i2c_sched_oldest(struct SYS_I2C_SCHED_PORT * port_addr);
+
+#define SYS_I2C_SCHED_BEFORE(seq_a, seq_b)  (0 > (int32_t)((seq_a) - (seq_b))) // arrival order, wrap safe
+#define SYS_I2C_SCHED_CLK(slot_addr)        ((slot_addr)->prep.i2c_config.master.clk_speed)
+
+// @brief One binary semaphore per slot.
+//
+bool sys_i2c_sched_init(void)
+{
+    TRACE_ENTER;
+    i2c_port_t port_num;
+    uint8_t slot_idx;
+
+    for (port_num = 0; I2C_NUM_MAX > port_num; ++port_num) {
+        struct SYS_I2C_SCHED_PORT * const port_addr = &sys_i2c_sched.port[port_num];
+        for (slot_idx = 0; SYS_I2C_SCHED_SLOT_CNT > slot_idx; ++slot_idx) {
+            struct SYS_I2C_SCHED_SLOT * const slot_addr = &port_addr->slot[slot_idx];
+            if (!slot_addr->wake_sem) {
+                if (!(slot_addr->wake_sem = xSemaphoreCreateBinary())) { goto fail; }
+            }
+            slot_addr->state = SYS_I2C_SCHED_FREE;
+        }
+        port_addr->server_flag = false;
+        port_addr->arrive_id   = SYS_I2C_ID_CNT;
+        port_addr->run_id      = SYS_I2C_ID_CNT;
+    }
+    memset(&sys_i2c_sched.stats, 0, sizeof(sys_i2c_sched.stats));
+    sys_i2c_sched.window     = SYS_I2C_SCHED_WINDOW;
+    sys_i2c_sched.ready_flag = true;
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_sched_init()
+
+bool sys_i2c_sched_read(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size)
+{
+    TRACE_ENTER;
+    if (!sys_i2c_sched_xfer(SYS_I2C_PREP_READ, sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_addr, buf_size)) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_sched_read()
+
+bool sys_i2c_sched_write(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size)
+{
+    TRACE_ENTER;
+    if (!sys_i2c_sched_xfer(SYS_I2C_PREP_WRITE, sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_addr, buf_size)) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_sched_write()
+
+bool sys_i2c_sched_window_set(uint8_t window)
+{
+    TRACE_ENTER;
+    if (!(SYS_I2C_SCHED_WINDOW_MAX >= window)) { goto fail; }
+
+    portENTER_CRITICAL(&sys_i2c_sched_mux);
+    sys_i2c_sched.window = window;
+    portEXIT_CRITICAL(&sys_i2c_sched_mux);
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_sched_window_set()
+
+bool sys_i2c_sched_stats(struct SYS_I2C_SCHED_STATS * stats_addr)
+{
+    TRACE_ENTER;
+    if (!stats_addr) { goto fail; }
+
+    portENTER_CRITICAL(&sys_i2c_sched_mux);
+    *stats_addr = sys_i2c_sched.stats;
+    portEXIT_CRITICAL(&sys_i2c_sched_mux);
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_sched_stats()
+
+bool sys_i2c_sched_print(void)
+{
+    TRACE_ENTER;
+    struct SYS_I2C_SCHED_STATS stats;
+
+    if (!sys_i2c_sched_stats(&stats)) { goto fail; }
+
+    printf("\nI2C SCHED: window = %d, requests = %u, passthrough = %u, reordered = %u, handoffs = %u\n",
+           sys_i2c_sched.window, stats.req_cnt, stats.passthrough_cnt, stats.reorder_cnt, stats.handoff_cnt);
+    printf("switches: arrival order = %u, run order = %u (clock only = %u), saved = %d\n",
+           stats.fifo_switch_cnt, stats.switch_cnt, stats.clock_switch_cnt, (int)(stats.fifo_switch_cnt - stats.switch_cnt));
+    printf("latency: bypass max = %u requests, wait max = %u us\n\n", stats.bypass_max, stats.wait_max_us);
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_sched_print()
+
+// @brief Claim a slot, queue, then serve or wait. No free slot: the plain call.
+//
+static bool sys_i2c_sched_xfer(enum SYS_I2C_PREP_DIR dir, uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size)
+{
+    TRACE_ENTER;
+    struct SYS_I2C_SCHED_SLOT * slot_addr = NULL;
+    bool serve_flag = false;
+    bool pass_flag;
+    uint8_t slot_idx;
+
+    if (!sys_i2c_sched.ready_flag) { goto fail; }
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    SYS_I2C_WCOMB_HOOK(sys_i2c_id, i2c_addr_num); // deferred writes to this device go first
+    const int64_t capture_us = SYS_I2C_CAPTURE_START_US();
+    struct SYS_I2C_SCHED_PORT * const port_addr = &sys_i2c_sched.port[SYS_I2C_runtime.unit[sys_i2c_id].port_num];
+
+    // 1A Claim a slot.
+    portENTER_CRITICAL(&sys_i2c_sched_mux);
+    for (slot_idx = 0; SYS_I2C_SCHED_SLOT_CNT > slot_idx; ++slot_idx) {
+        if (SYS_I2C_SCHED_FREE == port_addr->slot[slot_idx].state) {
+            slot_addr = &port_addr->slot[slot_idx];
+            slot_addr->state = SYS_I2C_SCHED_CLAIMED;
+            break;
+        }
+    }
+    if (!slot_addr) { sys_i2c_sched.stats.passthrough_cnt++; }
+    portEXIT_CRITICAL(&sys_i2c_sched_mux);
+
+    if (!slot_addr) {
+        pass_flag = (SYS_I2C_PREP_READ == dir) ? sys_i2c_read(sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_addr, buf_size)
+                                               : sys_i2c_write(sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_addr, buf_size);
+        if (!pass_flag) { goto fail; }
+        goto pass;
+    }
+
+    // 1B Checks and i2c_config, outside the critical section.
+    pass_flag = (SYS_I2C_PREP_READ == dir) ? sys_i2c_prep_read(&slot_addr->prep, sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_addr, buf_size)
+                                           : sys_i2c_prep_write(&slot_addr->prep, sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_addr, buf_size);
+    pass_flag = pass_flag && SYS_I2C_QUOTA_HOOK(sys_i2c_id, i2c_addr_num, buf_size, (SYS_I2C_PREP_READ == dir)); // passthrough: charged there
+    if (!pass_flag) {
+        portENTER_CRITICAL(&sys_i2c_sched_mux);
+        slot_addr->state = SYS_I2C_SCHED_FREE;
+        portEXIT_CRITICAL(&sys_i2c_sched_mux);
+        goto fail;
+    }
+
+    // 2A Queue. Arrival order switch count. No server: this task is it.
+    portENTER_CRITICAL(&sys_i2c_sched_mux);
+    slot_addr->state      = SYS_I2C_SCHED_QUEUED;
+    slot_addr->serve_flag = false;
+    slot_addr->bypass_cnt = 0;
+    slot_addr->seq        = port_addr->seq++;
+    slot_addr->enq_us     = esp_timer_get_time();
+    if ((SYS_I2C_ID_CNT != port_addr->arrive_id)
+        && ((sys_i2c_id != port_addr->arrive_id) || (SYS_I2C_SCHED_CLK(slot_addr) != port_addr->arrive_clk))) {
+        sys_i2c_sched.stats.fifo_switch_cnt++;
+    }
+    port_addr->arrive_id  = sys_i2c_id;
+    port_addr->arrive_clk = SYS_I2C_SCHED_CLK(slot_addr);
+    if (!port_addr->server_flag) {
+        port_addr->server_flag = true;
+        serve_flag = true;
+    }
+    portEXIT_CRITICAL(&sys_i2c_sched_mux);
+
+    // 2B Wait: done, or handed the server role.
+    if (!serve_flag) {
+        (void)xSemaphoreTake(slot_addr->wake_sem, portMAX_DELAY);
+        portENTER_CRITICAL(&sys_i2c_sched_mux);
+        serve_flag = slot_addr->serve_flag;
+        portEXIT_CRITICAL(&sys_i2c_sched_mux);
+    }
+    if (serve_flag) { sys_i2c_sched_serve(port_addr, slot_addr); }
+
+    // 3A Result out, slot free.
+    portENTER_CRITICAL(&sys_i2c_sched_mux);
+    const uint32_t wait_us = (uint32_t)(esp_timer_get_time() - slot_addr->enq_us);
+    if (sys_i2c_sched.stats.wait_max_us < wait_us) { sys_i2c_sched.stats.wait_max_us = wait_us; }
+    pass_flag = slot_addr->pass_flag;
+    slot_addr->state = SYS_I2C_SCHED_FREE;
+    portEXIT_CRITICAL(&sys_i2c_sched_mux);
+
+    SYS_I2C_CAPTURE_HOOK((SYS_I2C_PREP_READ == dir) ? SYS_I2C_CAPTURE_OP_READ : SYS_I2C_CAPTURE_OP_WRITE,
+                         sys_i2c_id, i2c_addr_num, i2c_reg_num, buf_size, capture_us, pass_flag);
+    if (!pass_flag) { goto fail; }
+
+  pass:
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_sched_xfer()
+
+// @brief Server: run queued requests until self_addr is done, at most SYS_I2C_SCHED_SLOT_CNT per port lock hold.
+// Pins stay attached while the next pick has the same sys_i2c_id and clk_speed. Then hand the role on, or drop it.
+//
+static void sys_i2c_sched_serve(struct SYS_I2C_SCHED_PORT * port_addr, struct SYS_I2C_SCHED_SLOT * self_addr)
+{
+    const uint8_t lock_id = self_addr->prep.sys_i2c_id; // any sys_i2c_id of this port_num
+    struct SYS_I2C_SCHED_SLOT * slot_addr;
+    struct SYS_I2C_SCHED_SLOT * next_addr;
+    uint8_t run_idx;
+
+    for (;;) {
+        const bool lock_flag = sys_i2c_port_take(lock_id);
+        uint8_t attached_id = SYS_I2C_ID_CNT;
+        uint32_t attached_clk = 0;
+
+        for (run_idx = 0; SYS_I2C_SCHED_SLOT_CNT > run_idx; ++run_idx) {
+            portENTER_CRITICAL(&sys_i2c_sched_mux);
+            slot_addr = sys_i2c_sched_pick(port_addr, attached_id, attached_clk);
+            portEXIT_CRITICAL(&sys_i2c_sched_mux);
+            if (!slot_addr) { break; }
+
+            // Switch only when the bus or clock differs. A failed transfer leaves the bus detached.
+            const uint8_t sys_i2c_id = slot_addr->prep.sys_i2c_id;
+            bool pass_flag = lock_flag;
+            if (pass_flag && ((sys_i2c_id != attached_id) || (SYS_I2C_SCHED_CLK(slot_addr) != attached_clk))) {
+                if (SYS_I2C_ID_CNT != attached_id) { (void)sys_i2c_detach_pins(attached_id); }
+                attached_id = SYS_I2C_ID_CNT;
+                pass_flag = sys_i2c_attach_pins_config(sys_i2c_id, &slot_addr->prep.i2c_config);
+                if (pass_flag) {
+                    attached_id  = sys_i2c_id;
+                    attached_clk = SYS_I2C_SCHED_CLK(slot_addr);
+                }
+            }
+            pass_flag = pass_flag && sys_i2c_prep_exec_attached(&slot_addr->prep);
+            if (!pass_flag && (SYS_I2C_ID_CNT != attached_id)) {
+                (void)sys_i2c_detach_pins(attached_id);
+                attached_id = SYS_I2C_ID_CNT;
+            }
+
+            portENTER_CRITICAL(&sys_i2c_sched_mux);
+            slot_addr->pass_flag = pass_flag;
+            slot_addr->state = SYS_I2C_SCHED_DONE;
+            sys_i2c_sched.stats.req_cnt++;
+            portEXIT_CRITICAL(&sys_i2c_sched_mux);
+            if (self_addr != slot_addr) { (void)xSemaphoreGive(slot_addr->wake_sem); }
+        }
+
+        if (SYS_I2C_ID_CNT != attached_id) { (void)sys_i2c_detach_pins(attached_id); }
+        if (lock_flag) { (void)sys_i2c_port_give(lock_id); }
+
+        // Own request done: hand the role to the oldest waiter, or drop it. Else another lock hold.
+        portENTER_CRITICAL(&sys_i2c_sched_mux);
+        if (SYS_I2C_SCHED_DONE != self_addr->state) {
+            portEXIT_CRITICAL(&sys_i2c_sched_mux);
+            continue;
+        }
+        if ((next_addr = sys_i2c_sched_oldest(port_addr))) {
+            next_addr->serve_flag = true;
+            sys_i2c_sched.stats.handoff_cnt++;
+        } else {
+            port_addr->server_flag = false;
+        }
+        portEXIT_CRITICAL(&sys_i2c_sched_mux);
+        if (next_addr) { (void)xSemaphoreGive(next_addr->wake_sem); }
+        return;
+    }
+} // end: sys_i2c_sched_serve()
+
+// @brief Next queued slot to run, marked wire; NULL: none queued. Inside the critical section.
+// Oldest when nothing is attached, when it used up the window, or window 0. Else the cheapest switch from
+// attached_id, attached_clk: 0 none, 1 clock only, 2 bus; ties in arrival order. Every older slot: passed over once more.
+//
+static struct SYS_I2C_SCHED_SLOT * sys_i2c_sched_pick(struct SYS_I2C_SCHED_PORT * port_addr, uint8_t attached_id, uint32_t attached_clk)
+{
+    struct SYS_I2C_SCHED_SLOT * const oldest_addr = sys_i2c_sched_oldest(port_addr);
+    struct SYS_I2C_SCHED_SLOT * best_addr = oldest_addr;
+    uint8_t best_cost = UINT8_MAX;
+    bool reorder_flag = false;
+    uint8_t slot_idx;
+
+    if (!oldest_addr) { return (NULL); }
+
+    if ((SYS_I2C_ID_CNT != attached_id) && sys_i2c_sched.window && (sys_i2c_sched.window > oldest_addr->bypass_cnt)) {
+        for (slot_idx = 0; SYS_I2C_SCHED_SLOT_CNT > slot_idx; ++slot_idx) {
+            struct SYS_I2C_SCHED_SLOT * const slot_addr = &port_addr->slot[slot_idx];
+            if (SYS_I2C_SCHED_QUEUED != slot_addr->state) { continue; }
+            const uint8_t cost = (slot_addr->prep.sys_i2c_id != attached_id) ? 2 : (SYS_I2C_SCHED_CLK(slot_addr) != attached_clk) ? 1 : 0;
+            if ((best_cost > cost) || ((best_cost == cost) && SYS_I2C_SCHED_BEFORE(slot_addr->seq, best_addr->seq))) {
+                best_addr = slot_addr;
+                best_cost = cost;
+            }
+        }
+    }
+
+    for (slot_idx = 0; SYS_I2C_SCHED_SLOT_CNT > slot_idx; ++slot_idx) {
+        struct SYS_I2C_SCHED_SLOT * const slot_addr = &port_addr->slot[slot_idx];
+        if (SYS_I2C_SCHED_QUEUED != slot_addr->state) { continue; }
+        if (!SYS_I2C_SCHED_BEFORE(slot_addr->seq, best_addr->seq)) { continue; }
+        reorder_flag = true;
+        if (sys_i2c_sched.stats.bypass_max < ++slot_addr->bypass_cnt) { sys_i2c_sched.stats.bypass_max = slot_addr->bypass_cnt; }
+    }
+    if (reorder_flag) { sys_i2c_sched.stats.reorder_cnt++; }
+
+    // Run order switch count, same rule as arrival order.
+    if ((SYS_I2C_ID_CNT != port_addr->run_id)
+        && ((best_addr->prep.sys_i2c_id != port_addr->run_id) || (SYS_I2C_SCHED_CLK(best_addr) != port_addr->run_clk))) {
+        sys_i2c_sched.stats.switch_cnt++;
+        if (best_addr->prep.sys_i2c_id == port_addr->run_id) { sys_i2c_sched.stats.clock_switch_cnt++; }
+    }
+    port_addr->run_id  = best_addr->prep.sys_i2c_id;
+    port_addr->run_clk = SYS_I2C_SCHED_CLK(best_addr);
+
+    best_addr->state = SYS_I2C_SCHED_WIRE;
+    return (best_addr);
+} // end: sys_i2c_sched_pick()
+
+// @brief Oldest queued slot, or NULL. Inside the critical section.
+//
+static struct SYS_I2C_SCHED_SLOT * sys_i2c_sched_oldest(struct SYS_I2C_SCHED_PORT * port_addr)
+{
+    struct SYS_I2C_SCHED_SLOT * oldest_addr = NULL;
+    uint8_t slot_idx;
+
+    for (slot_idx = 0; SYS_I2C_SCHED_SLOT_CNT > slot_idx; ++slot_idx) {
+        struct SYS_I2C_SCHED_SLOT * const slot_addr = &port_addr->slot[slot_idx];
+        if (SYS_I2C_SCHED_QUEUED != slot_addr->state) { continue; }
+        if (!oldest_addr || SYS_I2C_SCHED_BEFORE(slot_addr->seq, oldest_addr->seq)) { oldest_addr = slot_addr; }
+    }
+    return (oldest_addr);
+} // end: sys_i2c_sched_oldest()
+
+/* EOF sys_i2c_sched.c */
@@ -0,0 +1,358 @@
+// @file    sys_i2c_smbus.c
+//
+// @brief  SYS_I2C SMBus protocols. i2c_cmd programs composed here, run under the sys_i2c I2C port lock.
+//
+// @details
+// - Every protocol but Block Read is one write phase and/or one read phase: sys_i2c_smbus_xfer().
+// - Block Read is two i2c_master_cmd_begin() segments, one I2C port lock, one attach:
+//   segment 1 ends after the ACKed count byte without STOP, segment 2 reads count data bytes, PEC, STOP.
+// - PEC table: 256 bytes FLASH const, one lookup per byte.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+static const char * TAG = "sys_i2c_smbus";
+#include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
+#include "sys_i2c_smbus.h" // includes app_config.h, sys_i2c.h
+#include "sys_i2c_priv.h" // sys_i2c_port_take(), sys_i2c_attach_pins(), ESP32_I2C_ACK_CHECK_EN, hooks
+#include "sys_i2c_capture.h" // SYS_I2C_CAPTURE_OP_READ, SYS_I2C_CAPTURE_OP_WRITE
+
+#include "driver/i2c.h"
+
+#define SYS_I2C_SMBUS_TIMEOUT_TICK  (pdMS_TO_TICKS(35U) + 1U) // SMBus clock low timeout, 35ms max; +1 tick rounds up
+#define SYS_I2C_SMBUS_WR_MAX        (2U + SYS_I2C_SMBUS_BLOCK_MAX) // command code, byte count, data
+
+// Capture record of one sys_i2c_smbus_xfer(): command code as i2c_reg_num, bytes after it as buf_size.
+#define SYS_I2C_SMBUS_CAPTURE(wr_addr, wr_size, rd_size, capture_us, pass_flag) \
+        SYS_I2C_CAPTURE_HOOK(((rd_size) ? SYS_I2C_CAPTURE_OP_READ : SYS_I2C_CAPTURE_OP_WRITE), sys_i2c_id, i2c_addr_num, \
+                             (((wr_size) && (wr_addr)) ? (wr_addr)[0] : 0), ((rd_size) ? (rd_size) : ((wr_size) ? ((wr_size) - 1) : 0)), \
+                             (capture_us), (pass_flag))
+
+// CRC-8, poly x^8 + x^2 + x + 1 (0x07), init 0x00. SMBus 2.0 Appendix A.
+// FLASH const
+//
+static const uint8_t sys_i2c_smbus_crc8_tbl[256] = {
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+    0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+    0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+    0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+    0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+    0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+    0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+    0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+    0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+    0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+    0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3,
+};
+
+static bool sys_i2c_smbus_xfer(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t * wr_addr, size_t wr_size, uint8_t * rd_addr, size_t rd_size, bool pec_flag);
+static bool sys_i2c_smbus_exec(uint8_t sys_i2c_id, uint8_t i2c_addr_num, i2c_cmd_handle_t i2c_cmd);
+
+bool sys_i2c_smbus_quick(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool read_flag)
+{
+    TRACE_ENTER;
+    i2c_cmd_handle_t i2c_cmd = 0;
+
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    if (!(SYS_I2C_ADDR_INVALID > i2c_addr_num)) { goto fail; }
+
+    if (!(i2c_cmd = i2c_cmd_link_create())) { goto fail; }
+    if (ESP_OK != i2c_master_start(i2c_cmd)) { goto fail; }
+    if (ESP_OK != i2c_master_write_byte(i2c_cmd, i2c_addr_num << 1 | ((read_flag) ? I2C_MASTER_READ : I2C_MASTER_WRITE), ESP32_I2C_ACK_CHECK_EN)) { goto fail; }
+    if (ESP_OK != i2c_master_stop(i2c_cmd)) { goto fail; }
+    if (!sys_i2c_smbus_exec(sys_i2c_id, i2c_addr_num, i2c_cmd)) { goto fail; }
+    i2c_cmd_link_delete(i2c_cmd);
+    i2c_cmd = 0;
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    if (i2c_cmd) { i2c_cmd_link_delete(i2c_cmd); }
+    return (false);
+} // end: sys_i2c_smbus_quick()
+
+bool sys_i2c_smbus_send_byte(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t data_num, bool pec_flag)
+{
+    return (sys_i2c_smbus_xfer(sys_i2c_id, i2c_addr_num, &data_num, 1, NULL, 0, pec_flag));
+} // end: sys_i2c_smbus_send_byte()
+
+bool sys_i2c_smbus_recv_byte(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t * data_addr, bool pec_flag)
+{
+    return (sys_i2c_smbus_xfer(sys_i2c_id, i2c_addr_num, NULL, 0, data_addr, 1, pec_flag));
+} // end: sys_i2c_smbus_recv_byte()
+
+bool sys_i2c_smbus_write_byte(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t cmd_num, uint8_t data_num, bool pec_flag)
+{
+    uint8_t wr_buf[2] = { cmd_num, data_num };
+
+    return (sys_i2c_smbus_xfer(sys_i2c_id, i2c_addr_num, wr_buf, sizeof(wr_buf), NULL, 0, pec_flag));
+} // end: sys_i2c_smbus_write_byte()
+
+bool sys_i2c_smbus_read_byte(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t cmd_num, uint8_t * data_addr, bool pec_flag)
+{
+    return (sys_i2c_smbus_xfer(sys_i2c_id, i2c_addr_num, &cmd_num, 1, data_addr, 1, pec_flag));
+} // end: sys_i2c_smbus_read_byte()
+
+bool sys_i2c_smbus_write_word(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t cmd_num, uint16_t data_num, bool pec_flag)
+{
+    uint8_t wr_buf[3] = { cmd_num, (uint8_t)(data_num & 0xFF), (uint8_t)(data_num >> 8) };
+
+    return (sys_i2c_smbus_xfer(sys_i2c_id, i2c_addr_num, wr_buf, sizeof(wr_buf), NULL, 0, pec_flag));
+} // end: sys_i2c_smbus_write_word()
+
+bool sys_i2c_smbus_read_word(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t cmd_num, uint16_t * data_addr, bool pec_flag)
+{
+    TRACE_ENTER;
+    uint8_t rd_buf[2];
+
+    if (!data_addr) { goto fail; }
+    if (!sys_i2c_smbus_xfer(sys_i2c_id, i2c_addr_num, &cmd_num, 1, rd_buf, sizeof(rd_buf), pec_flag)) { goto fail; }
+    *data_addr = (uint16_t)(rd_buf[0] | (rd_buf[1] << 8));
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_smbus_read_word()
+
+bool sys_i2c_smbus_process_call(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t cmd_num, uint16_t wr_num, uint16_t * rd_addr, bool pec_flag)
+{
+    TRACE_ENTER;
+    uint8_t wr_buf[3] = { cmd_num, (uint8_t)(wr_num & 0xFF), (uint8_t)(wr_num >> 8) };
+    uint8_t rd_buf[2];
+
+    if (!rd_addr) { goto fail; }
+    if (!sys_i2c_smbus_xfer(sys_i2c_id, i2c_addr_num, wr_buf, sizeof(wr_buf), rd_buf, sizeof(rd_buf), pec_flag)) { goto fail; }
+    *rd_addr = (uint16_t)(rd_buf[0] | (rd_buf[1] << 8));
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_smbus_process_call()
+
+bool sys_i2c_smbus_block_write(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t cmd_num, const uint8_t * buf_addr, size_t buf_size, bool pec_flag)
+{
+    TRACE_ENTER;
+    uint8_t wr_buf[SYS_I2C_SMBUS_WR_MAX];
+    size_t idx;
+
+    if (!buf_addr) { goto fail; }
+    if (!buf_size || (SYS_I2C_SMBUS_BLOCK_MAX < buf_size)) { goto fail; }
+
+    wr_buf[0] = cmd_num;
+    wr_buf[1] = (uint8_t)buf_size;
+    for (idx = 0; buf_size > idx; ++idx) { wr_buf[2 + idx] = buf_addr[idx]; } // i2c_master_write() is not const on IDF < 4.3
+    if (!sys_i2c_smbus_xfer(sys_i2c_id, i2c_addr_num, wr_buf, 2 + buf_size, NULL, 0, pec_flag)) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_smbus_block_write()
+
+// @brief Block Read, one transaction, two I2C_FSM segments.
+// TASK SAFE: YES
+//
+bool sys_i2c_smbus_block_read(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t cmd_num, uint8_t * buf_addr, size_t buf_size, size_t * read_size_addr, bool pec_flag)
+{
+    TRACE_ENTER;
+    const int64_t capture_us = SYS_I2C_CAPTURE_START_US();
+    i2c_cmd_handle_t i2c_cmd = 0;
+    bool lock_taken = false;
+    uint8_t count_num = 0;
+    uint8_t pec_num = 0;
+
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    if (!(SYS_I2C_ADDR_INVALID > i2c_addr_num)) { goto fail; }
+    if (!buf_addr) { goto fail; }
+    if (!buf_size) { goto fail; }
+    if (!read_size_addr) { goto fail; }
+
+    const i2c_port_t port_num = SYS_I2C_runtime.unit[sys_i2c_id].port_num;
+    const uint8_t addr_wr = i2c_addr_num << 1 | I2C_MASTER_WRITE;
+    const uint8_t addr_rd = i2c_addr_num << 1 | I2C_MASTER_READ;
+    SYS_I2C_WCOMB_HOOK(sys_i2c_id, i2c_addr_num); // deferred writes to this device go first
+    if (!SYS_I2C_QUOTA_HOOK(sys_i2c_id, i2c_addr_num, 1 + buf_size, true)) { goto fail; } // count byte, buf_size at most
+
+    // start: Task Safe, one transaction
+    if (!sys_i2c_port_take(sys_i2c_id)) { goto fail; }
+    lock_taken = true;
+    if (!sys_i2c_attach_pins(sys_i2c_id, i2c_addr_num)) { goto fail; }
+
+    // 1A Segment 1: command code, repeated START, count byte ACKed. No STOP: SCL held low until segment 2.
+    if (!(i2c_cmd = i2c_cmd_link_create())) { goto fail; }
+    if (ESP_OK != i2c_master_start(i2c_cmd)) { goto fail; }
+    if (ESP_OK != i2c_master_write_byte(i2c_cmd, addr_wr, ESP32_I2C_ACK_CHECK_EN)) { goto fail; }
+    if (ESP_OK != i2c_master_write_byte(i2c_cmd, cmd_num, ESP32_I2C_ACK_CHECK_EN)) { goto fail; }
+    if (ESP_OK != i2c_master_start(i2c_cmd)) { goto fail; }
+    if (ESP_OK != i2c_master_write_byte(i2c_cmd, addr_rd, ESP32_I2C_ACK_CHECK_EN)) { goto fail; }
+    if (ESP_OK != i2c_master_read_byte(i2c_cmd, &count_num, ESP32_I2C_ACK_VAL)) { goto fail; }
+    if (ESP_OK != i2c_master_cmd_begin(port_num, i2c_cmd, SYS_I2C_SMBUS_TIMEOUT_TICK)) { goto fail; }
+    i2c_cmd_link_delete(i2c_cmd);
+    i2c_cmd = 0;
+
+    // 2A Segment 2: count data bytes, PEC, STOP. Bad count: one NACKed byte ends the transaction cleanly, then fail.
+    const bool count_ok = (count_num && (buf_size >= count_num));
+    if (!(i2c_cmd = i2c_cmd_link_create())) { goto fail; }
+    if (!count_ok) {
+        if (ESP_OK != i2c_master_read_byte(i2c_cmd, &pec_num, ESP32_I2C_NACK_VAL)) { goto fail; }
+    } else if (pec_flag) {
+        if (ESP_OK != i2c_master_read(i2c_cmd, buf_addr, count_num, ESP32_I2C_ACK_VAL)) { goto fail; }
+        if (ESP_OK != i2c_master_read_byte(i2c_cmd, &pec_num, ESP32_I2C_NACK_VAL)) { goto fail; }
+    } else {
+        if (count_num > 1) { if (ESP_OK != i2c_master_read(i2c_cmd, buf_addr, (count_num - 1), ESP32_I2C_ACK_VAL)) { goto fail; } }
+        if (ESP_OK != i2c_master_read_byte(i2c_cmd, (buf_addr + count_num - 1), ESP32_I2C_NACK_VAL)) { goto fail; }
+    }
+    if (ESP_OK != i2c_master_stop(i2c_cmd)) { goto fail; }
+    if (ESP_OK != i2c_master_cmd_begin(port_num, i2c_cmd, SYS_I2C_SMBUS_TIMEOUT_TICK)) { goto fail; }
+    i2c_cmd_link_delete(i2c_cmd);
+    i2c_cmd = 0;
+
+    if (!sys_i2c_detach_pins(sys_i2c_id)) { goto fail; }
+    lock_taken = false;
+    if (!sys_i2c_port_give(sys_i2c_id)) { goto fail; }
+    // end: Task Safe
+
+    if (!count_ok) { goto fail; }
+
+    // 3A PEC over every byte on the wire: address, command, address, count, data.
+    if (pec_flag) {
+        const uint8_t head_buf[4] = { addr_wr, cmd_num, addr_rd, count_num };
+        uint8_t crc_num = sys_i2c_smbus_pec(0, head_buf, sizeof(head_buf));
+        crc_num = sys_i2c_smbus_pec(crc_num, buf_addr, count_num);
+        if (crc_num != pec_num) { goto fail; }
+    }
+    *read_size_addr = count_num;
+
+    TRACE_PASS;
+    SYS_I2C_CAPTURE_HOOK(SYS_I2C_CAPTURE_OP_READ, sys_i2c_id, i2c_addr_num, cmd_num, count_num, capture_us, true);
+    return (true);
+  fail:
+    TRACE_FAIL;
+    if (i2c_cmd) { i2c_cmd_link_delete(i2c_cmd); }
+    if (lock_taken) {
+        (void)sys_i2c_detach_pins(sys_i2c_id);
+        (void)sys_i2c_port_give(sys_i2c_id);
+    }
+    SYS_I2C_CAPTURE_HOOK(SYS_I2C_CAPTURE_OP_READ, sys_i2c_id, i2c_addr_num, cmd_num, (count_num) ? count_num : buf_size, capture_us, false);
+    return (false);
+} // end: sys_i2c_smbus_block_read()
+
+uint8_t sys_i2c_smbus_pec(uint8_t pec_num, const uint8_t * buf_addr, size_t buf_size)
+{
+    while (buf_size--) { pec_num = sys_i2c_smbus_crc8_tbl[pec_num ^ *buf_addr++]; }
+    return (pec_num);
+} // end: sys_i2c_smbus_pec()
+
+// @brief Write phase and/or read phase, one transaction. Write-only: PEC appended. Read: PEC read last, checked.
+//
+static bool sys_i2c_smbus_xfer(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t * wr_addr, size_t wr_size, uint8_t * rd_addr, size_t rd_size, bool pec_flag)
+{
+    TRACE_ENTER;
+    const int64_t capture_us = SYS_I2C_CAPTURE_START_US();
+    i2c_cmd_handle_t i2c_cmd = 0;
+    uint8_t crc_num = 0;
+    uint8_t pec_num = 0;
+
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    if (!(SYS_I2C_ADDR_INVALID > i2c_addr_num)) { goto fail; }
+    if (wr_size && !wr_addr) { goto fail; }
+    if (rd_size && !rd_addr) { goto fail; }
+    if (!wr_size && !rd_size) { goto fail; }
+    // Command code as the register byte: a write is charged the bytes after it, a read its read phase.
+    if (!SYS_I2C_QUOTA_HOOK(sys_i2c_id, i2c_addr_num, (rd_size) ? rd_size : (wr_size - 1), (0 != rd_size))) { goto fail; }
+
+    const uint8_t addr_wr = i2c_addr_num << 1 | I2C_MASTER_WRITE;
+    const uint8_t addr_rd = i2c_addr_num << 1 | I2C_MASTER_READ;
+
+    if (!(i2c_cmd = i2c_cmd_link_create())) { goto fail; }
+
+    // 1A Write phase. PEC runs over the bytes as they are queued.
+    if (wr_size) {
+        crc_num = sys_i2c_smbus_pec(crc_num, &addr_wr, 1);
+        crc_num = sys_i2c_smbus_pec(crc_num, wr_addr, wr_size);
+        if (ESP_OK != i2c_master_start(i2c_cmd)) { goto fail; }
+        if (ESP_OK != i2c_master_write_byte(i2c_cmd, addr_wr, ESP32_I2C_ACK_CHECK_EN)) { goto fail; }
+        if (ESP_OK != i2c_master_write(i2c_cmd, wr_addr, wr_size, ESP32_I2C_ACK_CHECK_EN)) { goto fail; }
+        if (pec_flag && !rd_size) {
+            if (ESP_OK != i2c_master_write_byte(i2c_cmd, crc_num, ESP32_I2C_ACK_CHECK_EN)) { goto fail; }
+        }
+    }
+
+    // 1B Read phase, (repeated) START. Last byte on the wire NACKed: PEC if pec_flag, else data.
+    if (rd_size) {
+        crc_num = sys_i2c_smbus_pec(crc_num, &addr_rd, 1);
+        if (ESP_OK != i2c_master_start(i2c_cmd)) { goto fail; }
+        if (ESP_OK != i2c_master_write_byte(i2c_cmd, addr_rd, ESP32_I2C_ACK_CHECK_EN)) { goto fail; }
+        if (pec_flag) {
+            if (ESP_OK != i2c_master_read(i2c_cmd, rd_addr, rd_size, ESP32_I2C_ACK_VAL)) { goto fail; }
+            if (ESP_OK != i2c_master_read_byte(i2c_cmd, &pec_num, ESP32_I2C_NACK_VAL)) { goto fail; }
+        } else {
+            if (rd_size > 1) { if (ESP_OK != i2c_master_read(i2c_cmd, rd_addr, (rd_size - 1), ESP32_I2C_ACK_VAL)) { goto fail; } }
+            if (ESP_OK != i2c_master_read_byte(i2c_cmd, (rd_addr + rd_size - 1), ESP32_I2C_NACK_VAL)) { goto fail; }
+        }
+    }
+    if (ESP_OK != i2c_master_stop(i2c_cmd)) { goto fail; }
+
+    if (!sys_i2c_smbus_exec(sys_i2c_id, i2c_addr_num, i2c_cmd)) { goto fail; }
+    i2c_cmd_link_delete(i2c_cmd);
+    i2c_cmd = 0;
+
+    // 2A Read PEC continues from the write phase.
+    if (pec_flag && rd_size) {
+        crc_num = sys_i2c_smbus_pec(crc_num, rd_addr, rd_size);
+        if (crc_num != pec_num) { goto fail; }
+    }
+
+    TRACE_PASS;
+    SYS_I2C_SMBUS_CAPTURE(wr_addr, wr_size, rd_size, capture_us, true);
+    return (true);
+  fail:
+    TRACE_FAIL;
+    if (i2c_cmd) { i2c_cmd_link_delete(i2c_cmd); }
+    SYS_I2C_SMBUS_CAPTURE(wr_addr, wr_size, rd_size, capture_us, false);
+    return (false);
+} // end: sys_i2c_smbus_xfer()
+
+// @brief Run one composed i2c_cmd program: port lock, attach at the i2c_addr_num clock profile, execute, detach, unlock.
+//
+static bool sys_i2c_smbus_exec(uint8_t sys_i2c_id, uint8_t i2c_addr_num, i2c_cmd_handle_t i2c_cmd)
+{
+    TRACE_ENTER;
+    bool lock_taken = false;
+
+    const i2c_port_t port_num = SYS_I2C_runtime.unit[sys_i2c_id].port_num;
+    SYS_I2C_WCOMB_HOOK(sys_i2c_id, i2c_addr_num); // deferred writes to this device go first
+
+    // start: Task Safe
+    if (!sys_i2c_port_take(sys_i2c_id)) { goto fail; }
+    lock_taken = true;
+    if (!sys_i2c_attach_pins(sys_i2c_id, i2c_addr_num)) { goto fail; }
+    if (ESP_OK != i2c_master_cmd_begin(port_num, i2c_cmd, SYS_I2C_SMBUS_TIMEOUT_TICK)) { goto fail; }
+    if (!sys_i2c_detach_pins(sys_i2c_id)) { goto fail; }
+    lock_taken = false;
+    if (!sys_i2c_port_give(sys_i2c_id)) { goto fail; }
+    // end: Task Safe
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    if (lock_taken) {
+        (void)sys_i2c_detach_pins(sys_i2c_id);
+        (void)sys_i2c_port_give(sys_i2c_id);
+    }
+    return (false);
+} // end: sys_i2c_smbus_exec()
+
+/* EOF sys_i2c_smbus.c */
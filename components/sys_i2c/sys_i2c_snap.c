@@ -0,0 +1,146 @@
+// @file    sys_i2c_snap.c
+//
+// @brief  SYS_I2C snapshot: seqlock published I2C register blocks. One producer, many lock-free consumers.
+//
+// @details
+// - Producer: sys_i2c_read() into a local buffer, then publish. The I2C port lock is NOT held while publishing.
+// - Consumers: copy out between two reads of .seq. No mutex, no critical section, no I2C Bus access.
+// - GCC __atomic builtins give the cross-core ordering; ESP32 dual core and ESP32-S2 single core alike.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+static const char * TAG = "sys_i2c_snap";
+#include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
+#include "sys_i2c_snap.h" // includes app_config.h, sys_i2c.h
+
+#include <string.h> // memset()
+#include "esp_timer.h" // esp_timer_get_time()
+#include "esp_rom_sys.h" // esp_rom_delay_us()
+
+// helper: byte copy that the compiler can not merge or move across the seqlock sequence reads.
+static void sys_i2c_snap_copy(volatile uint8_t * dst_addr, const volatile uint8_t * src_addr, size_t size);
+
+// @brief Initialize snapshot source, nothing published yet.
+//
+bool sys_i2c_snap_init(struct SYS_I2C_SNAP * snap_addr, uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, size_t data_size)
+{
+    TRACE_ENTER;
+    if (!snap_addr) { goto fail; }
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    if (!(SYS_I2C_ADDR_INVALID > i2c_addr_num)) { goto fail; }
+    if (!data_size) { goto fail; }
+    if (SYS_I2C_SNAP_DATA_MAX < data_size) { goto fail; }
+
+    memset(snap_addr, 0, sizeof(*snap_addr));
+    snap_addr->sys_i2c_id   = sys_i2c_id;
+    snap_addr->i2c_addr_num = i2c_addr_num;
+    snap_addr->i2c_reg_num  = i2c_reg_num;
+    snap_addr->data_size    = data_size;
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_snap_init()
+
+// @brief Producer: I2C read, then publish. Port lock held only for the sys_i2c_read().
+//
+bool sys_i2c_snap_update(struct SYS_I2C_SNAP * snap_addr)
+{
+    TRACE_ENTER;
+    uint8_t buf_addr[SYS_I2C_SNAP_DATA_MAX];
+
+    if (!snap_addr) { goto fail; }
+    if (!sys_i2c_read(snap_addr->sys_i2c_id, snap_addr->i2c_addr_num, snap_addr->i2c_reg_num, buf_addr, snap_addr->data_size)) { goto fail; }
+    if (!sys_i2c_snap_publish(snap_addr, buf_addr, snap_addr->data_size)) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_snap_update()
+
+// @brief Producer: seqlock write side.
+// 1. .seq odd, consumers now retry.
+// 2. copy data, timestamp.
+// 3. .seq even, release: data stores visible before the new .seq. 0 means never published: the wrap skips it.
+//
+bool sys_i2c_snap_publish(struct SYS_I2C_SNAP * snap_addr, const uint8_t * buf_addr, size_t buf_size)
+{
+    TRACE_ENTER;
+    if (!snap_addr) { goto fail; }
+    if (!buf_addr) { goto fail; }
+    if (snap_addr->data_size != buf_size) { goto fail; }
+
+    const int64_t  time_us = esp_timer_get_time();
+    const uint32_t seq     = __atomic_load_n(&snap_addr->seq, __ATOMIC_RELAXED); // single producer, always even here
+    const uint32_t seq_new = (seq + 2U) ? (seq + 2U) : 2U;                      // 2^31 publishes: 0xFFFFFFFE, then 2
+
+    __atomic_store_n(&snap_addr->seq, seq + 1, __ATOMIC_RELAXED); // 1. odd
+    __atomic_thread_fence(__ATOMIC_RELEASE);                       //    odd .seq before any data store
+
+    sys_i2c_snap_copy(snap_addr->data, buf_addr, buf_size);         // 2.
+    snap_addr->time_us = time_us;
+
+    __atomic_store_n(&snap_addr->seq, seq_new, __ATOMIC_RELEASE);   // 3. even
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_snap_publish()
+
+// @brief Consumer: seqlock read side. No lock, no wait; a race with the producer spins, bounded by time.
+// TASK SAFE: YES
+//
+bool sys_i2c_snap_read(const struct SYS_I2C_SNAP * snap_addr, uint8_t * buf_addr, size_t buf_size, int64_t * time_us_addr, uint32_t * seq_addr)
+{
+    TRACE_ENTER;
+    int64_t  end_us = 0;                // spin deadline, set on the first race
+    uint32_t seq_1 = 0;
+    uint32_t seq_2;
+    int64_t  time_us = 0;
+
+    if (!snap_addr) { goto fail; }
+    if (!buf_addr) { goto fail; }
+    if (!buf_size) { goto fail; }
+    if (snap_addr->data_size < buf_size) { goto fail; }
+
+    for (;;) {
+        seq_1 = __atomic_load_n(&snap_addr->seq, __ATOMIC_ACQUIRE);
+        if (!seq_1) { goto fail; }      // never published
+        if (!(seq_1 & 1U)) {
+            sys_i2c_snap_copy(buf_addr, snap_addr->data, buf_size);
+            time_us = snap_addr->time_us;
+
+            __atomic_thread_fence(__ATOMIC_ACQUIRE); // data loads before the 2nd .seq load
+            seq_2 = __atomic_load_n(&snap_addr->seq, __ATOMIC_RELAXED);
+            if (seq_1 == seq_2) { goto pass; }
+        }
+
+        // Raced a publish: pause, poll again. Clock read only on this slow path.
+        if (!end_us) { end_us = esp_timer_get_time() + SYS_I2C_SNAP_SPIN_MAX_US; }
+        else if (end_us <= esp_timer_get_time()) { goto fail; } // producer preempted mid-publish
+        esp_rom_delay_us(1);
+    }
+
+  pass:
+    if (time_us_addr) { *time_us_addr = time_us; }
+    if (seq_addr) { *seq_addr = seq_1; }
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_snap_read()
+
+static void sys_i2c_snap_copy(volatile uint8_t * dst_addr, const volatile uint8_t * src_addr, size_t size)
+{
+    while (size--) { *dst_addr++ = *src_addr++; }
+} // end: sys_i2c_snap_copy()
+
+/* EOF sys_i2c_snap.c */
@@ -0,0 +1,324 @@
+// @file    sys_i2c_stream.c
+//
+// @brief  SYS_I2C stream: continuous I2C FIFO burst reads into a ring of buffers, one shared service task.
+//
+// @details
+// - Trigger: esp_timer periodic callback and/or data-ready GPIO ISR. Each only queues the stream to the service task.
+// - Service task: one burst per trigger, sys_i2c_read() straight into a free ring buffer. No copy to the consumer.
+// - Ring: two FreeRTOS queues of buffer indexes, free_queue and full_queue. Ring order kept: FIFO in, FIFO out.
+// - Overrun: a trigger while the previous one is still queued, or no free buffer. Counted, never blocks the service task.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+static const char * TAG = "sys_i2c_stream";
+#include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
+#include "sys_i2c_stream.h" // includes app_config.h, sys_i2c.h
+
+#include <string.h> // memset()
+#include "freertos/task.h"
+#include "esp_heap_caps.h" // heap_caps_malloc(), MALLOC_CAP_DMA
+
+#define SYS_I2C_STREAM_TASK_NAME        "sys_i2c_stream"
+#define SYS_I2C_STREAM_TASK_STACK       (3072U)
+#define SYS_I2C_STREAM_TASK_PRIORITY    (configMAX_PRIORITIES - 2) // High: a late burst is a FIFO overflow
+#define SYS_I2C_STREAM_QUEUE_LEN        (16U)  // Pending triggers, all streams
+#define SYS_I2C_STREAM_BUF_ALIGN        (4U)   // Word aligned ring buffers
+
+// One service task for all streams.
+// GLOBAL RAM
+//
+static struct {
+    QueueHandle_t                   queue;      // struct SYS_I2C_STREAM *, one entry per trigger
+    volatile TaskHandle_t           task;
+    volatile bool                   claimed;    // service creation started
+    struct SYS_I2C_STREAM * volatile busy_addr; // stream with a burst in progress, or NULL
+    bool                            isr_installed;
+} sys_i2c_stream_service;
+static portMUX_TYPE sys_i2c_stream_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool sys_i2c_stream_service_init(void);
+static void sys_i2c_stream_service_task(void * arg);
+static void sys_i2c_stream_timer_cb(void * arg);
+static void IRAM_ATTR sys_i2c_stream_drdy_isr(void * arg);
+static void sys_i2c_stream_free(struct SYS_I2C_STREAM * stream_addr);
+
+// @brief Validate config, allocate ring, start triggers.
+//
+bool sys_i2c_stream_start(struct SYS_I2C_STREAM * stream_addr, const struct SYS_I2C_STREAM_CONFIG * config_addr)
+{
+    TRACE_ENTER;
+    uint8_t buf_idx;
+
+    if (!stream_addr) { goto fail; }
+    if (!config_addr) { goto fail; }
+    memset(stream_addr, 0, sizeof(*stream_addr));
+
+    if (!(SYS_I2C_ID_CNT > config_addr->sys_i2c_id)) { goto fail; }
+    if (!(SYS_I2C_ADDR_INVALID > config_addr->i2c_addr_num)) { goto fail; }
+    if (!config_addr->buf_size) { goto fail; }
+    if (2U > config_addr->buf_cnt) { goto fail; }
+    if (SYS_I2C_STREAM_BUF_CNT_MAX < config_addr->buf_cnt) { goto fail; }
+    if (!config_addr->period_us && (GPIO_NUM_NC == config_addr->drdy_io_num)) { goto fail; } // no trigger
+    stream_addr->config = *config_addr;
+
+    if (!sys_i2c_stream_service_init()) { goto fail; }
+
+    // 1A Ring: buffers, and queues of buffer indexes. All buffers start free.
+    if (!(stream_addr->free_queue = xQueueCreate(config_addr->buf_cnt, sizeof(uint8_t)))) { goto fail; }
+    if (!(stream_addr->full_queue = xQueueCreate(config_addr->buf_cnt, sizeof(uint8_t)))) { goto fail; }
+    for (buf_idx = 0; config_addr->buf_cnt > buf_idx; ++buf_idx) {
+        const size_t buf_size = (config_addr->buf_size + SYS_I2C_STREAM_BUF_ALIGN - 1) & ~(SYS_I2C_STREAM_BUF_ALIGN - 1);
+        if (!(stream_addr->buf_addr[buf_idx] = heap_caps_malloc(buf_size, MALLOC_CAP_DMA | MALLOC_CAP_8BIT))) { goto fail; }
+        if (pdTRUE != xQueueSend(stream_addr->free_queue, &buf_idx, 0)) { goto fail; }
+    }
+    stream_addr->running = true;
+
+    // 2A Periodic trigger.
+    if (config_addr->period_us) {
+        const esp_timer_create_args_t timer_args = {
+            .callback           = sys_i2c_stream_timer_cb,
+            .arg                = stream_addr,
+            .dispatch_method    = ESP_TIMER_TASK,
+            .name               = SYS_I2C_STREAM_TASK_NAME,
+        };
+        if (ESP_OK != esp_timer_create(&timer_args, &stream_addr->timer)) { goto fail; }
+        if (ESP_OK != esp_timer_start_periodic(stream_addr->timer, config_addr->period_us)) { goto fail; }
+    }
+
+    // 2B Data-ready trigger. ISR service shared with the application; already installed is OK.
+    if (GPIO_NUM_NC != config_addr->drdy_io_num) {
+        const gpio_config_t cfg_gpio = {
+            .pin_bit_mask   = BIT64(config_addr->drdy_io_num),
+            .mode           = GPIO_MODE_INPUT,
+            .pull_up_en     = false,
+            .pull_down_en   = false,
+            .intr_type      = config_addr->drdy_intr_type,
+        };
+        if (ESP_OK != gpio_config(&cfg_gpio)) { goto fail; }
+        if (!sys_i2c_stream_service.isr_installed) {
+            const esp_err_t esp_err = gpio_install_isr_service(0);
+            if ((ESP_OK != esp_err) && (ESP_ERR_INVALID_STATE != esp_err)) { goto fail; }
+            sys_i2c_stream_service.isr_installed = true;
+        }
+        if (ESP_OK != gpio_isr_handler_add(config_addr->drdy_io_num, sys_i2c_stream_drdy_isr, stream_addr)) { goto fail; }
+        stream_addr->drdy_enabled = true;
+    }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    if (stream_addr) { (void)sys_i2c_stream_stop(stream_addr); }
+    return (false);
+} // end: sys_i2c_stream_start()
+
+// @brief Stop triggers, let the service task finish with this stream, free ring.
+//
+bool sys_i2c_stream_stop(struct SYS_I2C_STREAM * stream_addr)
+{
+    TRACE_ENTER;
+    if (!stream_addr) { goto fail; }
+
+    stream_addr->running = false;
+    if (stream_addr->timer) {
+        (void)esp_timer_stop(stream_addr->timer);
+        (void)esp_timer_delete(stream_addr->timer);
+        stream_addr->timer = NULL;
+    }
+    if (stream_addr->drdy_enabled) {
+        (void)gpio_isr_handler_remove(stream_addr->config.drdy_io_num);
+        stream_addr->drdy_enabled = false;
+    }
+
+    // A queued trigger is dropped by the service task once .running is false; a burst in progress completes.
+    while (stream_addr->trigger_pending || (stream_addr == sys_i2c_stream_service.busy_addr)) {
+        vTaskDelay(1);
+    }
+    sys_i2c_stream_free(stream_addr);
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_stream_stop()
+
+// @brief Consumer: oldest full buffer, zero-copy.
+//
+bool sys_i2c_stream_get(struct SYS_I2C_STREAM * stream_addr, uint8_t ** buf_addr_addr, size_t * buf_size_addr, int64_t * time_us_addr, TickType_t ticks_to_wait)
+{
+    TRACE_ENTER;
+    uint8_t buf_idx;
+
+    if (!stream_addr) { goto fail; }
+    if (!buf_addr_addr) { goto fail; }
+    if (!buf_size_addr) { goto fail; }
+    if (!stream_addr->full_queue) { goto fail; }
+
+    if (pdTRUE != xQueueReceive(stream_addr->full_queue, &buf_idx, ticks_to_wait)) { goto fail; }
+    *buf_addr_addr = stream_addr->buf_addr[buf_idx];
+    *buf_size_addr = stream_addr->config.buf_size;
+    if (time_us_addr) { *time_us_addr = stream_addr->time_us[buf_idx]; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_stream_get()
+
+// @brief Consumer: buffer back to the free list.
+//
+bool sys_i2c_stream_put(struct SYS_I2C_STREAM * stream_addr, const uint8_t * buf_addr)
+{
+    TRACE_ENTER;
+    uint8_t buf_idx;
+
+    if (!stream_addr) { goto fail; }
+    if (!buf_addr) { goto fail; }
+    if (!stream_addr->free_queue) { goto fail; }
+
+    for (buf_idx = 0; stream_addr->config.buf_cnt > buf_idx; ++buf_idx) {
+        if (buf_addr == stream_addr->buf_addr[buf_idx]) { break; }
+    }
+    if (!(stream_addr->config.buf_cnt > buf_idx)) { goto fail; } // not a ring buffer of this stream
+    if (pdTRUE != xQueueSend(stream_addr->free_queue, &buf_idx, 0)) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_stream_put()
+
+bool sys_i2c_stream_stats(const struct SYS_I2C_STREAM * stream_addr, uint32_t * burst_cnt_addr, uint32_t * overrun_cnt_addr, uint32_t * error_cnt_addr)
+{
+    TRACE_ENTER;
+    if (!stream_addr) { goto fail; }
+
+    if (burst_cnt_addr)   { *burst_cnt_addr   = stream_addr->burst_cnt; }
+    if (overrun_cnt_addr) { *overrun_cnt_addr = __atomic_load_n(&stream_addr->overrun_cnt, __ATOMIC_RELAXED); }
+    if (error_cnt_addr)   { *error_cnt_addr   = stream_addr->error_cnt; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_stream_stats()
+
+// @brief Create the one service task and its trigger queue, once.
+//
+static bool sys_i2c_stream_service_init(void)
+{
+    TRACE_ENTER;
+    bool create;
+
+    // Claim creation in the critical section, create outside it: no heap calls in a critical section.
+    portENTER_CRITICAL(&sys_i2c_stream_mux);
+    create = !sys_i2c_stream_service.claimed;
+    sys_i2c_stream_service.claimed = true;
+    portEXIT_CRITICAL(&sys_i2c_stream_mux);
+
+    if (!create) {
+        while (sys_i2c_stream_service.claimed && !sys_i2c_stream_service.task) { vTaskDelay(1); } // another task is creating
+        if (!sys_i2c_stream_service.task) { goto fail; }
+        goto pass;
+    }
+    if (!(sys_i2c_stream_service.queue = xQueueCreate(SYS_I2C_STREAM_QUEUE_LEN, sizeof(struct SYS_I2C_STREAM *)))) { goto fail_create; }
+    if (pdPASS != xTaskCreate(sys_i2c_stream_service_task, SYS_I2C_STREAM_TASK_NAME, SYS_I2C_STREAM_TASK_STACK,
+                              NULL, SYS_I2C_STREAM_TASK_PRIORITY, (TaskHandle_t *)&sys_i2c_stream_service.task)) { goto fail_create; }
+
+  pass:
+    TRACE_PASS;
+    return (true);
+  fail_create:
+    if (sys_i2c_stream_service.queue) { vQueueDelete(sys_i2c_stream_service.queue); }
+    sys_i2c_stream_service.queue = NULL;
+    sys_i2c_stream_service.claimed = false;
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_stream_service_init()
+
+// @brief One burst per trigger, any stream. Never blocks on a full ring.
+//
+static void sys_i2c_stream_service_task(void * arg)
+{
+    struct SYS_I2C_STREAM * stream_addr;
+    uint8_t buf_idx;
+
+    for (;;) {
+        if (pdTRUE != xQueueReceive(sys_i2c_stream_service.queue, &stream_addr, portMAX_DELAY)) { continue; }
+        sys_i2c_stream_service.busy_addr = stream_addr;
+        __atomic_store_n(&stream_addr->trigger_pending, 0, __ATOMIC_RELEASE);
+
+        if (!stream_addr->running) { goto next; }
+        if (pdTRUE != xQueueReceive(stream_addr->free_queue, &buf_idx, 0)) {
+            (void)__atomic_fetch_add(&stream_addr->overrun_cnt, 1, __ATOMIC_RELAXED); // consumer too slow
+            goto next;
+        }
+        if (!sys_i2c_read(stream_addr->config.sys_i2c_id, stream_addr->config.i2c_addr_num, stream_addr->config.i2c_reg_num,
+                          stream_addr->buf_addr[buf_idx], stream_addr->config.buf_size)) {
+            stream_addr->error_cnt++;
+            (void)xQueueSend(stream_addr->free_queue, &buf_idx, 0);
+            goto next;
+        }
+        stream_addr->time_us[buf_idx] = esp_timer_get_time();
+        stream_addr->burst_cnt++;
+        (void)xQueueSend(stream_addr->full_queue, &buf_idx, 0); // never full: ring holds buf_cnt indexes total
+      next:
+        sys_i2c_stream_service.busy_addr = NULL;
+    }
+} // end: sys_i2c_stream_service_task()
+
+// @brief esp_timer task context. Queue the stream unless a trigger is already pending.
+//
+static void sys_i2c_stream_timer_cb(void * arg)
+{
+    struct SYS_I2C_STREAM * stream_addr = arg;
+
+    if (__atomic_exchange_n(&stream_addr->trigger_pending, 1, __ATOMIC_ACQ_REL)) {
+        (void)__atomic_fetch_add(&stream_addr->overrun_cnt, 1, __ATOMIC_RELAXED); // trigger faster than the I2C Bus
+        return;
+    }
+    if (pdTRUE != xQueueSend(sys_i2c_stream_service.queue, &stream_addr, 0)) {
+        __atomic_store_n(&stream_addr->trigger_pending, 0, __ATOMIC_RELEASE);
+        (void)__atomic_fetch_add(&stream_addr->overrun_cnt, 1, __ATOMIC_RELAXED);
+    }
+} // end: sys_i2c_stream_timer_cb()
+
+// @brief Data-ready GPIO ISR. Same as the timer callback, from ISR.
+//
+static void IRAM_ATTR sys_i2c_stream_drdy_isr(void * arg)
+{
+    struct SYS_I2C_STREAM * stream_addr = arg;
+    BaseType_t task_woken = pdFALSE;
+
+    if (__atomic_exchange_n(&stream_addr->trigger_pending, 1, __ATOMIC_ACQ_REL)) {
+        (void)__atomic_fetch_add(&stream_addr->overrun_cnt, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    if (pdTRUE != xQueueSendFromISR(sys_i2c_stream_service.queue, &stream_addr, &task_woken)) {
+        __atomic_store_n(&stream_addr->trigger_pending, 0, __ATOMIC_RELEASE);
+        (void)__atomic_fetch_add(&stream_addr->overrun_cnt, 1, __ATOMIC_RELAXED);
+    }
+    if (task_woken) { portYIELD_FROM_ISR(); }
+} // end: sys_i2c_stream_drdy_isr()
+
+static void sys_i2c_stream_free(struct SYS_I2C_STREAM * stream_addr)
+{
+    uint8_t buf_idx;
+
+    for (buf_idx = 0; SYS_I2C_STREAM_BUF_CNT_MAX > buf_idx; ++buf_idx) {
+        if (stream_addr->buf_addr[buf_idx]) { heap_caps_free(stream_addr->buf_addr[buf_idx]); }
+        stream_addr->buf_addr[buf_idx] = NULL;
+    }
+    if (stream_addr->free_queue) { vQueueDelete(stream_addr->free_queue); }
+    if (stream_addr->full_queue) { vQueueDelete(stream_addr->full_queue); }
+    stream_addr->free_queue = NULL;
+    stream_addr->full_queue = NULL;
+} // end: sys_i2c_stream_free()
+
+/* EOF sys_i2c_stream.c */
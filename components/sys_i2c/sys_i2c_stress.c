@@ -0,0 +1,333 @@
+// @file    sys_i2c_stress.c
+//
+// @brief  SYS_I2C stress harness: worker tasks, fault injection hook, post-run checks, chart.
+//
+// @details
+// - Workers write counters straight into the caller's report buckets, portMUX protected, no blocking inside.
+// - sys_i2c_fault_hook() runs inside sys_i2c.c with the port lock held; stuck_cnt[sys_i2c_id] is only touched there,
+//   so the port lock guards it. Fault counters share the worker portMUX.
+// - The run task owns the phases: it sleeps, flips fault_flag, sleeps again, then waits for every worker to exit.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+static const char * TAG = "sys_i2c_stress";
+#include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
+#include "sys_i2c_stress.h" // includes app_config.h, sys_i2c.h
+#include "sys_i2c_priv.h" // sys_i2c_fault_hook() prototype, SYS_I2C_FAULT_POINT_*
+
+#include <stdio.h> // printf()
+#include <string.h> // memset()
+#include "freertos/task.h"
+#include "esp_timer.h" // esp_timer_get_time()
+#include "esp_system.h" // esp_random()
+#include "esp_heap_caps.h" // heap_caps_get_free_size()
+#include "soc/gpio_reg.h" // GPIO_FUNC0_OUT_SEL_CFG_REG, output matrix readback
+#include "soc/gpio_sig_map.h" // SIG_GPIO_OUT_IDX
+
+#define SYS_I2C_STRESS_TASK_NAME        "sys_i2c_strs%d"
+#define SYS_I2C_STRESS_TASK_STACK       (2048U)
+#define SYS_I2C_STRESS_TASK_PRIORITY    (tskIDLE_PRIORITY + 2)
+#define SYS_I2C_STRESS_BAR_WIDTH        (40U)
+#define SYS_I2C_STRESS_SETTLE_TICK      (pdMS_TO_TICKS(100U)) // idle task frees deleted worker stacks
+
+static const char * const sys_i2c_fault_name[SYS_I2C_FAULT_CNT] = {
+    [SYS_I2C_FAULT_NACK]        = "NACK",
+    [SYS_I2C_FAULT_STRETCH]     = "STRETCH",
+    [SYS_I2C_FAULT_TIMEOUT]     = "TIMEOUT",
+    [SYS_I2C_FAULT_STUCK_SDA]   = "STUCK_SDA",
+    [SYS_I2C_FAULT_ALLOC]       = "ALLOC",
+};
+
+// GLOBAL RAM
+//
+static struct {
+    const struct SYS_I2C_STRESS_CONFIG * config_addr;
+    struct SYS_I2C_STRESS_REPORT *       report_addr;
+    int64_t             start_us;
+    int64_t             end_us;
+    volatile bool       fault_flag;                     // fault phase
+    uint32_t            stuck_cnt[SYS_I2C_ID_CNT];      // STUCK_SDA episode, transactions left
+    SemaphoreHandle_t   done_sem;                       // one give per worker exit
+    bool                busy;                           // one run at a time
+} sys_i2c_stress;
+static portMUX_TYPE sys_i2c_stress_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void sys_i2c_stress_task(void * arg);
+static void sys_i2c_stress_count(int64_t at_us, bool pass_flag, bool write_flag, uint32_t lat_us, int fault);
+static bool sys_i2c_stress_check(struct SYS_I2C_STRESS_REPORT * report_addr);
+
+bool sys_i2c_stress_run(const struct SYS_I2C_STRESS_CONFIG * config_addr, struct SYS_I2C_STRESS_REPORT * report_addr)
+{
+    TRACE_ENTER;
+    bool busy_taken = false;
+    uint32_t task_idx = 0;
+    uint32_t bucket_idx;
+    uint8_t fault_idx;
+    uint8_t sys_i2c_id;
+
+    if (!config_addr || !report_addr) { goto fail; }
+    const struct SYS_I2C_STRESS_CONFIG * const c = config_addr;
+    if (!c->task_cnt || (SYS_I2C_STRESS_TASK_MAX < c->task_cnt)) { goto fail; }
+    if (!c->bucket_ms || (c->warmup_ms % c->bucket_ms) || (c->fault_ms % c->bucket_ms) || (c->cooldown_ms % c->bucket_ms)) { goto fail; }
+    if ((2 * c->bucket_ms) > c->warmup_ms) { goto fail; }
+    if (!c->cooldown_ms) { goto fail; }
+    if (SYS_I2C_STRESS_BUCKET_MAX < ((c->warmup_ms + c->fault_ms + c->cooldown_ms) / c->bucket_ms)) { goto fail; }
+    if (!(SYS_I2C_ADDR_INVALID > c->i2c_addr_num)) { goto fail; }
+    if (SYS_I2C_STRESS_READ_MAX < c->read_size) { goto fail; }
+    if (c->task_cnt < c->write_task_cnt) { goto fail; }
+    if (c->write_task_cnt && !(SYS_I2C_ADDR_INVALID > c->write_addr_num)) { goto fail; }
+    if (c->write_task_cnt && (!c->write_size || (SYS_I2C_STRESS_WRITE_MAX < c->write_size))) { goto fail; }
+    for (fault_idx = 0; SYS_I2C_FAULT_CNT > fault_idx; ++fault_idx) {
+        if (c->fault_rate[fault_idx] && (SYS_I2C_FAULT_INJECT_ENABLE != true)) { goto fail; } // hooks compiled out
+    }
+
+    portENTER_CRITICAL(&sys_i2c_stress_mux);
+    if (!sys_i2c_stress.busy) { sys_i2c_stress.busy = busy_taken = true; }
+    portEXIT_CRITICAL(&sys_i2c_stress_mux);
+    if (!busy_taken) { goto fail; }
+
+    memset(report_addr, 0, sizeof(*report_addr));
+    report_addr->bucket_ms   = c->bucket_ms;
+    report_addr->bucket_cnt  = (c->warmup_ms + c->fault_ms + c->cooldown_ms) / c->bucket_ms;
+    report_addr->fault_first = c->warmup_ms / c->bucket_ms;
+    report_addr->fault_last  = (c->warmup_ms + c->fault_ms) / c->bucket_ms; // one past
+
+    // 1A Prime: one probe per bus installs lazy ports and the driver heap before the heap baseline.
+    for (sys_i2c_id = 0; SYS_I2C_ID_CNT > sys_i2c_id; ++sys_i2c_id) {
+        bool found_flag;
+        (void)sys_i2c_probe(sys_i2c_id, c->i2c_addr_num, &found_flag);
+    }
+    const size_t heap_before = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+
+    // 2A Workers, then the three phases.
+    if (!(sys_i2c_stress.done_sem = xSemaphoreCreateCounting(SYS_I2C_STRESS_TASK_MAX, 0))) { goto fail; }
+    memset(sys_i2c_stress.stuck_cnt, 0, sizeof(sys_i2c_stress.stuck_cnt));
+    sys_i2c_stress.fault_flag  = false;
+    sys_i2c_stress.config_addr = c;
+    sys_i2c_stress.report_addr = report_addr;
+    sys_i2c_stress.start_us    = esp_timer_get_time();
+    sys_i2c_stress.end_us      = sys_i2c_stress.start_us + (1000LL * report_addr->bucket_cnt * c->bucket_ms);
+
+    for (task_idx = 0; c->task_cnt > task_idx; ++task_idx) {
+        char task_name[configMAX_TASK_NAME_LEN];
+        (void)snprintf(task_name, sizeof(task_name), SYS_I2C_STRESS_TASK_NAME, task_idx);
+        if (pdPASS != xTaskCreate(sys_i2c_stress_task, task_name, SYS_I2C_STRESS_TASK_STACK, (void *)(uintptr_t)task_idx,
+                                  SYS_I2C_STRESS_TASK_PRIORITY, NULL)) { goto fail; }
+    }
+    vTaskDelay(pdMS_TO_TICKS(c->warmup_ms));
+    sys_i2c_stress.fault_flag = true;
+    vTaskDelay(pdMS_TO_TICKS(c->fault_ms));
+    sys_i2c_stress.fault_flag = false;
+
+    // 3A Wait for every worker, then settle and check.
+    for (; task_idx; --task_idx) { (void)xSemaphoreTake(sys_i2c_stress.done_sem, portMAX_DELAY); }
+    vSemaphoreDelete(sys_i2c_stress.done_sem);
+    sys_i2c_stress.done_sem = NULL;
+    vTaskDelay(SYS_I2C_STRESS_SETTLE_TICK);
+    report_addr->heap_delta = (int32_t)heap_caps_get_free_size(MALLOC_CAP_8BIT) - (int32_t)heap_before;
+
+    for (bucket_idx = 1; report_addr->fault_first > bucket_idx; ++bucket_idx) { // bucket 0: worker start-up
+        report_addr->baseline_op_cnt += report_addr->bucket[bucket_idx].op_cnt;
+    }
+    report_addr->baseline_op_cnt /= (report_addr->fault_first - 1);
+    report_addr->recovery_op_cnt  = report_addr->bucket[report_addr->bucket_cnt - 1].op_cnt;
+
+    report_addr->pass_flag = sys_i2c_stress_check(report_addr);
+    sys_i2c_stress.busy = false;
+    if (!report_addr->pass_flag) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    if (sys_i2c_stress.done_sem) {
+        // workers already started stop at end_us; wait for them before the report goes out of scope
+        for (; task_idx; --task_idx) { (void)xSemaphoreTake(sys_i2c_stress.done_sem, portMAX_DELAY); }
+        vSemaphoreDelete(sys_i2c_stress.done_sem);
+        sys_i2c_stress.done_sem = NULL;
+    }
+    if (busy_taken) { sys_i2c_stress.busy = false; }
+    return (false);
+} // end: sys_i2c_stress_run()
+
+bool sys_i2c_stress_print(const struct SYS_I2C_STRESS_REPORT * report_addr)
+{
+    TRACE_ENTER;
+    uint32_t op_max = 1;
+    uint32_t bucket_idx;
+    uint8_t fault_idx;
+
+    if (!report_addr) { goto fail; }
+    const struct SYS_I2C_STRESS_REPORT * const r = report_addr;
+
+    printf("\nI2C STRESS: %s\n", (r->pass_flag) ? "PASS" : "FAIL");
+    printf("ops = %u, fail = %u; writes = %u, write fail = %u\n", r->op_cnt, r->fail_cnt, r->write_op_cnt, r->write_fail_cnt);
+    for (fault_idx = 0; SYS_I2C_FAULT_CNT > fault_idx; ++fault_idx) {
+        printf("fault %-9s = %u\n", sys_i2c_fault_name[fault_idx], r->fault_cnt[fault_idx]);
+    }
+    printf("lock leaks = %u, misrouted pins = %u, heap delta = %d bytes\n", r->lock_leak_cnt, r->pin_misroute_cnt, r->heap_delta);
+    printf("ops/bucket: baseline = %u, recovery = %u (>= %u%% required)\n", r->baseline_op_cnt, r->recovery_op_cnt, SYS_I2C_STRESS_RECOVER_PCT);
+
+    for (bucket_idx = 0; r->bucket_cnt > bucket_idx; ++bucket_idx) {
+        if (op_max < r->bucket[bucket_idx].op_cnt) { op_max = r->bucket[bucket_idx].op_cnt; }
+    }
+    printf("\n     ms  F    ops   fail  fault  lat_avg  lat_max  throughput\n");
+    for (bucket_idx = 0; r->bucket_cnt > bucket_idx; ++bucket_idx) {
+        const struct SYS_I2C_STRESS_BUCKET * const b = &r->bucket[bucket_idx];
+        const bool fault_phase = (r->fault_first <= bucket_idx) && (r->fault_last > bucket_idx);
+        const uint32_t lat_avg = (b->op_cnt) ? (uint32_t)(b->lat_sum_us / b->op_cnt) : 0;
+        uint32_t bar = (b->op_cnt * SYS_I2C_STRESS_BAR_WIDTH) / op_max;
+
+        printf("%7u  %c %6u %6u %6u %8u %8u  ", bucket_idx * r->bucket_ms, (fault_phase) ? '*' : ' ',
+               b->op_cnt, b->fail_cnt, b->fault_cnt, lat_avg, b->lat_max_us);
+        while (bar--) { printf("#"); }
+        printf("\n");
+    }
+    printf("\n");
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_stress_print()
+
+#if (SYS_I2C_FAULT_INJECT_ENABLE == true)
+// @brief Called by sys_i2c.c at each fault point, port lock held. Returns esp_err, or the injected one.
+//
+esp_err_t sys_i2c_fault_hook(uint8_t sys_i2c_id, uint8_t fault_point, esp_err_t esp_err)
+{
+    if (!sys_i2c_stress.fault_flag) { return (esp_err); }
+    const uint16_t * const rate = sys_i2c_stress.config_addr->fault_rate;
+    const int64_t at_us = esp_timer_get_time();
+
+    if (SYS_I2C_FAULT_POINT_ALLOC == fault_point) {
+        if ((esp_random() & 0xFFFFU) >= rate[SYS_I2C_FAULT_ALLOC]) { return (esp_err); }
+        sys_i2c_stress_count(at_us, true, false, 0, SYS_I2C_FAULT_ALLOC);
+        return (ESP_ERR_NO_MEM);
+    }
+
+    // SYS_I2C_FAULT_POINT_EXEC. A stuck episode continues first, then one roll per fault kind.
+    if (sys_i2c_stress.stuck_cnt[sys_i2c_id]) {
+        sys_i2c_stress.stuck_cnt[sys_i2c_id]--;
+        vTaskDelay(SYS_I2C_STRESS_TIMEOUT_TICK);
+        return (ESP_ERR_TIMEOUT);
+    }
+    if ((esp_random() & 0xFFFFU) < rate[SYS_I2C_FAULT_STUCK_SDA]) {
+        sys_i2c_stress.stuck_cnt[sys_i2c_id] = SYS_I2C_STRESS_STUCK_OPS - 1;
+        sys_i2c_stress_count(at_us, true, false, 0, SYS_I2C_FAULT_STUCK_SDA);
+        vTaskDelay(SYS_I2C_STRESS_TIMEOUT_TICK);
+        return (ESP_ERR_TIMEOUT);
+    }
+    if ((esp_random() & 0xFFFFU) < rate[SYS_I2C_FAULT_TIMEOUT]) {
+        sys_i2c_stress_count(at_us, true, false, 0, SYS_I2C_FAULT_TIMEOUT);
+        vTaskDelay(SYS_I2C_STRESS_TIMEOUT_TICK);
+        return (ESP_ERR_TIMEOUT);
+    }
+    if ((esp_random() & 0xFFFFU) < rate[SYS_I2C_FAULT_STRETCH]) {
+        sys_i2c_stress_count(at_us, true, false, 0, SYS_I2C_FAULT_STRETCH);
+        vTaskDelay(SYS_I2C_STRESS_STRETCH_TICK);
+        return (esp_err);
+    }
+    if ((esp_random() & 0xFFFFU) < rate[SYS_I2C_FAULT_NACK]) {
+        sys_i2c_stress_count(at_us, true, false, 0, SYS_I2C_FAULT_NACK);
+        return (ESP_FAIL);
+    }
+    return (esp_err);
+} // end: sys_i2c_fault_hook()
+#endif // SYS_I2C_FAULT_INJECT_ENABLE
+
+// @brief Worker: round-robin over all buses until end_us. arg: task index, staggers the first bus.
+// The last write_task_cnt workers write: the write path has its own NACK, detach and unlock handling.
+//
+static void sys_i2c_stress_task(void * arg)
+{
+    const struct SYS_I2C_STRESS_CONFIG * const c = sys_i2c_stress.config_addr;
+    const uint32_t task_idx = (uint32_t)(uintptr_t)arg;
+    const bool write_flag = ((uint32_t)(c->task_cnt - c->write_task_cnt) <= task_idx);
+    uint8_t buf[SYS_I2C_STRESS_READ_MAX];
+    uint32_t op_idx = task_idx;
+    int64_t at_us;
+
+    while (sys_i2c_stress.end_us > (at_us = esp_timer_get_time())) {
+        const uint8_t sys_i2c_id = op_idx++ % SYS_I2C_ID_CNT;
+        bool pass_flag;
+        bool found_flag;
+        uint8_t idx;
+
+        if (write_flag) {
+            for (idx = 0; c->write_size > idx; ++idx) { buf[idx] = (uint8_t)(op_idx + idx); } // new data every call
+            pass_flag = sys_i2c_write(sys_i2c_id, c->write_addr_num, c->write_reg_num, buf, c->write_size);
+        } else if (c->read_size) {
+            pass_flag = sys_i2c_read(sys_i2c_id, c->i2c_addr_num, c->i2c_reg_num, buf, c->read_size);
+        } else {
+            pass_flag = sys_i2c_probe(sys_i2c_id, c->i2c_addr_num, &found_flag);
+        }
+        sys_i2c_stress_count(at_us, pass_flag, write_flag, (uint32_t)(esp_timer_get_time() - at_us), -1);
+    }
+
+    (void)xSemaphoreGive(sys_i2c_stress.done_sem);
+    vTaskDelete(NULL);
+} // end: sys_i2c_stress_task()
+
+// @brief Add one completed call (fault < 0) or one injected fault to the bucket of at_us.
+//
+static void sys_i2c_stress_count(int64_t at_us, bool pass_flag, bool write_flag, uint32_t lat_us, int fault)
+{
+    struct SYS_I2C_STRESS_REPORT * const r = sys_i2c_stress.report_addr;
+    uint32_t bucket_idx = (uint32_t)((at_us - sys_i2c_stress.start_us) / (1000LL * r->bucket_ms));
+
+    if (r->bucket_cnt <= bucket_idx) { bucket_idx = r->bucket_cnt - 1; }
+    struct SYS_I2C_STRESS_BUCKET * const b = &r->bucket[bucket_idx];
+
+    portENTER_CRITICAL(&sys_i2c_stress_mux);
+    if (0 <= fault) {
+        r->fault_cnt[fault]++;
+        b->fault_cnt++;
+    } else {
+        r->op_cnt++;
+        b->op_cnt++;
+        b->lat_sum_us += lat_us;
+        if (b->lat_max_us < lat_us) { b->lat_max_us = lat_us; }
+        if (!pass_flag) { r->fail_cnt++; b->fail_cnt++; }
+        if (write_flag) { r->write_op_cnt++; }
+        if (write_flag && !pass_flag) { r->write_fail_cnt++; }
+    }
+    portEXIT_CRITICAL(&sys_i2c_stress_mux);
+} // end: sys_i2c_stress_count()
+
+// @brief Post-run checks: port locks free, pads back on GPIO, heap flat, throughput recovered.
+//
+static bool sys_i2c_stress_check(struct SYS_I2C_STRESS_REPORT * report_addr)
+{
+    TRACE_ENTER;
+    i2c_port_t port_num;
+    uint8_t sys_i2c_id;
+
+    for (port_num = 0; I2C_NUM_MAX > port_num; ++port_num) {
+        const SemaphoreHandle_t lock = SYS_I2C_runtime.port[port_num].lock;
+        if (lock && xSemaphoreGetMutexHolder(lock)) { report_addr->lock_leak_cnt++; }
+    }
+    for (sys_i2c_id = 0; SYS_I2C_ID_CNT > sys_i2c_id; ++sys_i2c_id) {
+        const uint32_t io_num[2] = { SYS_I2C_runtime.unit[sys_i2c_id].scl_io_num, SYS_I2C_runtime.unit[sys_i2c_id].sda_io_num };
+        uint8_t idx;
+        for (idx = 0; 2 > idx; ++idx) {
+            const uint32_t out_sel = REG_READ(GPIO_FUNC0_OUT_SEL_CFG_REG + (4 * io_num[idx])) & GPIO_FUNC0_OUT_SEL;
+            if (SIG_GPIO_OUT_IDX != out_sel) { report_addr->pin_misroute_cnt++; }
+        }
+    }
+
+    if (report_addr->lock_leak_cnt) { goto fail; }
+    if (report_addr->pin_misroute_cnt) { goto fail; }
+    if (-(int32_t)SYS_I2C_STRESS_HEAP_SLACK > report_addr->heap_delta) { goto fail; }
+    if (((uint64_t)report_addr->recovery_op_cnt * 100U) < ((uint64_t)report_addr->baseline_op_cnt * SYS_I2C_STRESS_RECOVER_PCT)) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_stress_check()
+
+/* EOF sys_i2c_stress.c */
@@ -0,0 +1,163 @@
+// @file    sys_i2c_vec.c
+//
+// @brief  SYS_I2C vectored transfers: one worker task per I2C_FSM port_num, caller runs one port_num itself.
+//
+// @details
+// - Job: the whole operation list, plus the port_num to run. Each runner skips operations on other ports.
+// - Completion: counting semaphore on the caller stack, one give per worker job. No heap per call.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+static const char * TAG = "sys_i2c_vec";
+#include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
+#include "sys_i2c_vec.h" // includes app_config.h, sys_i2c.h
+
+#include <stdio.h> // snprintf()
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+#define SYS_I2C_VEC_TASK_NAME       "sys_i2c_vec%d"
+#define SYS_I2C_VEC_TASK_STACK      (2048U)
+#define SYS_I2C_VEC_TASK_PRIORITY   (configMAX_PRIORITIES - 3) // Above application tasks, below sys_i2c_stream
+#define SYS_I2C_VEC_QUEUE_LEN       (4U)  // Pending jobs, per port_num
+
+struct SYS_I2C_VEC_JOB {
+    struct SYS_I2C_VEC_OP * op_addr;
+    size_t                  op_cnt;
+    i2c_port_t              port_num;
+    SemaphoreHandle_t       done_sem;
+};
+
+// GLOBAL RAM
+//
+static QueueHandle_t sys_i2c_vec_queue[I2C_NUM_MAX]; // NULL: port_num not used by any I2C Bus
+
+static bool sys_i2c_vec_run(struct SYS_I2C_VEC_OP * op_addr, size_t op_cnt, i2c_port_t port_num);
+static void sys_i2c_vec_task(void * arg);
+
+bool sys_i2c_vec_init(void)
+{
+    TRACE_ENTER;
+    char task_name[configMAX_TASK_NAME_LEN];
+    uint8_t sys_i2c_id;
+
+    for (sys_i2c_id = 0; SYS_I2C_ID_CNT > sys_i2c_id; ++sys_i2c_id) {
+        const i2c_port_t port_num = SYS_I2C_runtime.unit[sys_i2c_id].port_num;
+        if (sys_i2c_vec_queue[port_num]) { continue; } // one worker per port_num
+
+        if (!(sys_i2c_vec_queue[port_num] = xQueueCreate(SYS_I2C_VEC_QUEUE_LEN, sizeof(struct SYS_I2C_VEC_JOB)))) { goto fail; }
+        (void)snprintf(task_name, sizeof(task_name), SYS_I2C_VEC_TASK_NAME, port_num);
+        if (pdPASS != xTaskCreate(sys_i2c_vec_task, task_name, SYS_I2C_VEC_TASK_STACK,
+                                  sys_i2c_vec_queue[port_num], SYS_I2C_VEC_TASK_PRIORITY, NULL)) { goto fail; }
+    }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_vec_init()
+
+// @brief Hand every port_num but the first to its worker, run the first here, wait for the workers.
+// TASK SAFE: YES
+//
+bool sys_i2c_vec_xfer(struct SYS_I2C_VEC_OP * op_addr, size_t op_cnt)
+{
+    TRACE_ENTER;
+    StaticSemaphore_t done_buf; // caller stack, lives until every worker gave
+    SemaphoreHandle_t done_sem;
+    bool port_used[I2C_NUM_MAX] = { false };
+    uint32_t job_cnt = 0;
+    bool pass_flag = true;
+    size_t idx;
+    i2c_port_t port_idx;
+
+    if (!op_addr) { goto fail; }
+    if (!op_cnt) { goto fail; }
+
+    // 1A Validate all, before any I2C Bus activity.
+    for (idx = 0; op_cnt > idx; ++idx) {
+        op_addr[idx].pass_flag = false;
+        if (!(SYS_I2C_ID_CNT > op_addr[idx].sys_i2c_id)) { goto fail; }
+        port_used[SYS_I2C_runtime.unit[op_addr[idx].sys_i2c_id].port_num] = true;
+    }
+    const i2c_port_t self_port = SYS_I2C_runtime.unit[op_addr[0].sys_i2c_id].port_num;
+
+    // 2A Other port_num to the workers.
+    if (!(done_sem = xSemaphoreCreateCountingStatic(I2C_NUM_MAX, 0, &done_buf))) { goto fail; }
+    for (port_idx = 0; I2C_NUM_MAX > port_idx; ++port_idx) {
+        if (!port_used[port_idx] || (self_port == port_idx)) { continue; }
+
+        const struct SYS_I2C_VEC_JOB job = { .op_addr = op_addr, .op_cnt = op_cnt, .port_num = port_idx, .done_sem = done_sem };
+        if (!sys_i2c_vec_queue[port_idx] || (pdTRUE != xQueueSend(sys_i2c_vec_queue[port_idx], &job, portMAX_DELAY))) {
+            pass_flag = (sys_i2c_vec_run(op_addr, op_cnt, port_idx) && pass_flag); // no worker: run it here, serial
+            continue;
+        }
+        job_cnt++;
+    }
+
+    // 2B First port_num here, concurrently with the workers.
+    pass_flag = (sys_i2c_vec_run(op_addr, op_cnt, self_port) && pass_flag);
+
+    // 3A Wait for every worker job. done_sem is on this stack: never leave early.
+    while (job_cnt--) { (void)xSemaphoreTake(done_sem, portMAX_DELAY); }
+    vSemaphoreDelete(done_sem);
+
+    // 3B Worker results are in op_addr[].pass_flag.
+    for (idx = 0; op_cnt > idx; ++idx) {
+        if (!op_addr[idx].pass_flag) { pass_flag = false; }
+    }
+    if (!pass_flag) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_vec_xfer()
+
+// @brief Run the operations of one port_num, in list order.
+//
+static bool sys_i2c_vec_run(struct SYS_I2C_VEC_OP * op_addr, size_t op_cnt, i2c_port_t port_num)
+{
+    TRACE_ENTER;
+    bool pass_flag = true;
+    size_t idx;
+
+    for (idx = 0; op_cnt > idx; ++idx) {
+        struct SYS_I2C_VEC_OP * const op = &op_addr[idx];
+        if (port_num != SYS_I2C_runtime.unit[op->sys_i2c_id].port_num) { continue; }
+
+        if (SYS_I2C_VEC_WRITE == op->dir) {
+            op->pass_flag = sys_i2c_write(op->sys_i2c_id, op->i2c_addr_num, op->i2c_reg_num, op->buf_addr, op->buf_size);
+        } else {
+            op->pass_flag = sys_i2c_read(op->sys_i2c_id, op->i2c_addr_num, op->i2c_reg_num, op->buf_addr, op->buf_size);
+        }
+        if (!op->pass_flag) { pass_flag = false; } // keep going, per operation status
+    }
+
+    if (!pass_flag) { goto fail; }
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_vec_run()
+
+// @brief One worker per port_num. arg: its job queue.
+//
+static void sys_i2c_vec_task(void * arg)
+{
+    QueueHandle_t queue = arg;
+    struct SYS_I2C_VEC_JOB job;
+
+    for (;;) {
+        if (pdTRUE != xQueueReceive(queue, &job, portMAX_DELAY)) { continue; }
+        (void)sys_i2c_vec_run(job.op_addr, job.op_cnt, job.port_num);
+        (void)xSemaphoreGive(job.done_sem);
+    }
+} // end: sys_i2c_vec_task()
+
+/* EOF sys_i2c_vec.c */
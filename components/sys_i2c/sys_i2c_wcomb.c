@@ -0,0 +1,375 @@
+// @file    sys_i2c_wcomb.c
+//
+// @brief  SYS_I2C write combining: per-device run queue, flush under one I2C port lock, flush timer task.
+//
+// @details
+// Lock order: device lock, then I2C port lock. The device lock, a FreeRTOS mutex, guards the queued runs and is
+// held across a flush, so a write arriving during a flush queues behind it. The portMUX guards the device table
+// and the counters only; nothing blocks inside it.
+// Runs sit back to back in .buf: a run that grows is always the last one.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+static const char * TAG = "sys_i2c_wcomb";
+#include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
+#include "sys_i2c_wcomb.h" // includes app_config.h, sys_i2c.h
+#include "sys_i2c_priv.h" // sys_i2c_port_take(), sys_i2c_write_locked(), sys_i2c_port_give()
+
+#include <string.h> // memcpy(), memset()
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#define SYS_I2C_WCOMB_TASK_NAME     "sys_i2c_wcomb"
+#define SYS_I2C_WCOMB_TASK_STACK    (2048U)
+#define SYS_I2C_WCOMB_TASK_PRIORITY (tskIDLE_PRIORITY + 2) // Background: a late timer flush only delays, never reorders
+
+struct SYS_I2C_WCOMB_RUN {
+    uint8_t             i2c_reg_num;
+    uint8_t             buf_off;        // into .buf
+    uint8_t             buf_size;
+};
+
+struct SYS_I2C_WCOMB_DEV {
+    bool                in_use;
+    uint8_t             sys_i2c_id;
+    uint8_t             i2c_addr_num;
+    bool                fail_flag;      // a flush failed since the last barrier
+    TickType_t          flush_tick;     // 0: no timer
+    TickType_t          due_tick;       // timer flush due, valid while run_cnt
+    SemaphoreHandle_t   lock;           // mutex, guards the fields below, held across a flush
+    uint8_t             run_cnt;
+    uint8_t             buf_used;
+    struct SYS_I2C_WCOMB_RUN run[SYS_I2C_WCOMB_RUN_MAX];
+    uint8_t             buf[SYS_I2C_WCOMB_BUF_MAX];
+};
+
+// GLOBAL RAM
+//
+static struct {
+    struct SYS_I2C_WCOMB_DEV    dev[SYS_I2C_WCOMB_DEV_CNT];
+    struct SYS_I2C_WCOMB_STATS  stats;
+    volatile uint32_t           pending_cnt;    // devices with queued runs; sys_i2c_wcomb_hook() fast path
+    TaskHandle_t                task;
+    bool                        ready;
+} sys_i2c_wcomb;
+static portMUX_TYPE sys_i2c_wcomb_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static struct SYS_I2C_WCOMB_DEV * sys_i2c_wcomb_find(uint8_t sys_i2c_id, uint8_t i2c_addr_num);
+static bool sys_i2c_wcomb_lock(struct SYS_I2C_WCOMB_DEV * dev_addr, uint8_t sys_i2c_id, uint8_t i2c_addr_num);
+static bool sys_i2c_wcomb_drain(struct SYS_I2C_WCOMB_DEV * dev_addr, uint8_t cause);
+static bool sys_i2c_wcomb_barrier(struct SYS_I2C_WCOMB_DEV * dev_addr, uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool disable_flag);
+static void sys_i2c_wcomb_task(void * arg);
+
+bool sys_i2c_wcomb_init(void)
+{
+    TRACE_ENTER;
+    uint8_t dev_idx;
+
+    for (dev_idx = 0; SYS_I2C_WCOMB_DEV_CNT > dev_idx; ++dev_idx) {
+        struct SYS_I2C_WCOMB_DEV * const dev_addr = &sys_i2c_wcomb.dev[dev_idx];
+        if (!dev_addr->lock) {
+            if (!(dev_addr->lock = xSemaphoreCreateMutex())) { goto fail; }
+        }
+    }
+    if (!sys_i2c_wcomb.task) {
+        if (pdPASS != xTaskCreate(sys_i2c_wcomb_task, SYS_I2C_WCOMB_TASK_NAME, SYS_I2C_WCOMB_TASK_STACK,
+                                  NULL, SYS_I2C_WCOMB_TASK_PRIORITY, &sys_i2c_wcomb.task)) { goto fail; }
+    }
+    portENTER_CRITICAL(&sys_i2c_wcomb_mux);
+    memset(&sys_i2c_wcomb.stats, 0, sizeof(sys_i2c_wcomb.stats));
+    portEXIT_CRITICAL(&sys_i2c_wcomb_mux);
+    sys_i2c_wcomb.ready = true;
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_wcomb_init()
+
+bool sys_i2c_wcomb_enable(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint32_t flush_ms)
+{
+    TRACE_ENTER;
+    struct SYS_I2C_WCOMB_DEV * dev_addr = NULL;
+    uint8_t dev_idx;
+
+    if (!sys_i2c_wcomb.ready) { goto fail; }
+    if (!(SYS_I2C_ID_CNT > sys_i2c_id)) { goto fail; }
+    if (!(SYS_I2C_ADDR_INVALID > i2c_addr_num)) { goto fail; }
+
+    TickType_t flush_tick = pdMS_TO_TICKS(flush_ms);
+    if (flush_ms && !flush_tick) { flush_tick = 1; } // shorter than a tick: next tick
+
+    portENTER_CRITICAL(&sys_i2c_wcomb_mux);
+    for (dev_idx = 0; SYS_I2C_WCOMB_DEV_CNT > dev_idx; ++dev_idx) {
+        struct SYS_I2C_WCOMB_DEV * const d = &sys_i2c_wcomb.dev[dev_idx];
+        if (d->in_use && (sys_i2c_id == d->sys_i2c_id) && (i2c_addr_num == d->i2c_addr_num)) { dev_addr = d; break; }
+        if (!d->in_use && !dev_addr) { dev_addr = d; }
+    }
+    if (dev_addr) {
+        dev_addr->flush_tick = flush_tick;
+        if (!dev_addr->in_use) {
+            dev_addr->sys_i2c_id   = sys_i2c_id;
+            dev_addr->i2c_addr_num = i2c_addr_num;
+            dev_addr->fail_flag    = false;
+            dev_addr->run_cnt      = 0;
+            dev_addr->buf_used     = 0;
+            dev_addr->in_use       = true;
+        }
+    }
+    portEXIT_CRITICAL(&sys_i2c_wcomb_mux);
+    if (!dev_addr) { goto fail; } // table full
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_wcomb_enable()
+
+bool sys_i2c_wcomb_disable(uint8_t sys_i2c_id, uint8_t i2c_addr_num)
+{
+    TRACE_ENTER;
+    if (!sys_i2c_wcomb_barrier(sys_i2c_wcomb_find(sys_i2c_id, i2c_addr_num), sys_i2c_id, i2c_addr_num, true)) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_wcomb_disable()
+
+// @brief Queue, merge, or pass through to sys_i2c_write().
+// TASK SAFE: YES
+//
+bool sys_i2c_write_deferred(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, const uint8_t * buf_addr, size_t buf_size)
+{
+    TRACE_ENTER;
+    struct SYS_I2C_WCOMB_DEV * const dev_addr = sys_i2c_wcomb_find(sys_i2c_id, i2c_addr_num);
+
+    if (!buf_addr) { goto fail; }
+    if (!buf_size) { goto fail; }
+    if (!dev_addr) { goto passthrough; }
+
+    if (!sys_i2c_wcomb_lock(dev_addr, sys_i2c_id, i2c_addr_num)) { goto passthrough; } // disabled meanwhile
+    if (SYS_I2C_WCOMB_BUF_MAX < buf_size) {
+        (void)sys_i2c_wcomb_drain(dev_addr, SYS_I2C_WCOMB_FLUSH_FULL); // queued writes first; failure kept for the barrier
+        (void)xSemaphoreGive(dev_addr->lock);
+        goto passthrough;
+    }
+
+    // 1A Extend the last run when this write starts right after it, else a new run. Flush first when full.
+    struct SYS_I2C_WCOMB_RUN * last_addr = (dev_addr->run_cnt) ? &dev_addr->run[dev_addr->run_cnt - 1] : NULL;
+    bool merge_flag = last_addr && ((uint16_t)(last_addr->i2c_reg_num + last_addr->buf_size) == i2c_reg_num)
+                   && (UINT8_MAX >= (last_addr->buf_size + buf_size));
+    if ((SYS_I2C_WCOMB_BUF_MAX < (dev_addr->buf_used + buf_size)) || (!merge_flag && (SYS_I2C_WCOMB_RUN_MAX == dev_addr->run_cnt))) {
+        (void)sys_i2c_wcomb_drain(dev_addr, SYS_I2C_WCOMB_FLUSH_FULL);
+        merge_flag = false;
+    }
+
+    const bool first_flag = !dev_addr->run_cnt;
+    memcpy(&dev_addr->buf[dev_addr->buf_used], buf_addr, buf_size);
+    if (merge_flag) {
+        dev_addr->run[dev_addr->run_cnt - 1].buf_size += buf_size;
+    } else {
+        dev_addr->run[dev_addr->run_cnt++] = (struct SYS_I2C_WCOMB_RUN) { .i2c_reg_num = i2c_reg_num,
+                                                                          .buf_off = dev_addr->buf_used, .buf_size = buf_size };
+    }
+    dev_addr->buf_used += buf_size;
+    if (first_flag) { dev_addr->due_tick = xTaskGetTickCount() + dev_addr->flush_tick; }
+
+    portENTER_CRITICAL(&sys_i2c_wcomb_mux);
+    sys_i2c_wcomb.stats.write_cnt++;
+    if (merge_flag) { sys_i2c_wcomb.stats.merged_cnt++; }
+    if (first_flag) { sys_i2c_wcomb.pending_cnt++; }
+    portEXIT_CRITICAL(&sys_i2c_wcomb_mux);
+    (void)xSemaphoreGive(dev_addr->lock);
+
+    if (first_flag && dev_addr->flush_tick) { (void)xTaskNotifyGive(sys_i2c_wcomb.task); } // new deadline
+
+    TRACE_PASS;
+    return (true);
+  passthrough:
+    portENTER_CRITICAL(&sys_i2c_wcomb_mux);
+    sys_i2c_wcomb.stats.passthrough_cnt++;
+    portEXIT_CRITICAL(&sys_i2c_wcomb_mux);
+    if (!sys_i2c_write(sys_i2c_id, i2c_addr_num, i2c_reg_num, (uint8_t *)buf_addr, buf_size)) { goto fail; }
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_write_deferred()
+
+bool sys_i2c_wcomb_flush(uint8_t sys_i2c_id, uint8_t i2c_addr_num)
+{
+    TRACE_ENTER;
+    if (!sys_i2c_wcomb_barrier(sys_i2c_wcomb_find(sys_i2c_id, i2c_addr_num), sys_i2c_id, i2c_addr_num, false)) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_wcomb_flush()
+
+bool sys_i2c_wcomb_flush_all(void)
+{
+    TRACE_ENTER;
+    bool pass_flag = true;
+    uint8_t dev_idx;
+
+    for (dev_idx = 0; SYS_I2C_WCOMB_DEV_CNT > dev_idx; ++dev_idx) {
+        struct SYS_I2C_WCOMB_DEV * const dev_addr = &sys_i2c_wcomb.dev[dev_idx];
+        if (!dev_addr->in_use) { continue; }
+        if (!sys_i2c_wcomb_barrier(dev_addr, dev_addr->sys_i2c_id, dev_addr->i2c_addr_num, false)) { pass_flag = false; }
+    }
+    if (!pass_flag) { goto fail; }
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_wcomb_flush_all()
+
+bool sys_i2c_wcomb_stats(struct SYS_I2C_WCOMB_STATS * stats_addr)
+{
+    TRACE_ENTER;
+    if (!stats_addr) { goto fail; }
+
+    portENTER_CRITICAL(&sys_i2c_wcomb_mux);
+    *stats_addr = sys_i2c_wcomb.stats;
+    portEXIT_CRITICAL(&sys_i2c_wcomb_mux);
+
+    TRACE_PASS;
+    return (true);
+  fail:
+    TRACE_FAIL;
+    return (false);
+} // end: sys_i2c_wcomb_stats()
+
+#if (SYS_I2C_WCOMB_ENABLE == true)
+// @brief Access flush: any transaction entry point, see sys_i2c_wcomb.h, to a device with queued writes runs them first.
+// Called before the port lock. One volatile read when nothing is queued anywhere.
+//
+void sys_i2c_wcomb_hook(uint8_t sys_i2c_id, uint8_t i2c_addr_num)
+{
+    if (!sys_i2c_wcomb.pending_cnt) { return; }
+    struct SYS_I2C_WCOMB_DEV * const dev_addr = sys_i2c_wcomb_find(sys_i2c_id, i2c_addr_num);
+    if (!dev_addr) { return; }
+    if (!sys_i2c_wcomb_lock(dev_addr, sys_i2c_id, i2c_addr_num)) { return; }
+    (void)sys_i2c_wcomb_drain(dev_addr, SYS_I2C_WCOMB_FLUSH_ACCESS); // failure kept for the barrier
+    (void)xSemaphoreGive(dev_addr->lock);
+} // end: sys_i2c_wcomb_hook()
+#endif // SYS_I2C_WCOMB_ENABLE
+
+// @brief Enabled device of sys_i2c_id, i2c_addr_num, or NULL.
+//
+static struct SYS_I2C_WCOMB_DEV * sys_i2c_wcomb_find(uint8_t sys_i2c_id, uint8_t i2c_addr_num)
+{
+    struct SYS_I2C_WCOMB_DEV * dev_addr = NULL;
+    uint8_t dev_idx;
+
+    if (!sys_i2c_wcomb.ready) { return (NULL); }
+    portENTER_CRITICAL(&sys_i2c_wcomb_mux);
+    for (dev_idx = 0; SYS_I2C_WCOMB_DEV_CNT > dev_idx; ++dev_idx) {
+        struct SYS_I2C_WCOMB_DEV * const d = &sys_i2c_wcomb.dev[dev_idx];
+        if (d->in_use && (sys_i2c_id == d->sys_i2c_id) && (i2c_addr_num == d->i2c_addr_num)) { dev_addr = d; break; }
+    }
+    portEXIT_CRITICAL(&sys_i2c_wcomb_mux);
+    return (dev_addr);
+} // end: sys_i2c_wcomb_find()
+
+// @brief Take the device lock; false, not held, when the slot was disabled or reused while waiting.
+//
+static bool sys_i2c_wcomb_lock(struct SYS_I2C_WCOMB_DEV * dev_addr, uint8_t sys_i2c_id, uint8_t i2c_addr_num)
+{
+    if (pdTRUE != xSemaphoreTake(dev_addr->lock, portMAX_DELAY)) { return (false); }
+    if (dev_addr->in_use && (sys_i2c_id == dev_addr->sys_i2c_id) && (i2c_addr_num == dev_addr->i2c_addr_num)) { return (true); }
+    (void)xSemaphoreGive(dev_addr->lock);
+    return (false);
+} // end: sys_i2c_wcomb_lock()
+
+// @brief Run the queued runs in order under one I2C port lock, empty the queue. Caller holds the device lock.
+// Stops at the first failed run; the rest are dropped, .fail_flag set.
+//
+static bool sys_i2c_wcomb_drain(struct SYS_I2C_WCOMB_DEV * dev_addr, uint8_t cause)
+{
+    uint8_t run_idx = 0;
+    bool pass_flag = false;
+
+    if (!dev_addr->run_cnt) { return (true); }
+
+    if (sys_i2c_port_take(dev_addr->sys_i2c_id)) {
+        for (pass_flag = true; pass_flag && (dev_addr->run_cnt > run_idx); ++run_idx) {
+            const struct SYS_I2C_WCOMB_RUN * const r = &dev_addr->run[run_idx];
+            pass_flag = sys_i2c_write_locked(dev_addr->sys_i2c_id, dev_addr->i2c_addr_num, r->i2c_reg_num, &dev_addr->buf[r->buf_off], r->buf_size);
+        }
+        if (!sys_i2c_port_give(dev_addr->sys_i2c_id)) { pass_flag = false; }
+    }
+    dev_addr->run_cnt  = 0;
+    dev_addr->buf_used = 0;
+    if (!pass_flag) { dev_addr->fail_flag = true; }
+
+    portENTER_CRITICAL(&sys_i2c_wcomb_mux);
+    sys_i2c_wcomb.pending_cnt--;
+    sys_i2c_wcomb.stats.bus_cnt += run_idx;
+    sys_i2c_wcomb.stats.flush_cnt[cause]++;
+    if (!pass_flag) { sys_i2c_wcomb.stats.fail_cnt++; }
+    portEXIT_CRITICAL(&sys_i2c_wcomb_mux);
+    return (pass_flag);
+} // end: sys_i2c_wcomb_drain()
+
+// @brief Barrier: flush, report and clear the kept failure; optionally release the slot.
+// dev_addr NULL: device not enabled, nothing queued, pass.
+//
+static bool sys_i2c_wcomb_barrier(struct SYS_I2C_WCOMB_DEV * dev_addr, uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool disable_flag)
+{
+    bool pass_flag;
+
+    if (!dev_addr) { return (true); }
+    if (!sys_i2c_wcomb_lock(dev_addr, sys_i2c_id, i2c_addr_num)) { return (true); } // disabled meanwhile, by its barrier
+
+    pass_flag = sys_i2c_wcomb_drain(dev_addr, SYS_I2C_WCOMB_FLUSH_BARRIER) && !dev_addr->fail_flag;
+    dev_addr->fail_flag = false;
+    if (disable_flag) {
+        portENTER_CRITICAL(&sys_i2c_wcomb_mux);
+        dev_addr->in_use = false;
+        portEXIT_CRITICAL(&sys_i2c_wcomb_mux);
+    }
+    (void)xSemaphoreGive(dev_addr->lock);
+    return (pass_flag);
+} // end: sys_i2c_wcomb_barrier()
+
+// @brief Timer flush: sleep until the earliest due_tick, or until a write queues on an idle device.
+// due_tick and run_cnt are peeked without the device lock, then checked again under it.
+//
+static void sys_i2c_wcomb_task(void * arg)
+{
+    (void)arg;
+    for (;;) {
+        TickType_t wait_tick = portMAX_DELAY;
+        uint8_t dev_idx;
+
+        for (dev_idx = 0; SYS_I2C_WCOMB_DEV_CNT > dev_idx; ++dev_idx) {
+            struct SYS_I2C_WCOMB_DEV * const dev_addr = &sys_i2c_wcomb.dev[dev_idx];
+            if (!dev_addr->in_use || !dev_addr->run_cnt || !dev_addr->flush_tick) { continue; }
+
+            const TickType_t left_tick = dev_addr->due_tick - xTaskGetTickCount();
+            if (0 < (int32_t)left_tick) {
+                if (wait_tick > left_tick) { wait_tick = left_tick; }
+                continue;
+            }
+            if (!sys_i2c_wcomb_lock(dev_addr, dev_addr->sys_i2c_id, dev_addr->i2c_addr_num)) { continue; }
+            if (dev_addr->run_cnt && (0 >= (int32_t)(dev_addr->due_tick - xTaskGetTickCount()))) {
+                (void)sys_i2c_wcomb_drain(dev_addr, SYS_I2C_WCOMB_FLUSH_TIMER); // failure kept for the barrier
+            }
+            (void)xSemaphoreGive(dev_addr->lock);
+        }
+        (void)ulTaskNotifyTake(pdTRUE, wait_tick);
+    }
+} // end: sys_i2c_wcomb_task()
+
+/* EOF sys_i2c_wcomb.c */
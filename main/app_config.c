@@ -18,7 +18,7 @@
 // Supports more than 2 HW I2C Interfaces using one or two ESP32 I2C_NUM ports.
 //  .port_num  = i2c_port_t I2C_NUM_0, or I2C_NUM_1
 //  .clk_speed = Any value from 100 Hz (looks cool!) to 1MHz enforced limit. Standard: 100000U, 400000U, 800000U;
-//  .clk_flags = 0; WIP new feature UNTESTED,  Bitwise of ``I2C_SCLK_SRC_FLAG_**FOR_DFS**`` for clk source choice
+//  .clk_flags = clock source policy, ESP32-IDF >= 4.3: 0, or I2C_SCLK_SRC_FLAG_AWARE_DFS with .clk_speed <= 50 KHz
 //
 // @details
 // How to read SYS_I2C_CONFIG table from FLASH:
@@ -32,17 +32,17 @@
 // uint32_t     clk_speed   = SYS_I2C_config.port[port_num].clk_speed;
 // uint32_t     clk_flags   = SYS_I2C_config.port[port_num].clk_flags;
 //
-// @note clk_flags -- very untested
-//        I2C_SCLK_SRC_FLAG_FOR_NOMAL       (0)         /*!< Any one clock source that is available for the specified frequency may be choosen*/
-//     THESE 2 MUST HAVE SCL 50KHz MAX ? watch out.
-//        I2C_SCLK_SRC_FLAG_AWARE_DFS       (1 << 0)    /*!< For REF tick clock, it won't change with APB.*/
-//        I2C_SCLK_SRC_FLAG_LIGHT_SLEEP     (1 << 1)    /*!< For light sleep mode.*/
+// @note clk_flags, checked by sys_i2c_init_all(); policy in sys_i2c.h:
+//        I2C_SCLK_SRC_FLAG_FOR_NOMAL       (0)         APB; REF_TICK per transaction when power management is on
+//        I2C_SCLK_SRC_FLAG_AWARE_DFS       (1 << 0)    REF_TICK whenever clk_speed <= 50 KHz, PM on or off
+//        I2C_SCLK_SRC_FLAG_LIGHT_SLEEP     (1 << 1)    rejected: no such clock source on ESP32, ESP32-S2
 //
 // @note Tables entries here require corresponding BSP_I2C_config[bsp_id] entries in bsp_config.c to define GPIO.
 //
 // The two I2C config tables are the arguments to sys_i2c_init_all() mostly for lower level ESP32_IDF_I2C init calls.
 //
 // Optional, .unit[sys_i2c_id] can use only I2C_NUM_0. Example uses I2C_NUM_1 to select clock 1000000
+// sys_i2c_vec.h runs buses in parallel only across I2C_NUM_0 and I2C_NUM_1: all on I2C_NUM_0 runs them in turn.
 // Required, both .port[] entries must be present, even if one is not used. Assumes two ESP32_I2C_FSMs, not RISC-V only 1
 //
 //
@@ -54,17 +54,18 @@ SYS_I2C_config = {
         // [SYS_I2C_ID_02] = { .port_num = I2C_NUM_0, },
         // [SYS_I2C_ID_03] = { .port_num = I2C_NUM_0, },
         // [SYS_I2C_ID_04] = { .port_num = I2C_NUM_1, }, // Select clk_speed = 100 KHz. Any an be I2C_NUM_1 if needed.
+        // [SYS_I2C_ID_05] = { .mux_parent_id = SYS_I2C_ID_00, .mux_addr = 0x70, .mux_channel = 0, }, // Virtual, TCA9548A channel 0. See sys_i2c_mux.h
     },
 
     .port = {
         [I2C_NUM_0] = {
             .clk_speed = 400000U, // 400 KHz
-            .clk_flags = 0, // I2C_SCLK_SRC_FLAG_FOR_NOMAL new feature, untested, 0 currently safe default.
+            .clk_flags = 0, // I2C_SCLK_SRC_FLAG_FOR_NOMAL, 400 KHz: APB
         },
 
         [I2C_NUM_1] = {
             .clk_speed = 100000U, // 100 KHz
-            .clk_flags = 0, // no idea what I'm doing here. "non-NOMAL" flags MUST HAVE SCL 50KHz MAX
+            .clk_flags = 0, // I2C_SCLK_SRC_FLAG_FOR_NOMAL; AWARE_DFS needs .clk_speed <= 50 KHz
         },
     },
 }; // end: SYS_I2C_config
@@ -97,6 +97,7 @@ enum SYS_I2C_ID {
     // SYS_I2C_ID_02, // I2C_BUS #3, uncomment to add more I2C Buses.
     // SYS_I2C_ID_03, // I2C_BUS #4
     // SYS_I2C_ID_04, // I2C_BUS #5, add lines of SYS_I2C_ID as needed.
+    // SYS_I2C_ID_05, // Virtual I2C_BUS, a mux channel, after its parent. See sys_i2c_mux.h
     SYS_I2C_ID_CNT // DO NOT RENAME, always last, automatically adjusts.
 };
 
@@ -152,6 +153,120 @@ enum SYS_I2C_ID {
   #define SYS_I2C_PULL_UP_ENABLE      false
 #endif
 
+//! @brief
+//! Maximum wire time, microseconds, one bulk chunk holds the I2C port lock. Set in `Kconfig`.
+//! sys_i2c_write_bulk() and sys_i2c_read_bulk() release the lock between chunks.
+//!
+#define SYS_I2C_LOCK_HOLD_MAX_US    CONFIG_SYS_I2C_LOCK_HOLD_MAX_US
+
+//! @brief
+//! Maximum time, microseconds, a contended I2C port lock take spins before it blocks on the mutex. Set in `Kconfig`.
+//! Spins only while the holder can give back without this core. 0: always block.
+//!
+#define SYS_I2C_LOCK_SPIN_MAX_US    CONFIG_SYS_I2C_LOCK_SPIN_MAX_US
+
+//! @brief
+//! Runtime I2C tables generated at build time from `main/bsp_i2c_board.cmake`. Set in `Kconfig`.
+//! true: sys_i2c_init_all() uses the validated FLASH table SYS_I2C_unit_gen[bsp_id]; no RAM copy, no boot asserts.
+//! false: DEFAULT: BSP_I2C_config in bsp_config.c and SYS_I2C_config in app_config.c, copied and checked at boot.
+//!
+#ifdef CONFIG_SYS_I2C_BOARD_GEN
+  #define SYS_I2C_BOARD_GEN_ENABLE    true
+#else
+  #define SYS_I2C_BOARD_GEN_ENABLE    false
+#endif
+
+//! @brief
+//! Defer each ESP32_I2C_FSM driver install to the first I2C transaction on its port_num. Set in `Kconfig`.
+//! true: sys_i2c_init_all() only creates port locks; boot does not wait for unused ports.
+//! false: DEFAULT: sys_i2c_init_all() installs every used port_num.
+//!
+#ifdef CONFIG_SYS_I2C_LAZY_INSTALL
+  #define SYS_I2C_LAZY_INSTALL_ENABLE true
+#else
+  #define SYS_I2C_LAZY_INSTALL_ENABLE false
+#endif
+
+//! @brief
+//! Fault injection points in sys_i2c_read(), sys_i2c_write(), sys_i2c_probe(), for sys_i2c_stress.h. Set in `Kconfig`.
+//! true: hooks compiled in; faults injected only while sys_i2c_stress_run() runs.
+//! false: DEFAULT: hooks compile to nothing.
+//!
+#ifdef CONFIG_SYS_I2C_FAULT_INJECT
+  #define SYS_I2C_FAULT_INJECT_ENABLE true
+#else
+  #define SYS_I2C_FAULT_INJECT_ENABLE false
+#endif
+
+//! @brief
+//! Workload capture hook in sys_i2c_read(), sys_i2c_write(), sys_i2c_probe(), for sys_i2c_capture.h. Set in `Kconfig`.
+//! true: hook compiled in; records only while a capture runs.
+//! false: DEFAULT: hook compiles to nothing.
+//!
+#ifdef CONFIG_SYS_I2C_CAPTURE
+  #define SYS_I2C_CAPTURE_ENABLE      true
+#else
+  #define SYS_I2C_CAPTURE_ENABLE      false
+#endif
+
+//! @brief
+//! Hot-path phase profiler in sys_i2c_read(), sys_i2c_write(), sys_i2c_probe(), for sys_i2c_profile.h. Set in `Kconfig`.
+//! true: CPU cycle stamps around each phase, aggregated per I2C Bus.
+//! false: DEFAULT: stamps compile to nothing.
+//!
+#ifdef CONFIG_SYS_I2C_PROFILE
+  #define SYS_I2C_PROFILE_ENABLE      true
+#else
+  #define SYS_I2C_PROFILE_ENABLE      false
+#endif
+
+//! @brief
+//! Write-combining access flush in sys_i2c_read(), sys_i2c_write(), for sys_i2c_wcomb.h. Set in `Kconfig`.
+//! true: a call to a device with queued deferred writes runs them first.
+//! false: DEFAULT: hook compiles to nothing.
+//!
+#ifdef CONFIG_SYS_I2C_WCOMB
+  #define SYS_I2C_WCOMB_ENABLE        true
+#else
+  #define SYS_I2C_WCOMB_ENABLE        false
+#endif
+
+//! @brief
+//! Bandwidth quota admission in sys_i2c_read(), sys_i2c_write() and the prepared paths, for sys_i2c_quota.h. Set in `Kconfig`.
+//! true: calls matching a quota entry are charged, deferred or rejected before the port lock.
+//! false: DEFAULT: hook compiles to nothing.
+//!
+#ifdef CONFIG_SYS_I2C_QUOTA
+  #define SYS_I2C_QUOTA_ENABLE        true
+#else
+  #define SYS_I2C_QUOTA_ENABLE        false
+#endif
+
+//! @brief
+//! ESP32-IDF power management, Kconfig PM_ENABLE, Component config -> Power Management. Not a SYS_I2C setting.
+//! true: per transaction clock source and PM lock while the pins are attached, see SYS_I2C_config .clk_flags in sys_i2c.h.
+//! false: APB is fixed; no PM lock.
+//!
+#ifdef CONFIG_PM_ENABLE
+  #define SYS_I2C_PM_ENABLE           true
+#else
+  #define SYS_I2C_PM_ENABLE           false
+#endif
+
+//! @brief
+//! Most later requests one waiting sys_i2c_sched_*() request can be passed over by, see sys_i2c_sched.h. Set in `Kconfig`.
+//! 0: arrival order. Runtime change: sys_i2c_sched_window_set().
+//!
+#define SYS_I2C_SCHED_WINDOW        CONFIG_SYS_I2C_SCHED_WINDOW
+
+//! @brief
+//! Hot-plug monitor, see sys_i2c_hotplug.h. Set in `Kconfig`.
+//! Period: each watched device probed once per period, ms. Runtime change: sys_i2c_hotplug_period_set().
+//! Miss count: probes in a row without ACK before a detach event.
+//!
+#define SYS_I2C_HOTPLUG_PERIOD_MS   CONFIG_SYS_I2C_HOTPLUG_PERIOD_MS
+#define SYS_I2C_HOTPLUG_MISS_CNT    CONFIG_SYS_I2C_HOTPLUG_MISS_CNT
+
 // CMAKE. See CMakeLists.txt for logic.
 
 //! @brief Calculated value from CMake. Do not edit.
@@ -161,11 +276,17 @@ enum SYS_I2C_ID {
 //!   if ESP32-IDF Version >= 4.3 then CMAKE_ESP32_IDF_AT_LEAST_4_3 = true, use new I2C clk_flags
 //! Internal value SYS_I2C_CLK_FLAGS_ENABLE used in code.
 //!
-//! @todo  if ESP32-IDF Version >= 4.3 then CMAKE_ESP32_IDF_AT_LEAST_4_3 = true, use new I2C static calls
-//! #define SYS_I2C_STATIC_ENABLE    CMAKE_ESP32_IDF_AT_LEAST_4_3 // not implemented yet
-//!
 #define SYS_I2C_CLK_FLAGS_ENABLE    CMAKE_ESP32_IDF_AT_LEAST_4_3
 
+//! @brief Calculated value from CMake. Do not edit.
+//! New I2C static cmd link calls, i2c_cmd_link_create_static(), enabled if ESP32-IDF >= 4.4.
+//! @details
+//! In sys_i2c/CMakeLists.txt,
+//!   if ESP32-IDF Version >= 4.4 then CMAKE_ESP32_IDF_AT_LEAST_4_4 = true, use new I2C static calls
+//! Internal value SYS_I2C_STATIC_ENABLE used in code: sys_i2c_prep.c builds into a preallocated buffer, no heap.
+//!
+#define SYS_I2C_STATIC_ENABLE       CMAKE_ESP32_IDF_AT_LEAST_4_4
+
 //
 #include "sys_i2c.h" // Multiple ESP32 I2C physical interfaces (1, 2, 3+ !!) freeRTOS task-safe
 extern const struct SYS_I2C_CONFIG    SYS_I2C_config;               // I2C settings in app_config.c
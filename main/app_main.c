@@ -20,7 +20,8 @@
 //
 // This example has console output even if no I2C devices attached. External I2C pull-up resistors are required for real systems.
 // Example enables internal pull-up resisors to allow testing only.
-// This example scans all defined I2C Buses and prints to console a classic I2C scan map with added GPIO scl/sda numbers for each I2C Bus.
+// This example scans all defined I2C Buses in the background while Example #1 runs,
+// then prints to console a classic I2C scan map with added GPIO scl/sda numbers for each I2C Bus.
 // Then quits.
 //
 // SPDX-FileCopyrightText: 2021 burtrum
@@ -28,6 +29,9 @@
 //
 #include "sys_trace_macros.h" // TRACE_ENTER; TRACE_PASS; TRACE_FAIL; Must enable ESP32 log level ESP_LOG_DEBUG
 #include "app_config.h" // bsp_id and user application specific settings - see app_config.c and bsp_config.c
+#include "sys_i2c_discover.h" // background I2C device discovery
+#include "sys_i2c_devmap.h" // persisted device map, warm boot discovery
+#include "nvs_flash.h" // nvs_flash_init(), devmap storage
 
 /*********************************************************************/
 //! @brief Application Configuration - Select Target Board GPIO map
@@ -58,10 +62,12 @@ void app_main(void)
     TRACE_ENTER;
     assert(BSP_ID_CNT > APP_config.bsp_id); // validate BSP_ID from FLASH
 
+    bool warm_boot = true; // device map from the last boot still valid, see Example 2
     esp_reset_reason_t  reset_reason = esp_reset_reason();
     switch (reset_reason) {
         case ESP_RST_POWERON:    // 1 ESP_RST_POWERON
             printf("\n***POWERON RESET*** reset reason = %d ... 'goto Start_i2c_example;'\n", reset_reason);
+            warm_boot = false; // devices may have been swapped while powered off
             goto Start_i2c_example;
         break;
 
@@ -94,6 +100,24 @@ void app_main(void)
     //
     if (!sys_i2c_init_all()) { goto fail; } // Initialize all SYS_I2C Buses from I2C_config tables.
 
+    // Device map storage. Full or old-format NVS partition: erase once, map rebuilt by a full scan.
+    esp_err_t nvs_err = nvs_flash_init();
+    if ((ESP_ERR_NVS_NO_FREE_PAGES == nvs_err) || (ESP_ERR_NVS_NEW_VERSION_FOUND == nvs_err)) {
+        if (ESP_OK != nvs_flash_erase()) { goto fail; }
+        nvs_err = nvs_flash_init();
+    }
+    if (ESP_OK != nvs_err) { goto fail; }
+
+    // Discover every I2C Bus in the background, both I2C_FSMs.
+    // Warm boot with a saved map: probe only the known devices. Otherwise: full scan.
+    uint32_t known_map[SYS_I2C_ID_CNT][4];
+    if (warm_boot && sys_i2c_devmap_load(&SYS_I2C_devmap_store_nvs, APP_config.bsp_id, known_map)) {
+        printf("***WARM BOOT: verify saved I2C device map***\n\n");
+        if (!sys_i2c_discover_start_known((const uint32_t (*)[4])known_map)) { goto fail; }
+    } else {
+        if (!sys_i2c_discover_start()) { goto fail; }
+    }
+
     // Example 1: Probe a single SYS_I2C Bus 'sys_i2c_id' for a single I2C device at 'i2c_addr_num'.
     //
     uint8_t sys_i2c_id              = SYS_I2C_ID_00; // The first I2C Bus
@@ -114,11 +138,15 @@ void app_main(void)
     printf("\n");
 
     // Example 2: Scan all SYS_I2C HW Buses: sys_i2c_id = 0 to SYS_I2C_ID_CNT-1;
+    // Started in the background right after init; wait for "discovery complete", then print.
+    // Blocking alternative, scan and print in this task: sys_i2c_scan_print()
     //
-    printf("***I2C Example #2: 'sys_i2c_scan_print()'' No I2C devices needed***\n");
+    printf("***I2C Example #2: 'sys_i2c_discover_print()'' No I2C devices needed***\n");
     printf("Print tabular I2C Bus maps.\n");
 
-    if (!sys_i2c_scan_print()) { goto fail; }
+    if (!sys_i2c_discover_wait(portMAX_DELAY)) { goto fail; }
+    if (!sys_i2c_devmap_save(&SYS_I2C_devmap_store_nvs, APP_config.bsp_id)) { goto fail; } // only writes if changed
+    if (!sys_i2c_discover_print()) { goto fail; }
 
     printf("\n***End I2C Examples - Bye\n");
     // end: i2c_example.
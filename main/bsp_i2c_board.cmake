@@ -0,0 +1,36 @@
+# @file main/bsp_i2c_board.cmake
+#
+# @brief SYS_I2C board description. Used only when CONFIG_SYS_I2C_BOARD_GEN=y.
+# One file replaces SYS_I2C_config (app_config.c) and BSP_I2C_config[] (bsp_config.c).
+#
+# @details
+# Read at CMake configure time by components/sys_i2c/sys_i2c_board_gen.cmake; checked, then generated into
+# the FLASH table SYS_I2C_unit_gen[BSP_ID_CNT][SYS_I2C_ID_CNT]. Mistakes stop the build, not the boot.
+#
+# @note Names SHALL match `enum BSP_ID` and `enum SYS_I2C_ID` in app_config.h. All boards SHALL be listed, in any order.
+# Kconfig values are available as ${CONFIG_...}.
+#
+
+# ESP32_I2C_FSM clocks. Same as SYS_I2C_config.port[]
+sys_i2c_port(I2C_NUM_0 CLK_SPEED 400000 CLK_FLAGS 0) # 400 KHz
+sys_i2c_port(I2C_NUM_1 CLK_SPEED 100000 CLK_FLAGS 0) # 100 KHz
+
+# I2C Bus to ESP32_I2C_FSM. Same as SYS_I2C_config.unit[]
+sys_i2c_bus(SYS_I2C_ID_00 PORT I2C_NUM_0)
+# sys_i2c_bus(SYS_I2C_ID_01 PORT I2C_NUM_0)
+# sys_i2c_bus(SYS_I2C_ID_02 PORT I2C_NUM_1)
+# sys_i2c_bus(SYS_I2C_ID_03 MUX SYS_I2C_ID_00 ADDR 0x70 CHANNEL 0) # virtual: TCA9548A channel 0, no sys_i2c_pins()
+
+# GPIO per board. Same as BSP_I2C_config[bsp_id].unit[]
+sys_i2c_board(BSP_0000_DEFAULT)
+sys_i2c_pins(SYS_I2C_ID_00 SDA 4 SCL 3)
+# sys_i2c_pins(SYS_I2C_ID_01 SDA 2 SCL 1)
+# sys_i2c_pins(SYS_I2C_ID_02 SDA 7 SCL 6)
+
+sys_i2c_board(BSP_0000_KCONFIG)
+sys_i2c_pins(SYS_I2C_ID_00 SDA ${CONFIG_SYS_I2C_ID_00_SDA_IO_NUM} SCL ${CONFIG_SYS_I2C_ID_00_SCL_IO_NUM})
+
+sys_i2c_board(BSP_0001_ESP32S2_SAOLA_1)
+sys_i2c_pins(SYS_I2C_ID_00 SDA 4 SCL 3)
+
+# EOF main/bsp_i2c_board.cmake
@@ -0,0 +1,9 @@
+// @file    test_host/stub/driver/gpio.h
+//
+// @brief  Host stub of the ESP32-IDF header.
+//
+#pragma once
+#include "esp_err.h"
+
+typedef enum { GPIO_NUM_NC = -1, GPIO_NUM_0 = 0, GPIO_NUM_MAX = 40 } gpio_num_t;
+/* EOF gpio.h */
@@ -0,0 +1,22 @@
+// @file    test_host/stub/driver/i2c.h
+//
+// @brief  Host stub of the ESP32-IDF header: port numbers and the 4.3 clock source flags.
+//
+#pragma once
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+typedef enum { I2C_NUM_0 = 0, I2C_NUM_1, I2C_NUM_MAX } i2c_port_t;
+typedef void * i2c_cmd_handle_t;
+
+typedef struct {
+    int         sda_io_num;
+    int         scl_io_num;
+    struct { uint32_t clk_speed; } master;
+    uint32_t    clk_flags;
+} i2c_config_t;
+
+#define I2C_SCLK_SRC_FLAG_FOR_NOMAL     (0)         // APB clock, any clk_speed
+#define I2C_SCLK_SRC_FLAG_AWARE_DFS     (1 << 0)    // REF_TICK, clock kept when APB changes
+#define I2C_SCLK_SRC_FLAG_LIGHT_SLEEP   (1 << 1)
+/* EOF i2c.h */
@@ -0,0 +1,11 @@
+// @file    test_host/stub/esp_err.h
+//
+// @brief  Host stub of the ESP32-IDF header: what the code under test uses, nothing more.
+//
+#pragma once
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK      (0)
+#define ESP_FAIL    (-1)
+/* EOF esp_err.h */
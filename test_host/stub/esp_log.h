@@ -0,0 +1,12 @@
+// @file    test_host/stub/esp_log.h
+//
+// @brief  Host stub of the ESP32-IDF header: log level ESP_LOG_INFO, ESP_LOGD() off.
+//
+#pragma once
+#include <stdio.h>
+
+#define ESP_LOGE(tag, ...)  do { printf("E %s: ", (tag)); printf(__VA_ARGS__); printf("\n"); } while (0)
+#define ESP_LOGW(tag, ...)  do { printf("W %s: ", (tag)); printf(__VA_ARGS__); printf("\n"); } while (0)
+#define ESP_LOGI(tag, ...)  do { printf("I %s: ", (tag)); printf(__VA_ARGS__); printf("\n"); } while (0)
+#define ESP_LOGD(tag, ...)  do { (void)(tag); } while (0)
+/* EOF esp_log.h */
@@ -0,0 +1,9 @@
+// @file    test_host/stub/esp_pm.h
+//
+// @brief  Host stub of the ESP32-IDF header.
+//
+#pragma once
+#include "esp_err.h"
+
+typedef void * esp_pm_lock_handle_t;
+/* EOF esp_pm.h */
@@ -0,0 +1,9 @@
+// @file    test_host/stub/esp_timer.h
+//
+// @brief  Host stub of the ESP32-IDF header. The test defines esp_timer_get_time(): a simulated clock.
+//
+#pragma once
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
+/* EOF esp_timer.h */
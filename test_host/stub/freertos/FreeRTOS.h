@@ -0,0 +1,25 @@
+// @file    test_host/stub/freertos/FreeRTOS.h
+//
+// @brief  Host stub of the ESP32-IDF header: types and port macros, single core.
+//
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef uint32_t    TickType_t;
+typedef int         BaseType_t;
+typedef unsigned    UBaseType_t;
+
+typedef struct { volatile uint32_t owner; volatile uint32_t count; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED    { 0, 0 }
+#define portENTER_CRITICAL(mux_addr)    ((void)(mux_addr))
+#define portEXIT_CRITICAL(mux_addr)     ((void)(mux_addr))
+
+#define portNUM_PROCESSORS  (1)
+#define portTICK_PERIOD_MS  (10)
+#define portMAX_DELAY       (0xFFFFFFFFU)
+#define pdTRUE              (1)
+#define pdFALSE             (0)
+#define pdMS_TO_TICKS(ms)   ((TickType_t)((ms) / portTICK_PERIOD_MS))
+/* EOF FreeRTOS.h */
@@ -0,0 +1,9 @@
+// @file    test_host/stub/freertos/semphr.h
+//
+// @brief  Host stub of the ESP32-IDF header.
+//
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+typedef void * SemaphoreHandle_t;
+/* EOF semphr.h */
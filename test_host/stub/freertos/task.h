@@ -0,0 +1,15 @@
+// @file    test_host/stub/freertos/task.h
+//
+// @brief  Host stub of the ESP32-IDF header. The tests define what they call: vTaskDelay() advances a simulated clock,
+// vPortYield() behind taskYIELD() counts yields.
+//
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+typedef void * TaskHandle_t;
+
+void vTaskDelay(TickType_t tick_cnt);
+TickType_t xTaskGetTickCount(void);
+void vPortYield(void);
+#define taskYIELD()         vPortYield()
+/* EOF task.h */
@@ -0,0 +1,14 @@
+// @file    test_host/stub/sdkconfig.h
+//
+// @brief  Host stub: the Kconfig values app_config.h reads. Defaults of components/sys_i2c/Kconfig, optional parts off.
+//
+#pragma once
+#define CONFIG_SYS_I2C_ID_00_SCL_IO_NUM     3
+#define CONFIG_SYS_I2C_ID_00_SDA_IO_NUM     4
+#define CONFIG_SYS_I2C_PULL_UP_ENABLE       1
+#define CONFIG_SYS_I2C_LOCK_HOLD_MAX_US     2000
+#define CONFIG_SYS_I2C_LOCK_SPIN_MAX_US     40
+#define CONFIG_SYS_I2C_SCHED_WINDOW         4
+#define CONFIG_SYS_I2C_HOTPLUG_PERIOD_MS    1000
+#define CONFIG_SYS_I2C_HOTPLUG_MISS_CNT     2
+/* EOF sdkconfig.h */
@@ -0,0 +1,264 @@
+// @file    test_dev_bmp280.c
+//
+// @brief  Host test of dev_bmp280.c against a simulated BMP280 behind sys_i2c_read() / sys_i2c_write().
+//
+// @details
+// The simulated device is a 256 byte register file: chip id 0xD0, calibration block 0x88, ctrl_meas 0xF4,
+// result burst 0xF7. A forced mode write to ctrl_meas converts the raw values set by the test into 0xF7 - 0xFC, and the
+// part goes back to sleep mode. Soft reset clears ctrl_meas, config, and sets the results to 0x80000: skipped.
+// esp_timer_get_time() is a simulated clock, vTaskDelay() advances it.
+// Reference values: BST-BMP280-DS001, section 8.2 example, dig_T1 .. dig_P9, adc_T 519888, adc_P 415148.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+#include "dev_bmp280.h" // includes app_config.h, sys_i2c.h
+
+#include <stdio.h> // printf()
+#include <string.h> // memset(), memcpy()
+#include "esp_timer.h" // esp_timer_get_time()
+#include "freertos/task.h" // vTaskDelay()
+
+#define TEST_ADDR           DEV_BMP280_ADDR_LO
+#define TEST_ADC_T          (519888)
+#define TEST_ADC_P          (415148)
+#define TEST_ADC_SKIPPED    (0x80000)
+#define TEST_TEMP_CENTI_C   (2508)      // 25.08 degC
+#define TEST_PRESS_Q24_8    (25767233U) // 100653.25 Pa
+#define TEST_WRITE_MAX      (16U)
+
+#define TEST_CHECK(cond)    test_check((cond), #cond, __LINE__)
+
+// GLOBAL RAM: the simulated device and clock.
+static struct {
+    uint8_t     reg[256];
+    bool        ack_flag;           // false: no device at TEST_ADDR, every access fails
+    int32_t     adc_t;              // converted on a forced mode write
+    int32_t     adc_p;
+    int64_t     now_us;
+    int64_t     burst_us;           // last 0xF7 burst read, now_us
+    uint32_t    burst_cnt;
+    uint8_t     write_reg[TEST_WRITE_MAX];
+    uint8_t     write_val[TEST_WRITE_MAX];
+    uint32_t    write_cnt;
+} sim;
+
+static uint32_t test_fail_cnt;
+
+// Datasheet 8.2 trimming parameters, dig_T1 .. dig_P9.
+static const int32_t test_calib[12] = { 27504, 26435, -1000, 36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000 };
+
+static void test_check(bool pass_flag, const char * cond_addr, int line_num)
+{
+    if (pass_flag) { return; }
+    test_fail_cnt++;
+    printf("FAIL: line %d: %s\n", line_num, cond_addr);
+} // end: test_check()
+
+// @brief 20 bit raw value to msb, lsb, xlsb[7:4].
+//
+static void sim_adc_set(uint8_t reg_num, int32_t adc)
+{
+    sim.reg[reg_num]     = (uint8_t)(adc >> 12);
+    sim.reg[reg_num + 1] = (uint8_t)(adc >> 4);
+    sim.reg[reg_num + 2] = (uint8_t)((adc & 0x0F) << 4);
+} // end: sim_adc_set()
+
+// @brief Power on state: trimmed part, sleep mode, results skipped.
+//
+static void sim_reset(void)
+{
+    memset(&sim, 0, sizeof(sim));
+    sim.ack_flag = true;
+    sim.now_us = 1000000;
+    sim.reg[0xD0] = 0x58;
+    for (size_t idx = 0; idx < 12; idx++) {
+        sim.reg[0x88 + (2 * idx)]     = (uint8_t)(test_calib[idx] & 0xFF);
+        sim.reg[0x88 + (2 * idx) + 1] = (uint8_t)((test_calib[idx] >> 8) & 0xFF);
+    }
+    sim_adc_set(0xF7, TEST_ADC_SKIPPED);
+    sim_adc_set(0xFA, TEST_ADC_SKIPPED);
+    sim.adc_t = TEST_ADC_T;
+    sim.adc_p = TEST_ADC_P;
+} // end: sim_reset()
+
+// Simulated SYS_I2C API, one device at TEST_ADDR on SYS_I2C_ID_00.
+
+bool sys_i2c_read(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size)
+{
+    if (!sim.ack_flag || (SYS_I2C_ID_00 != sys_i2c_id) || (TEST_ADDR != i2c_addr_num)) { return (false); }
+    if (!buf_addr || !buf_size || (256U < (i2c_reg_num + buf_size))) { return (false); }
+    memcpy(buf_addr, &sim.reg[i2c_reg_num], buf_size);
+    if (0xF7 == i2c_reg_num) {
+        sim.burst_us = sim.now_us;
+        sim.burst_cnt++;
+    }
+    return (true);
+} // end: sys_i2c_read()
+
+bool sys_i2c_write(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size)
+{
+    if (!sim.ack_flag || (SYS_I2C_ID_00 != sys_i2c_id) || (TEST_ADDR != i2c_addr_num)) { return (false); }
+    if (!buf_addr || (1U != buf_size)) { return (false); }
+    if (TEST_WRITE_MAX > sim.write_cnt) {
+        sim.write_reg[sim.write_cnt] = i2c_reg_num;
+        sim.write_val[sim.write_cnt] = buf_addr[0];
+    }
+    sim.write_cnt++;
+
+    if ((0xE0 == i2c_reg_num) && (0xB6 == buf_addr[0])) { // soft reset
+        sim.reg[0xF4] = 0;
+        sim.reg[0xF5] = 0;
+        sim_adc_set(0xF7, TEST_ADC_SKIPPED);
+        sim_adc_set(0xFA, TEST_ADC_SKIPPED);
+        return (true);
+    }
+    sim.reg[i2c_reg_num] = buf_addr[0];
+    if ((0xF4 == i2c_reg_num) && (0x01 == (buf_addr[0] & 0x03))) { // forced mode: convert, back to sleep
+        sim_adc_set(0xFA, (buf_addr[0] >> 5) ? sim.adc_t : TEST_ADC_SKIPPED);
+        sim_adc_set(0xF7, ((buf_addr[0] >> 2) & 0x07) ? sim.adc_p : TEST_ADC_SKIPPED);
+        sim.reg[0xF4] &= (uint8_t)~0x03;
+    }
+    return (true);
+} // end: sys_i2c_write()
+
+int64_t esp_timer_get_time(void)
+{
+    return (sim.now_us);
+} // end: esp_timer_get_time()
+
+void vTaskDelay(TickType_t tick_cnt)
+{
+    sim.now_us += 1000LL * portTICK_PERIOD_MS * tick_cnt;
+} // end: vTaskDelay()
+
+// Tests
+
+static void test_compensate(void)
+{
+    struct DEV_BMP280_CALIB calib = {
+        .dig_t1 = 27504,    .dig_t2 = 26435,    .dig_t3 = -1000,
+        .dig_p1 = 36477,    .dig_p2 = -10685,   .dig_p3 = 3024,
+        .dig_p4 = 2855,     .dig_p5 = 140,      .dig_p6 = -7,
+        .dig_p7 = 15500,    .dig_p8 = -14600,   .dig_p9 = 6000,
+    };
+    struct DEV_BMP280_SAMPLE sample;
+
+    dev_bmp280_compensate(&calib, TEST_ADC_T, TEST_ADC_P, &sample);
+    TEST_CHECK(TEST_TEMP_CENTI_C == sample.temp_centi_c);
+    TEST_CHECK(TEST_PRESS_Q24_8 == sample.press_q24_8);
+    TEST_CHECK(128422 == sample.t_fine);
+
+    dev_bmp280_compensate(&calib, TEST_ADC_T, TEST_ADC_SKIPPED, &sample);
+    TEST_CHECK(TEST_TEMP_CENTI_C == sample.temp_centi_c);
+    TEST_CHECK(0 == sample.press_q24_8);
+} // end: test_compensate()
+
+static void test_init(void)
+{
+    struct DEV_BMP280 dev;
+
+    // Chip id, reset, calibration, then config before ctrl_meas, sleep mode.
+    sim_reset();
+    TEST_CHECK(dev_bmp280_init(&dev, SYS_I2C_ID_00, TEST_ADDR, DEV_BMP280_OSRS_X2, DEV_BMP280_OSRS_X16, DEV_BMP280_FILTER_4));
+    TEST_CHECK(3 == sim.write_cnt);
+    TEST_CHECK((0xE0 == sim.write_reg[0]) && (0xB6 == sim.write_val[0]));
+    TEST_CHECK((0xF5 == sim.write_reg[1]) && ((DEV_BMP280_FILTER_4 << 2) == sim.write_val[1]));
+    TEST_CHECK((0xF4 == sim.write_reg[2]) && (((DEV_BMP280_OSRS_X2 << 5) | (DEV_BMP280_OSRS_X16 << 2)) == sim.write_val[2]));
+    TEST_CHECK(0 == (sim.reg[0xF4] & 0x03));
+    TEST_CHECK(1000000 + 2000 <= sim.now_us); // startup time after reset
+    TEST_CHECK(27504 == dev.calib.dig_t1);
+    TEST_CHECK(-1000 == dev.calib.dig_t3);
+    TEST_CHECK(36477 == dev.calib.dig_p1);
+    TEST_CHECK(-14600 == dev.calib.dig_p8);
+    TEST_CHECK(6000 == dev.calib.dig_p9);
+    TEST_CHECK(1250 + (2300 * 2) + (2300 * 16) + 575 == dev.meas_us);
+    TEST_CHECK(dev.ready_flag);
+
+    // Rejected: wrong chip id, no answer, untrimmed part, temperature skipped.
+    sim_reset();
+    sim.reg[0xD0] = 0x60; // BME280
+    TEST_CHECK(!dev_bmp280_init(&dev, SYS_I2C_ID_00, TEST_ADDR, DEV_BMP280_OSRS_X1, DEV_BMP280_OSRS_X1, DEV_BMP280_FILTER_OFF));
+    TEST_CHECK(0 == sim.write_cnt);
+    TEST_CHECK(!dev.ready_flag);
+
+    sim_reset();
+    sim.ack_flag = false;
+    TEST_CHECK(!dev_bmp280_init(&dev, SYS_I2C_ID_00, TEST_ADDR, DEV_BMP280_OSRS_X1, DEV_BMP280_OSRS_X1, DEV_BMP280_FILTER_OFF));
+
+    sim_reset();
+    memset(&sim.reg[0x88], 0, 24);
+    TEST_CHECK(!dev_bmp280_init(&dev, SYS_I2C_ID_00, TEST_ADDR, DEV_BMP280_OSRS_X1, DEV_BMP280_OSRS_X1, DEV_BMP280_FILTER_OFF));
+
+    sim_reset();
+    TEST_CHECK(!dev_bmp280_init(&dev, SYS_I2C_ID_00, TEST_ADDR, DEV_BMP280_OSRS_SKIP, DEV_BMP280_OSRS_X1, DEV_BMP280_FILTER_OFF));
+    TEST_CHECK(!dev_bmp280_init(&dev, SYS_I2C_ID_CNT, TEST_ADDR, DEV_BMP280_OSRS_X1, DEV_BMP280_OSRS_X1, DEV_BMP280_FILTER_OFF));
+    TEST_CHECK(0 == sim.write_cnt);
+} // end: test_init()
+
+static void test_forced(void)
+{
+    struct DEV_BMP280 dev;
+    struct DEV_BMP280_SAMPLE sample;
+
+    sim_reset();
+    TEST_CHECK(dev_bmp280_init(&dev, SYS_I2C_ID_00, TEST_ADDR, DEV_BMP280_OSRS_X1, DEV_BMP280_OSRS_X4, DEV_BMP280_FILTER_OFF));
+
+    // No conversion started: refused, no I2C.
+    TEST_CHECK(!dev_bmp280_force_read(&dev, &sample));
+    TEST_CHECK(0 == sim.burst_cnt);
+
+    // Before any conversion the part reports 0x80000: no sample.
+    TEST_CHECK(!dev_bmp280_read(&dev, &sample));
+
+    // Forced mode: ctrl_meas with mode 01, then one burst after the conversion time.
+    sim.write_cnt = 0;
+    TEST_CHECK(dev_bmp280_force_start(&dev));
+    TEST_CHECK((1 == sim.write_cnt) && (0xF4 == sim.write_reg[0]) && ((dev.ctrl_meas | 0x01) == sim.write_val[0]));
+    const int64_t start_us = sim.now_us;
+    sim.burst_cnt = 0;
+    TEST_CHECK(dev_bmp280_force_read(&dev, &sample));
+    TEST_CHECK(1 == sim.burst_cnt);
+    TEST_CHECK(start_us + dev.meas_us <= sim.burst_us);
+    TEST_CHECK(TEST_TEMP_CENTI_C == sample.temp_centi_c);
+    TEST_CHECK(TEST_PRESS_Q24_8 == sample.press_q24_8);
+    TEST_CHECK(0 == dev.ready_us);
+
+    // One start, one read: a second read needs a new start.
+    TEST_CHECK(!dev_bmp280_force_read(&dev, &sample));
+
+    // Read failed: reported, conversion consumed.
+    TEST_CHECK(dev_bmp280_force_start(&dev));
+    sim.ack_flag = false;
+    TEST_CHECK(!dev_bmp280_force_read(&dev, &sample));
+    sim.ack_flag = true;
+    TEST_CHECK(!dev_bmp280_force_read(&dev, &sample));
+} // end: test_forced()
+
+static void test_skipped_pressure(void)
+{
+    struct DEV_BMP280 dev;
+    struct DEV_BMP280_SAMPLE sample;
+
+    sim_reset();
+    TEST_CHECK(dev_bmp280_init(&dev, SYS_I2C_ID_00, TEST_ADDR, DEV_BMP280_OSRS_X1, DEV_BMP280_OSRS_SKIP, DEV_BMP280_FILTER_OFF));
+    TEST_CHECK(1250 + 2300 == dev.meas_us); // no pressure conversion time
+
+    TEST_CHECK(dev_bmp280_force_start(&dev));
+    TEST_CHECK(dev_bmp280_force_read(&dev, &sample));
+    TEST_CHECK(TEST_TEMP_CENTI_C == sample.temp_centi_c);
+    TEST_CHECK(0 == sample.press_q24_8);
+} // end: test_skipped_pressure()
+
+int main(void)
+{
+    test_compensate();
+    test_init();
+    test_forced();
+    test_skipped_pressure();
+
+    printf("test_dev_bmp280: %s, %u failed\n", (test_fail_cnt) ? "FAIL" : "PASS", test_fail_cnt);
+    return ((test_fail_cnt) ? 1 : 0);
+} // end: main()
+
+/* EOF test_dev_bmp280.c */
@@ -0,0 +1,199 @@
+// @file    test_sys_i2c_bulk.c
+//
+// @brief  Host test of sys_i2c_write_bulk() / sys_i2c_read_bulk() chunking against a simulated 24C02 EEPROM.
+//
+// @details
+// The simulated EEPROM: 256 bytes, 16 byte pages. A page write wraps inside its page, as the part does: a chunk across
+// a page boundary overwrites the start of the page. Every write and read is logged as a chunk.
+// sys_i2c_clock_get() is per device: TEST_ADDR_SLOW runs at 100 KHz, TEST_ADDR_FAST at 1 MHz, both on one I2C Bus.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+#include "app_config.h" // SYS_I2C_ID_00; includes sys_i2c.h
+#include "sys_i2c_clock.h" // sys_i2c_clock_get()
+
+#include <stdio.h> // printf()
+#include <string.h> // memset(), memcmp()
+#include "freertos/task.h" // taskYIELD()
+
+#define TEST_ADDR_EEPROM    (0x50U) // 400 KHz, port clk_speed
+#define TEST_ADDR_SLOW      (0x51U) // 100 KHz clock profile
+#define TEST_ADDR_FAST      (0x52U) // 1 MHz clock profile
+#define TEST_PAGE_SIZE      (16U)
+#define TEST_CHUNK_MAX      (64U)
+
+#define TEST_CHECK(cond)    test_check((cond), #cond, __LINE__)
+
+// GLOBAL RAM: the simulated EEPROM and the chunk log.
+static struct {
+    uint8_t     mem[256];
+    uint32_t    cross_cnt;                  // page writes across a page boundary: wrapped, data lost
+    uint32_t    chunk_cnt;
+    uint8_t     chunk_reg[TEST_CHUNK_MAX];
+    size_t      chunk_size[TEST_CHUNK_MAX];
+    uint32_t    yield_cnt;
+} sim;
+
+static uint32_t test_fail_cnt;
+
+static void test_check(bool pass_flag, const char * cond_addr, int line_num)
+{
+    if (pass_flag) { return; }
+    test_fail_cnt++;
+    printf("FAIL: line %d: %s\n", line_num, cond_addr);
+} // end: test_check()
+
+static void sim_reset(void)
+{
+    memset(&sim, 0, sizeof(sim));
+    memset(sim.mem, 0xFF, sizeof(sim.mem)); // erased
+} // end: sim_reset()
+
+static void sim_chunk_log(uint8_t i2c_reg_num, size_t buf_size)
+{
+    if (TEST_CHUNK_MAX > sim.chunk_cnt) {
+        sim.chunk_reg[sim.chunk_cnt]  = i2c_reg_num;
+        sim.chunk_size[sim.chunk_cnt] = buf_size;
+    }
+    sim.chunk_cnt++;
+} // end: sim_chunk_log()
+
+// Simulated SYS_I2C API.
+
+bool sys_i2c_write(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size)
+{
+    const size_t page_num = i2c_reg_num / TEST_PAGE_SIZE;
+    size_t idx;
+
+    sim_chunk_log(i2c_reg_num, buf_size);
+    if (TEST_PAGE_SIZE < ((i2c_reg_num % TEST_PAGE_SIZE) + buf_size)) { sim.cross_cnt++; }
+    for (idx = 0; buf_size > idx; ++idx) { // address counter: low 4 bits only, wraps inside the page
+        sim.mem[(page_num * TEST_PAGE_SIZE) + ((i2c_reg_num + idx) % TEST_PAGE_SIZE)] = buf_addr[idx];
+    }
+    return (true);
+} // end: sys_i2c_write()
+
+bool sys_i2c_read(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size)
+{
+    sim_chunk_log(i2c_reg_num, buf_size);
+    if (256U < (i2c_reg_num + buf_size)) { return (false); }
+    memcpy(buf_addr, &sim.mem[i2c_reg_num], buf_size); // sequential read crosses pages
+    return (true);
+} // end: sys_i2c_read()
+
+bool sys_i2c_probe(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool * found_flag_addr)
+{
+    *found_flag_addr = true; // write cycle done at once
+    return (true);
+} // end: sys_i2c_probe()
+
+uint32_t sys_i2c_clock_get(uint8_t sys_i2c_id, uint8_t i2c_addr_num)
+{
+    if (TEST_ADDR_SLOW == i2c_addr_num) { return (100000U); }
+    if (TEST_ADDR_FAST == i2c_addr_num) { return (1000000U); }
+    return (400000U);
+} // end: sys_i2c_clock_get()
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (0);
+} // end: xTaskGetTickCount()
+
+void vPortYield(void)
+{
+    sim.yield_cnt++;
+} // end: vPortYield()
+
+// Tests
+
+static void test_write_unaligned(void)
+{
+    uint8_t buf[64];
+    size_t idx;
+
+    for (idx = 0; sizeof(buf) > idx; ++idx) { buf[idx] = (uint8_t)idx; }
+
+    // 0x1C, 64 bytes, 16 byte pages: 4 to the boundary, three full pages, 12 left. No chunk across a page.
+    sim_reset();
+    TEST_CHECK(sys_i2c_write_bulk(SYS_I2C_ID_00, TEST_ADDR_EEPROM, 0x1C, buf, sizeof(buf), TEST_PAGE_SIZE, SYS_I2C_BULK_REG_INCR | SYS_I2C_BULK_ACK_POLL));
+    TEST_CHECK(0 == sim.cross_cnt);
+    TEST_CHECK(5 == sim.chunk_cnt);
+    TEST_CHECK((0x1C == sim.chunk_reg[0]) && (4 == sim.chunk_size[0]));
+    TEST_CHECK((0x20 == sim.chunk_reg[1]) && (16 == sim.chunk_size[1]));
+    TEST_CHECK((0x30 == sim.chunk_reg[2]) && (16 == sim.chunk_size[2]));
+    TEST_CHECK((0x40 == sim.chunk_reg[3]) && (16 == sim.chunk_size[3]));
+    TEST_CHECK((0x50 == sim.chunk_reg[4]) && (12 == sim.chunk_size[4]));
+    TEST_CHECK(0 == memcmp(&sim.mem[0x1C], buf, sizeof(buf)));
+    TEST_CHECK(0xFF == sim.mem[0x1B]);
+    TEST_CHECK(0xFF == sim.mem[0x5C]);
+
+    // No yield after the last chunk.
+    TEST_CHECK(4 == sim.yield_cnt);
+
+    // Aligned start, inside one page: one chunk, no yield.
+    sim_reset();
+    TEST_CHECK(sys_i2c_write_bulk(SYS_I2C_ID_00, TEST_ADDR_EEPROM, 0x30, buf, 16, TEST_PAGE_SIZE, SYS_I2C_BULK_REG_INCR));
+    TEST_CHECK((1 == sim.chunk_cnt) && (0 == sim.cross_cnt) && (0 == sim.yield_cnt));
+    TEST_CHECK(0 == memcmp(&sim.mem[0x30], buf, 16));
+
+    // Past register 0xFF: rejected, nothing written.
+    sim_reset();
+    TEST_CHECK(!sys_i2c_write_bulk(SYS_I2C_ID_00, TEST_ADDR_EEPROM, 0xF8, buf, 16, TEST_PAGE_SIZE, SYS_I2C_BULK_REG_INCR));
+    TEST_CHECK(0 == sim.chunk_cnt);
+} // end: test_write_unaligned()
+
+static void test_read_unaligned(void)
+{
+    uint8_t buf[40];
+    size_t idx;
+
+    sim_reset();
+    for (idx = 0; sizeof(sim.mem) > idx; ++idx) { sim.mem[idx] = (uint8_t)(idx ^ 0xA5); }
+
+    TEST_CHECK(sys_i2c_read_bulk(SYS_I2C_ID_00, TEST_ADDR_EEPROM, 0x0A, buf, sizeof(buf), TEST_PAGE_SIZE, SYS_I2C_BULK_REG_INCR));
+    TEST_CHECK(0 == memcmp(buf, &sim.mem[0x0A], sizeof(buf)));
+    TEST_CHECK(4 == sim.chunk_cnt); // 6, 16, 16, 2
+    TEST_CHECK((0x0A == sim.chunk_reg[0]) && (6 == sim.chunk_size[0]));
+    TEST_CHECK((0x30 == sim.chunk_reg[3]) && (2 == sim.chunk_size[3]));
+    TEST_CHECK(3 == sim.yield_cnt);
+} // end: test_read_unaligned()
+
+static void test_device_clock(void)
+{
+    uint8_t buf[100];
+
+    memset(buf, 0x5A, sizeof(buf));
+
+    // SYS_I2C_LOCK_HOLD_MAX_US 2000, 9 bits per byte, 3 bytes overhead. 100 KHz: 19 bytes; 400 KHz: 85; 1 MHz: 219.
+    sim_reset();
+    TEST_CHECK(sys_i2c_write_bulk(SYS_I2C_ID_00, TEST_ADDR_SLOW, 0x40, buf, sizeof(buf), 0, SYS_I2C_BULK_REG_FIXED));
+    TEST_CHECK(6 == sim.chunk_cnt);
+    TEST_CHECK((19 == sim.chunk_size[0]) && (5 == sim.chunk_size[5]));
+    TEST_CHECK((0x40 == sim.chunk_reg[0]) && (0x40 == sim.chunk_reg[5]));
+
+    sim_reset();
+    TEST_CHECK(sys_i2c_write_bulk(SYS_I2C_ID_00, TEST_ADDR_EEPROM, 0x40, buf, sizeof(buf), 0, SYS_I2C_BULK_REG_FIXED));
+    TEST_CHECK((2 == sim.chunk_cnt) && (85 == sim.chunk_size[0]));
+
+    sim_reset();
+    TEST_CHECK(sys_i2c_write_bulk(SYS_I2C_ID_00, TEST_ADDR_FAST, 0x40, buf, sizeof(buf), 0, SYS_I2C_BULK_REG_FIXED));
+    TEST_CHECK((1 == sim.chunk_cnt) && (100 == sim.chunk_size[0]));
+
+    // REG_FIXED stream: whole multiples of chunk_align, counted from the first byte.
+    sim_reset();
+    TEST_CHECK(sys_i2c_write_bulk(SYS_I2C_ID_00, TEST_ADDR_EEPROM, 0x40, buf, sizeof(buf), 32, SYS_I2C_BULK_REG_FIXED));
+    TEST_CHECK((2 == sim.chunk_cnt) && (64 == sim.chunk_size[0]) && (36 == sim.chunk_size[1]));
+} // end: test_device_clock()
+
+int main(void)
+{
+    test_write_unaligned();
+    test_read_unaligned();
+    test_device_clock();
+
+    printf("test_sys_i2c_bulk: %s, %u failed\n", (test_fail_cnt) ? "FAIL" : "PASS", test_fail_cnt);
+    return ((test_fail_cnt) ? 1 : 0);
+} // end: main()
+
+/* EOF test_sys_i2c_bulk.c */
@@ -0,0 +1,86 @@
+// @file    test_sys_i2c_clock.c
+//
+// @brief  Host test of sys_i2c_clock_source(): clock source per transaction, one table for every build configuration.
+//
+// @details
+// Built three times, see CMakeLists.txt: PM off, PM on (CONFIG_PM_ENABLE), ESP32-IDF < 4.3 (no clk_flags, APB only).
+// Each row: port clk_flags policy, transaction clk_speed, expected source with PM off and with PM on.
+// The port lock, *_locked() bodies and discovery sys_i2c_clock.c links against are stubs; the source choice uses none.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+#include "sys_i2c_clock.h" // includes app_config.h, sys_i2c.h
+#include "sys_i2c_discover.h" // sys_i2c_discover_ready(), sys_i2c_discover_found()
+#include "sys_i2c_priv.h" // sys_i2c_clock_source()
+
+#include <stdio.h> // printf()
+
+#define TEST_APB        (I2C_SCLK_SRC_FLAG_FOR_NOMAL)
+#define TEST_REF_TICK   (I2C_SCLK_SRC_FLAG_AWARE_DFS)
+
+struct TEST_CLOCK_ROW {
+    uint32_t    clk_flags;      // port policy, SYS_I2C_config.port[].clk_flags
+    uint32_t    clk_speed;      // this transaction: port clk_speed or the device clock profile
+    uint32_t    pm_off_flags;   // expected, SYS_I2C_PM_ENABLE false
+    uint32_t    pm_on_flags;    // expected, SYS_I2C_PM_ENABLE true
+};
+
+static const struct TEST_CLOCK_ROW test_clock_row[] = {
+    // above 50 KHz: APB whatever the policy; REF_TICK cannot divide down to it
+    { TEST_APB,         400000, TEST_APB,       TEST_APB        },
+    { TEST_APB,         100000, TEST_APB,       TEST_APB        },
+    { TEST_APB,         50001,  TEST_APB,       TEST_APB        },
+    { TEST_REF_TICK,    400000, TEST_APB,       TEST_APB        }, // AWARE_DFS port, faster clock profile
+    { TEST_REF_TICK,    50001,  TEST_APB,       TEST_APB        },
+    // 50 KHz and below: REF_TICK when asked for, or when PM may scale APB under the transfer
+    { TEST_APB,         50000,  TEST_APB,       TEST_REF_TICK   },
+    { TEST_APB,         10000,  TEST_APB,       TEST_REF_TICK   },
+    { TEST_REF_TICK,    50000,  TEST_REF_TICK,  TEST_REF_TICK   },
+    { TEST_REF_TICK,    10000,  TEST_REF_TICK,  TEST_REF_TICK   },
+};
+
+// GLOBAL RAM: what sys_i2c.c owns on target.
+struct SYS_I2C_RUNTIME SYS_I2C_runtime;
+static struct SYS_I2C_UNIT test_unit[SYS_I2C_ID_CNT];
+
+// Stubs: sys_i2c_clock.c links against these; sys_i2c_clock_source() calls none of them.
+bool sys_i2c_port_take(uint8_t sys_i2c_id) { return (true); }
+bool sys_i2c_port_give(uint8_t sys_i2c_id) { return (true); }
+bool sys_i2c_read_locked(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size) { return (false); }
+bool sys_i2c_write_locked(uint8_t sys_i2c_id, uint8_t i2c_addr_num, uint8_t i2c_reg_num, uint8_t * buf_addr, size_t buf_size) { return (false); }
+bool sys_i2c_probe_locked(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool * found_flag_addr) { return (false); }
+bool sys_i2c_probe(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool * found_flag_addr) { return (false); }
+bool sys_i2c_discover_ready(uint8_t sys_i2c_id) { return (false); }
+bool sys_i2c_discover_found(uint8_t sys_i2c_id, uint8_t i2c_addr_num, bool * found_flag_addr) { return (false); }
+
+int main(void)
+{
+    uint32_t fail_cnt = 0;
+    size_t row_idx;
+
+    SYS_I2C_runtime.unit = test_unit;
+    for (row_idx = 0; (sizeof(test_clock_row) / sizeof(test_clock_row[0])) > row_idx; ++row_idx) {
+        const struct TEST_CLOCK_ROW * const row_addr = &test_clock_row[row_idx];
+        #if (SYS_I2C_CLK_FLAGS_ENABLE == true)
+        const uint32_t expect_flags = (SYS_I2C_PM_ENABLE == true) ? row_addr->pm_on_flags : row_addr->pm_off_flags;
+        #else
+        const uint32_t expect_flags = TEST_APB; // ESP32-IDF < 4.3: APB only
+        #endif
+
+        test_unit[SYS_I2C_ID_00].clk_flags = row_addr->clk_flags;
+        test_unit[SYS_I2C_ID_00].clk_speed = row_addr->clk_speed;
+        const uint32_t clk_flags = sys_i2c_clock_source(SYS_I2C_ID_00, row_addr->clk_speed);
+        if (expect_flags != clk_flags) {
+            fail_cnt++;
+            printf("FAIL: row %zu: clk_flags = %u, clk_speed = %u: got %u, expected %u\n", row_idx,
+                   row_addr->clk_flags, row_addr->clk_speed, clk_flags, expect_flags);
+        }
+    }
+
+    printf("test_sys_i2c_clock: PM %s, clk_flags %s: %s, %u failed\n", (SYS_I2C_PM_ENABLE == true) ? "ON" : "OFF",
+           (SYS_I2C_CLK_FLAGS_ENABLE == true) ? "ON" : "OFF", (fail_cnt) ? "FAIL" : "PASS", fail_cnt);
+    return ((fail_cnt) ? 1 : 0);
+} // end: main()
+
+/* EOF test_sys_i2c_clock.c */
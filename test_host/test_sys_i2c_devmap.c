@@ -0,0 +1,242 @@
+// @file    test_sys_i2c_devmap.c
+//
+// @brief  Host test of the persisted device map: file backend, record encode/decode, rejected records.
+//
+// @details
+// sys_i2c_devmap_save() through sys_i2c_devmap_file_save() into a temporary directory, sys_i2c_devmap_load() back.
+// Each corrupt record is written with the file backend itself: bad magic, version, bus count, bsp_id, CRC, truncated.
+// Header fields are changed with the CRC fixed up, so the field check, not the CRC, must reject them.
+// sys_i2c_discover_map() returns a fixed map; sys_i2c_smbus_pec() is a bitwise CRC-8, polynomial 0x07, the SMBus PEC.
+//
+// SPDX-FileCopyrightText: 2021 burtrum
+// SPDX-License-Identifier: Apache-2.0
+//
+#include "sys_i2c_devmap.h" // includes app_config.h, sys_i2c.h
+#include "sys_i2c_discover.h" // sys_i2c_discover_map()
+#include "sys_i2c_smbus.h" // sys_i2c_smbus_pec()
+
+#include <stdio.h> // printf(), snprintf(), remove()
+#include <stdlib.h> // mkdtemp()
+#include <string.h> // memset(), memcmp()
+#include <unistd.h> // rmdir()
+
+#define TEST_BSP_ID         (3U)
+#define TEST_BSP_ID_OTHER   (4U)
+#define TEST_KEY            "i2c_map_3"     // SYS_I2C_DEVMAP_KEY_FMT, TEST_BSP_ID
+#define TEST_KEY_OTHER      "i2c_map_4"
+#define TEST_PATH_SIZE      (128U)
+
+#define TEST_CHECK(cond)    test_check((cond), #cond, __LINE__)
+
+// GLOBAL RAM: the discovered map, the temporary directory, backend call counts.
+static uint32_t test_found_map[SYS_I2C_ID_CNT][4];
+static bool     test_discover_flag;
+static char     test_dir[] = "/tmp/test_sys_i2c_devmap_XXXXXX";
+static uint32_t test_save_cnt;
+static uint32_t test_fail_cnt;
+
+static void test_check(bool pass_flag, const char * cond_addr, int line_num)
+{
+    if (pass_flag) { return; }
+    test_fail_cnt++;
+    printf("FAIL: line %d: %s\n", line_num, cond_addr);
+} // end: test_check()
+
+// Counting wrapper: sys_i2c_devmap_save() must not write an unchanged record.
+static bool test_file_save(const void * ctx, const char * key, const uint8_t * buf_addr, size_t buf_size)
+{
+    test_save_cnt++;
+    return (sys_i2c_devmap_file_save(ctx, key, buf_addr, buf_size));
+} // end: test_file_save()
+
+static const struct SYS_I2C_DEVMAP_STORE test_store = {
+    .load   = sys_i2c_devmap_file_load,
+    .save   = test_file_save,
+    .ctx    = test_dir,
+};
+
+// Simulated SYS_I2C API.
+
+bool sys_i2c_discover_map(uint8_t sys_i2c_id, uint32_t found_map[4], bool * full_scan_flag_addr)
+{
+    if (!test_discover_flag) { return (false); } // discovery not done
+    memcpy(found_map, test_found_map[sys_i2c_id], sizeof(test_found_map[0]));
+    if (full_scan_flag_addr) { *full_scan_flag_addr = true; }
+    return (true);
+} // end: sys_i2c_discover_map()
+
+uint8_t sys_i2c_smbus_pec(uint8_t pec_num, const uint8_t * buf_addr, size_t buf_size)
+{
+    uint8_t bit_idx;
+
+    while (buf_size--) {
+        pec_num ^= *buf_addr++;
+        for (bit_idx = 0; 8 > bit_idx; ++bit_idx) {
+            pec_num = (pec_num & 0x80U) ? (uint8_t)((pec_num << 1) ^ 0x07U) : (uint8_t)(pec_num << 1);
+        }
+    }
+    return (pec_num);
+} // end: sys_i2c_smbus_pec()
+
+// Helpers
+
+static void test_map_set(uint32_t map[4], uint8_t i2c_addr_num)
+{
+    map[i2c_addr_num / 32] |= (1UL << (i2c_addr_num % 32));
+} // end: test_map_set()
+
+static void test_rec_read(const char * key, uint8_t rec_buf[SYS_I2C_DEVMAP_RECORD_SIZE])
+{
+    size_t read_size = 0;
+
+    TEST_CHECK(sys_i2c_devmap_file_load(test_dir, key, rec_buf, SYS_I2C_DEVMAP_RECORD_SIZE, &read_size));
+    TEST_CHECK(SYS_I2C_DEVMAP_RECORD_SIZE == read_size);
+} // end: test_rec_read()
+
+// The saved record as a valid TEST_BSP_ID_OTHER record, then one byte XOR xor_num, loaded as TEST_BSP_ID_OTHER.
+// crc_flag: fix the CRC up after the change, so only the changed field is wrong.
+static bool test_load_patched(size_t byte_idx, uint8_t xor_num, bool crc_flag)
+{
+    uint8_t rec_buf[SYS_I2C_DEVMAP_RECORD_SIZE];
+    uint32_t known_map[SYS_I2C_ID_CNT][4];
+
+    test_rec_read(TEST_KEY, rec_buf);
+    rec_buf[3] = TEST_BSP_ID_OTHER;
+    rec_buf[sizeof(rec_buf) - 1] = sys_i2c_smbus_pec(0, rec_buf, sizeof(rec_buf) - 1);
+    rec_buf[byte_idx] ^= xor_num;
+    if (crc_flag) { rec_buf[sizeof(rec_buf) - 1] = sys_i2c_smbus_pec(0, rec_buf, sizeof(rec_buf) - 1); }
+    TEST_CHECK(sys_i2c_devmap_file_save(test_dir, TEST_KEY_OTHER, rec_buf, sizeof(rec_buf)));
+    return (sys_i2c_devmap_load(&test_store, TEST_BSP_ID_OTHER, known_map));
+} // end: test_load_patched()
+
+// Tests
+
+static void test_round_trip(void)
+{
+    uint8_t rec_buf[SYS_I2C_DEVMAP_RECORD_SIZE];
+    uint32_t known_map[SYS_I2C_ID_CNT][4];
+
+    // Discovery not done: nothing saved.
+    test_discover_flag = false;
+    TEST_CHECK(!sys_i2c_devmap_save(&test_store, TEST_BSP_ID));
+    TEST_CHECK(0 == test_save_cnt);
+
+    // No record yet: load fails, full scan.
+    TEST_CHECK(!sys_i2c_devmap_load(&test_store, TEST_BSP_ID, known_map));
+
+    // First and last valid address bits, and a few real parts: SSD1306 0x3C, 24C02 0x50, BMP280 0x76/0x77.
+    memset(test_found_map, 0, sizeof(test_found_map));
+    test_map_set(test_found_map[SYS_I2C_ID_00], 0x08);
+    test_map_set(test_found_map[SYS_I2C_ID_00], 0x3C);
+    test_map_set(test_found_map[SYS_I2C_ID_00], 0x50);
+    test_map_set(test_found_map[SYS_I2C_ID_00], 0x76);
+    test_map_set(test_found_map[SYS_I2C_ID_00], 0x77);
+    test_discover_flag = true;
+    TEST_CHECK(sys_i2c_devmap_save(&test_store, TEST_BSP_ID));
+    TEST_CHECK(1 == test_save_cnt);
+
+    // Record layout, byte by byte.
+    test_rec_read(TEST_KEY, rec_buf);
+    TEST_CHECK(('S' == rec_buf[0]) && ('M' == rec_buf[1]));
+    TEST_CHECK(SYS_I2C_DEVMAP_VERSION == rec_buf[2]);
+    TEST_CHECK(TEST_BSP_ID == rec_buf[3]);
+    TEST_CHECK(SYS_I2C_ID_CNT == rec_buf[4]);
+    TEST_CHECK(0x01 == rec_buf[SYS_I2C_DEVMAP_HEAD_SIZE + (0x08 / 8)]);         // 0x08: bit 0
+    TEST_CHECK(0x10 == rec_buf[SYS_I2C_DEVMAP_HEAD_SIZE + (0x3C / 8)]);         // 0x3C: bit 4
+    TEST_CHECK(0x01 == rec_buf[SYS_I2C_DEVMAP_HEAD_SIZE + (0x50 / 8)]);         // 0x50: bit 0
+    TEST_CHECK(0xC0 == rec_buf[SYS_I2C_DEVMAP_HEAD_SIZE + (0x76 / 8)]);         // 0x76, 0x77: bits 6, 7
+    TEST_CHECK(sys_i2c_smbus_pec(0, rec_buf, sizeof(rec_buf) - 1) == rec_buf[sizeof(rec_buf) - 1]);
+
+    // Load: same words back; known_map cleared first.
+    memset(known_map, 0xFF, sizeof(known_map));
+    TEST_CHECK(sys_i2c_devmap_load(&test_store, TEST_BSP_ID, known_map));
+    TEST_CHECK(0 == memcmp(known_map, test_found_map, sizeof(known_map)));
+
+    // Unchanged: no write. Changed: written again, and loads back.
+    TEST_CHECK(sys_i2c_devmap_save(&test_store, TEST_BSP_ID));
+    TEST_CHECK(1 == test_save_cnt);
+    test_map_set(test_found_map[SYS_I2C_ID_00], 0x68);
+    TEST_CHECK(sys_i2c_devmap_save(&test_store, TEST_BSP_ID));
+    TEST_CHECK(2 == test_save_cnt);
+    TEST_CHECK(sys_i2c_devmap_load(&test_store, TEST_BSP_ID, known_map));
+    TEST_CHECK(0 == memcmp(known_map, test_found_map, sizeof(known_map)));
+} // end: test_round_trip()
+
+static void test_reject(void)
+{
+    uint8_t rec_buf[SYS_I2C_DEVMAP_RECORD_SIZE];
+    uint32_t known_map[SYS_I2C_ID_CNT][4];
+
+    // Unchanged: accepted. The patch helper itself is sound.
+    TEST_CHECK(test_load_patched(0, 0x00, false));
+
+    // Header fields, CRC fixed up: the field check rejects them.
+    TEST_CHECK(!test_load_patched(0, 0x01, true));                              // magic
+    TEST_CHECK(!test_load_patched(1, 0x01, true));
+    TEST_CHECK(!test_load_patched(2, 0x01, true));                              // version
+    TEST_CHECK(!test_load_patched(3, TEST_BSP_ID ^ TEST_BSP_ID_OTHER, true));   // bsp_id 3 in the bsp_id 4 slot
+    TEST_CHECK(!test_load_patched(4, 0x01, true));                              // bus count
+
+    // Payload or CRC byte changed, CRC left alone.
+    TEST_CHECK(!test_load_patched(SYS_I2C_DEVMAP_HEAD_SIZE, 0x01, false));
+    TEST_CHECK(!test_load_patched(SYS_I2C_DEVMAP_RECORD_SIZE - 1, 0x80, false));
+
+    // Truncated, from a valid TEST_BSP_ID_OTHER record: one byte short, header only, empty.
+    test_rec_read(TEST_KEY, rec_buf);
+    rec_buf[3] = TEST_BSP_ID_OTHER;
+    rec_buf[sizeof(rec_buf) - 1] = sys_i2c_smbus_pec(0, rec_buf, sizeof(rec_buf) - 1);
+    TEST_CHECK(sys_i2c_devmap_file_save(test_dir, TEST_KEY_OTHER, rec_buf, sizeof(rec_buf) - 1));
+    TEST_CHECK(!sys_i2c_devmap_load(&test_store, TEST_BSP_ID_OTHER, known_map));
+    TEST_CHECK(sys_i2c_devmap_file_save(test_dir, TEST_KEY_OTHER, rec_buf, SYS_I2C_DEVMAP_HEAD_SIZE));
+    TEST_CHECK(!sys_i2c_devmap_load(&test_store, TEST_BSP_ID_OTHER, known_map));
+    TEST_CHECK(sys_i2c_devmap_file_save(test_dir, TEST_KEY_OTHER, rec_buf, 0));
+    TEST_CHECK(!sys_i2c_devmap_load(&test_store, TEST_BSP_ID_OTHER, known_map));
+} // end: test_reject()
+
+static void test_file_backend(void)
+{
+    uint8_t rec_buf[SYS_I2C_DEVMAP_RECORD_SIZE];
+    char long_dir[SYS_I2C_DEVMAP_RECORD_SIZE * 4];
+    size_t read_size = 0;
+
+    memset(rec_buf, 0xA5, sizeof(rec_buf));
+    TEST_CHECK(!sys_i2c_devmap_file_load(test_dir, "i2c_map_99", rec_buf, sizeof(rec_buf), &read_size)); // no file
+    TEST_CHECK(!sys_i2c_devmap_file_load(NULL, TEST_KEY, rec_buf, sizeof(rec_buf), &read_size));
+    TEST_CHECK(!sys_i2c_devmap_file_save(test_dir, NULL, rec_buf, sizeof(rec_buf)));
+    TEST_CHECK(!sys_i2c_devmap_file_save("/nonexistent_dir", TEST_KEY, rec_buf, sizeof(rec_buf)));
+
+    // Path longer than SYS_I2C_DEVMAP_PATH_SIZE: rejected, not truncated to some other file.
+    memset(long_dir, 'd', sizeof(long_dir) - 1);
+    long_dir[sizeof(long_dir) - 1] = '\0';
+    TEST_CHECK(!sys_i2c_devmap_file_save(long_dir, TEST_KEY, rec_buf, sizeof(rec_buf)));
+    TEST_CHECK(!sys_i2c_devmap_file_load(long_dir, TEST_KEY, rec_buf, sizeof(rec_buf), &read_size));
+} // end: test_file_backend()
+
+static void test_cleanup(void)
+{
+    char path[TEST_PATH_SIZE];
+
+    (void)snprintf(path, sizeof(path), "%s/%s.bin", test_dir, TEST_KEY);
+    (void)remove(path);
+    (void)snprintf(path, sizeof(path), "%s/%s.bin", test_dir, TEST_KEY_OTHER);
+    (void)remove(path);
+    (void)rmdir(test_dir);
+} // end: test_cleanup()
+
+int main(void)
+{
+    if (!mkdtemp(test_dir)) {
+        printf("test_sys_i2c_devmap: FAIL, mkdtemp()\n");
+        return (1);
+    }
+
+    test_round_trip();
+    test_reject();
+    test_file_backend();
+    test_cleanup();
+
+    printf("test_sys_i2c_devmap: %s, %u failed\n", (test_fail_cnt) ? "FAIL" : "PASS", test_fail_cnt);
+    return ((test_fail_cnt) ? 1 : 0);
+} // end: main()
+
+/* EOF test_sys_i2c_devmap.c */